@@ -0,0 +1,127 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+
+#pragma once
+
+// cpp headers
+#include <cstddef>
+// os headers
+#include <Windows.h>
+#include <intrin.h>
+#include <nmmintrin.h>
+
+
+namespace ctl {
+
+    ///
+    /// ctCrc32c namespace contains functions to calculate a CRC-32C (Castagnoli) checksum
+    /// - uses the SSE 4.2 crc32 instruction when the processor supports it
+    /// - otherwise falls back to a table-driven software implementation
+    ///
+    /// Callers can calculate a checksum over discontiguous buffers by passing the prior
+    /// - returned value into the next call to update(); start with 0 for a new checksum
+    ///
+    namespace ctCrc32c {
+
+        ///
+        /// InitOnce the lookup table and the processor check
+        /// - the state is selectany so every translation unit shares the one table
+        ///
+        namespace details {
+            __declspec(selectany) INIT_ONCE s_Crc32cInitOnce = INIT_ONCE_STATIC_INIT;
+            __declspec(selectany) unsigned long s_Crc32cTable[256];
+            __declspec(selectany) bool s_Crc32cHardware = false;
+
+            inline
+            BOOL CALLBACK s_Crc32cInitOnceCallback(_In_ PINIT_ONCE, _In_ PVOID, _In_ PVOID*)
+            {
+                // reversed Castagnoli polynomial
+                static const unsigned long Crc32cPolynomial = 0x82F63B78UL;
+                for (unsigned long index = 0; index < 256; ++index) {
+                    unsigned long crc = index;
+                    for (unsigned bit = 0; bit < 8; ++bit) {
+                        crc = (crc & 1) ? (crc >> 1) ^ Crc32cPolynomial : (crc >> 1);
+                    }
+                    s_Crc32cTable[index] = crc;
+                }
+
+                // CPUID function 1 : ECX bit 20 indicates SSE 4.2
+                int cpu_info[4] = { 0 };
+                ::__cpuid(cpu_info, 1);
+                s_Crc32cHardware = (cpu_info[2] & (1 << 20)) != 0;
+                return TRUE;
+            }
+
+            inline
+            unsigned long update_software(unsigned long _crc, const unsigned char* _buffer, size_t _length) throw()
+            {
+                while (_length-- > 0) {
+                    _crc = s_Crc32cTable[(_crc ^ *_buffer++) & 0xff] ^ (_crc >> 8);
+                }
+                return _crc;
+            }
+
+            inline
+            unsigned long update_hardware(unsigned long _crc, const unsigned char* _buffer, size_t _length) throw()
+            {
+#if defined(_M_X64)
+                unsigned long long crc64 = _crc;
+                while (_length >= sizeof(unsigned long long)) {
+                    crc64 = _mm_crc32_u64(crc64, *reinterpret_cast<const unsigned long long*>(_buffer));
+                    _buffer += sizeof(unsigned long long);
+                    _length -= sizeof(unsigned long long);
+                }
+                _crc = static_cast<unsigned long>(crc64);
+#endif
+                while (_length >= sizeof(unsigned int)) {
+                    _crc = _mm_crc32_u32(_crc, *reinterpret_cast<const unsigned int*>(_buffer));
+                    _buffer += sizeof(unsigned int);
+                    _length -= sizeof(unsigned int);
+                }
+                while (_length-- > 0) {
+                    _crc = _mm_crc32_u8(_crc, *_buffer++);
+                }
+                return _crc;
+            }
+        }
+
+        ///
+        /// Continues a CRC-32C calculation over the given buffer
+        /// - _crc is the value returned from the prior call (or 0 to begin a new checksum)
+        ///
+        inline
+        unsigned long update(unsigned long _crc, _In_reads_bytes_(_length) const void* _buffer, size_t _length) throw()
+        {
+            (void) ::InitOnceExecuteOnce(&details::s_Crc32cInitOnce, details::s_Crc32cInitOnceCallback, nullptr, nullptr);
+            const unsigned char* buffer = static_cast<const unsigned char*>(_buffer);
+            _crc = ~_crc;
+            _crc = details::s_Crc32cHardware ?
+                details::update_hardware(_crc, buffer, _length) :
+                details::update_software(_crc, buffer, _length);
+            return ~_crc;
+        }
+
+        ///
+        /// Returns true if the processor's crc32 instruction is being used
+        ///
+        inline
+        bool is_hardware_accelerated() throw()
+        {
+            (void) ::InitOnceExecuteOnce(&details::s_Crc32cInitOnce, details::s_Crc32cInitOnceCallback, nullptr, nullptr);
+            return details::s_Crc32cHardware;
+        }
+
+    } // namespace ctCrc32c
+
+} // namespace ctl
@@ -0,0 +1,247 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+
+#pragma once
+
+// os headers
+#include <Windows.h>
+#include <intrin.h>
+// ctl headers
+#include "ctLocks.hpp"
+
+
+namespace ctl {
+
+    ///
+    /// ctHistogram records the distribution of non-negative integer values
+    /// - values are tracked in log-linear buckets: each power-of-two range is split into 8 equal buckets
+    ///   so any reported value is within 12.5% of the value which was recorded
+    /// - values below 8 are recorded exactly; values at or above 2^48 are recorded in the last bucket
+    ///
+    /// All methods are concurrent-safe through Interlocked* operations
+    /// - no locks are taken, so it can be updated from IO completion paths
+    /// - a copy or a snap() taken while values are being added is not an atomic view across all buckets
+    ///
+    class ctHistogram {
+    public:
+        static const unsigned long SubBucketBits = 3;
+        static const unsigned long SubBucketCount = 1UL << SubBucketBits;
+        static const unsigned long MaximumValueBits = 48;
+        static const unsigned long BucketCount = (MaximumValueBits - SubBucketBits + 1) * SubBucketCount;
+
+        ctHistogram() throw() :
+            buckets(),
+            value_count(0LL),
+            value_sum(0LL),
+            value_minimum(MAXLONGLONG),
+            value_maximum(0LL)
+        {
+        }
+        ///
+        /// implementing the copy c'tor with memory barriers in place
+        ///
+        ctHistogram(const ctHistogram& _in) throw() :
+            buckets(),
+            value_count(ctMemoryGuardRead(&_in.value_count)),
+            value_sum(ctMemoryGuardRead(&_in.value_sum)),
+            value_minimum(ctMemoryGuardRead(&_in.value_minimum)),
+            value_maximum(ctMemoryGuardRead(&_in.value_maximum))
+        {
+            for (unsigned long bucket = 0; bucket < BucketCount; ++bucket) {
+                buckets[bucket] = ctMemoryGuardRead(&_in.buckets[bucket]);
+            }
+        }
+
+        void add(long long _value) throw()
+        {
+            if (_value < 0) {
+                _value = 0;
+            }
+            ctMemoryGuardIncrement(&this->buckets[bucket_index(_value)]);
+            ctMemoryGuardIncrement(&this->value_count);
+            ctMemoryGuardAdd(&this->value_sum, _value);
+
+            long long current = ctMemoryGuardRead(&this->value_minimum);
+            while (_value < current) {
+                long long prior = ctMemoryGuardWriteConditionally(&this->value_minimum, _value, current);
+                if (prior == current) {
+                    break;
+                }
+                current = prior;
+            }
+            current = ctMemoryGuardRead(&this->value_maximum);
+            while (_value > current) {
+                long long prior = ctMemoryGuardWriteConditionally(&this->value_maximum, _value, current);
+                if (prior == current) {
+                    break;
+                }
+                current = prior;
+            }
+        }
+
+        ///
+        /// Adds every value recorded in the [in] histogram into this histogram
+        ///
+        void merge(const ctHistogram& _in) throw()
+        {
+            long long in_count = ctMemoryGuardRead(&_in.value_count);
+            if (0 == in_count) {
+                return;
+            }
+            for (unsigned long bucket = 0; bucket < BucketCount; ++bucket) {
+                long long bucket_count = ctMemoryGuardRead(&_in.buckets[bucket]);
+                if (bucket_count > 0) {
+                    ctMemoryGuardAdd(&this->buckets[bucket], bucket_count);
+                }
+            }
+            ctMemoryGuardAdd(&this->value_count, in_count);
+            ctMemoryGuardAdd(&this->value_sum, ctMemoryGuardRead(&_in.value_sum));
+
+            long long in_minimum = ctMemoryGuardRead(&_in.value_minimum);
+            long long current = ctMemoryGuardRead(&this->value_minimum);
+            while (in_minimum < current) {
+                long long prior = ctMemoryGuardWriteConditionally(&this->value_minimum, in_minimum, current);
+                if (prior == current) {
+                    break;
+                }
+                current = prior;
+            }
+            long long in_maximum = ctMemoryGuardRead(&_in.value_maximum);
+            current = ctMemoryGuardRead(&this->value_maximum);
+            while (in_maximum > current) {
+                long long prior = ctMemoryGuardWriteConditionally(&this->value_maximum, in_maximum, current);
+                if (prior == current) {
+                    break;
+                }
+                current = prior;
+            }
+        }
+
+        ///
+        /// Copies the values recorded into the [out] histogram (which is expected to be empty)
+        /// - optionally resetting this histogram, to capture the delta between calls
+        ///
+        void snap(ctHistogram& _out, bool _clear) throw()
+        {
+            if (!_clear) {
+                _out.merge(*this);
+                return;
+            }
+
+            for (unsigned long bucket = 0; bucket < BucketCount; ++bucket) {
+                long long bucket_count = ctMemoryGuardWrite(&this->buckets[bucket], 0LL);
+                if (bucket_count > 0) {
+                    ctMemoryGuardAdd(&_out.buckets[bucket], bucket_count);
+                }
+            }
+            ctMemoryGuardAdd(&_out.value_count, ctMemoryGuardWrite(&this->value_count, 0LL));
+            ctMemoryGuardAdd(&_out.value_sum, ctMemoryGuardWrite(&this->value_sum, 0LL));
+            ctMemoryGuardWrite(&_out.value_minimum, ctMemoryGuardWrite(&this->value_minimum, MAXLONGLONG));
+            ctMemoryGuardWrite(&_out.value_maximum, ctMemoryGuardWrite(&this->value_maximum, 0LL));
+        }
+
+        long long count() const throw()
+        {
+            return ctMemoryGuardRead(&this->value_count);
+        }
+        long long minimum() const throw()
+        {
+            return (this->count() > 0) ? ctMemoryGuardRead(&this->value_minimum) : 0LL;
+        }
+        long long maximum() const throw()
+        {
+            return ctMemoryGuardRead(&this->value_maximum);
+        }
+        long long mean() const throw()
+        {
+            long long current_count = this->count();
+            return (current_count > 0) ? ctMemoryGuardRead(&this->value_sum) / current_count : 0LL;
+        }
+
+        ///
+        /// Returns the value at the [in] percentile (0.0 - 100.0)
+        /// - reported as the upper bound of the bucket holding that value, never more than the maximum value recorded
+        ///
+        long long percentile(double _percentile) const throw()
+        {
+            long long current_count = this->count();
+            if (0 == current_count) {
+                return 0LL;
+            }
+
+            long long target = static_cast<long long>((_percentile / 100.0) * static_cast<double>(current_count) + 0.5);
+            if (target < 1) {
+                target = 1;
+            }
+            long long seen = 0;
+            for (unsigned long bucket = 0; bucket < BucketCount; ++bucket) {
+                seen += ctMemoryGuardRead(&this->buckets[bucket]);
+                if (seen >= target) {
+                    long long upper_bound = bucket_upper_bound(bucket);
+                    long long current_maximum = this->maximum();
+                    return (upper_bound < current_maximum) ? upper_bound : current_maximum;
+                }
+            }
+            return this->maximum();
+        }
+
+    private:
+        // not allowing assignment - must be explicit through snap() or merge()
+        ctHistogram& operator=(const ctHistogram&);
+
+        static unsigned long bucket_index(long long _value) throw()
+        {
+            if (_value < static_cast<long long>(SubBucketCount)) {
+                return static_cast<unsigned long>(_value);
+            }
+
+            unsigned long most_significant_bit;
+#if defined(_M_X64)
+            ::_BitScanReverse64(&most_significant_bit, static_cast<unsigned long long>(_value));
+#else
+            // _BitScanReverse64 is x64-only: scan the high 32 bits, then the low 32 bits
+            const unsigned long high_bits = static_cast<unsigned long>(static_cast<unsigned long long>(_value) >> 32);
+            if (::_BitScanReverse(&most_significant_bit, high_bits)) {
+                most_significant_bit += 32;
+            } else {
+                ::_BitScanReverse(&most_significant_bit, static_cast<unsigned long>(_value));
+            }
+#endif
+            if (most_significant_bit >= MaximumValueBits) {
+                return BucketCount - 1;
+            }
+            // the top SubBucketBits + 1 bits of the value select the bucket within its power-of-two range
+            unsigned long shift = most_significant_bit - SubBucketBits;
+            unsigned long sub_bucket = static_cast<unsigned long>(_value >> shift) - SubBucketCount;
+            return (shift + 1) * SubBucketCount + sub_bucket;
+        }
+
+        static long long bucket_upper_bound(unsigned long _bucket) throw()
+        {
+            if (_bucket < SubBucketCount) {
+                return static_cast<long long>(_bucket);
+            }
+            unsigned long shift = _bucket / SubBucketCount - 1;
+            unsigned long sub_bucket = _bucket % SubBucketCount;
+            return (static_cast<long long>(SubBucketCount + sub_bucket + 1) << shift) - 1;
+        }
+
+        long long buckets[BucketCount];
+        long long value_count;
+        long long value_sum;
+        long long value_minimum;
+        long long value_maximum;
+    };
+
+} // namespace ctl
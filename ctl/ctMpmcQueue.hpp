@@ -0,0 +1,167 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+
+#pragma once
+
+// cpp headers
+#include <memory>
+#include <utility>
+// os headers
+#include <Windows.h>
+// ctl headers
+#include "ctLocks.hpp"
+
+
+namespace ctl {
+
+    ///
+    /// ctMpmcQueue is a bounded FIFO queue for any number of producers and consumers
+    /// - no locks are taken: each cell carries a sequence number which producers and consumers
+    ///   claim through Interlocked* operations on the enqueue and dequeue positions
+    /// - the capacity is rounded up to a power of two; try_push fails (rather than blocks) when full
+    ///   and try_pop fails when empty
+    ///
+    /// T must be default-constructible, and copy and move assignment must not throw
+    /// - a popped cell is reset to T() so it doesn't hold a reference to what was popped
+    ///
+    template <typename T>
+    class ctMpmcQueue {
+    public:
+        explicit ctMpmcQueue(unsigned long _capacity) :
+            cells(),
+            cell_mask(0LL),
+            enqueue_position(0LL),
+            dequeue_position(0LL)
+        {
+            long long capacity = 2LL;
+            while (capacity < static_cast<long long>(_capacity)) {
+                capacity <<= 1;
+            }
+            // can throw std::bad_alloc
+            cells.reset(new Cell[static_cast<size_t>(capacity)]);
+            for (long long cell = 0; cell < capacity; ++cell) {
+                cells[static_cast<size_t>(cell)].sequence = cell;
+            }
+            cell_mask = capacity - 1;
+        }
+
+        bool try_push(const T& _value) throw()
+        {
+            Cell* cell = this->claim_push();
+            if (nullptr == cell) {
+                return false;
+            }
+            cell->value = _value;
+            // publish the value to consumers
+            ctMemoryGuardWrite(&cell->sequence, cell->claimed_position + 1);
+            return true;
+        }
+
+        bool try_pop(T& _value) throw()
+        {
+            Cell* cell = this->claim_pop();
+            if (nullptr == cell) {
+                return false;
+            }
+            _value = std::move(cell->value);
+            cell->value = T();
+            // release the cell back to producers for the next lap around the queue
+            ctMemoryGuardWrite(&cell->sequence, cell->claimed_position + this->cell_mask + 1);
+            return true;
+        }
+
+        ///
+        /// a snapshot which can be stale as soon as it's returned
+        ///
+        bool empty() const throw()
+        {
+            return ctMemoryGuardRead(&this->dequeue_position) >= ctMemoryGuardRead(&this->enqueue_position);
+        }
+
+        // non-copyable
+        ctMpmcQueue(const ctMpmcQueue&) = delete;
+        ctMpmcQueue& operator=(const ctMpmcQueue&) = delete;
+
+    private:
+        struct Cell {
+            Cell() : sequence(0LL), claimed_position(0LL), value()
+            {
+            }
+            long long sequence;
+            // only written by the thread which claimed the cell
+            long long claimed_position;
+            T value;
+        };
+
+        Cell* claim_push() throw()
+        {
+            long long position = ctMemoryGuardRead(&this->enqueue_position);
+            for (;;) {
+                Cell* cell = &this->cells[static_cast<size_t>(position & this->cell_mask)];
+                const long long difference = ctMemoryGuardRead(&cell->sequence) - position;
+                if (0 == difference) {
+                    // the cell is free for this position: try to claim it
+                    const long long prior = ctMemoryGuardWriteConditionally(&this->enqueue_position, position + 1, position);
+                    if (prior == position) {
+                        cell->claimed_position = position;
+                        return cell;
+                    }
+                    position = prior;
+                } else if (difference < 0) {
+                    // the cell still holds a value from the prior lap: the queue is full
+                    return nullptr;
+                } else {
+                    // another producer claimed this position
+                    position = ctMemoryGuardRead(&this->enqueue_position);
+                }
+            }
+        }
+
+        Cell* claim_pop() throw()
+        {
+            long long position = ctMemoryGuardRead(&this->dequeue_position);
+            for (;;) {
+                Cell* cell = &this->cells[static_cast<size_t>(position & this->cell_mask)];
+                const long long difference = ctMemoryGuardRead(&cell->sequence) - (position + 1);
+                if (0 == difference) {
+                    // the cell holds a published value for this position: try to claim it
+                    const long long prior = ctMemoryGuardWriteConditionally(&this->dequeue_position, position + 1, position);
+                    if (prior == position) {
+                        cell->claimed_position = position;
+                        return cell;
+                    }
+                    position = prior;
+                } else if (difference < 0) {
+                    // no value has been published for this position yet: the queue is empty
+                    return nullptr;
+                } else {
+                    // another consumer claimed this position
+                    position = ctMemoryGuardRead(&this->dequeue_position);
+                }
+            }
+        }
+
+        std::unique_ptr<Cell[]> cells;
+        long long cell_mask;
+        // the producer and consumer positions are padded onto separate cache lines
+        // - padding rather than __declspec(align) so classes embedding a queue aren't over-aligned
+        //   (which heap-allocating them with new would not honor: C4316)
+        char cell_padding[64 - sizeof(long long)];
+        long long enqueue_position;
+        char enqueue_padding[64 - sizeof(long long)];
+        long long dequeue_position;
+        char dequeue_padding[64 - sizeof(long long)];
+    };
+
+} // namespace ctl
@@ -14,6 +14,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #pragma once
 
 #include <windows.h>
+#include <intrin.h>
 
 
 
@@ -159,6 +160,151 @@ namespace ctl {
             // multiplying by 1000 as (qpc / qpf) == seconds
             return static_cast<long long>((qpc.QuadPart * 1000LL) / s_Qpf.QuadPart);
         }
+        ///
+        /// Returns the current 'time' from QPC/QPF in terms of microseconds
+        /// - splitting whole seconds from the remainder so the multiply cannot overflow
+        ///
+        inline
+        long long snap_qpc_usec() throw()
+        {
+            (void) ::InitOnceExecuteOnce(&s_QpfInitOnce, s_QpfInitOnceCallback, nullptr, nullptr);
+            LARGE_INTEGER qpc;
+            QueryPerformanceCounter(&qpc);
+            return static_cast<long long>(
+                (qpc.QuadPart / s_Qpf.QuadPart) * 1000000LL +
+                ((qpc.QuadPart % s_Qpf.QuadPart) * 1000000LL) / s_Qpf.QuadPart);
+        }
+
+        ///
+        /// snap_clock_nsec is a cheaper monotonic clock for hot paths (per-IO timing, pacing, statistics)
+        /// - on x64 CPUs reporting an invariant TSC it reads the TSC directly, calibrated against QPC at first use
+        /// - otherwise it falls back to QPC
+        /// - ticks are converted with a 32.32 fixed-point multiply instead of a 64-bit divide
+        ///
+        /// The clock is anchored to QPC when calibrated, so its values are comparable to snap_qpc_* values
+        /// - the calibration state is shared across every translation unit (selectany) so all callers see one clock
+        /// - calibrate_clock should be called once at startup, so snap_clock_nsec only reads these values
+        ///
+        namespace details {
+            __declspec(selectany) INIT_ONCE s_ClockInitOnce = INIT_ONCE_STATIC_INIT;
+            // set once the values below are written: read without taking the INIT_ONCE
+            __declspec(selectany) volatile bool s_ClockCalibrated = false;
+            __declspec(selectany) bool s_ClockUsesTsc = false;
+            __declspec(selectany) unsigned long long s_ClockBaseTicks = 0ULL;
+            __declspec(selectany) long long s_ClockBaseNsec = 0LL;
+            __declspec(selectany) long long s_ClockQpf = 0LL;
+            // nanoseconds per tick as a 32.32 fixed-point value
+            __declspec(selectany) unsigned long long s_ClockScale = 0ULL;
+
+            inline
+            unsigned long long read_clock_ticks() throw()
+            {
+#if defined(_M_X64)
+                if (s_ClockUsesTsc) {
+                    return __rdtsc();
+                }
+#endif
+                LARGE_INTEGER qpc;
+                QueryPerformanceCounter(&qpc);
+                return static_cast<unsigned long long>(qpc.QuadPart);
+            }
+
+            inline
+            BOOL CALLBACK clock_init_once_callback(_In_ PINIT_ONCE, _In_ PVOID, _In_ PVOID*)
+            {
+                s_ClockQpf = snap_qpf();
+                unsigned long long ticks_per_second = static_cast<unsigned long long>(s_ClockQpf);
+#if defined(_M_X64)
+                // only trusting the TSC if it runs at a constant rate across P-states and C-states
+                // - CPUID 0x80000007 EDX bit 8 (invariant TSC)
+                int cpu_info[4];
+                __cpuid(cpu_info, 0x80000000);
+                if (static_cast<unsigned long>(cpu_info[0]) >= 0x80000007UL) {
+                    __cpuid(cpu_info, 0x80000007);
+                    if (cpu_info[3] & (1 << 8)) {
+                        // calibrate the TSC frequency against QPC over ~10ms
+                        LARGE_INTEGER qpc_start;
+                        LARGE_INTEGER qpc_end;
+                        QueryPerformanceCounter(&qpc_start);
+                        const unsigned long long tsc_start = __rdtsc();
+                        do {
+                            QueryPerformanceCounter(&qpc_end);
+                        } while (qpc_end.QuadPart - qpc_start.QuadPart < s_ClockQpf / 100);
+                        const unsigned long long tsc_end = __rdtsc();
+
+                        const unsigned long long tsc_per_second =
+                            (tsc_end - tsc_start) * static_cast<unsigned long long>(s_ClockQpf) /
+                            static_cast<unsigned long long>(qpc_end.QuadPart - qpc_start.QuadPart);
+                        if (tsc_per_second > 0) {
+                            ticks_per_second = tsc_per_second;
+                            s_ClockUsesTsc = true;
+                        }
+                    }
+                }
+#endif
+                s_ClockScale = (1000000000ULL << 32) / ticks_per_second;
+
+                // anchor the clock to the current QPC time
+                LARGE_INTEGER qpc;
+                QueryPerformanceCounter(&qpc);
+                s_ClockBaseTicks = read_clock_ticks();
+                s_ClockBaseNsec =
+                    (qpc.QuadPart / s_ClockQpf) * 1000000000LL +
+                    ((qpc.QuadPart % s_ClockQpf) * 1000000000LL) / s_ClockQpf;
+                return TRUE;
+            }
+        }
+
+        ///
+        /// calibrate_clock measures the TSC against QPC (~10ms when the TSC is used)
+        /// - safe to call from multiple threads: only the first call calibrates
+        ///
+        inline
+        void calibrate_clock() throw()
+        {
+            (void) ::InitOnceExecuteOnce(&details::s_ClockInitOnce, details::clock_init_once_callback, nullptr, nullptr);
+            details::s_ClockCalibrated = true;
+        }
+
+        inline
+        long long snap_clock_nsec() throw()
+        {
+            if (!details::s_ClockCalibrated) {
+                // only taken until calibrate_clock has been called
+                calibrate_clock();
+            }
+            // the TSC can be read slightly behind the base on another core: never return a time before the anchor
+            long long elapsed_ticks = static_cast<long long>(details::read_clock_ticks() - details::s_ClockBaseTicks);
+            if (elapsed_ticks < 0) {
+                elapsed_ticks = 0;
+            }
+#if defined(_M_X64)
+            unsigned long long high;
+            const unsigned long long low = _umul128(static_cast<unsigned long long>(elapsed_ticks), details::s_ClockScale, &high);
+            return details::s_ClockBaseNsec + static_cast<long long>((high << 32) | (low >> 32));
+#else
+            // no 128-bit multiply: split whole seconds from the remainder so the multiply cannot overflow
+            const long long qpf = details::s_ClockQpf;
+            return details::s_ClockBaseNsec +
+                (elapsed_ticks / qpf) * 1000000000LL +
+                ((elapsed_ticks % qpf) * 1000000000LL) / qpf;
+#endif
+        }
+        ///
+        /// snap_clock_usec / snap_clock_msec : snap_clock_nsec scaled to micro- and milliseconds
+        /// - dividing by a constant, which the compiler turns into a multiply
+        ///
+        inline
+        long long snap_clock_usec() throw()
+        {
+            return snap_clock_nsec() / 1000LL;
+        }
+        inline
+        long long snap_clock_msec() throw()
+        {
+            return snap_clock_nsec() / 1000000LL;
+        }
+
         ///
         /// Returns the current 'time' from QPC/QPF as a FILETIME
         /// (FILETIME records time in one-hundred-nano-seconds)
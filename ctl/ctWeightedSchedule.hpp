@@ -0,0 +1,86 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <vector>
+// os headers
+#include <Windows.h>
+// ctl headers
+#include "ctLocks.hpp"
+
+
+namespace ctl {
+
+    ///
+    /// ctWeightedSchedule hands out indexes in proportion to their weights
+    /// - turns are chosen with smooth weighted round-robin: each turn goes to the index furthest behind its share
+    ///   so weights of 1 and 1 alternate, and weights of 3 and 1 give 0, 0, 1, 0 rather than runs of each index
+    /// - each turn is computed as it is taken, so memory is proportional to the # of weights, not their total
+    /// - next() is concurrent-safe, serialized through a CRITICAL_SECTION
+    ///
+    class ctWeightedSchedule {
+    public:
+        ///
+        /// _weights must not be empty, and each weight must be greater than zero
+        /// - can throw std::bad_alloc and ctl::ctException
+        ///
+        explicit ctWeightedSchedule(const std::vector<unsigned long>& _weights) :
+            schedule_lock(),
+            weights(_weights.begin(), _weights.end()),
+            current_weights(_weights.size(), 0LL),
+            total_weight(0LL)
+        {
+            for (const auto& weight : this->weights) {
+                this->total_weight += weight;
+            }
+            if (!::InitializeCriticalSectionEx(&this->schedule_lock, 4000, 0)) {
+                throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctl::ctWeightedSchedule", false);
+            }
+        }
+
+        ~ctWeightedSchedule() throw()
+        {
+            ::DeleteCriticalSection(&this->schedule_lock);
+        }
+
+        unsigned long next() throw()
+        {
+            ctAutoReleaseCriticalSection auto_lock(&this->schedule_lock);
+
+            unsigned long selected = 0;
+            for (unsigned long index = 0; index < this->weights.size(); ++index) {
+                this->current_weights[index] += this->weights[index];
+                if (this->current_weights[index] > this->current_weights[selected]) {
+                    selected = index;
+                }
+            }
+            this->current_weights[selected] -= this->total_weight;
+            return selected;
+        }
+
+        // non-copyable
+        ctWeightedSchedule(const ctWeightedSchedule&) = delete;
+        ctWeightedSchedule& operator=(const ctWeightedSchedule&) = delete;
+
+    private:
+        CRITICAL_SECTION schedule_lock;
+        const std::vector<long long> weights;
+        // guarded by schedule_lock
+        std::vector<long long> current_weights;
+        // only set in the c'tor
+        long long total_weight;
+    };
+
+} // namespace ctl
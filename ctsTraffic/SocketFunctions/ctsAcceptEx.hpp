@@ -17,7 +17,6 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <memory>
 #include <vector>
 #include <string>
-#include <queue>
 // os headers
 #include <mswsock.h>
 #include <winsock2.h>
@@ -29,6 +28,8 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctScopeGuard.hpp>
 #include <ctLocks.hpp>
 #include <ctTimer.hpp>
+#include <ctThreadPoolTimer.hpp>
+#include <ctMpmcQueue.hpp>
 // project headers
 #include "ctsSocket.h"
 
@@ -63,12 +64,26 @@ namespace ctsTraffic {
         /// - if the callback is called and the counter reflects no request arrived yet,
         /// --- the new connection is added to a queue and AcceptEx is not reposted
         ///
+        /// The number of AcceptEx requests kept posted on each listener adapts to the accept rate
+        /// - it doubles whenever fewer than a quarter of the requests are left posted as one completes
+        /// - it halves when more than half the requests went unused over an entire adapt interval
+        /// --- the requests beyond the new target are canceled, and made idle once their cancellation completes
+        /// - a completion which leaves no requests posted is counted as a listen queue overflow:
+        /// --- connections then wait in the listen backlog (or are refused once it is full) until more are posted
+        ///
 
     private:
         ///
-        /// constant defining how many acceptex requests we want maintained per listener
+        /// constants bounding how many acceptex requests are maintained per listener
+        ///
+        static const unsigned long InitialPendedAcceptRequests = 100;
+        static const unsigned long MinimumPendedAcceptRequests = 16;
+        static const unsigned long MaximumPendedAcceptRequests = 4096;
+        static const unsigned long AdaptIntervalMilliseconds = 1000;
+        ///
+        /// bounds the requests for accepted sockets, and the accepted sockets, waiting to be paired
         ///
-        static const unsigned PendedAcceptRequests = 100;
+        static const unsigned long MaximumQueuedAccepts = 16384;
 
         ///
         /// necessary forward declarations of internal classes
@@ -87,8 +102,12 @@ namespace ctsTraffic {
             DWORD  gle;
             ctl::ctSockaddr local_addr;
             ctl::ctSockaddr remote_addr;
+            // when AcceptEx completed, to track how long the connection waited for a ctsSocket
+            long long accepted_usec;
+            // the AcceptEx request had been canceled to shrink the number posted
+            bool cancelled;
 
-            ctsAcceptedConnection() : accept_socket(INVALID_SOCKET), gle(0), local_addr(), remote_addr()
+            ctsAcceptedConnection() : accept_socket(INVALID_SOCKET), gle(0), local_addr(), remote_addr(), accepted_usec(0LL), cancelled(false)
             {
             }
         };
@@ -105,13 +124,23 @@ namespace ctsTraffic {
             ctsListenSocketInfo(const ctl::ctSockaddr& _listening_addr);
             ~ctsListenSocketInfo() throw();
 
-            // attempt to restart any accept sockets which failed last time they were attempted
-            void RestartStalledAccepts(std::shared_ptr<ctsAcceptEx::ctsAcceptExImpl> _pimpl);
+            // must be called holding the ctsAcceptExImpl lock
+            // - returns the accept sockets to post (outside the lock) to bring this listener up to its target
+            std::vector<ctsAcceptSocketInfo*> TakeAcceptsToPost() throw();
 
             SOCKET socket;
             ctl::ctSockaddr addr;
             std::shared_ptr<ctl::ctThreadIocp> iocp;
             std::vector<std::shared_ptr<ctsAcceptSocketInfo>> accept_sockets;
+
+            // the adaptive AcceptEx depth - all guarded by the ctsAcceptExImpl lock
+            // - posted_accepts includes the cancelling_accepts until their cancellation completes
+            // - posted_accepts_low is the fewest requests left posted over the current adapt interval
+            std::vector<ctsAcceptSocketInfo*> idle_accept_sockets;
+            unsigned long target_accepts;
+            unsigned long posted_accepts;
+            unsigned long cancelling_accepts;
+            unsigned long posted_accepts_low;
         };
 
 
@@ -125,11 +154,21 @@ namespace ctsTraffic {
         class ctsAcceptSocketInfo {
         public:
             // c'tor throws ctException on failure
-            ctsAcceptSocketInfo(std::shared_ptr<ctsListenSocketInfo>& _listen_socket);
+            ctsAcceptSocketInfo(ctsListenSocketInfo* _listen_socket);
             ~ctsAcceptSocketInfo() throw();
 
             // attempts to post a new AcceptEx - internally tracks if succeeds or fails
-            void InitatiateAcceptEx(std::shared_ptr<ctsAcceptEx::ctsAcceptExImpl> _pimpl);
+            // - returns false if the AcceptEx could not be posted
+            bool InitatiateAcceptEx(std::shared_ptr<ctsAcceptEx::ctsAcceptExImpl> _pimpl);
+
+            // attempts to cancel a posted AcceptEx - the callback still completes for the request
+            // - returns false if no AcceptEx is currently posted
+            bool CancelAcceptEx() throw();
+
+            ctsListenSocketInfo* GetListener() const throw()
+            {
+                return this->listen_socket_info;
+            }
 
             // returns a ctsAcceptedConnection struct describing the result of an AcceptEx call
             // - must be called only after the previous AcceptEx call has completed its OVERLAPPED call
@@ -153,6 +192,10 @@ namespace ctsTraffic {
             ctl::ctSockaddr listening_addr;
             // the IOCP object that is associated with the listening socket
             std::shared_ptr<ctl::ctThreadIocp> listening_iocp;
+            // the parent listener, which owns this object
+            ctsListenSocketInfo* listen_socket_info;
+            // the posted AcceptEx was canceled to shrink the number posted
+            bool cancelled;
             // the buffer to supply to AcceptEx to capture the address information
             char OutputBuffer[SingleOutputBufferSize * 2];
 
@@ -170,37 +213,62 @@ namespace ctsTraffic {
         ///
         ///
         struct ctsAcceptExImpl {
-            // must guard access to internal containers
+            // guards the listeners and their accept sockets
+            // - the two queues below are not guarded: requests and accepted connections are paired without a lock
+            //   so the threads requesting sockets never block behind AcceptEx completions (nor the reverse)
             CRITICAL_SECTION cs;
             std::vector<std::shared_ptr<ctsListenSocketInfo>> listeners;
-            std::queue<std::weak_ptr<ctsSocket>> pended_accept_requests;
-            std::queue<ctsAcceptedConnection> accepted_connections;
-
-            ctsAcceptExImpl() : cs(), listeners(), accepted_connections(), pended_accept_requests()
+            ctl::ctMpmcQueue<std::weak_ptr<ctsSocket>> pended_accept_requests;
+            ctl::ctMpmcQueue<ctsAcceptedConnection> accepted_connections;
+            // the # of threads which asked to pair the above queues: only the first pairs them
+            _Interlocked_
+            long pairing_requests;
+            // only touched by the thread pairing the queues: a request popped before a connection was queued for it
+            std::weak_ptr<ctsSocket> pairing_request;
+            // periodically shrinks the AcceptEx requests posted on idle listeners
+            std::unique_ptr<ctl::ctThreadpoolTimer> adapt_timer;
+
+            ctsAcceptExImpl() :
+                cs(),
+                listeners(),
+                pended_accept_requests(MaximumQueuedAccepts),
+                accepted_connections(MaximumQueuedAccepts),
+                pairing_requests(0L),
+                pairing_request(),
+                adapt_timer()
             {
                 if (!::InitializeCriticalSectionAndSpinCount(&cs, 4000)) {
                     throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionAndSpinCount", L"ctsAcceptEx", false);
                 }
+                try {
+                    adapt_timer.reset(new ctl::ctThreadpoolTimer(ctsConfig::Settings->PTPEnvironment));
+                }
+                catch (...) {
+                    ::DeleteCriticalSection(&cs);
+                    throw;
+                }
             }
 
             ~ctsAcceptExImpl() throw()
             {
+                // stop (and wait for) the adapt timer before tearing down the listeners it walks
+                adapt_timer.reset();
+
                 // close out all caller requests for new accepted sockets 
-                while (!pended_accept_requests.empty()) {
-                    auto weak_socket = pended_accept_requests.front();
+                std::weak_ptr<ctsSocket> weak_socket(pairing_request);
+                do {
                     auto shared_socket(weak_socket.lock());
-
-                    ctsSocket* socket_lock = shared_socket.get();
-                    if (socket_lock != nullptr) {
-                        socket_lock->complete_state(WSAECONNABORTED);
+                    if (shared_socket) {
+                        shared_socket->complete_state(WSAECONNABORTED);
                     }
-
-                    pended_accept_requests.pop();
-                }
+                } while (pended_accept_requests.try_pop(weak_socket));
 
                 listeners.clear();
-                while (!accepted_connections.empty()) {
-                    accepted_connections.pop();
+                ctsAcceptedConnection accepted_connection;
+                while (accepted_connections.try_pop(accepted_connection)) {
+                    if (accepted_connection.accept_socket != INVALID_SOCKET) {
+                        ::closesocket(accepted_connection.accept_socket);
+                    }
                 }
 
                 ::DeleteCriticalSection(&cs);
@@ -224,6 +292,8 @@ namespace ctsTraffic {
         ///
         ctsAcceptEx() : pimpl(new ctsAcceptExImpl)
         {
+            // new only honors the default heap alignment: the Impl (and the queues it embeds) must not ask for more
+            static_assert(alignof(ctsAcceptExImpl) <= MEMORY_ALLOCATION_ALIGNMENT, "ctsAcceptExImpl must not be over-aligned");
             ctl::ctAutoReleaseCriticalSection auto_lock(&pimpl->cs);
 
             // swap in the listen vector only if fully created
@@ -236,14 +306,20 @@ namespace ctsTraffic {
                 std::shared_ptr<ctsListenSocketInfo> listen_socket_info = std::make_shared<ctsListenSocketInfo>(addr);
                 ctsConfig::PrintDebug(L"\t\tListening to %s\n", addr.writeCompleteAddress().c_str());
                 //
-                // Add PendedAcceptRequests pended acceptex objects per listener
+                // Add InitialPendedAcceptRequests pended acceptex objects per listener
+                // - posted while holding the lock, so completions can't run until the listener is saved
                 //
-                for (unsigned accept_counter = 0; accept_counter < PendedAcceptRequests; ++accept_counter) {
-                    std::shared_ptr<ctsAcceptSocketInfo> accept_socket_info = std::make_shared<ctsAcceptSocketInfo>(listen_socket_info);
+                for (unsigned accept_counter = 0; accept_counter < InitialPendedAcceptRequests; ++accept_counter) {
+                    std::shared_ptr<ctsAcceptSocketInfo> accept_socket_info = std::make_shared<ctsAcceptSocketInfo>(listen_socket_info.get());
                     listen_socket_info->accept_sockets.push_back(accept_socket_info);
                     // post AcceptEx on this socket
-                    accept_socket_info->InitatiateAcceptEx(pimpl);
+                    ++listen_socket_info->posted_accepts;
+                    if (!accept_socket_info->InitatiateAcceptEx(pimpl)) {
+                        --listen_socket_info->posted_accepts;
+                        listen_socket_info->idle_accept_sockets.push_back(accept_socket_info.get());
+                    }
                 }
+                listen_socket_info->posted_accepts_low = listen_socket_info->posted_accepts;
 
                 // all successful - save this listen socket
                 temp_listeners.push_back(listen_socket_info);
@@ -255,70 +331,29 @@ namespace ctsTraffic {
 
             // everything succeeded - safely save the listen queue
             pimpl->listeners.swap(temp_listeners);
+
+            pimpl->adapt_timer->schedule_reoccuring(ctsAcceptExAdaptCallback, pimpl.get(), AdaptIntervalMilliseconds, AdaptIntervalMilliseconds);
         }
 
         //
         //
         // An accepted socket is being requested
-        // - if have one queued, return that
-        // - else store the weak_ptr<ctsSocket> to be fulfilled later
+        // - queue the request, then pair it with a queued accepted connection if one is waiting
         //
         //
         void operator() (std::weak_ptr<ctsSocket> _socket) throw()
         {
-            auto shared_socket_lock(_socket.lock());
-            ctsSocket* socket_lock = shared_socket_lock.get();
-            if (socket_lock == nullptr) {
-                // underlying socket went away - nothing to do now
-                return;
-            }
-
-            ctsAcceptedConnection accepted_connection;
-            int error = 0;
-
-            // scoped to the auto-release CS object
-            {
-                ctl::ctAutoReleaseCriticalSection csLock(&pimpl->cs);
-                // guard access to internal queues
-                if (pimpl->accepted_connections.empty()) {
-                    try {
-                        // no accepted connections yet -- save the weak_ptr, *not* the shared_ptr
-                        pimpl->pended_accept_requests.push(_socket);
-                    }
-                    catch (const std::bad_alloc&) {
-                        // fail the caller if can't save this request
-                        error = WSAENOBUFS;
-                    }
-                } else {
-                    // pull the next connection off the queue
-                    accepted_connection = pimpl->accepted_connections.front();
-                    error = accepted_connection.gle;
-                    pimpl->accepted_connections.pop();
+            if (!pimpl->pended_accept_requests.try_push(_socket)) {
+                // fail the caller if can't save this request
+                ctsConfig::PrintErrorIfFailed(L"AcceptEx", WSAENOBUFS);
+                auto shared_socket(_socket.lock());
+                if (shared_socket) {
+                    shared_socket->complete_state(WSAENOBUFS);
                 }
+                return;
             }
 
-            //
-            // complete this socket state if something failed, or if have a new socket to return
-            //
-            ctsConfig::PrintErrorIfFailed(L"AcceptEx", error);
-            if (error != 0) {
-                socket_lock->complete_state(error);
-            } else {
-                // if did not defer the accept request, return the socket
-                if (accepted_connection.accept_socket != INVALID_SOCKET) {
-                    // set the local addr
-                    ctl::ctSockaddr local_addr;
-                    int local_addr_len = local_addr.length();
-                    if (0 == ::getsockname(accepted_connection.accept_socket, local_addr.sockaddr(), &local_addr_len)) {
-                        socket_lock->set_local(local_addr);
-                    }
-                    socket_lock->set_socket(accepted_connection.accept_socket);
-                    socket_lock->set_target(accepted_connection.remote_addr);
-                    socket_lock->complete_state(0);
-
-                    ctsConfig::PrintNewConnection(accepted_connection.remote_addr);
-                }
-            }
+            CompleteAcceptedConnections(pimpl.get());
         }
 
 
@@ -331,58 +366,200 @@ namespace ctsTraffic {
             ) throw()
         {
             ctsAcceptedConnection accepted_socket = _accept_info->GetAcceptedSocket();
+            ctsListenSocketInfo* listener = _accept_info->GetListener();
 
-            ctl::ctAutoReleaseCriticalSection auto_lock(&_pimpl->cs);
-            if (_pimpl->pended_accept_requests.size() > 0) {
+            //
+            // only guard access to the listener's accounting
+            // - the connection is queued and paired outside the lock, so the lock is not held while completing the ctsSocket
+            //
+            std::vector<ctsAcceptSocketInfo*> accept_sockets_to_post;
+            bool queue_connection = false;
+            {
+                ctl::ctAutoReleaseCriticalSection auto_lock(&_pimpl->cs);
                 //
-                // we have unfulfilled requests for more connections
-                // return a previously accepted socket
+                // this request is no longer posted: track how many are left posted on the listener
                 //
-                auto weak_socket = _pimpl->pended_accept_requests.front();
-                _pimpl->pended_accept_requests.pop();
-
-                auto shared_socket_lock(weak_socket.lock());
-                ctsSocket* socket_lock = shared_socket_lock.get();
-                if (socket_lock != nullptr) {
-                    ctsConfig::PrintErrorIfFailed(L"AcceptEx", accepted_socket.gle);
-
-                    if (0 == accepted_socket.gle) {
-                        // set the local addr
-                        ctl::ctSockaddr local_addr;
-                        int local_addr_len = local_addr.length();
-                        if (0 == ::getsockname(accepted_socket.accept_socket, local_addr.sockaddr(), &local_addr_len)) {
-                            socket_lock->set_local(local_addr);
-                        }
-                        socket_lock->set_socket(accepted_socket.accept_socket);
-                        socket_lock->set_target(accepted_socket.remote_addr);
-                        socket_lock->complete_state(0);
-
-                        ctsConfig::PrintNewConnection(accepted_socket.remote_addr);
-                    } else {
-                        socket_lock->complete_state(accepted_socket.gle);
+                --listener->posted_accepts;
+                if (accepted_socket.cancelled) {
+                    --listener->cancelling_accepts;
+                }
+                const unsigned long remaining_accepts = listener->posted_accepts - listener->cancelling_accepts;
+                if (remaining_accepts < listener->posted_accepts_low) {
+                    listener->posted_accepts_low = remaining_accepts;
+                }
+                if (!accepted_socket.cancelled) {
+                    if (0 == remaining_accepts) {
+                        ctsConfig::Settings->HistoricConnectionDetails.accept_overflows.increment();
+                    }
+                    if (remaining_accepts < listener->target_accepts / 4 && listener->target_accepts < MaximumPendedAcceptRequests) {
+                        listener->target_accepts = min(listener->target_accepts * 2, MaximumPendedAcceptRequests);
+                        ctsConfig::PrintDebug(
+                            L"\t\tctsAcceptEx: %s now keeping %lu AcceptEx requests posted\n",
+                            listener->addr.writeCompleteAddress().c_str(), listener->target_accepts);
                     }
-                } else {
-                    // socket was closed from beneath us
-                    ctsConfig::PrintErrorIfFailed(L"AcceptEx", WSAECONNABORTED);
                 }
-            } else {
-                //
-                // else, we have no requests for another connection,
-                // - queue this one for when a request comes in
-                //
+
+                // a completed cancellation has no connection to return
+                // - everything else (including a failed AcceptEx) is handed to the next request
+                queue_connection = !(accepted_socket.cancelled && accepted_socket.gle != 0);
+
+                // this accept socket is now idle: repost it (and more if the target grew) unless the listener is shrinking
                 try {
-                    _pimpl->accepted_connections.push(accepted_socket);
+                    listener->idle_accept_sockets.push_back(_accept_info);
                 }
                 catch (const std::bad_alloc&) {
-                    // if fails to be added to our queue, it's OK 
-                    // - it will be destroyed and we'll make another later
+                    // still owned by the listener - just won't be reused
                 }
+                accept_sockets_to_post = listener->TakeAcceptsToPost();
             }
-
             //
-            // always attempt another AcceptEx
+            // post the AcceptEx requests before completing the socket
+            // - so the listener is re-armed while its IO is started
             //
-            _accept_info->InitatiateAcceptEx(_pimpl);
+            PostAccepts(_pimpl, listener, accept_sockets_to_post);
+
+            if (queue_connection) {
+                if (!_pimpl->accepted_connections.try_push(accepted_socket)) {
+                    ctsConfig::PrintErrorIfFailed(L"AcceptEx", WSAENOBUFS);
+                    if (accepted_socket.accept_socket != INVALID_SOCKET) {
+                        ::closesocket(accepted_socket.accept_socket);
+                    }
+                    return;
+                }
+                CompleteAcceptedConnections(_pimpl.get());
+            }
+        }
+
+        //
+        // pairs queued accepted connections with queued requests
+        // - called by each thread after adding to either queue: only one thread pairs at a time, and each caller's
+        //   request is counted so the pairing thread makes another pass for any value pushed while it was pairing
+        // - as each queue then has a single consumer, a failed pop means that queue has nothing (yet) to pair
+        //
+        static
+        void CompleteAcceptedConnections(ctsAcceptExImpl* _pimpl) throw()
+        {
+            long requests = ctl::ctMemoryGuardIncrement(&_pimpl->pairing_requests);
+            if (requests > 1) {
+                // the thread already pairing will make another pass for this request
+                return;
+            }
+
+            for (;;) {
+                PairQueuedConnections(_pimpl);
+                // exit only if no more requests came in while pairing
+                const long remaining = ctl::ctMemoryGuardSubtract(&_pimpl->pairing_requests, requests) - requests;
+                if (0 == remaining) {
+                    break;
+                }
+                requests = remaining;
+            }
+        }
+
+        //
+        // only called by the thread pairing connections
+        // - the request popped for the next connection is held in pairing_request across passes
+        //   so it's never pushed back onto pended_accept_requests
+        //
+        static
+        void PairQueuedConnections(ctsAcceptExImpl* _pimpl) throw()
+        {
+            for (;;) {
+                auto shared_socket(_pimpl->pairing_request.lock());
+                if (!shared_socket) {
+                    // not yet holding a request, or the socket was closed from beneath us
+                    if (!_pimpl->pended_accept_requests.try_pop(_pimpl->pairing_request)) {
+                        return;
+                    }
+                    continue;
+                }
+
+                ctsAcceptedConnection accepted_connection;
+                if (!_pimpl->accepted_connections.try_pop(accepted_connection)) {
+                    // keep holding the request for the next connection
+                    return;
+                }
+                _pimpl->pairing_request.reset();
+
+                ctsConfig::PrintErrorIfFailed(L"AcceptEx", accepted_connection.gle);
+                if (accepted_connection.gle != 0) {
+                    shared_socket->complete_state(accepted_connection.gle);
+                    continue;
+                }
+
+                // set the local addr
+                ctl::ctSockaddr local_addr;
+                int local_addr_len = local_addr.length();
+                if (0 == ::getsockname(accepted_connection.accept_socket, local_addr.sockaddr(), &local_addr_len)) {
+                    shared_socket->set_local(local_addr);
+                }
+                shared_socket->set_socket(accepted_connection.accept_socket);
+                shared_socket->set_target(accepted_connection.remote_addr);
+                ctsConfig::Settings->HistoricConnectionDetails.accept_latency_usec.add(ctl::ctTimer::snap_clock_usec() - accepted_connection.accepted_usec);
+                shared_socket->complete_state(0);
+
+                ctsConfig::PrintNewConnection(accepted_connection.remote_addr);
+            }
+        }
+
+        //
+        // posts AcceptEx on each of the accept sockets taken from the listener
+        // - must be called without holding the ctsAcceptExImpl lock
+        //
+        static
+        void PostAccepts(
+            const std::shared_ptr<ctsAcceptExImpl>& _pimpl,
+            ctsListenSocketInfo* _listener,
+            const std::vector<ctsAcceptSocketInfo*>& _accept_sockets) throw()
+        {
+            for (const auto& accept_socket : _accept_sockets) {
+                bool posted = false;
+                try {
+                    posted = accept_socket->InitatiateAcceptEx(_pimpl);
+                }
+                catch (const std::exception& e) {
+                    ctsConfig::PrintException(e);
+                }
+
+                if (!posted) {
+                    ctl::ctAutoReleaseCriticalSection auto_lock(&_pimpl->cs);
+                    --_listener->posted_accepts;
+                    try {
+                        _listener->idle_accept_sockets.push_back(accept_socket);
+                    }
+                    catch (const std::bad_alloc&) {
+                        // still owned by the listener - just won't be reused
+                    }
+                }
+            }
+        }
+
+        //
+        // shrinks the AcceptEx requests posted on listeners which left over half of them unused
+        // - over the entire adapt interval, and not below MinimumPendedAcceptRequests
+        //
+        static
+        void ctsAcceptExAdaptCallback(ctsAcceptExImpl* _pimpl) throw()
+        {
+            ctl::ctAutoReleaseCriticalSection auto_lock(&_pimpl->cs);
+            for (auto& listener : _pimpl->listeners) {
+                if (listener->posted_accepts_low > listener->target_accepts / 2 && listener->target_accepts > MinimumPendedAcceptRequests) {
+                    listener->target_accepts = max(listener->target_accepts / 2, MinimumPendedAcceptRequests);
+                    ctsConfig::PrintDebug(
+                        L"\t\tctsAcceptEx: %s now keeping %lu AcceptEx requests posted\n",
+                        listener->addr.writeCompleteAddress().c_str(), listener->target_accepts);
+
+                    for (auto& accept_socket : listener->accept_sockets) {
+                        if (listener->posted_accepts - listener->cancelling_accepts <= listener->target_accepts) {
+                            break;
+                        }
+                        if (accept_socket->CancelAcceptEx()) {
+                            ++listener->cancelling_accepts;
+                        }
+                    }
+                }
+                listener->posted_accepts_low = listener->posted_accepts - listener->cancelling_accepts;
+            }
         }
     };
 
@@ -395,7 +572,15 @@ namespace ctsTraffic {
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     inline
     ctsAcceptEx::ctsListenSocketInfo::ctsListenSocketInfo(const ctl::ctSockaddr& _addr)
-    : socket(INVALID_SOCKET), addr(_addr), iocp(), accept_sockets()
+    : socket(INVALID_SOCKET),
+      addr(_addr),
+      iocp(),
+      accept_sockets(),
+      idle_accept_sockets(),
+      target_accepts(InitialPendedAcceptRequests),
+      posted_accepts(0),
+      cancelling_accepts(0),
+      posted_accepts_low(0)
     {
         //
         // Create, Bind, Listen, create an IOCP thread pool
@@ -435,11 +620,25 @@ namespace ctsTraffic {
     }
 
     inline
-    void ctsAcceptEx::ctsListenSocketInfo::RestartStalledAccepts(std::shared_ptr<ctsAcceptEx::ctsAcceptExImpl> _pimpl)
+    std::vector<ctsAcceptEx::ctsAcceptSocketInfo*> ctsAcceptEx::ctsListenSocketInfo::TakeAcceptsToPost() throw()
     {
-        for (auto& accept_socket : accept_sockets) {
-            accept_socket->InitatiateAcceptEx(_pimpl);
+        std::vector<ctsAcceptSocketInfo*> accept_sockets_to_post;
+        try {
+            while (this->posted_accepts - this->cancelling_accepts < this->target_accepts) {
+                if (this->idle_accept_sockets.empty()) {
+                    this->accept_sockets.push_back(std::make_shared<ctsAcceptSocketInfo>(this));
+                    this->idle_accept_sockets.push_back(this->accept_sockets.rbegin()->get());
+                }
+                accept_sockets_to_post.push_back(*this->idle_accept_sockets.rbegin());
+                this->idle_accept_sockets.pop_back();
+                ++this->posted_accepts;
+            }
         }
+        catch (const std::exception& e) {
+            // post what we could - the next completion will try again
+            ctsConfig::PrintException(e);
+        }
+        return accept_sockets_to_post;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -450,13 +649,15 @@ namespace ctsTraffic {
     ///
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     inline
-    ctsAcceptEx::ctsAcceptSocketInfo::ctsAcceptSocketInfo(std::shared_ptr<ctsAcceptEx::ctsListenSocketInfo>& _listen_socket)
+    ctsAcceptEx::ctsAcceptSocketInfo::ctsAcceptSocketInfo(ctsAcceptEx::ctsListenSocketInfo* _listen_socket)
     : socket(INVALID_SOCKET),
       cs(),
       pov(NULL),
       listening_socket(_listen_socket->socket),
       listening_addr(_listen_socket->addr),
-      listening_iocp(_listen_socket->iocp)
+      listening_iocp(_listen_socket->iocp),
+      listen_socket_info(_listen_socket),
+      cancelled(false)
     {
         if (!::InitializeCriticalSectionAndSpinCount(&cs, 4000)) {
             throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionAndSpinCount", L"ctsAcceptEx", false);
@@ -473,67 +674,94 @@ namespace ctsTraffic {
     }
 
     inline
-    void ctsAcceptEx::ctsAcceptSocketInfo::InitatiateAcceptEx(std::shared_ptr<ctsAcceptEx::ctsAcceptExImpl> _pimpl)
+    bool ctsAcceptEx::ctsAcceptSocketInfo::InitatiateAcceptEx(std::shared_ptr<ctsAcceptEx::ctsAcceptExImpl> _pimpl)
     {
-        ctl::ctAutoReleaseCriticalSection lock(&this->cs);
+        bool completed_inline = false;
+        // scoping the lock: an inline completion must be processed after releasing it
+        // - the callback takes the ctsAcceptExImpl lock, which is held while taking this lock to cancel requests
+        {
+            ctl::ctAutoReleaseCriticalSection lock(&this->cs);
 
-        if (this->socket != INVALID_SOCKET) {
-            // no need to post another AcceptEx
-            return;
-        }
+            if (this->socket != INVALID_SOCKET) {
+                // no need to post another AcceptEx
+                return true;
+            }
 
-        SOCKET new_socket = ::WSASocket(this->listening_addr.family(), SOCK_STREAM, IPPROTO_TCP, NULL, 0, ctsConfig::Settings->SocketFlags);
-        if (INVALID_SOCKET == new_socket) {
-            throw ctl::ctException(::WSAGetLastError(), L"WSASocket", L"ctsAcceptEx", false);
-        }
-        ctlScopeGuard(closeSocketOnError, { ::closesocket(new_socket); });
+            SOCKET new_socket = ::WSASocket(this->listening_addr.family(), SOCK_STREAM, IPPROTO_TCP, NULL, 0, ctsConfig::Settings->SocketFlags);
+            if (INVALID_SOCKET == new_socket) {
+                throw ctl::ctException(::WSAGetLastError(), L"WSASocket", L"ctsAcceptEx", false);
+            }
+            ctlScopeGuard(closeSocketOnError, { ::closesocket(new_socket); });
 
-        // since not inheriting from the listing socket, must explicity set options on the accept socket
-        // - passing the listening address since that will be the local address of this accepted socket
-        auto options = ctsConfig::SetPreBindOptions(new_socket, this->listening_addr);
-        if (options != 0) {
-            throw ctl::ctException(options, L"SetPreBindOptions", L"ctsAcceptEx", false);
-        }
-        options = ctsConfig::SetPreConnectOptions(new_socket);
-        if (options != 0) {
-            throw ctl::ctException(options, L"SetPreConnectOptions", L"ctsAcceptEx", false);
-        }
+            // since not inheriting from the listing socket, must explicity set options on the accept socket
+            // - passing the listening address since that will be the local address of this accepted socket
+            auto options = ctsConfig::SetPreBindOptions(new_socket, this->listening_addr);
+            if (options != 0) {
+                throw ctl::ctException(options, L"SetPreBindOptions", L"ctsAcceptEx", false);
+            }
+            options = ctsConfig::SetPreConnectOptions(new_socket);
+            if (options != 0) {
+                throw ctl::ctException(options, L"SetPreConnectOptions", L"ctsAcceptEx", false);
+            }
 
-        ::ZeroMemory(this->OutputBuffer, SingleOutputBufferSize * 2);
-        DWORD bytes_received;
+            ::ZeroMemory(this->OutputBuffer, SingleOutputBufferSize * 2);
+            DWORD bytes_received;
+
+            this->pov = this->listening_iocp->new_request(
+                ctsAcceptExIoCompletionCallback,
+                _pimpl,
+                this);
+            if (!ctl::ctAcceptEx(
+                    this->listening_socket,
+                    new_socket,
+                    this->OutputBuffer,
+                    0, SingleOutputBufferSize, SingleOutputBufferSize,
+                    &bytes_received,
+                    this->pov)) {
+                int error = ::WSAGetLastError();
+                if (ERROR_IO_PENDING != error) {
+                    // a real failure - must abort the IO
+                    this->listening_iocp->cancel_request(this->pov);
+                    this->pov = nullptr;
+                    // the scope guard closes new_socket
+                    ctsConfig::PrintErrorIfFailed(L"AcceptEx", error);
+                    return false;
+                }
 
-        this->pov = this->listening_iocp->new_request(
-            ctsAcceptExIoCompletionCallback,
-            _pimpl,
-            this);
-        if (!ctl::ctAcceptEx(
-                this->listening_socket,
-                new_socket,
-                this->OutputBuffer,
-                0, SingleOutputBufferSize, SingleOutputBufferSize,
-                &bytes_received,
-                this->pov)) {
-            int error = ::WSAGetLastError();
-            if (ERROR_IO_PENDING != error) {
-                // a real failure - must abort the IO
+            } else if (ctsConfig::Settings->Options & ctsConfig::OptionType::HANDLE_INLINE_IOCP) {
+                // AcceptEx completed inline - directly invoke the callback to handle the completion
+                // - after canceling the TP request
                 this->listening_iocp->cancel_request(this->pov);
                 this->pov = nullptr;
-                ::closesocket(new_socket);
-                ctsConfig::PrintErrorIfFailed(L"AcceptEx", error);
-                return;
+                completed_inline = true;
             }
 
-        } else if (ctsConfig::Settings->Options & ctsConfig::OptionType::HANDLE_INLINE_IOCP) {
-            // AcceptEx completed inline - directly invoke the callback to handle the completion
-            // - after canceling the TP request
-            this->listening_iocp->cancel_request(this->pov);
-            this->pov = nullptr;
+            // no failures - store the socket
+            closeSocketOnError.dismiss();
+            this->socket = new_socket;
+        }
+
+        if (completed_inline) {
             ctsAcceptExIoCompletionCallback(nullptr, _pimpl, this);
         }
+        return true;
+    }
+
+    inline
+    bool ctsAcceptEx::ctsAcceptSocketInfo::CancelAcceptEx() throw()
+    {
+        ctl::ctAutoReleaseCriticalSection lock(&this->cs);
 
-        // no failures - store the socket
-        closeSocketOnError.dismiss();
-        this->socket = new_socket;
+        // a null OVERLAPPED* would cancel all IO on the listening socket
+        if (INVALID_SOCKET == this->socket || nullptr == this->pov || this->cancelled) {
+            return false;
+        }
+        // fails with ERROR_NOT_FOUND if the AcceptEx has already completed
+        if (!::CancelIoEx(reinterpret_cast<HANDLE>(this->listening_socket), this->pov)) {
+            return false;
+        }
+        this->cancelled = true;
+        return true;
     }
 
     inline
@@ -542,6 +770,9 @@ namespace ctsTraffic {
         ctl::ctAutoReleaseCriticalSection auto_lock(&this->cs);
 
         ctsAcceptEx::ctsAcceptedConnection return_details;
+        return_details.accepted_usec = ctl::ctTimer::snap_clock_usec();
+        return_details.cancelled = this->cancelled;
+        this->cancelled = false;
         // if the OVERLAPPED* is null, it means it completed inline (no OVERLAPPED async completion)
         // - thus we know it already succeeded
         if (this->pov) {
@@ -554,7 +785,10 @@ namespace ctsTraffic {
                 &flags)) {
                 return_details.gle = ::WSAGetLastError();
 
-                ctsConfig::PrintErrorIfFailed(L"AcceptEx", return_details.gle);
+                // not an error when we canceled the request
+                if (!return_details.cancelled) {
+                    ctsConfig::PrintErrorIfFailed(L"AcceptEx", return_details.gle);
+                }
                 if (this->socket != INVALID_SOCKET) {
                     ::closesocket(this->socket);
                     this->socket = INVALID_SOCKET;
@@ -579,7 +813,11 @@ namespace ctsTraffic {
             static_cast<long long>(socket),
             static_cast<long long>(this->listening_socket));
 
+        const long long accepted_usec = return_details.accepted_usec;
+        const bool cancelled_request = return_details.cancelled;
         return_details = this->make_sockaddr_details();
+        return_details.accepted_usec = accepted_usec;
+        return_details.cancelled = cancelled_request;
         // about to return the socket to the user, nullify it here first
         this->socket = INVALID_SOCKET;
         return return_details;
@@ -36,7 +36,8 @@ namespace ctsTraffic {
     void ctsConnectExIoCompletionCallback(
         OVERLAPPED* _overlapped,
         std::weak_ptr<ctsSocket> _socket,
-        const ctl::ctSockaddr _targetAddress
+        const ctl::ctSockaddr _targetAddress,
+        long long _connect_start_usec
         ) throw()
     {
         auto shared_socket_lock(_socket.lock());
@@ -71,6 +72,7 @@ namespace ctsTraffic {
         }
 
         ctsConfig::PrintErrorIfFailed(L"ConnecteEx", gle);
+        ctsConfig::Settings->HistoricConnectionDetails.record_connect(_connect_start_usec, gle);
 
         if (NO_ERROR == gle) {
             // get the local addr
@@ -82,8 +84,9 @@ namespace ctsTraffic {
         }
 
         // unlock before completing the socket state
+        // - holding no locks, so IO can start inline on this thread
         socket_lock->unlock_socket();
-        socket_lock->complete_state(gle);
+        socket_lock->complete_state_inline(gle);
 
         // print results after completing state
         if (NO_ERROR == gle) {
@@ -114,7 +117,8 @@ namespace ctsTraffic {
 
                 // get a new IO request from the socket's TP
                 std::shared_ptr<ctl::ctThreadIocp> connect_iocp = socket_lock->thread_pool();
-                OVERLAPPED* pov = connect_iocp->new_request(ctsConnectExIoCompletionCallback, _socket, targetAddress);
+                const long long connect_start_usec = ctl::ctTimer::snap_clock_usec();
+                OVERLAPPED* pov = connect_iocp->new_request(ctsConnectExIoCompletionCallback, _socket, targetAddress, connect_start_usec);
 
                 if (!ctl::ctConnectEx(
                         socket,
@@ -131,6 +135,7 @@ namespace ctsTraffic {
                     } else {
                         // must call cancel() on the IOCP TP if the IO call fails
                         connect_iocp->cancel_request(pov);
+                        ctsConfig::Settings->HistoricConnectionDetails.record_connect(connect_start_usec, error);
                     }
 
                 } else if (ctsConfig::Settings->Options & ctsConfig::OptionType::HANDLE_INLINE_IOCP) {
@@ -138,7 +143,7 @@ namespace ctsTraffic {
                     connect_iocp->cancel_request(pov);
                     // directly invoke the callback to complete the IO
                     // - with a nullptr OVERLAPPED to indicate it's already completed
-                    ctsConnectExIoCompletionCallback(nullptr, _socket, targetAddress);
+                    ctsConnectExIoCompletionCallback(nullptr, _socket, targetAddress, connect_start_usec);
                 }
 
                 ctsConfig::PrintErrorIfFailed(L"ConnectEx", error);
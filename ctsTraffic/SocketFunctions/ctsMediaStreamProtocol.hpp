@@ -41,6 +41,7 @@ namespace ctsTraffic {
     ///   PAUSE
     ///   RESUME
     ///   DONE
+    ///   ECHO.<sequence_number><timestamp><payload>
     ///
 
     ///
@@ -51,6 +52,13 @@ namespace ctsTraffic {
     static const unsigned long UdpDatagramMaximumSizeBytes = 64000UL;
     static const unsigned long UdpDatagramHeaderSizeBytes = 24UL;
 
+    ///
+    /// The largest ECHO probe a client can send: the server receives all client messages into a buffer of this size
+    /// The header size of every ECHO probe: "ECHO." followed by the sequence number and the client's timestamp
+    ///
+    static const unsigned long UdpEchoMaximumSizeBytes = 1024UL;
+    static const unsigned long UdpEchoHeaderSizeBytes = 21UL;
+
     class ctsMediaStreamSendRequests {
     public:
         ctsMediaStreamSendRequests() = delete;
@@ -270,7 +278,8 @@ namespace ctsTraffic {
         enum Action : char {
             START = 0x1,
             RESEND = 0x2,
-            DONE = 0x3
+            DONE = 0x3,
+            ECHO = 0x4
         } action;
 
         ctsMediaStreamMessage(Action _action) throw()
@@ -323,6 +332,16 @@ namespace ctsTraffic {
 
             return constructed_string;
         }
+        ///
+        /// Writes the ECHO header into the start of the [in] buffer
+        /// - the buffer must be at least UdpEchoHeaderSizeBytes
+        ///
+        static void ConstructEcho(_Out_writes_bytes_(UdpEchoHeaderSizeBytes) char* _buffer, long long _seq_number, long long _timestamp) throw()
+        {
+            ::memcpy(_buffer, "ECHO.", 5);
+            ::memcpy(_buffer + 5, &_seq_number, 8);
+            ::memcpy(_buffer + 13, &_timestamp, 8);
+        }
 
         static ctsMediaStreamMessage Extract(_In_reads_bytes_(_input_length) const char* _input, _In_ unsigned _input_length)
         {
@@ -341,6 +360,12 @@ namespace ctsTraffic {
                 return resend;
             }
 
+            if (_input_length >= UdpEchoHeaderSizeBytes && ctl::ctString::istarts_with(buffer, "ECHO.")) {
+                ctsMediaStreamMessage echo(ECHO);
+                echo.sequence_number = *reinterpret_cast<const long long*>(_input + 5);
+                return echo;
+            }
+
             throw ctl::ctException(
                 ERROR_INVALID_DATA,
                 ctl::ctString::format_string(
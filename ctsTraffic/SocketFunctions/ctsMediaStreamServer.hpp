@@ -31,6 +31,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctScopeGuard.hpp>
 #include <ctThreadIocp.hpp>
 #include <ctHandle.hpp>
+#include <ctMpmcQueue.hpp>
 // project headers
 #include "ctsSocket.h"
 #include "ctsConfig.h"
@@ -46,6 +47,9 @@ See the Apache Version 2.0 License for specific language governing permissions a
 ///   - it queues up IO to a central prioritized queue of work
 ///     since all IO is triggered to occur at a future point, the queue is sorted by work that comes soonest
 ///
+/// - ctsMediaStreamServerAbort is the 'Abort' function
+///   - the sends are not pended on the ctsSocket, so closing it will not complete the connection
+///
 
 
 namespace ctsTraffic {
@@ -57,6 +61,10 @@ namespace ctsTraffic {
     /// Function to pass to the cts 'IO' functor
     ///
     void ctsMediaStreamServerIo(std::weak_ptr<ctsSocket> _socket) throw();
+    ///
+    /// Function to pass to the cts 'abort' functor
+    ///
+    void ctsMediaStreamServerAbort(std::weak_ptr<ctsSocket> _socket) throw();
 
     class ctsMediaStreamListeningSocket {
     private:
@@ -66,7 +74,7 @@ namespace ctsTraffic {
         _Guarded_by_(object_guard)
         std::shared_ptr<ctl::ctThreadIocp> thread_iocp;
         _Guarded_by_(object_guard)
-        std::array<char, 1024> recv_buffer;
+        std::array<char, UdpEchoMaximumSizeBytes> recv_buffer;
         _Guarded_by_(object_guard)
         ctl::ctScopedSocket socket;
         _Guarded_by_(object_guard)
@@ -165,7 +173,7 @@ namespace ctsTraffic {
           remote_addr(_addr),
           next_task(),
           sequence_number(0LL),
-          connect_time(ctl::ctTimer::snap_qpc_msec())
+          connect_time(ctl::ctTimer::snap_clock_msec())
         {
             if (!::InitializeCriticalSectionEx(&object_guard, 4000, 0)) {
                 throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsMediaStreamServer", false);
@@ -260,6 +268,11 @@ namespace ctsTraffic {
 
     class ctsMediaStreamServerImpl {
     private:
+        ///
+        /// bounds the ctsSockets, and the client endpoints, waiting to be paired
+        ///
+        static const unsigned long MaximumQueuedStarts = 16384;
+
         // ctsMediaStreamListeningSocket doesn't allow copies so using unique_ptr's to move them around
         std::vector<std::unique_ptr<ctsMediaStreamListeningSocket>> listening_sockets;
 
@@ -268,14 +281,19 @@ namespace ctsTraffic {
         _Guarded_by_(connected_object_guard)
         std::vector<std::unique_ptr<ctsMediaStreamConnectedSocket>> connected_sockets;
 
-        CRITICAL_SECTION awaiting_object_guard;
         // weak_ptr<> to ctsSocket objects ready to accept a connection
-        _Guarded_by_(awaiting_object_guard)
-        std::vector<std::weak_ptr<ctsSocket>> accepting_sockets;
+        // - not guarded: ctsSockets and endpoints are paired without a lock so the threads
+        //   accepting ctsSockets never block behind the threads processing START requests (nor the reverse)
+        ctl::ctMpmcQueue<std::weak_ptr<ctsSocket>> accepting_sockets;
 
         // endpoints that have been received from clients not yet matched to ctsSockets
-        _Guarded_by_(awaiting_object_guard)
-        std::vector<std::pair<SOCKET, ctl::ctSockaddr>> awaiting_endpoints;
+        ctl::ctMpmcQueue<std::pair<SOCKET, ctl::ctSockaddr>> awaiting_endpoints;
+
+        // the # of threads which asked to pair the above queues: only the first pairs them
+        _Interlocked_
+        long pairing_requests;
+        // only touched by the thread pairing the queues: a ctsSocket popped before an endpoint was queued for it
+        std::weak_ptr<ctsSocket> pairing_socket;
 
     public:
         // non-copyable
@@ -287,18 +305,14 @@ namespace ctsTraffic {
         : listening_sockets(),
           connected_object_guard(),
           connected_sockets(),
-          awaiting_object_guard(),
-          accepting_sockets(),
-          awaiting_endpoints()
+          accepting_sockets(MaximumQueuedStarts),
+          awaiting_endpoints(MaximumQueuedStarts),
+          pairing_requests(0L),
+          pairing_socket()
         {
             if (!::InitializeCriticalSectionEx(&connected_object_guard, 4000, 0)) {
                 throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsMediaStreamServer", false);
             }
-            if (!::InitializeCriticalSectionEx(&awaiting_object_guard, 4000, 0)) {
-                auto gle = ::GetLastError();
-                ::DeleteCriticalSection(&connected_object_guard);
-                throw ctl::ctException(gle, L"InitializeCriticalSectionEx", L"ctsMediaStreamServer", false);
-            }
 
             // 'listen' to each address
             for (const auto& addr : ctsConfig::Settings->ListenAddresses) {
@@ -392,57 +406,20 @@ namespace ctsTraffic {
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
         void accept_socket(const std::weak_ptr<ctsSocket>& _socket)
         {
-            auto shared_socket(_socket.lock());
-            if (shared_socket) {
-                // need a writer lock to allow modifying accepting_sockets and awaiting_endpoints
-                ctl::ctAutoReleaseCriticalSection lock_awaiting_object(&this->awaiting_object_guard);
-
-                if (0 == this->awaiting_endpoints.size()) {
-                    // just add it to our accepting sockets vector under the writer lock
-                    this->accepting_sockets.push_back(_socket);
-
-                } else {
-                    auto waiting_endpoint = this->awaiting_endpoints.rbegin();
-
-                    // must guard connected_sockets since we need to add it to the vector
-                    // - scope to the lock
-                    {
-                        ctl::ctAutoReleaseCriticalSection lock_connected_object(&this->connected_object_guard);
-                        this->connected_sockets.emplace_back(std::make_unique<ctsMediaStreamConnectedSocket>(
-                            _socket, waiting_endpoint->first, waiting_endpoint->second));
-                    }
-
-                    // now complete the ctsSocket 'Create' request
-                    // find the local address
-                    auto found_socket = std::find_if(
-                        this->listening_sockets.begin(),
-                        this->listening_sockets.end(),
-                        [&waiting_endpoint] (const std::unique_ptr<ctsMediaStreamListeningSocket>& _listener) {
-                        return (_listener->get_socket() == waiting_endpoint->first);
-                    });
-
-                    ctl::ctFatalCondition(
-                        (found_socket == this->listening_sockets.end()),
-                        L"Could not find the socket (%Iu) in the waiting_endpoint from our listening sockets (%p)\n",
-                        waiting_endpoint->first, &this->listening_sockets);
-
-                    shared_socket->set_local((*found_socket)->get_address());
-                    shared_socket->set_target(waiting_endpoint->second);
-                    shared_socket->complete_state(NO_ERROR);
-
-                    // if added to connected_sockets, can then safely remove it from the waiting endpoint
-                    // - no longer touching the iterator waiting_endpoint
-                    this->awaiting_endpoints.pop_back();
-                }
+            if (!this->accepting_sockets.try_push(_socket)) {
+                throw ctl::ctException(WSAENOBUFS, L"ctsSocket could not be queued to accept a connection", L"ctsMediaStreamServer", false);
             }
+
+            this->pair_awaiting_endpoints();
         }
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Process the removal of a connected socket once it is completed
         /// - remove_socket takes the remote address to find the socket
+        ///   and the error to complete its ctsSocket with
         /// 
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        void remove_socket(const ctl::ctSockaddr& _target_addr)
+        void remove_socket(const ctl::ctSockaddr& _target_addr, DWORD _error)
         {
             std::unique_ptr<ctsMediaStreamConnectedSocket> removed_socket;
             // scoping to the lock
@@ -462,7 +439,8 @@ namespace ctsTraffic {
                     removed_socket = std::move(*found_socket);
                     this->connected_sockets.erase(found_socket);
 
-                } else {
+                } else if (NO_ERROR == _error) {
+                    // an aborted socket may have already been removed by its DONE request
                     ctsConfig::PrintErrorInfo(
                         L"[%.3f] ctsMediaStreamServer - no connected socket with remote address %s to process the Done request\n",
                         ctsConfig::GetStatusTimeStamp(),
@@ -474,7 +452,7 @@ namespace ctsTraffic {
             if (removed_socket) {
                 std::shared_ptr<ctsSocket> shared_socket(removed_socket->reference_ctsSocket());
                 if (shared_socket) {
-                    shared_socket->complete_state(0);
+                    shared_socket->complete_state(_error);
                 }
             }
             // only after releasing the lock can we delete the removed ctsMediaStreamConnectedSocket
@@ -486,11 +464,10 @@ namespace ctsTraffic {
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Processes the incoming START request from the client
-        /// - if we have a waiting ctsSocket to accept it, will add it to connected_sockets
-        /// - else we'll queue it to awaiting_endpoints
+        /// - queues it to awaiting_endpoints, then pairs it with a waiting ctsSocket if there is one
         ///
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        void start(const ctl::ctScopedSocket& _socket, const ctl::ctSockaddr& _local_addr, const ctl::ctSockaddr& _target_addr)
+        void start(const ctl::ctScopedSocket& _socket, const ctl::ctSockaddr& _target_addr)
         {
             // before starting a socket, verify there is not already a connected socket with this same socket address
             // - scope the lock
@@ -514,41 +491,123 @@ namespace ctsTraffic {
                 }
             }
 
-            // find a ctsSocket waiting to 'accept' a connection and complete it
-            ctl::ctAutoReleaseCriticalSection lock_awaiting_object(&this->awaiting_object_guard);
-
-            // walk through the list to find a socket that is still alive to take this connection
-            bool added_connection = false;
-            while (!this->accepting_sockets.empty()) {
-                auto weak_instance = *this->accepting_sockets.rbegin();
-                auto shared_instance = weak_instance.lock();
-                if (shared_instance.get() != nullptr) {
-                    // 'move' the accepting socket to connected
-                    // - scope the lock
-                    {
-                        ctl::ctAutoReleaseCriticalSection lock_connected_object(&this->connected_object_guard);
-                        this->connected_sockets.emplace_back(std::make_unique<ctsMediaStreamConnectedSocket>(
-                            weak_instance, _socket.get(), _target_addr));
-                    }
+            // queue the endpoint, then pair it with a ctsSocket if one is waiting to 'accept' a connection
+            if (!this->awaiting_endpoints.try_push(std::make_pair(_socket.get(), _target_addr))) {
+                // the client will resend its START request
+                ctsConfig::PrintDebug(
+                    L"ctsMediaStreamServer - could not queue the START request from remote address %s\n",
+                    _target_addr.writeCompleteAddress().c_str());
+                return;
+            }
 
-                    // verify is successfully added to connected_sockets before popping off accepting_sockets
-                    added_connection = true;
-                    this->accepting_sockets.pop_back();
+            this->pair_awaiting_endpoints();
+        }
 
-                    // now complete the accepted ctsSocket back to the ctsSocketState
-                    shared_instance->set_local(_local_addr);
-                    shared_instance->set_target(_target_addr);
-                    shared_instance->complete_state(0);
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Pairs queued ctsSockets with queued endpoints
+        /// - called after adding to either queue: only one thread pairs at a time, and each caller's request
+        ///   is counted so the pairing thread makes another pass for any value pushed while it was pairing
+        /// - as each queue then has a single consumer, a failed pop means that queue has nothing (yet) to pair
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        void pair_awaiting_endpoints()
+        {
+            long requests = ctl::ctMemoryGuardIncrement(&this->pairing_requests);
+            if (requests > 1) {
+                // the thread already pairing will make another pass for this request
+                return;
+            }
 
-                    ctsConfig::PrintNewConnection(_target_addr);
+            for (;;) {
+                this->pair_queued_endpoints();
+                // exit only if no more requests came in while pairing
+                const long remaining = ctl::ctMemoryGuardSubtract(&this->pairing_requests, requests) - requests;
+                if (0 == remaining) {
                     break;
                 }
+                requests = remaining;
             }
+        }
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Only called by the thread pairing endpoints
+        /// - the ctsSocket popped for the next endpoint is held in pairing_socket across passes
+        ///   so it's never pushed back onto accepting_sockets
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        void pair_queued_endpoints()
+        {
+            for (;;) {
+                auto shared_instance = this->pairing_socket.lock();
+                if (!shared_instance) {
+                    // not yet holding a ctsSocket, or the ctsSocket was closed from beneath us
+                    if (!this->accepting_sockets.try_pop(this->pairing_socket)) {
+                        return;
+                    }
+                    continue;
+                }
+
+                std::pair<SOCKET, ctl::ctSockaddr> waiting_endpoint;
+                if (!this->awaiting_endpoints.try_pop(waiting_endpoint)) {
+                    // keep holding the ctsSocket for the next endpoint
+                    return;
+                }
+
+                // find the local address
+                // - listening_sockets is not modified after construction so needs no lock
+                auto found_socket = std::find_if(
+                    this->listening_sockets.begin(),
+                    this->listening_sockets.end(),
+                    [&waiting_endpoint] (const std::unique_ptr<ctsMediaStreamListeningSocket>& _listener) {
+                    return (_listener->get_socket() == waiting_endpoint.first);
+                });
+
+                ctl::ctFatalCondition(
+                    (found_socket == this->listening_sockets.end()),
+                    L"Could not find the socket (%Iu) in the waiting_endpoint from our listening sockets (%p)\n",
+                    waiting_endpoint.first, &this->listening_sockets);
+
+                // 'move' the accepting socket to connected
+                // - unless a START resent by the client was queued more than once, and an earlier one was already paired
+                bool already_connected = false;
+                try {
+                    ctl::ctAutoReleaseCriticalSection lock_connected_object(&this->connected_object_guard);
+                    already_connected = std::end(this->connected_sockets) != std::find_if(
+                        std::begin(this->connected_sockets),
+                        std::end(this->connected_sockets),
+                        [&waiting_endpoint] (const std::unique_ptr<ctsMediaStreamConnectedSocket>& _connected_socket) {
+                        return waiting_endpoint.second == _connected_socket->get_address();
+                    });
+                    if (!already_connected) {
+                        this->connected_sockets.emplace_back(std::make_unique<ctsMediaStreamConnectedSocket>(
+                            this->pairing_socket, waiting_endpoint.first, waiting_endpoint.second));
+                    }
+                }
+                catch (const std::exception& e) {
+                    // the endpoint is dropped: the client will resend its START request
+                    ctsConfig::PrintException(e);
+                    this->pairing_socket.reset();
+                    shared_instance->complete_state(ERROR_OUTOFMEMORY);
+                    continue;
+                }
 
-            // if we didn't find a waiting connection to accept it, queue it for when one arrives later
-            if (!added_connection) {
-                // only queue it if we aren't already waiting on this address
-                this->awaiting_endpoints.emplace_back(_socket.get(), _target_addr);
+                if (already_connected) {
+                    ctsConfig::PrintDebug(
+                        L"ctsMediaStreamServer - dropping a duplicate START request queued for remote address %s\n",
+                        waiting_endpoint.second.writeCompleteAddress().c_str());
+                    // keep holding the ctsSocket for the next endpoint
+                    continue;
+                }
+
+                // now complete the accepted ctsSocket back to the ctsSocketState
+                this->pairing_socket.reset();
+                shared_instance->set_local((*found_socket)->get_address());
+                shared_instance->set_target(waiting_endpoint.second);
+                shared_instance->complete_state(NO_ERROR);
+
+                ctsConfig::PrintNewConnection(waiting_endpoint.second);
             }
         }
 
@@ -615,6 +674,75 @@ namespace ctsTraffic {
                 }
             }
         }
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Process an incoming ECHO probe
+        /// - the datagram is sent back unmodified, only to clients which were Started
+        ///   so the server cannot be used to reflect datagrams to arbitrary addresses
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        void echo(_In_reads_bytes_(_buffer_length) char* _buffer, unsigned long _buffer_length, const ctl::ctSockaddr& _target_addr)
+        {
+            std::shared_ptr<ctsSocket> shared_socket;
+            unsigned long echo_error = NO_ERROR;
+            DWORD bytes_sent = 0;
+            // scope to the lock
+            {
+                ctl::ctAutoReleaseCriticalSection lock_connected_object(&this->connected_object_guard);
+
+                auto found_socket = std::find_if(
+                    std::begin(this->connected_sockets),
+                    std::end(this->connected_sockets),
+                    [&_target_addr] (const std::unique_ptr<ctsMediaStreamConnectedSocket>& _connected_socket) {
+                    return _target_addr == _connected_socket->get_address();
+                });
+                if (found_socket == std::end(this->connected_sockets)) {
+                    // probes can arrive before the START was matched to a ctsSocket: the client counts these as lost
+                    ctsConfig::PrintDebug(
+                        L"\t\tctsMediaStreamServer - dropping an ECHO from %s which has not been Started\n",
+                        _target_addr.writeCompleteAddress().c_str());
+                    return;
+                }
+
+                const std::unique_ptr<ctsMediaStreamConnectedSocket>& found_protected_socket = *found_socket;
+                shared_socket = found_protected_socket->reference_ctsSocket();
+                if (!shared_socket) {
+                    return;
+                }
+
+                SOCKET s = found_protected_socket->socket_lock();
+#pragma warning(suppress: 26110)   //  PREFast is getting confused with the scope guard
+                ctlScopeGuard(releaseSocketLockOnExit, { found_protected_socket->socket_release(); });
+                if (INVALID_SOCKET == s) {
+                    return;
+                }
+
+                WSABUF wsabuf;
+                wsabuf.buf = _buffer;
+                wsabuf.len = _buffer_length;
+                // making a synchronous call
+                if (SOCKET_ERROR == ::WSASendTo(s, &wsabuf, 1, &bytes_sent, 0, _target_addr.sockaddr(), _target_addr.length(), nullptr, nullptr)) {
+                    echo_error = ::WSAGetLastError();
+                    ctsConfig::PrintErrorInfo(
+                        L"[%.3f] WSASendTo(%Iu, %s) for an ECHO request failed [%d]\n",
+                        ctsConfig::GetStatusTimeStamp(),
+                        s,
+                        _target_addr.writeCompleteAddress().c_str(),
+                        echo_error);
+                }
+            }
+
+            // the reflected probe is counted by the ctsSocket's IO Pattern - outside the connected socket lock
+            ctsIOTask echo_task;
+            echo_task.ioAction = ctsIOTask::IOAction::Send;
+            echo_task.tracked_io = false;
+            echo_task.buffer = _buffer;
+            echo_task.buffer_length = _buffer_length;
+            if (ctsSocket::IOStatus::Failure == shared_socket->complete_io(echo_task, bytes_sent, echo_error)) {
+                this->remove_socket(_target_addr, NO_ERROR);
+            }
+        }
     };
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -627,6 +755,8 @@ namespace ctsTraffic {
     static inline
     BOOL CALLBACK InitOnceImpl(PINIT_ONCE, PVOID, PVOID *)
     {
+        // new only honors the default heap alignment: the Impl (and the queues it embeds) must not ask for more
+        static_assert(alignof(ctsMediaStreamServerImpl) <= MEMORY_ALLOCATION_ALIGNMENT, "ctsMediaStreamServerImpl must not be over-aligned");
         try {
             pimpl = new ctsMediaStreamServerImpl();
         }
@@ -705,6 +835,31 @@ namespace ctsTraffic {
         }
     }
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Called when the time limit aborts a connection which is sending
+    /// - stops its timer and removes it from the connected_sockets vector,
+    ///   completing the ctsSocket as aborted
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline
+    void ctsMediaStreamServerAbort(std::weak_ptr<ctsSocket> _socket) throw()
+    {
+        try {
+            if (!::InitOnceExecuteOnce(&InitImpl, InitOnceImpl, NULL, NULL)) {
+                throw std::runtime_error("ctsMediaStreamServerAbort could not be instantiated");
+            }
+
+            auto shared_socket(_socket.lock());
+            if (shared_socket) {
+                pimpl->remove_socket(shared_socket->get_target(), WSAECONNABORTED);
+            }
+        }
+        catch (const std::exception& e) {
+            ctsConfig::PrintException(e);
+        }
+    }
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
     /// Definitions for methods declared above
@@ -743,7 +898,7 @@ namespace ctsTraffic {
                                 this->remote_addr.writeCompleteAddress().c_str());
 
                             // cannot hold the object lock when remove this object through the pimpl
-                            pimpl_operation = ([&] () { pimpl->remove_socket(this->remote_addr); });
+                            pimpl_operation = ([&] () { pimpl->remove_socket(this->remote_addr, NO_ERROR); });
 
                         } else {
                             ctsConfig::PrintErrorInfo(
@@ -762,7 +917,7 @@ namespace ctsTraffic {
 #ifndef TESTING_IGNORE_START
                                 // cannot hold the object lock when remove this object through the pimpl
                                 // - all values must be passed to the lambda by value not by reference since they will be accessed outside the lock
-                                pimpl_operation = ([&] () { pimpl->start(this->socket, this->listening_addr, this->remote_addr); });
+                                pimpl_operation = ([&] () { pimpl->start(this->socket, this->remote_addr); });
 #endif
                                 break;
 
@@ -782,7 +937,13 @@ namespace ctsTraffic {
                                     this->remote_addr.writeCompleteAddress().c_str());
 
                                 // cannot hold the object lock when remove this object through the pimpl
-                                pimpl_operation = ([&] () {pimpl->remove_socket(this->remote_addr); });
+                                pimpl_operation = ([&] () {pimpl->remove_socket(this->remote_addr, NO_ERROR); });
+                                break;
+
+                            case ctsMediaStreamMessage::Action::ECHO:
+                                // cannot hold the object lock when reflecting the probe through the pimpl
+                                // - the recv_buffer is not reused until initiate_recv is called after pimpl_operation
+                                pimpl_operation = ([this, bytes_received] () { pimpl->echo(this->recv_buffer.data(), bytes_received, this->remote_addr); });
                                 break;
 
                             default:
@@ -933,7 +1094,7 @@ namespace ctsTraffic {
         std::shared_ptr<ctsSocket> shared_ctsSocket = this_ptr->cts_socket.lock();
         if (shared_ctsSocket.get() == nullptr) {
             // socket is already gone - remove it from the impl and exit
-            pimpl->remove_socket(this_ptr->remote_addr);
+            pimpl->remove_socket(this_ptr->remote_addr, NO_ERROR);
             return;
         }
 
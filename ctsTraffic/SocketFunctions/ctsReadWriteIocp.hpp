@@ -107,6 +107,29 @@ namespace ctsTraffic {
         psocket->unlock_socket();
     }
 
+    ///
+    /// TP timer callback continuing IO once the -InlineCompletions budget was exhausted
+    /// - an IO count was taken when this was scheduled, released once the IO has been continued
+    ///
+    static
+    inline
+    void ctsReadWriteIocpContinueIo(std::weak_ptr<ctsSocket> _weak_socket, const ctsIOTask&) throw()
+    {
+        auto shared_socket_lock(_weak_socket.lock());
+        ctsSocket* psocket(shared_socket_lock.get());
+        if (nullptr == psocket) {
+            // underlying socket went away - nothing to do
+            return;
+        }
+
+        ctsReadWriteIocp(_weak_socket);
+
+        if (psocket->decrement_io() == 0) {
+            // any IO failure was already recorded on the socket by complete_io
+            psocket->complete_state(NO_ERROR);
+        }
+    }
+
     ///
     /// The registered function with ctsConfig
     ///
@@ -125,11 +148,30 @@ namespace ctsTraffic {
         long io_count = -1;
         bool io_done = false;
         int io_error = NO_ERROR;
+        // IO completing inline is processed on this thread, up to the -InlineCompletions budget
+        unsigned long inline_completions = 0;
 
         SOCKET s = psocket->lock_socket();
         if (s != INVALID_SOCKET) {
             // loop until failure or initiate_io returns None
             while (!io_done && (NO_ERROR == io_error)) {
+                if (inline_completions >= ctsConfig::Settings->InlineCompletions) {
+                    // budget exhausted: continue from a TP thread (with no delay) so one connection
+                    // - with a fast peer cannot monopolize this thread
+                    // - holding an IO count until the continuation runs
+                    io_count = psocket->increment_io();
+                    try {
+                        psocket->set_timer(ctsIOTask(), ctsReadWriteIocpContinueIo);
+                        break;
+                    }
+                    catch (const std::exception& e) {
+                        // failing to schedule is not fatal: keep processing IO inline
+                        ctsConfig::PrintException(e);
+                        io_count = psocket->decrement_io();
+                        inline_completions = 0;
+                    }
+                }
+
                 ctsIOTask next_io = psocket->initiate_io();
                 if (ctsIOTask::IOAction::None == next_io.ioAction) {
                     // nothing failed, just no more IO right now
@@ -170,28 +212,41 @@ namespace ctsTraffic {
                 // No-Throw operations from here until end of try {} block
                 /////////////////////////////////////////////////////////////
 
+                BOOL io_succeeded;
                 if (ctsIOTask::IOAction::Send == next_io.ioAction) {
-                    if (!::WriteFile(reinterpret_cast<HANDLE>(s), next_io.buffer + next_io.buffer_offset, next_io.buffer_length, NULL, pov)) {
-                        io_error = ::GetLastError();
-                    }
+                    io_succeeded = ::WriteFile(reinterpret_cast<HANDLE>(s), next_io.buffer + next_io.buffer_offset, next_io.buffer_length, NULL, pov);
                 } else {
-                    if (!::ReadFile(reinterpret_cast<HANDLE>(s), next_io.buffer + next_io.buffer_offset, next_io.buffer_length, NULL, pov)) {
-                        io_error = ::GetLastError();
-                    }
+                    io_succeeded = ::ReadFile(reinterpret_cast<HANDLE>(s), next_io.buffer + next_io.buffer_offset, next_io.buffer_length, NULL, pov);
+                }
+                if (!io_succeeded) {
+                    io_error = ::GetLastError();
                 }
                 //
                 // not calling complete_io on success, since the IO completion will handle that in the callback
+                // - unless the IO completed inline and no completion will be queued (HANDLE_INLINE_IOCP)
                 //
                 if (ERROR_IO_PENDING == io_error) {
                     io_error = NO_ERROR;
                 }
-
-                if (io_error != NO_ERROR) {
-                    // must cancel the IOCP TP if the IO call fails
+                const bool completed_inline =
+                    io_succeeded &&
+                    !!(ctsConfig::Settings->Options & ctsConfig::OptionType::HANDLE_INLINE_IOCP);
+
+                if (io_error != NO_ERROR || completed_inline) {
+                    DWORD bytes_transferred = 0;
+                    if (completed_inline) {
+                        DWORD flags;
+                        if (!::WSAGetOverlappedResult(s, pov, &bytes_transferred, FALSE, &flags)) {
+                            ctl::ctAlwaysFatalCondition(
+                                L"WSAGetOverlappedResult failed (%d) after the IO request succeeded", ::WSAGetLastError());
+                        }
+                        ++inline_completions;
+                    }
+                    // must cancel the IOCP TP since the IO is not pended
                     io_thread_pool->cancel_request(pov);
-                    // call back to the socket that it failed to see if wants more IO
+                    // call back to the socket to see if wants more IO
                     const wchar_t* Function = (ctsIOTask::IOAction::Send == next_io.ioAction) ? L"WriteFile" : L"ReadFile";
-                    ctsSocket::IOStatus protocol_status = psocket->complete_io(next_io, 0, io_error);
+                    ctsSocket::IOStatus protocol_status = psocket->complete_io(next_io, bytes_transferred, io_error);
                     io_done = (protocol_status != ctsSocket::IOStatus::SuccessMoreIO);
                     switch (protocol_status) {
                         case ctsSocket::IOStatus::SuccessMoreIO:
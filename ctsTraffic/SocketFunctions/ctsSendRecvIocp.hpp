@@ -28,6 +28,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsConfig.h"
 #include "ctsSocket.h"
 #include "ctsIOTask.hpp"
+#include "ctsIoScheduler.h"
 
 
 namespace ctsTraffic {
@@ -37,7 +38,7 @@ namespace ctsTraffic {
     void ctsSendRecvIocp(std::weak_ptr<ctsSocket> _weak_socket) throw();
 
     struct  ctsSendRecvStatus {
-        ctsSendRecvStatus() throw() : io_errorcode(NO_ERROR), io_done(false), io_started(false)
+        ctsSendRecvStatus() throw() : io_errorcode(NO_ERROR), io_done(false), io_started(false), io_completed_inline(false)
         {
         }
 
@@ -47,6 +48,8 @@ namespace ctsTraffic {
         bool io_done;
         // returns if IO was started (since can return !io_done, but I/O wasn't started yet)
         bool io_started;
+        // returns if the IO call succeeded and its completion was processed inline (HANDLE_INLINE_IOCP)
+        bool io_completed_inline;
     };
 
     ///
@@ -85,8 +88,14 @@ namespace ctsTraffic {
                 // write to PrintDebug if the IO failed - only debug since the protocol ignored the error
                 ctsConfig::PrintDebugIfFailed(function, gle, L"ctsSendRecvIocp");
                 // more IO is requested from the protocol
-                // - invoke the new IO call while holding a refcount to the prior IO
-                ctsSendRecvIocp(_weak_socket);
+                if (ctsConfig::Settings->IoScheduler != ctsConfig::IoSchedulerType::NoScheduler) {
+                    // the scheduler holds its own refcount until it issues this connection's next IO
+                    psocket->increment_io();
+                    ctsIoScheduler::ScheduleIo(_weak_socket, transferred);
+                } else {
+                    // invoke the new IO call while holding a refcount to the prior IO
+                    ctsSendRecvIocp(_weak_socket);
+                }
                 break;
 
             case ctsSocket::IOStatus::SuccessDone:
@@ -211,6 +220,7 @@ namespace ctsTraffic {
         } else {
             // process the completion if the API call failed, or if it succeeded and we're handling the completion inline, 
             return_status.io_started = false;
+            return_status.io_completed_inline = (NO_ERROR == return_status.io_errorcode);
             // determine # of bytes transferred, if any
             DWORD bytes_transferred = 0;
             if (NO_ERROR == return_status.io_errorcode) {
@@ -296,6 +306,28 @@ namespace ctsTraffic {
         }
     }
 
+    ///
+    /// TP timer callback continuing IO once the -InlineCompletions budget was exhausted
+    /// - an IO count was taken when this was scheduled, released once the IO has been continued
+    ///
+    static inline
+    void ctsSendRecvIocpContinueIo(std::weak_ptr<ctsSocket> _weak_socket, const ctsIOTask&) throw()
+    {
+        auto shared_socket_lock(_weak_socket.lock());
+        ctsSocket* psocket = shared_socket_lock.get();
+        if (nullptr == psocket) {
+            // underlying socket went away - nothing to do
+            return;
+        }
+
+        ctsSendRecvIocp(_weak_socket);
+
+        if (psocket->decrement_io() == 0) {
+            // any IO failure was already recorded on the socket by complete_io
+            psocket->complete_state(NO_ERROR);
+        }
+    }
+
     ///
     /// The function registered with ctsConfig
     ///
@@ -320,8 +352,27 @@ namespace ctsTraffic {
         //
         psocket->increment_io();
 
+        // IO completing inline is processed on this thread, up to the -InlineCompletions budget
+        unsigned long inline_completions = 0;
         ctsSendRecvStatus status;
         while (!status.io_done) {
+            if (inline_completions >= ctsConfig::Settings->InlineCompletions) {
+                // budget exhausted: continue from a TP thread (with no delay) so one connection
+                // - with a fast peer cannot monopolize this thread
+                // - holding an IO count until the continuation runs
+                psocket->increment_io();
+                try {
+                    shared_socket_lock->set_timer(ctsIOTask(), ctsSendRecvIocpContinueIo);
+                    break;
+                }
+                catch (const std::exception& e) {
+                    // failing to schedule is not fatal: keep processing IO inline
+                    ctsConfig::PrintException(e);
+                    psocket->decrement_io();
+                    inline_completions = 0;
+                }
+            }
+
             ctsIOTask next_io = psocket->initiate_io();
             if (ctsIOTask::IOAction::None == next_io.ioAction) {
                 // nothing failed, just no more IO right now
@@ -350,6 +401,9 @@ namespace ctsTraffic {
 
             } else {
                 status = ctsProcessIOTask(shared_socket_lock, next_io);
+                if (status.io_completed_inline) {
+                    ++inline_completions;
+                }
             }
 
             // if no IO was started, decrement the IO counter
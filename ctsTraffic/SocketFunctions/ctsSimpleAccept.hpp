@@ -14,7 +14,6 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #pragma once
 
 // cpp headers
-#include <algorithm>
 #include <vector>
 #include <memory>
 #include <string>
@@ -25,7 +24,9 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // ctl headers
 #include <ctSockaddr.hpp>
 #include <ctException.hpp>
-#include <ctHandle.hpp>
+#include <ctScopeGuard.hpp>
+#include <ctTimer.hpp>
+#include <ctMpmcQueue.hpp>
 // project headers
 #include "ctsSocket.h"
 #include "ctsConfig.h"
@@ -35,61 +36,108 @@ namespace ctsTraffic {
     ///
     /// Functor class for implementing ctsSocketFunction
     ///
-    /// Implements listing/accepting connections in the simplest form
-    /// - posting an accept() for each functor instance
+    /// Implements listing/accepting connections with nonblocking accept() calls
+    /// - each listener is nonblocking and signals an event through WSAEventSelect(FD_ACCEPT)
+    /// - a threadpool wait on that event drains the entire backlog with accept() until WSAEWOULDBLOCK
+    ///
+    /// Accepted sockets and the ctsSocket objects requesting them meet in two lock-free queues
+    /// - whichever side adds to its queue then pairs entries off both queues until either is empty
+    /// - an entry popped without a match is pushed back and the queues re-checked,
+    ///   so an entry is never stranded while the other queue is non-empty
     ///
     /// Each listener functor will be copy constructed
     /// - so need to ensure that all members are easily copied
-    /// - also means the counter will need to be a ptr
-    ///
-    /// The refcount_sockets vector will optimize in balancing accept calls
-    /// - across all listeners
     ///
     class ctsSimpleAccept {
     private:
+        ///
+        /// bounds for the rendezvous queues - a push to a full queue fails that request or accepted socket
+        ///
+        static const unsigned long MaximumQueuedAccepts = 65536;
+
+        struct ctsSimpleAcceptImpl;
+
+        struct ctsAcceptedSocket {
+            SOCKET socket;
+            ctl::ctSockaddr local_addr;
+            ctl::ctSockaddr remote_addr;
+            // when accept() returned, to track how long the connection waited for a ctsSocket
+            long long accepted_usec;
+
+            ctsAcceptedSocket() throw() : socket(INVALID_SOCKET), local_addr(), remote_addr(), accepted_usec(0LL)
+            {
+            }
+        };
+
+        struct ctsListener {
+            SOCKET socket;
+            WSAEVENT accept_event;
+            PTP_WAIT thread_pool_wait;
+            ctl::ctSockaddr addr;
+            ctsSimpleAcceptImpl* pimpl;
+
+            ctsListener(const ctl::ctSockaddr& _addr, ctsSimpleAcceptImpl* _pimpl) throw() :
+                socket(INVALID_SOCKET),
+                accept_event(WSA_INVALID_EVENT),
+                thread_pool_wait(nullptr),
+                addr(_addr),
+                pimpl(_pimpl)
+            {
+            }
+            ~ctsListener() throw()
+            {
+                if (thread_pool_wait != nullptr) {
+                    // stop listening for the event and wait for any callbacks to complete
+                    ::SetThreadpoolWait(thread_pool_wait, nullptr, nullptr);
+                    ::WaitForThreadpoolWaitCallbacks(thread_pool_wait, TRUE);
+                    ::CloseThreadpoolWait(thread_pool_wait);
+                }
+                if (socket != INVALID_SOCKET) {
+                    ::closesocket(socket);
+                }
+                if (accept_event != WSA_INVALID_EVENT) {
+                    ::WSACloseEvent(accept_event);
+                }
+            }
+
+            // non-copyable
+            ctsListener(const ctsListener&) = delete;
+            ctsListener& operator=(const ctsListener&) = delete;
+        };
+
         //
         // since this object can be copied, all the members need to be within a single impl object
         // - so that the shared_ptr<> for this struct can remain constant across all copies
         //
         struct ctsSimpleAcceptImpl
         {
-            PTP_WORK thread_pool_worker;
-            TP_CALLBACK_ENVIRON thread_pool_environment;
-            // CS guards access to the accepting_sockets vector
-            CRITICAL_SECTION accepting_cs;
-
-            std::vector<SOCKET> listening_sockets;
-            std::vector<LONG> listening_sockets_refcount;
-            std::vector<std::weak_ptr<ctsSocket>> accepting_sockets;
+            std::vector<std::unique_ptr<ctsListener>> listeners;
+            ctl::ctMpmcQueue<std::weak_ptr<ctsSocket>> accepting_sockets;
+            ctl::ctMpmcQueue<ctsAcceptedSocket> accepted_sockets;
 
             ctsSimpleAcceptImpl() :
-                thread_pool_worker(nullptr),
-                thread_pool_environment(),
-                accepting_cs(),
-                listening_sockets(),
-                listening_sockets_refcount(),
-                accepting_sockets()
+                listeners(),
+                accepting_sockets(MaximumQueuedAccepts),
+                accepted_sockets(MaximumQueuedAccepts)
             {
-                ::ZeroMemory(&thread_pool_environment, sizeof thread_pool_environment);
-                ::ZeroMemory(&accepting_cs, sizeof accepting_cs);
             }
-            ~ctsSimpleAcceptImpl()
+            ~ctsSimpleAcceptImpl() throw()
             {
-                /// close all listening sockets to release any pended accept's
-                for (auto& listening_socket : listening_sockets) {
-                    if (listening_socket != INVALID_SOCKET) {
-                        ::closesocket(listening_socket);
+                // stop all accept callbacks and close all listening sockets
+                listeners.clear();
+
+                // fail all caller requests for new accepted sockets
+                std::weak_ptr<ctsSocket> weak_socket;
+                while (accepting_sockets.try_pop(weak_socket)) {
+                    auto shared_socket(weak_socket.lock());
+                    if (shared_socket) {
+                        shared_socket->complete_state(WSAECONNABORTED);
                     }
                 }
-                listening_sockets.clear();
-
-                if (thread_pool_worker != nullptr) {
-                    // ctsSimpleAccept object was initialized
-                    ::WaitForThreadpoolWorkCallbacks(thread_pool_worker, TRUE);
-                    ::CloseThreadpoolWork(thread_pool_worker);
+                ctsAcceptedSocket accepted_socket;
+                while (accepted_sockets.try_pop(accepted_socket)) {
+                    ::closesocket(accepted_socket.socket);
                 }
-
-                ::DeleteCriticalSection(&accepting_cs);
             }
 
             // non-copyable
@@ -102,160 +150,187 @@ namespace ctsTraffic {
     public:
         ctsSimpleAccept() : pimpl(new ctsSimpleAcceptImpl)
         {
-            // need a CS to guard access to our vectors
-            if (!::InitializeCriticalSectionAndSpinCount(&pimpl->accepting_cs, 4000)) {
-                throw ctl::ctException(::GetLastError(), L"InitializeCriticalSectionAndSpinCount", L"ctsSimpleAccept", false);
-            }
-
-            // will use the global threadpool, but will mark these work-items as running long
-            ::InitializeThreadpoolEnvironment(&pimpl->thread_pool_environment);
-            ::SetThreadpoolCallbackRunsLong(&pimpl->thread_pool_environment);
-        
-            // can *not* pass the this ptr to the threadpool, since this object can be copied
-            pimpl->thread_pool_worker = ::CreateThreadpoolWork(ThreadPoolWorker, pimpl.get(), ctsConfig::Settings->PTPEnvironment);
-            if (nullptr == pimpl->thread_pool_worker) {
-                throw ctl::ctException(::GetLastError(), L"CreateThreadpoolWork", L"ctsSimpleAccept", false);
-            }
-
             // listen to each address
             for (const auto& addr : ctsConfig::Settings->ListenAddresses) {
-#pragma warning(suppress: 28193) // PREFast isn't seeing that listening is indeed evaluated before being referenced
-                SOCKET listening(::WSASocket(addr.family(), SOCK_STREAM, IPPROTO_TCP, NULL, 0, ctsConfig::Settings->SocketFlags));
-                ctlScopeGuard(closeSocketOnError, { if (listening != INVALID_SOCKET) ::closesocket(listening); });
+                std::unique_ptr<ctsListener> listener(new ctsListener(addr, pimpl.get()));
 
-                if (INVALID_SOCKET == listening) {
+                listener->socket = ::WSASocket(addr.family(), SOCK_STREAM, IPPROTO_TCP, NULL, 0, ctsConfig::Settings->SocketFlags);
+                if (INVALID_SOCKET == listener->socket) {
                     throw ctl::ctException(::WSAGetLastError(), L"socket", L"ctsSimpleAccept", false);
                 }
-            
-                int gle = ctsConfig::SetPreBindOptions(listening, addr);
+
+                int gle = ctsConfig::SetPreBindOptions(listener->socket, addr);
                 if (gle != NO_ERROR) {
                     throw ctl::ctException(gle, L"SetPreBindOptions", L"ctsSimpleAccept", false);
                 }
-                gle = ctsConfig::SetPreConnectOptions(listening);
+                gle = ctsConfig::SetPreConnectOptions(listener->socket);
                 if (gle != NO_ERROR) {
                     throw ctl::ctException(gle, L"SetPreConnectOptions", L"ctsSimpleAccept", false);
                 }
 
-                if (SOCKET_ERROR == ::bind(listening, addr.sockaddr(), addr.length())) {
+                if (SOCKET_ERROR == ::bind(listener->socket, addr.sockaddr(), addr.length())) {
                     throw ctl::ctException(::WSAGetLastError(), L"bind", L"ctsSimpleAccept", false);
                 }
 
-                if (SOCKET_ERROR == ::listen(listening, ctsConfig::GetListenBacklog())) {
+                if (SOCKET_ERROR == ::listen(listener->socket, ctsConfig::GetListenBacklog())) {
                     throw ctl::ctException(::WSAGetLastError(), L"listen", L"ctsSimpleAccept", false);
                 }
 
-                pimpl->listening_sockets.push_back(listening);
-                // socket is now being tracked in listening_sockets, dismiss the scope guard
-                closeSocketOnError.dismiss();
+                // WSAEventSelect also sets the listening socket nonblocking
+                listener->accept_event = ::WSACreateEvent();
+                if (WSA_INVALID_EVENT == listener->accept_event) {
+                    throw ctl::ctException(::WSAGetLastError(), L"WSACreateEvent", L"ctsSimpleAccept", false);
+                }
+                if (SOCKET_ERROR == ::WSAEventSelect(listener->socket, listener->accept_event, FD_ACCEPT)) {
+                    throw ctl::ctException(::WSAGetLastError(), L"WSAEventSelect", L"ctsSimpleAccept", false);
+                }
+
+                // can *not* pass the this ptr to the threadpool, since this object can be copied
+                listener->thread_pool_wait = ::CreateThreadpoolWait(ThreadPoolWaitCallback, listener.get(), ctsConfig::Settings->PTPEnvironment);
+                if (nullptr == listener->thread_pool_wait) {
+                    throw ctl::ctException(::GetLastError(), L"CreateThreadpoolWait", L"ctsSimpleAccept", false);
+                }
 
                 ctsConfig::PrintDebug(
                     L"\t\tListening to %s\n", addr.writeCompleteAddress().c_str());
+
+                pimpl->listeners.push_back(std::move(listener));
             }
 
-            if (pimpl->listening_sockets.empty()) {
+            if (pimpl->listeners.empty()) {
                 throw std::exception("ctsSimpleAccept invoked with no listening addresses specified");
             }
-            pimpl->listening_sockets_refcount.resize(pimpl->listening_sockets.size(), 0L);
+
+            // start waiting for connections only once all listeners were created
+            for (const auto& listener : pimpl->listeners) {
+                ::SetThreadpoolWait(listener->thread_pool_wait, listener->accept_event, nullptr);
+            }
         }
 
 
         ///
         /// ctsSocketFunction functor operator()
-        /// - Needs to not block ctsSocketState - will just schedule work on its own TP
+        /// - Needs to not block ctsSocketState - queues the request to be paired with an accepted socket
         ///
         void operator() (std::weak_ptr<ctsSocket> _socket)
         {
-            bool bSubmittedWork = false;
-            ::EnterCriticalSection(&pimpl->accepting_cs);
-            try {
-                pimpl->accepting_sockets.push_back(_socket);
-                ::SubmitThreadpoolWork(pimpl->thread_pool_worker);
-                bSubmittedWork = true;
-            } catch (const std::bad_alloc& e) {
-                ctsConfig::PrintException(e);
-            }
-            ::LeaveCriticalSection(&pimpl->accepting_cs);
-
-            // fail the socket if can't submit to the worker thread
-            if (!bSubmittedWork) {
+            if (!pimpl->accepting_sockets.try_push(_socket)) {
+                // fail the socket if can't queue the request
                 auto shared_socket(_socket.lock());
                 if (shared_socket) {
-                    shared_socket->complete_state(ERROR_OUTOFMEMORY);
+                    shared_socket->complete_state(WSAENOBUFS);
                 }
+                return;
             }
+
+            CompleteAcceptedSockets(pimpl.get());
         }
 
+    private:
+        ///
+        /// drains the backlog of the listener whose FD_ACCEPT event was signaled
+        ///
         static
-        VOID NTAPI ThreadPoolWorker(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) throw()
+        VOID NTAPI ThreadPoolWaitCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WAIT _wait, TP_WAIT_RESULT) throw()
         {
-            ctsSimpleAcceptImpl* pimpl = reinterpret_cast<ctsSimpleAcceptImpl*>(_context);
-
-            // get an accept-socket off the vector (protected with its cs)
-            ::EnterCriticalSection(&pimpl->accepting_cs);
-            std::weak_ptr<ctsSocket> weak_socket(*pimpl->accepting_sockets.rbegin());
-            pimpl->accepting_sockets.pop_back();
-            ::LeaveCriticalSection(&pimpl->accepting_cs);
-
-            auto shared_socket(weak_socket.lock());
-            ctsSocket* accept_socket = shared_socket.get();
-            if (accept_socket == nullptr) {
-                // underlying socket went away - nothing to do now
-                return;
+            ctsListener* listener = reinterpret_cast<ctsListener*>(_context);
+
+            // resets the event - FD_ACCEPT is signaled again once a connection arrives after accept() fails with WSAEWOULDBLOCK
+            WSANETWORKEVENTS network_events;
+            if (SOCKET_ERROR == ::WSAEnumNetworkEvents(listener->socket, listener->accept_event, &network_events)) {
+                ctsConfig::PrintErrorIfFailed(L"WSAEnumNetworkEvents", ::WSAGetLastError());
             }
 
-            // based off of the refcount, choose a socket that's least used
-            // - not taking a lock: it doesn't have to be that precise
-            LONG lowest_refcount = pimpl->listening_sockets_refcount[0];
-            unsigned listener_counter = 0;
-            unsigned listener_position = 0;
-            for (const auto& refcount : pimpl->listening_sockets_refcount) {
-                if (refcount < lowest_refcount) {
-                    lowest_refcount = refcount;
-                    listener_position = listener_counter;
+            bool added_sockets = false;
+            for (;;) {
+                ctsAcceptedSocket accepted_socket;
+                int remote_addr_len = accepted_socket.remote_addr.length();
+                accepted_socket.socket = ::accept(listener->socket, accepted_socket.remote_addr.sockaddr(), &remote_addr_len);
+                if (INVALID_SOCKET == accepted_socket.socket) {
+                    const DWORD gle = ::WSAGetLastError();
+                    if (gle != WSAEWOULDBLOCK) {
+                        ctsConfig::PrintErrorIfFailed(L"accept", gle);
+                        if (WSAECONNRESET == gle) {
+                            // the connection was reset before it could be accepted - keep draining
+                            continue;
+                        }
+                    }
+                    break;
+                }
+                accepted_socket.accepted_usec = ctl::ctTimer::snap_clock_usec();
+
+                // the accepted socket inherits the event selection (and so nonblocking mode) from the listener
+                // - clear both to hand back the same socket as a blocking accept() would,
+                //   unless nonblocking IO was explicitly requested
+                u_long nonblocking = (ctsConfig::Settings->Options & ctsConfig::OptionType::NON_BLOCKING_IO) ? 1 : 0;
+                if (SOCKET_ERROR == ::WSAEventSelect(accepted_socket.socket, nullptr, 0) ||
+                    SOCKET_ERROR == ::ioctlsocket(accepted_socket.socket, FIONBIO, &nonblocking)) {
+                    ctsConfig::PrintErrorIfFailed(L"WSAEventSelect", ::WSAGetLastError());
+                    ::closesocket(accepted_socket.socket);
+                    continue;
                 }
-                ++listener_counter;
-            } 
 
-            //
-            // increment the listening socket we chose to accept on
-            //
-            ::InterlockedIncrement(&pimpl->listening_sockets_refcount[listener_position]);
-            SOCKET listener = pimpl->listening_sockets[listener_position];
+                int local_addr_len = accepted_socket.local_addr.length();
+                if (::getsockname(accepted_socket.socket, accepted_socket.local_addr.sockaddr(), &local_addr_len) != 0) {
+                    accepted_socket.local_addr = listener->addr;
+                }
 
-            // call accept on the blocking socket
-            ctl::ctSockaddr remote_addr;
-            int remote_addr_len = remote_addr.length();
-            SOCKET new_socket = ::accept(listener, remote_addr.sockaddr(), &remote_addr_len);
-            DWORD gle = ::WSAGetLastError();
-            ::InterlockedDecrement(&pimpl->listening_sockets_refcount[listener_position]);
-
-            // take a lock on the accepted socket before setting it
-            accept_socket->lock_socket();
-
-            ctsConfig::PrintErrorIfFailed(L"accept", gle);
-            if (new_socket == INVALID_SOCKET) {
-                // an unexpected error occured, return it so we can track it
-                accept_socket->complete_state(gle);
-            } else {
-                // set the local addr
-                ctl::ctSockaddr local_addr;
-                int local_addr_len = local_addr.length();
-                if (0 == ::getsockname(new_socket, local_addr.sockaddr(), &local_addr_len)) {
-                    accept_socket->set_local(local_addr);
-                } else if (0 == ::getsockname(listener, local_addr.sockaddr(), &local_addr_len)) {
-                    accept_socket->set_local(local_addr);
+                if (!listener->pimpl->accepted_sockets.try_push(accepted_socket)) {
+                    ctsConfig::PrintErrorIfFailed(L"accept", WSAENOBUFS);
+                    ::closesocket(accepted_socket.socket);
+                    continue;
                 }
+                added_sockets = true;
+            }
 
-                accept_socket->set_socket(new_socket);
-                accept_socket->set_target(remote_addr);
-                accept_socket->complete_state(0);
+            // wait for the next connections to arrive
+            ::SetThreadpoolWait(_wait, listener->accept_event, nullptr);
 
-                ctsConfig::PrintNewConnection(remote_addr);
+            if (added_sockets) {
+                CompleteAcceptedSockets(listener->pimpl);
             }
+        }
+
+        ///
+        /// pairs queued accepted sockets with queued ctsSocket requests until either queue is empty
+        /// - called by each thread after adding to either queue
+        ///
+        static
+        void CompleteAcceptedSockets(ctsSimpleAcceptImpl* _pimpl) throw()
+        {
+            while (!_pimpl->accepting_sockets.empty() && !_pimpl->accepted_sockets.empty()) {
+                std::weak_ptr<ctsSocket> weak_socket;
+                if (!_pimpl->accepting_sockets.try_pop(weak_socket)) {
+                    continue;
+                }
+                auto shared_socket(weak_socket.lock());
+                if (!shared_socket) {
+                    // underlying socket went away - pair the next request
+                    continue;
+                }
+
+                ctsAcceptedSocket accepted_socket;
+                if (!_pimpl->accepted_sockets.try_pop(accepted_socket)) {
+                    // another thread took the socket - requeue the request then re-check both queues
+                    if (!_pimpl->accepting_sockets.try_push(weak_socket)) {
+                        shared_socket->complete_state(WSAENOBUFS);
+                    }
+                    continue;
+                }
 
-            // unlock after done touching the SOCKET
-            accept_socket->unlock_socket();
+                // take a lock on the accepted socket before setting it
+                shared_socket->lock_socket();
+                shared_socket->set_local(accepted_socket.local_addr);
+                shared_socket->set_socket(accepted_socket.socket);
+                shared_socket->set_target(accepted_socket.remote_addr);
+                // unlock after done touching the SOCKET
+                shared_socket->unlock_socket();
+
+                ctsConfig::Settings->HistoricConnectionDetails.accept_latency_usec.add(ctl::ctTimer::snap_clock_usec() - accepted_socket.accepted_usec);
+                shared_socket->complete_state(0);
+
+                ctsConfig::PrintNewConnection(accepted_socket.remote_addr);
+            }
         }
     };
 } // namespace
-
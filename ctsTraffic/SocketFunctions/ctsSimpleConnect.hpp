@@ -22,6 +22,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // ctl headers
 #include <ctSockaddr.hpp>
 #include <ctException.hpp>
+#include <ctTimer.hpp>
 // project headers
 #include "ctsSocket.h"
 #include "ctsConfig.h"
@@ -30,12 +31,127 @@ See the Apache Version 2.0 License for specific language governing permissions a
 
 namespace ctsTraffic {
     ///
-    /// ctsSimpleConnect makes *blocking* calls to connect
-    /// - callers should be careful to ensure that this is really what they want
-    /// - since it will not scale out well
+    /// ctsSimpleConnect makes *nonblocking* calls to connect
+    /// - the socket signals an event through WSAEventSelect(FD_CONNECT) when the connect completes
+    /// - a threadpool wait on that event completes the ctsSocket, so no thread is blocked per connect
     ///
-    /// Its intended use is either for UDP sockets, or for very few concurrent connections
+    /// The socket is put back in blocking mode once connected (unless nonblocking IO was requested)
+    /// - so the IO functions see the same socket as they would after a blocking connect
     ///
+    /// The number of connects in flight is bounded by the broker's ConnectionThrottleLimit
+    ///
+
+    struct ctsSimpleConnectContext {
+        // how often the threadpool wait times out to verify the socket wasn't closed while connecting
+        static const long long RecheckSocketMilliseconds = 1000LL;
+
+        std::weak_ptr<ctsSocket> socket;
+        ctl::ctSockaddr target_address;
+        WSAEVENT connect_event;
+        PTP_WAIT thread_pool_wait;
+        long long connect_start_usec;
+
+        ctsSimpleConnectContext(const std::weak_ptr<ctsSocket>& _socket, const ctl::ctSockaddr& _target_address) throw() :
+            socket(_socket),
+            target_address(_target_address),
+            connect_event(WSA_INVALID_EVENT),
+            thread_pool_wait(nullptr),
+            connect_start_usec(0LL)
+        {
+        }
+        ~ctsSimpleConnectContext() throw()
+        {
+            // only ever destroyed once the wait is no longer set
+            // - so it's safe to close from within the wait callback
+            if (thread_pool_wait != nullptr) {
+                ::CloseThreadpoolWait(thread_pool_wait);
+            }
+            if (connect_event != WSA_INVALID_EVENT) {
+                ::WSACloseEvent(connect_event);
+            }
+        }
+
+        void wait_for_connect() throw()
+        {
+            FILETIME recheck_time(ctl::ctTimer::convert_hundredNs_relative_filetime(ctl::ctTimer::convert_msec_hundredNs(RecheckSocketMilliseconds)));
+            ::SetThreadpoolWait(thread_pool_wait, connect_event, &recheck_time);
+        }
+
+        // non-copyable
+        ctsSimpleConnectContext(const ctsSimpleConnectContext&) = delete;
+        ctsSimpleConnectContext& operator=(const ctsSimpleConnectContext&) = delete;
+    };
+
+    ///
+    /// Clears the event selection from the connected socket, restoring its blocking mode, and records its local address
+    ///
+    inline
+    int ctsSimpleConnectCompleted(ctsSocket* _socket_lock, SOCKET _s) throw()
+    {
+        u_long nonblocking = (ctsConfig::Settings->Options & ctsConfig::OptionType::NON_BLOCKING_IO) ? 1 : 0;
+        if (SOCKET_ERROR == ::WSAEventSelect(_s, nullptr, 0) ||
+            SOCKET_ERROR == ::ioctlsocket(_s, FIONBIO, &nonblocking)) {
+            const int error = ::WSAGetLastError();
+            ctsConfig::PrintErrorIfFailed(L"WSAEventSelect", error);
+            return error;
+        }
+
+        // get the local addr
+        ctl::ctSockaddr local_addr;
+        int local_addr_len = local_addr.length();
+        if (0 == ::getsockname(_s, local_addr.sockaddr(), &local_addr_len)) {
+            _socket_lock->set_local(local_addr);
+        }
+        return NO_ERROR;
+    }
+
+    static inline
+    VOID NTAPI ctsSimpleConnectWaitCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WAIT, TP_WAIT_RESULT) throw()
+    {
+        std::unique_ptr<ctsSimpleConnectContext> context(reinterpret_cast<ctsSimpleConnectContext*>(_context));
+
+        auto shared_socket_lock(context->socket.lock());
+        ctsSocket* socket_lock = shared_socket_lock.get();
+        if (socket_lock == nullptr) {
+            // the underlying socket went away - nothing to do
+            return;
+        }
+
+        int error = NO_ERROR;
+        SOCKET s = socket_lock->lock_socket();
+        if (s != INVALID_SOCKET) {
+            WSANETWORKEVENTS network_events;
+            if (SOCKET_ERROR == ::WSAEnumNetworkEvents(s, context->connect_event, &network_events)) {
+                error = ::WSAGetLastError();
+            } else if (0 == (network_events.lNetworkEvents & FD_CONNECT)) {
+                // the wait timed out and the socket is still open - keep waiting for the connect to complete
+                socket_lock->unlock_socket();
+                context.release()->wait_for_connect();
+                return;
+            } else {
+                error = network_events.iErrorCode[FD_CONNECT_BIT];
+                if (NO_ERROR == error) {
+                    error = ctsSimpleConnectCompleted(socket_lock, s);
+                }
+            }
+        } else {
+            // the socket was closed while connecting
+            error = WSAECONNABORTED;
+        }
+
+        ctsConfig::PrintErrorIfFailed(L"connect", error);
+        ctsConfig::Settings->HistoricConnectionDetails.record_connect(context->connect_start_usec, error);
+
+        // unlock before completing the socket state
+        // - holding no locks, so IO can start inline on this thread
+        socket_lock->unlock_socket();
+        socket_lock->complete_state_inline(error);
+
+        // print results after completing state
+        if (NO_ERROR == error) {
+            ctsConfig::PrintNewConnection(context->target_address);
+        }
+    }
 
     inline
     void ctsSimpleConnect(std::weak_ptr<ctsSocket> _socket) throw()
@@ -49,6 +165,7 @@ namespace ctsTraffic {
         }
 
         int error = NO_ERROR;
+        bool connect_pended = false;
         SOCKET s = socket_lock->lock_socket();
         if (s != INVALID_SOCKET) {
             try {
@@ -58,16 +175,38 @@ namespace ctsTraffic {
                     throw ctl::ctException(error, L"ctsConfig::SetPreConnectOptions", false);
                 }
 
+                std::unique_ptr<ctsSimpleConnectContext> context(new ctsSimpleConnectContext(_socket, targetAddress));
+                context->connect_event = ::WSACreateEvent();
+                if (WSA_INVALID_EVENT == context->connect_event) {
+                    throw ctl::ctException(::WSAGetLastError(), L"WSACreateEvent", L"ctsSimpleConnect", false);
+                }
+                context->thread_pool_wait = ::CreateThreadpoolWait(ctsSimpleConnectWaitCallback, context.get(), ctsConfig::Settings->PTPEnvironment);
+                if (nullptr == context->thread_pool_wait) {
+                    throw ctl::ctException(::GetLastError(), L"CreateThreadpoolWait", L"ctsSimpleConnect", false);
+                }
+                // WSAEventSelect also sets the socket nonblocking
+                if (SOCKET_ERROR == ::WSAEventSelect(s, context->connect_event, FD_CONNECT)) {
+                    throw ctl::ctException(::WSAGetLastError(), L"WSAEventSelect", L"ctsSimpleConnect", false);
+                }
+
+                context->connect_start_usec = ctl::ctTimer::snap_clock_usec();
                 if (0 != ::connect(s, targetAddress.sockaddr(), targetAddress.length())) {
                     error = ::WSAGetLastError();
-                    ctsConfig::PrintErrorIfFailed(L"connect", error);
-                } else {
-                    // get the local addr
-                    ctl::ctSockaddr local_addr;
-                    int local_addr_len = local_addr.length();
-                    if (0 == ::getsockname(s, local_addr.sockaddr(), &local_addr_len)) {
-                        socket_lock->set_local(local_addr);
+                    if (WSAEWOULDBLOCK == error) {
+                        // the wait callback now owns the context, and will complete the socket
+                        // - it can't run until this thread unlocks the socket
+                        error = NO_ERROR;
+                        connect_pended = true;
+                        context.release()->wait_for_connect();
+                        ctsConfig::PrintDebug(L"\t\tConnecting to %s\n", targetAddress.writeCompleteAddress().c_str());
+                    } else {
+                        ctsConfig::PrintErrorIfFailed(L"connect", error);
+                        ctsConfig::Settings->HistoricConnectionDetails.record_connect(context->connect_start_usec, error);
                     }
+                } else {
+                    // completed inline (e.g. UDP)
+                    error = ctsSimpleConnectCompleted(socket_lock, s);
+                    ctsConfig::Settings->HistoricConnectionDetails.record_connect(context->connect_start_usec, error);
                 }
             }
             catch (const ctl::ctException& e) {
@@ -87,7 +226,11 @@ namespace ctsTraffic {
 
         // unlock before completing the socket state
         socket_lock->unlock_socket();
-        socket_lock->complete_state(error);
+        // a pended connect is completed by the wait callback
+        // - holding no locks, so IO can start inline on this thread
+        if (!connect_pended) {
+            socket_lock->complete_state_inline(error);
+        }
     }
 
 }
\ No newline at end of file
@@ -121,7 +121,8 @@ namespace ctsTraffic {
             socket_lock->set_socket(s);
             socket_lock->set_local(local_addr);
             socket_lock->set_target(target_addr);
-            socket_lock->complete_state(NO_ERROR);
+            // called from the Creating state holding no locks, so the connect can start inline on this thread
+            socket_lock->complete_state_inline(NO_ERROR);
         } else {
             ctsConfig::PrintErrorIfFailed(function, gle);
             socket_lock->complete_state(gle);
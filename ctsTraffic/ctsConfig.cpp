@@ -34,6 +34,9 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsLogger.hpp"
 #include "ctsIOPattern.h"
 #include "ctsPrintStatus.hpp"
+#include "ctsConnectionOutliers.h"
+#include "ctsCongestionControl.h"
+#include "ctsNetworkCounters.h"
 
 // local functors
 #include "ctsConnectEx.hpp"
@@ -92,6 +95,8 @@ namespace ctsTraffic {
         static const wchar_t* ConnectFunctionName = nullptr;
         static const wchar_t* AcceptFunctionName = nullptr;
         static const wchar_t* IoFunctionName = nullptr;
+        // only the iocp IO function schedules tasks deferred through ctsIOTask::time_offset_milliseconds
+        static bool IoFunctionDefersTasks = false;
 
         // connection info + error info
         static unsigned long verbosity = 4;
@@ -99,11 +104,20 @@ namespace ctsTraffic {
         static unsigned long buffersize_high = 0;
         static long long ratelimit_low = 0;
         static long long ratelimit_high = 0;
+        static long long recv_ratelimit_low = 0;
+        static long long recv_ratelimit_high = 0;
         static unsigned long long transfer_low = DefaultTransfer;
         static unsigned long long transfer_high = 0;
 
         static const unsigned long DefaultPushBytes = 0x100000;
         static const unsigned long DefaultPullBytes = 0x100000;
+        static const unsigned long MaximumPushPullPipeline = 1024;
+        static const unsigned long DefaultMessageSize = 1024;
+        static unsigned long message_size_low = DefaultMessageSize;
+        static unsigned long message_size_high = 0;
+
+        static const unsigned long DefaultDatagramSize = 64;
+        static const unsigned long MinimumDatagramSize = 64;
 
         static ctsUnsignedLong timer_changed_count = 0;
 
@@ -114,6 +128,7 @@ namespace ctsTraffic {
         static ctNetAdapterAddresses* netAdapterAddresses = nullptr;
 
         static MediaStreamSettings media_stream_settings;
+        static DatagramSettings datagram_settings;
         static ctRandomTwister random;
 
         // default to 5 seconds
@@ -342,6 +357,37 @@ namespace ctsTraffic {
             return return_value;
         }
 
+        template <typename T>
+        void get_range(_In_z_ wchar_t* _value, T& _out_low, T& _out_high)
+        {
+            // a range was specified
+            // - find the ',' the '[', and the ']'
+            size_t value_length = ::wcslen(_value);
+            wchar_t* value_end = _value + value_length;
+            if ((value_length < 5) || (_value[0] != L'[') || (_value[value_length - 1] != L']')) {
+                throw invalid_argument("range value [###,###]");
+            }
+            wchar_t* comma_delimiter = find(_value, value_end, L',');
+            if (!(value_end > comma_delimiter + 1)) {
+                throw invalid_argument("range value [###,###]");
+            }
+
+            // null-terminate the first number at the delimiter to do a string -> int conversion
+            *(comma_delimiter) = L'\0';
+            wchar_t* value_low = _value + 1; // move past the '['
+            _out_low = as_integral<T>(value_low);
+
+            // null-terminate for the 2nd number over the last ']' to doa string -> int conversion
+            _value[value_length - 1] = L'\0';
+            wchar_t* value_high = comma_delimiter + 1;
+            _out_high = as_integral<T>(value_high);
+
+            // validate buffer values
+            if (_out_high < _out_low) {
+                throw invalid_argument("range value [###,###]");
+            }
+        }
+
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Parses for the connect function to use
@@ -400,7 +446,7 @@ namespace ctsTraffic {
                 _args.erase(found_arg);
 
             } else {
-                if (Settings->IoPattern != IoPatternType::MediaStream) {
+                if (ProtocolType::UDP != Settings->Protocol) {
                     Settings->ConnectFunction = ctsConnectEx;
                     ConnectFunctionName = L"ConnectEx";
                 } else {
@@ -451,7 +497,7 @@ namespace ctsTraffic {
                 _args.erase(found_arg);
 
             } else if (Settings->ListenAddresses.size() > 0) {
-                if (IoPatternType::MediaStream != Settings->IoPattern) {
+                if (ProtocolType::UDP != Settings->Protocol) {
                     // only default an Accept function if listening
                     Settings->AcceptFunction = ctsAcceptEx();
                     AcceptFunctionName = L"AcceptEx";
@@ -492,9 +538,11 @@ namespace ctsTraffic {
                     Settings->IoFunction = ctsSendRecvIocp;
                     Settings->Options |= OptionType::HANDLE_INLINE_IOCP;
                     IoFunctionName = L"iocp (WSASend/WSARecv using IOCP)";
+                    IoFunctionDefersTasks = true;
 
                 } else if (ctString::iordinal_equals(L"readwritefile", value)) {
                     Settings->IoFunction = ctsReadWriteIocp;
+                    Settings->Options |= OptionType::HANDLE_INLINE_IOCP;
                     IoFunctionName = L"readwritefile (ReadFile/WriteFile using IOCP)";
 
                 } else if (ctString::iordinal_equals(L"rioiocp", value)) {
@@ -514,11 +562,14 @@ namespace ctsTraffic {
                     Settings->IoFunction = ctsSendRecvIocp;
                     Settings->Options |= OptionType::HANDLE_INLINE_IOCP;
                     IoFunctionName = L"iocp (WSASend/WSARecv using IOCP)";
+                    IoFunctionDefersTasks = true;
 
                 } else {
                     // UDP only has one IOFunction: media streaming
+                    // - the Datagram and Echo patterns are driven through the same engine
                     if (IsListening()) {
                         Settings->IoFunction = ctsMediaStreamServerIo;
+                        Settings->AbortFunction = ctsMediaStreamServerAbort;
                         IoFunctionName = L"MediaStream Server";
                     } else {
                         Settings->IoFunction = ctsMediaStreamClient;
@@ -610,6 +661,105 @@ namespace ctsTraffic {
             }
         }
 
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for the congestion control to apply across TCP connections
+        /// - allows for more than one algorithm to be set, each with its share of connections
+        /// -CongestionControl:<default,ledbat>[:weight] [-CongestionControl:<...>]
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_congestionControl(vector<wchar_t*>& _args)
+        {
+            for (;;) {
+                // loop until cannot find -CongestionControl
+                auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                    wchar_t* value = ParseArgument(parameter, L"-CongestionControl");
+                    return (value != nullptr);
+                });
+                if (found_arg == end(_args)) {
+                    break;
+                }
+
+                if (Settings->Protocol != ProtocolType::TCP) {
+                    throw invalid_argument("-CongestionControl (only applicable to TCP)");
+                }
+
+                wstring value(ParseArgument(*found_arg, L"-CongestionControl"));
+                CongestionControlWeight congestion_control;
+                congestion_control.weight = 1;
+                const size_t weight_offset = value.find(L':');
+                if (weight_offset != wstring::npos) {
+                    congestion_control.weight = as_integral<unsigned long>(value.substr(weight_offset + 1));
+                    if (0 == congestion_control.weight) {
+                        throw invalid_argument("-CongestionControl (the weight must be greater than zero)");
+                    }
+                    value.resize(weight_offset);
+                }
+
+                if (ctString::iordinal_equals(L"default", value)) {
+                    congestion_control.algorithm = CongestionControlType::DefaultCongestionControl;
+
+                } else if (ctString::iordinal_equals(L"ledbat", value)) {
+                    congestion_control.algorithm = CongestionControlType::LedbatCongestionControl;
+
+                } else {
+                    throw invalid_argument("-CongestionControl");
+                }
+                Settings->CongestionControls.push_back(congestion_control);
+
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            }
+
+            // rather than failing the ioctls on every connection
+            if (!Settings->CongestionControls.empty() && !ctsCongestionControl::IsSupported()) {
+                throw invalid_argument("-CongestionControl (requires SIO_PRIORITY_HINT and SIO_TCP_INFO, which this OS does not support)");
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for the DSCP values to mark across connections
+        /// - allows for more than one class to be set, each with its share of connections
+        /// -Dscp:<0-63>[:weight] [-Dscp:<...>]
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_dscp(vector<wchar_t*>& _args)
+        {
+            for (;;) {
+                // loop until cannot find -Dscp
+                auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                    wchar_t* value = ParseArgument(parameter, L"-Dscp");
+                    return (value != nullptr);
+                });
+                if (found_arg == end(_args)) {
+                    break;
+                }
+
+                wstring value(ParseArgument(*found_arg, L"-Dscp"));
+                TrafficClassWeight traffic_class;
+                traffic_class.weight = 1;
+                const size_t weight_offset = value.find(L':');
+                if (weight_offset != wstring::npos) {
+                    traffic_class.weight = as_integral<unsigned long>(value.substr(weight_offset + 1));
+                    if (0 == traffic_class.weight) {
+                        throw invalid_argument("-Dscp (the weight must be greater than zero)");
+                    }
+                    value.resize(weight_offset);
+                }
+                traffic_class.dscp = as_integral<unsigned long>(value);
+                if (traffic_class.dscp > 63) {
+                    throw invalid_argument("-Dscp (the DSCP value must be between 0 and 63)");
+                }
+                Settings->TrafficClasses.push_back(traffic_class);
+
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            }
+        }
+
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Parses for the wire-Protocol to use
@@ -629,12 +779,25 @@ namespace ctsTraffic {
                 return (value != nullptr);
             });
             if (found_arg != end(_args)) {
-                if (Settings->Protocol != ctsConfig::ProtocolType::TCP) {
-                    throw invalid_argument("-pattern (only applicable to TCP)");
-                }
-
                 wchar_t* value = ParseArgument(*found_arg, L"-pattern");
-                if (ctString::iordinal_equals(L"push", value)) {
+                if (Settings->Protocol == ProtocolType::UDP) {
+                    if (ctString::iordinal_equals(L"mediastream", value)) {
+                        Settings->IoPattern = IoPatternType::MediaStream;
+
+                    } else if (ctString::iordinal_equals(L"datagram", value)) {
+                        Settings->IoPattern = IoPatternType::Datagram;
+
+                    } else if (ctString::iordinal_equals(L"echo", value)) {
+                        Settings->IoPattern = IoPatternType::Echo;
+
+                    } else {
+                        throw invalid_argument("-pattern (UDP supports only MediaStream, Datagram, and Echo)");
+                    }
+
+                } else if (Settings->Protocol != ProtocolType::TCP) {
+                    throw invalid_argument("-pattern (only applicable to TCP and UDP)");
+
+                } else if (ctString::iordinal_equals(L"push", value)) {
                     Settings->IoPattern = IoPatternType::Push;
 
                 } else if (ctString::iordinal_equals(L"pull", value)) {
@@ -647,6 +810,9 @@ namespace ctsTraffic {
                     // the old name for this was 'flood'
                     Settings->IoPattern = IoPatternType::Duplex;
 
+                } else if (ctString::iordinal_equals(L"message", value)) {
+                    Settings->IoPattern = IoPatternType::Message;
+
                 } else {
                     throw invalid_argument("-pattern");
                 }
@@ -694,6 +860,54 @@ namespace ctsTraffic {
                 Settings->PullBytes = DefaultPullBytes;
             }
 
+            auto found_pipeline = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-PushPullPipeline");
+                return (value != nullptr);
+            });
+            if (found_pipeline != end(_args)) {
+                if (Settings->IoPattern != IoPatternType::PushPull) {
+                    throw invalid_argument("-PushPullPipeline can only be set with -Pattern:PushPull");
+                }
+                Settings->PushPullPipeline = as_integral<unsigned long>(ParseArgument(*found_pipeline, L"-PushPullPipeline"));
+                if (Settings->PushPullPipeline > MaximumPushPullPipeline) {
+                    throw invalid_argument("-PushPullPipeline");
+                }
+                // every pipelined segment must carry data in both directions
+                if (Settings->PushPullPipeline > 0 && (0 == Settings->PushBytes || 0 == Settings->PullBytes)) {
+                    throw invalid_argument("-PushPullPipeline requires non-zero -PushBytes and -PullBytes");
+                }
+                // always remove the arg from our vector
+                _args.erase(found_pipeline);
+            } else {
+                Settings->PushPullPipeline = 0;
+            }
+
+            auto found_messagesize = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-MessageSize");
+                return (value != nullptr);
+            });
+            if (found_messagesize != end(_args)) {
+                if (Settings->IoPattern != IoPatternType::Message) {
+                    throw invalid_argument("-MessageSize can only be set with -Pattern:Message");
+                }
+                wchar_t* value = ParseArgument(*found_messagesize, L"-MessageSize");
+                if (value[0] == L'[') {
+                    get_range(value, message_size_low, message_size_high);
+                } else {
+                    // single values are written to message_size_low, with message_size_high left at zero
+                    message_size_low = as_integral<unsigned long>(value);
+                    message_size_high = 0;
+                }
+                if (0 == message_size_low) {
+                    throw invalid_argument("-MessageSize");
+                }
+                // always remove the arg from our vector
+                _args.erase(found_messagesize);
+            } else {
+                message_size_low = DefaultMessageSize;
+                message_size_high = 0;
+            }
+
             //
             // Options for the UDP protocol
             //
@@ -777,8 +991,85 @@ namespace ctsTraffic {
                 _args.erase(found_arg);
             }
 
+            found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-DatagramSize");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                if (Settings->IoPattern != IoPatternType::Datagram && Settings->IoPattern != IoPatternType::Echo) {
+                    throw invalid_argument("-DatagramSize requires -Pattern:Datagram or -Pattern:Echo");
+                }
+                wchar_t* value = ParseArgument(*found_arg, L"-DatagramSize");
+                unsigned long size_low = 0;
+                unsigned long size_high = 0;
+                if (value[0] == L'[') {
+                    get_range(value, size_low, size_high);
+                } else {
+                    // single values are written to size_low, with size_high left at zero
+                    size_low = as_integral<unsigned long>(value);
+                }
+                datagram_settings.DatagramSizeLow = size_low;
+                datagram_settings.DatagramSizeHigh = size_high;
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            } else {
+                datagram_settings.DatagramSizeLow = DefaultDatagramSize;
+                datagram_settings.DatagramSizeHigh = 0;
+            }
+
+            found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-PacketRate");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                if (Settings->IoPattern != IoPatternType::Datagram && Settings->IoPattern != IoPatternType::Echo) {
+                    throw invalid_argument("-PacketRate requires -Pattern:Datagram or -Pattern:Echo");
+                }
+                datagram_settings.PacketsPerSecond = as_integral<unsigned long>(ParseArgument(*found_arg, L"-PacketRate"));
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            }
+
+            found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-PacketCount");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                if (Settings->IoPattern != IoPatternType::Datagram && Settings->IoPattern != IoPatternType::Echo) {
+                    throw invalid_argument("-PacketCount requires -Pattern:Datagram or -Pattern:Echo");
+                }
+                datagram_settings.PacketCount = as_integral<unsigned long>(ParseArgument(*found_arg, L"-PacketCount"));
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            }
+
             // validate and resolve the UDP protocol options
-            if (ProtocolType::UDP == Settings->Protocol) {
+            if (IoPatternType::Datagram == Settings->IoPattern || IoPatternType::Echo == Settings->IoPattern) {
+                if (0 == datagram_settings.PacketCount) {
+                    throw invalid_argument("-PacketCount is required");
+                }
+                if (media_stream_settings.BitsPerSecond != 0 || media_stream_settings.FramesPerSecond != 0 ||
+                    media_stream_settings.BufferDepthSeconds != 0 || media_stream_settings.StreamLengthSeconds != 0) {
+                    throw invalid_argument("-BitsPerSecond, -FrameRate, -BufferDepth, and -StreamLength are not used with -Pattern:Datagram or -Pattern:Echo");
+                }
+                // every datagram carries the sequence number header used to track loss and reordering
+                if (datagram_settings.DatagramSizeLow < MinimumDatagramSize) {
+                    throw invalid_argument("-DatagramSize must be at least 64 bytes");
+                }
+                if (datagram_settings.DatagramSizeHigh > 0 && datagram_settings.DatagramSizeHigh < datagram_settings.DatagramSizeLow) {
+                    throw invalid_argument("-DatagramSize range must be specified as [low,high]");
+                }
+                const unsigned long max_datagram_size = (datagram_settings.DatagramSizeHigh > 0) ? datagram_settings.DatagramSizeHigh : datagram_settings.DatagramSizeLow;
+                if (max_datagram_size > UdpDatagramMaximumSizeBytes) {
+                    throw invalid_argument("-DatagramSize cannot exceed 64000 bytes");
+                }
+                if (IoPatternType::Echo == Settings->IoPattern && max_datagram_size > UdpEchoMaximumSizeBytes) {
+                    throw invalid_argument("-DatagramSize cannot exceed 1024 bytes with -Pattern:Echo");
+                }
+                // the transfer is an upper bound: the server fixes its total once the final datagram size is known
+                transfer_low = static_cast<unsigned long long>(datagram_settings.PacketCount) * max_datagram_size;
+
+            } else if (ProtocolType::UDP == Settings->Protocol) {
                 if (0 == media_stream_settings.BitsPerSecond) {
                     throw invalid_argument("-BitsPerSecond is required");
                 }
@@ -1104,37 +1395,6 @@ namespace ctsTraffic {
             }
         }
 
-        template <typename T>
-        void get_range(_In_z_ wchar_t* _value, T& _out_low, T& _out_high)
-        {
-            // a range was specified
-            // - find the ',' the '[', and the ']'
-            size_t value_length = ::wcslen(_value);
-            wchar_t* value_end = _value + value_length;
-            if ((value_length < 5) || (_value[0] != L'[') || (_value[value_length - 1] != L']')) {
-                throw invalid_argument("range value [###,###]");
-            }
-            wchar_t* comma_delimiter = find(_value, value_end, L',');
-            if (!(value_end > comma_delimiter + 1)) {
-                throw invalid_argument("range value [###,###]");
-            }
-
-            // null-terminate the first number at the delimiter to do a string -> int conversion
-            *(comma_delimiter) = L'\0';
-            wchar_t* value_low = _value + 1; // move past the '['
-            _out_low = as_integral<T>(value_low);
-
-            // null-terminate for the 2nd number over the last ']' to doa string -> int conversion
-            _value[value_length - 1] = L'\0';
-            wchar_t* value_high = comma_delimiter + 1;
-            _out_high = as_integral<T>(value_high);
-
-            // validate buffer values
-            if (_out_high < _out_low) {
-                throw invalid_argument("range value [###,###]");
-            }
-        }
-
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Parses for the buffer size to push down per IO
@@ -1250,6 +1510,10 @@ namespace ctsTraffic {
         /// -RateLimit:####
         ///           :[low,high]
         /// -RateLimitPeriod:####
+        /// -RecvRateLimit:####
+        ///               :[low,high]
+        /// -RecvStallInterval:####
+        /// -RecvStallTime:####
         ///
         //////////////////////////////////////////////////////////////////////////////////////////
         static
@@ -1292,6 +1556,112 @@ namespace ctsTraffic {
                 // always remove the arg from our vector
                 _args.erase(found_ratelimit_period);
             }
+            // sends are only rate limited when at least one byte can be sent each period
+            // - (bytes/sec) * (1 sec/1000 ms) * (x ms/period) == (bytes/period)
+            if (ratelimit_low > 0LL &&
+                0LL == ratelimit_low * static_cast<long long>(Settings->TcpBytesPerSecondPeriod) / 1000LL) {
+                throw invalid_argument("-RateLimit (must allow at least 1 byte per -RateLimitPeriod)");
+            }
+
+            auto found_recv_ratelimit = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-RecvRateLimit");
+                return (value != nullptr);
+            });
+            if (found_recv_ratelimit != end(_args)) {
+                if (Settings->Protocol != ctsConfig::ProtocolType::TCP) {
+                    throw invalid_argument("-RecvRateLimit (only applicable to TCP)");
+                }
+                wchar_t* value = ParseArgument(*found_recv_ratelimit, L"-RecvRateLimit");
+                if (value[0] == L'[') {
+                    get_range(value, recv_ratelimit_low, recv_ratelimit_high);
+                } else {
+                    // single values are written to recv_ratelimit_low, with recv_ratelimit_high left at zero
+                    recv_ratelimit_low = as_integral<long long>(value);
+                }
+                if (0LL == recv_ratelimit_low) {
+                    throw invalid_argument("-RecvRateLimit");
+                }
+                // always remove the arg from our vector
+                _args.erase(found_recv_ratelimit);
+            }
+
+            auto found_stall_interval = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-RecvStallInterval");
+                return (value != nullptr);
+            });
+            if (found_stall_interval != end(_args)) {
+                if (Settings->Protocol != ctsConfig::ProtocolType::TCP) {
+                    throw invalid_argument("-RecvStallInterval (only applicable to TCP)");
+                }
+                Settings->RecvStallInterval = as_integral<unsigned long>(ParseArgument(*found_stall_interval, L"-RecvStallInterval"));
+                if (0 == Settings->RecvStallInterval) {
+                    throw invalid_argument("-RecvStallInterval");
+                }
+                // always remove the arg from our vector
+                _args.erase(found_stall_interval);
+            }
+
+            auto found_stall_time = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-RecvStallTime");
+                return (value != nullptr);
+            });
+            if (found_stall_time != end(_args)) {
+                if (Settings->Protocol != ctsConfig::ProtocolType::TCP) {
+                    throw invalid_argument("-RecvStallTime (only applicable to TCP)");
+                }
+                Settings->RecvStallTime = as_integral<unsigned long>(ParseArgument(*found_stall_time, L"-RecvStallTime"));
+                if (0 == Settings->RecvStallTime) {
+                    throw invalid_argument("-RecvStallTime");
+                }
+                // always remove the arg from our vector
+                _args.erase(found_stall_time);
+            }
+            // a stall episode needs both how often and how long
+            if ((0 == Settings->RecvStallInterval) != (0 == Settings->RecvStallTime)) {
+                throw invalid_argument("-RecvStallInterval and -RecvStallTime must be specified together");
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for how TCP connections are torn down once the transfer completes
+        ///
+        /// -Teardown:<graceful,client,server,rst>
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_teardown(vector<wchar_t*>& _args)
+        {
+            auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-Teardown");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                if (Settings->Protocol != ProtocolType::TCP) {
+                    throw invalid_argument("-Teardown (only applicable to TCP)");
+                }
+                wchar_t* value = ParseArgument(*found_arg, L"-Teardown");
+                if (ctString::iordinal_equals(L"graceful", value)) {
+                    Settings->Teardown = TeardownType::GracefulTeardown;
+
+                } else if (ctString::iordinal_equals(L"client", value)) {
+                    Settings->Teardown = TeardownType::ClientTeardown;
+
+                } else if (ctString::iordinal_equals(L"server", value)) {
+                    Settings->Teardown = TeardownType::ServerTeardown;
+
+                } else if (ctString::iordinal_equals(L"rst", value)) {
+                    Settings->Teardown = TeardownType::AbortiveTeardown;
+
+                } else {
+                    throw invalid_argument("-Teardown");
+                }
+
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            } else {
+                Settings->Teardown = TeardownType::GracefulTeardown;
+            }
         }
 
         //////////////////////////////////////////////////////////////////////////////////////////
@@ -1524,6 +1894,218 @@ namespace ctsTraffic {
             }
         }
 
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Sets optional prepostsends value
+        ///
+        /// -PrePostSends:#####
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_prepostsends(vector<wchar_t*>& _args)
+        {
+            auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-PrePostSends");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                if (Settings->Protocol != ProtocolType::TCP) {
+                    throw invalid_argument("-PrePostSends (only applicable to TCP)");
+                }
+                Settings->PrePostSends = as_integral<unsigned long>(ParseArgument(*found_arg, L"-PrePostSends"));
+                if (0 == Settings->PrePostSends) {
+                    throw invalid_argument("-PrePostSends");
+                }
+
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            } else {
+                Settings->PrePostSends = 1;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Sets the optional number of threads dedicated to verifying received buffers
+        /// - 0 (the default) verifies buffers inline as each recv completes
+        ///
+        /// -VerifyThreads:#####
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_verifyThreads(vector<wchar_t*>& _args)
+        {
+            auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-VerifyThreads");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                Settings->VerifyThreads = as_integral<unsigned long>(ParseArgument(*found_arg, L"-VerifyThreads"));
+                if (Settings->VerifyThreads > 0 && !Settings->ShouldVerifyBuffers) {
+                    throw invalid_argument("-VerifyThreads requires -Verify:data");
+                }
+                // connections waiting on the verifier threads are resumed through the TCP IO functions
+                if (Settings->VerifyThreads > 0 && Settings->Protocol != ProtocolType::TCP) {
+                    throw invalid_argument("-VerifyThreads (only applicable to TCP)");
+                }
+
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            } else {
+                Settings->VerifyThreads = 0;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Sets the fairness budget for IO which completes inline
+        /// - the # of IO requests one connection can complete back-to-back on the calling thread
+        ///   before continuing its remaining IO from a threadpool thread
+        ///
+        /// -InlineCompletions:#####
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_inlineCompletions(vector<wchar_t*>& _args)
+        {
+            auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-InlineCompletions");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                Settings->InlineCompletions = as_integral<unsigned long>(ParseArgument(*found_arg, L"-InlineCompletions"));
+                if (0 == Settings->InlineCompletions) {
+                    throw invalid_argument("-InlineCompletions must be greater than zero");
+                }
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            } else {
+                Settings->InlineCompletions = 64;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for which interface and stack counters to list with each status update
+        ///
+        /// -NetCounters:<physical,all>
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_netcounters(vector<wchar_t*>& _args)
+        {
+            auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-NetCounters");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                wchar_t* value = ParseArgument(*found_arg, L"-NetCounters");
+                if (ctString::iordinal_equals(L"physical", value)) {
+                    Settings->NetCounters = NetCounterType::PhysicalInterfaces;
+
+                } else if (ctString::iordinal_equals(L"all", value)) {
+                    Settings->NetCounters = NetCounterType::AllInterfaces;
+
+                } else {
+                    throw invalid_argument("-NetCounters");
+                }
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            } else {
+                Settings->NetCounters = NetCounterType::NoNetCounters;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for the # of the slowest active connections to list with each status update
+        ///
+        /// -Outliers:#####
+        /// -OutliersBy:<throughput,idle>
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_outliers(vector<wchar_t*>& _args)
+        {
+            auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-Outliers");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                if (Settings->Protocol != ProtocolType::TCP) {
+                    throw invalid_argument("-Outliers (only applicable to TCP)");
+                }
+                Settings->OutlierCount = as_integral<unsigned long>(ParseArgument(*found_arg, L"-Outliers"));
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            } else {
+                Settings->OutlierCount = 0;
+            }
+
+            auto found_rank = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-OutliersBy");
+                return (value != nullptr);
+            });
+            if (found_rank != end(_args)) {
+                if (0 == Settings->OutlierCount) {
+                    throw invalid_argument("-OutliersBy requires -Outliers");
+                }
+                wchar_t* value = ParseArgument(*found_rank, L"-OutliersBy");
+                if (ctString::iordinal_equals(L"throughput", value)) {
+                    Settings->OutlierRank = OutlierRankType::LowestThroughput;
+
+                } else if (ctString::iordinal_equals(L"idle", value)) {
+                    Settings->OutlierRank = OutlierRankType::LongestIdle;
+
+                } else {
+                    throw invalid_argument("-OutliersBy");
+                }
+                // always remove the arg from our vector
+                _args.erase(found_rank);
+            } else {
+                Settings->OutlierRank = OutlierRankType::LowestThroughput;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Parses for the order in which connections issue their next IO as prior IO completes
+        ///
+        /// -IoScheduler:<fifo,rr,drr>
+        ///
+        //////////////////////////////////////////////////////////////////////////////////////////
+        static
+        void set_ioScheduler(vector<wchar_t*>& _args)
+        {
+            auto found_arg = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-IoScheduler");
+                return (value != nullptr);
+            });
+            if (found_arg != end(_args)) {
+                if (Settings->Protocol != ProtocolType::TCP) {
+                    throw invalid_argument("-IoScheduler (only applicable to TCP)");
+                }
+                wchar_t* value = ParseArgument(*found_arg, L"-IoScheduler");
+                if (ctString::iordinal_equals(L"fifo", value)) {
+                    Settings->IoScheduler = IoSchedulerType::FifoScheduler;
+
+                } else if (ctString::iordinal_equals(L"rr", value)) {
+                    Settings->IoScheduler = IoSchedulerType::RoundRobinScheduler;
+
+                } else if (ctString::iordinal_equals(L"drr", value)) {
+                    Settings->IoScheduler = IoSchedulerType::DeficitRoundRobinScheduler;
+
+                } else {
+                    throw invalid_argument("-IoScheduler");
+                }
+
+                // always remove the arg from our vector
+                _args.erase(found_arg);
+            } else {
+                Settings->IoScheduler = IoSchedulerType::NoScheduler;
+            }
+        }
+
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Sets a threadpool environment for TP APIs
@@ -1595,12 +2177,13 @@ namespace ctsTraffic {
         ///
         /// Parses for whether to verify buffer contents on receiver
         ///
-        /// -verify:<connection,data>
+        /// -verify:<connection,data,checksum>
         /// (the old options were <always,never>)
         ///
         /// Note this controls if using a SharedBuffer across all IO or unique buffers
         /// - if not validating data, won't waste memory creating buffers for every connection
         /// - if validating data, must create buffers for every connection
+        /// - if validating a checksum, must create buffers for every connection to checksum what was received
         ///
         //////////////////////////////////////////////////////////////////////////////////////////
         static
@@ -1614,10 +2197,16 @@ namespace ctsTraffic {
                 wchar_t* value = ParseArgument(*found_arg, L"-verify");
                 if (ctString::iordinal_equals(L"always", value) || ctString::iordinal_equals(L"data", value)) {
                     Settings->ShouldVerifyBuffers = true;
+                    Settings->ShouldVerifyChecksum = false;
                     Settings->UseSharedBuffer = false;
                 } else if (ctString::iordinal_equals(L"never", value) || ctString::iordinal_equals(L"connection", value)) {
                     Settings->ShouldVerifyBuffers = false;
+                    Settings->ShouldVerifyChecksum = false;
                     Settings->UseSharedBuffer = true;
+                } else if (ctString::iordinal_equals(L"checksum", value)) {
+                    Settings->ShouldVerifyBuffers = false;
+                    Settings->ShouldVerifyChecksum = true;
+                    Settings->UseSharedBuffer = false;
                 } else {
                     throw invalid_argument("-verify");
                 }
@@ -1630,8 +2219,10 @@ namespace ctsTraffic {
         //////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Parses for the optional maximum time to run
+        /// - and the time given to in-flight connections to complete once that time is up
         ///
         /// -TimeLimit:##
+        /// -TimeLimitDrain:##
         ///
         //////////////////////////////////////////////////////////////////////////////////////////
         static
@@ -1649,6 +2240,19 @@ namespace ctsTraffic {
                 // always remove the arg from our vector
                 _args.erase(found_arg);
             }
+
+            auto found_drain = find_if(begin(_args), end(_args), [&] (wchar_t* parameter) -> bool {
+                wchar_t* value = ParseArgument(parameter, L"-timelimitdrain");
+                return (value != nullptr);
+            });
+            if (found_drain != end(_args)) {
+                if (0 == Settings->TimeLimit) {
+                    throw invalid_argument("-TimeLimitDrain requires -TimeLimit");
+                }
+                Settings->TimeLimitDrain = as_integral<unsigned long>(ParseArgument(*found_drain, L"-timelimitdrain"));
+                // always remove the arg from our vector
+                _args.erase(found_drain);
+            }
         }
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1693,11 +2297,12 @@ namespace ctsTraffic {
                                  L"\t-Port\n"
                                  L"\t-Protocol\n"
                                  L"\t-Verify\n"
-                                 L"\t-Pattern (on TCP)\n"
+                                 L"\t-Pattern\n"
                                  L"\t-Transfer (on TCP)\n"
                                  L"\t-BitsPerSecond (on UDP)\n"
                                  L"\t-FrameRate (on UDP)\n"
                                  L"\t-StreamLength (on UDP)\n"
+                                 L"\t-PacketCount (on UDP)\n"
                                  L"\n\n"
                                  L"----------------------------------------------------------------------\n"
                                  L"                    Common Server-side options                        \n"
@@ -1747,13 +2352,17 @@ namespace ctsTraffic {
                                  L"   - the protocol used for connectivity and IO\n"
                                  L"\t- tcp : see -help:TCP for usage options\n"
                                  L"\t- udp : see -help:UDP for usage options\n"
-                                 L"-Verify:<connection,data>\n"
+                                 L"-Verify:<connection,data,checksum>\n"
                                  L"   - an enumeration to indicate the level of integrity verification\n"
                                  L"\t- <default> == data\n"
                                  L"\t- connection : the integrity of every connection is verified\n"
                                  L"\t             : including the precise # of bytes to send and receive\n"
                                  L"\t- data : the integrity of every received data buffer is verified against the an expected bit-pattern\n"
                                  L"\t       : this validation is a superset of 'connection' integrity validation\n"
+                                 L"\t- checksum : the sender appends a CRC32C of all bytes sent, which the receiver verifies against\n"
+                                 L"\t           : a CRC32C of all bytes received - the payload is random rather than a bit-pattern\n"
+                                 L"\t           : this validation is a superset of 'connection' integrity validation\n"
+                                 L"\t           : only supported with -Pattern:push and -Pattern:pull, and not with -IO:rioiocp\n"
                                  L"\n");
                     break;
 
@@ -1762,8 +2371,9 @@ namespace ctsTraffic {
                                  L"----------------------------------------------------------------------\n"
                                  L"                    TCP-specific usage options                        \n"
                                  L"                                                                      \n"
-                                 L"  -Buffer, -IO, -Pattern, -PullBytes, -PushBytes, -RateLimit,         \n"
-                                 L"   -Transfer                                                          \n"
+                                 L"  -Buffer, -IO, -MessageSize, -Pattern, -PullBytes, -PushBytes,       \n"
+                                 L"   -PushPullPipeline, -RateLimit, -RecvRateLimit, -RecvStallInterval, \n"
+                                 L"   -RecvStallTime, -Teardown, -Transfer                               \n"
                                  L"                                                                      \n"
                                  L"----------------------------------------------------------------------\n"
                                  L"-Buffer:#####\n"
@@ -1777,13 +2387,25 @@ namespace ctsTraffic {
                                  L"\t- <default> == iocp\n"
                                  L"\t- iocp : leverages WSARecv/WSASend using IOCP for async completions\n"
                                  L"\t- rioiocp : registered i/o using an overlapped IOCP for completion notification\n"
-                                 L"-Pattern:<push,pull,pushpull,duplex>\n"
+                                 L"-MessageSize:#####\n"
+                                 L"-MessageSize:[low,high]\n"
+                                 L"   - applied only with -Pattern:Message - the payload bytes of each framed message\n"
+                                 L"\t- <default> == 1024\n"
+                                 L"\t- supports range : [low,high]  (each message will randomly choose a payload size from within this range)\n"
+                                 L"\t  note : each message is preceded by a 4 byte length header\n"
+                                 L"-Pattern:<push,pull,pushpull,duplex,message>\n"
                                  L"   - the protocol pattern to send & recv over the TCP connection\n"
                                  L"\t- <default> == push\n"
                                  L"\t- push : client pushes data to server\n"
                                  L"\t- pull : client pulls data from server\n"
                                  L"\t- pushpull : client/server alternates sending/receiving data\n"
                                  L"\t- duplex : client/server sends and receives concurrently throughout the entire connection\n"
+                                 L"\t- message : client pushes length-prefixed messages which the server reassembles across recvs\n"
+                                 L"\t            -Buffer controls how messages are split or coalesced within each send and recv\n"
+                                 L"\t            the server reports messages/sec and each message's reassembly time: from receiving\n"
+                                 L"\t            its first byte until its last byte (not a one-way latency, which would need synchronized clocks)\n"
+                                 L"\t  note : -Pattern:message requires -Verify:connection and is not supported with -IO:rioiocp\n"
+                                 L"\t         nor with more than one -PrePostSends\n"
                                  L"-PullBytes:#####\n"
                                  L"   - applied only with -Pattern:PushPull - the number of bytes to 'pull'\n"
                                  L"\t- <default> == 1048576 (1MB)\n"
@@ -1792,10 +2414,42 @@ namespace ctsTraffic {
                                  L"   - applied only with -Pattern:PushPull - the number of bytes to 'push'\n"
                                  L"\t- <default> == 1048576 (1MB)\n"
                                  L"\t  note : pushbytes are the bytes sent from the client and received on the server\n"
+                                 L"-PushPullPipeline:#####\n"
+                                 L"   - applied only with -Pattern:PushPull - the number of push segments the client can have\n"
+                                 L"     outstanding while waiting for their pull segments from the server\n"
+                                 L"\t- <default> == 0 (the client and server strictly alternate pushing and pulling)\n"
+                                 L"\t- the maximum value is 1024\n"
+                                 L"\t  note : the client records the latency of each segment: from when its push began until its pull completed\n"
                                  L"-RateLimit:#####\n"
                                  L"   - rate limits the number of bytes/sec being *sent* on each individual connection\n"
                                  L"\t- <default> == 0 (no rate limits)\n"
                                  L"\t- supports range : [low,high]  (each connection will randomly choose a rate limit setting from within this range)\n"
+                                 L"-RecvRateLimit:#####\n"
+                                 L"   - rate limits the number of bytes/sec being *received* on each individual connection\n"
+                                 L"\t     recvs are reposted only once the prior bytes received have drained at this rate\n"
+                                 L"\t     simulating a slow consumer, forcing its peer to buffer the data it is sending\n"
+                                 L"\t- <default> == 0 (recvs are reposted immediately)\n"
+                                 L"\t- supports range : [low,high]  (each connection will randomly choose a rate limit setting from within this range)\n"
+                                 L"\t  note : only supported with -IO:iocp\n"
+                                 L"-RecvStallInterval:#####\n"
+                                 L"-RecvStallTime:#####\n"
+                                 L"   - every -RecvStallInterval milliseconds, stop reposting recvs for -RecvStallTime milliseconds\n"
+                                 L"\t     simulating a consumer which periodically stops reading (e.g. a mobile client changing networks)\n"
+                                 L"\t- <default> == 0 (no stalls)\n"
+                                 L"\t  note : both must be specified together, and are only supported with -IO:iocp\n"
+                                 L"\t  note : the sender's SendBlocked and SendBacklog summary count the bytes in sends it has posted\n"
+                                 L"\t         which have not yet completed - application bytes in flight, not TCP send buffer occupancy\n"
+                                 L"-Teardown:<graceful,client,server,rst>\n"
+                                 L"   - how each connection is torn down once all data has been transferred\n"
+                                 L"\t- <default> == graceful\n"
+                                 L"\t- graceful : both the client and the server send their FIN as soon as their transfer completes\n"
+                                 L"\t- client : the client sends the first FIN, the server sends its FIN only when it closes its socket\n"
+                                 L"\t           (the client is left with the connection in TIME_WAIT)\n"
+                                 L"\t- server : the server sends the first FIN, the client sends its FIN only when it closes its socket\n"
+                                 L"\t           (the server is left with the connection in TIME_WAIT)\n"
+                                 L"\t- rst : the server sends the first FIN, the client then closes its socket with an RST (SO_LINGER 0)\n"
+                                 L"\t        (neither side is left with the connection in TIME_WAIT)\n"
+                                 L"\t  note : must match on both the client and the server\n"
                                  L"-Transfer:#####\n"
                                  L"   - the total bytes to transfer per TCP connection\n"
                                  L"\t- <default> == 1073741824  (each connection will transfer a sum total of 1GB)\n"
@@ -1814,16 +2468,50 @@ namespace ctsTraffic {
                                  L"  * In all cases, the client-side receives and server-side sends      \n"
                                  L"    at a fixed bit-rate and frame-size                                \n"
                                  L"                                                                      \n"
+                                 L"  * -Pattern:Datagram instead streams small sequenced datagrams       \n"
+                                 L"    to measure packets per second, loss, and reordering               \n"
+                                 L"                                                                      \n"
                                  L"  -BitsPerSecond, -FrameRate, -BufferDepth,                           \n"
-                                 L"   -StreamLength, -StreamCodec                                        \n"
+                                 L"   -StreamLength, -StreamCodec, -Pattern,                             \n"
+                                 L"   -DatagramSize, -PacketRate, -PacketCount                           \n"
                                  L"                                                                      \n"
                                  L"----------------------------------------------------------------------\n"
+                                 L"-Pattern:<mediastream,datagram,echo>\n"
+                                 L"   - the UDP stream to send between the client and the server\n"
+                                 L"\t- <default> == mediastream\n"
+                                 L"\t- mediastream : frames are streamed at the rate set by -BitsPerSecond and -FrameRate\n"
+                                 L"\t- datagram : -PacketCount datagrams are streamed, each tagged with a sequence number\n"
+                                 L"\t             the client counts datagrams received, lost, reordered, and repeated\n"
+                                 L"\t           : the MediaStream options do not apply to this pattern\n"
+                                 L"\t- echo : the client sends -PacketCount timestamped probes which the server echoes back\n"
+                                 L"\t         the client tracks the round-trip time of each probe, and counts probes lost,\n"
+                                 L"\t         reordered, and repeated\n"
+                                 L"\t       : a probe not echoed within 1 second is counted as lost\n"
+                                 L"\t       : the MediaStream options do not apply to this pattern\n"
+                                 L"-DatagramSize:####\n"
+                                 L"-DatagramSize:[low,high]\n"
+                                 L"   - applied only with -Pattern:Datagram or -Pattern:Echo - the size in bytes of each datagram\n"
+                                 L"\t- <default> == 64\n"
+                                 L"\t  note : each datagram size is chosen randomly within the range when a range is given\n"
+                                 L"\t       : must be at least 64 bytes and no more than 64000 bytes (1024 bytes with echo)\n"
+                                 L"-PacketRate:####\n"
+                                 L"   - applied only with -Pattern:Datagram or -Pattern:Echo\n"
+                                 L"\t  the number of datagrams per second the server sends, or probes per second the client sends\n"
+                                 L"\t- <default> == 0 (datagram: send as fast as possible)\n"
+                                 L"\t                 (echo: send the next probe once the prior probe is echoed or lost)\n"
+                                 L"\t  note : a datagram client ends the stream once nothing has arrived for 500ms, or for 4 packet\n"
+                                 L"\t         intervals at its own -PacketRate: give the client the server's rate when below 8/sec\n"
+                                 L"-PacketCount:####\n"
+                                 L"   - applied only with -Pattern:Datagram or -Pattern:Echo\n"
+                                 L"\t  the total number of datagrams streamed, or probes sent, per connection\n"
+                                 L"\t- <required>\n"
+                                 L"\t  note : must match on both the client and the server\n"
                                  L"-BitsPerSecond:####\n"
                                  L"   - the number of bits per second to stream split across '-FrameRate' # of frames\n"
-                                 L"\t- <required>\n"
+                                 L"\t- <required> with -Pattern:MediaStream\n"
                                  L"-FrameRate:####\n"
                                  L"   - the number of frames per second being streamed\n"
-                                 L"\t- <required>\n"
+                                 L"\t- <required> with -Pattern:MediaStream\n"
                                  L"\t  note : for server-side this is the specific frequency that datagrams are sent\n"
                                  L"\t       : for client-side this is the frequency that frames are processed and verified\n"
                                  L"-BufferDepth:####\n"
@@ -1934,9 +2622,11 @@ namespace ctsTraffic {
                                  L"                                                                      \n"
                                  L"  * these options target specific scenario requirements               \n"
                                  L"                                                                      \n"
-                                 L" -Acc, -Bind, -Compartment, -Conn, -IO, -LocalPort,                   \n"
-                                 L" -OnError, -Options, -Pattern, -PrePostRecvs, -RateLimitPeriod        \n"
-                                 L" -ThrottleConnections, -TimeLimit                                     \n"
+                                 L" -Acc, -Bind, -Compartment, -CongestionControl, -Conn, -Dscp,         \n"
+                                 L" -InlineCompletions, -IO, -IoScheduler, -LocalPort, -NetCounters,     \n"
+                                 L" -OnError, -Options, -Outliers, -Pattern, -PrePostRecvs,              \n"
+                                 L" -PrePostSends, -RateLimitPeriod, -ThrottleConnections, -TimeLimit,   \n"
+                                 L" -TimeLimitDrain, -VerifyThreads                                      \n"
                                  L"                                                                      \n"
                                  L"----------------------------------------------------------------------\n"
                                  L"-Acc:<accept,AcceptEx>\n"
@@ -1944,8 +2634,9 @@ namespace ctsTraffic {
                                  L"    the default is appropriate unless deliberately needing to test other APIs\n"
                                  L"\t- <default> == AcceptEx\n"
                                  L"\t- AcceptEx : uses OVERLAPPED AcceptEx with IO Completion ports\n"
-                                 L"\t- accept : uses blocking calls to accept\n"
-                                 L"\t         : be careful using this as it will not scale out well as each call blocks a thread\n"
+                                 L"\t            the number of AcceptEx requests kept posted on each listener adapts to the accept rate\n"
+                                 L"\t- accept : uses nonblocking calls to accept, draining each listener's backlog\n"
+                                 L"\t           whenever it signals FD_ACCEPT\n"
                                  L"-Bind:<IP-address or *>\n"
                                  L"   - a client-side option used to control what IP address is used for outgoing connections\n"
                                  L"\t- <default> == *  (will implicitly bind to the correct IP to connect to the target IP)\n"
@@ -1959,16 +2650,53 @@ namespace ctsTraffic {
                                  L"\t  note : all systems use the default compartment unless explicitly configured otherwise\n"
                                  L"\t  note : the IP addressese specified through -Bind (for clients) and -Listen (for servers)\n"
                                  L"\t         will be directly affected by this Compartment value, including specifying '*'\n"
+                                 L"-CongestionControl:<default,ledbat>[:weight]  [-CongestionControl:<...>]\n"
+                                 L"   - the congestion control applied to each TCP connection, assigned across connections in proportion\n"
+                                 L"\t     to each algorithm's weight (e.g. -CongestionControl:default:50 -CongestionControl:ledbat:50)\n"
+                                 L"\t     the summary then lists the throughput, RTT and retransmissions seen with each algorithm\n"
+                                 L"\t- <default> == not set: all connections use the provider of the transport template they match\n"
+                                 L"\t- default : the congestion provider of the transport template the connection matches (e.g. CUBIC)\n"
+                                 L"\t- ledbat : LEDBAT++, a background transfer which yields to other traffic (set through SIO_PRIORITY_HINT)\n"
+                                 L"\t- weight : the relative share of connections (the default is 1)\n"
+                                 L"\t  note : only supported with TCP; Windows only allows the provider to be chosen per socket for LEDBAT\n"
+                                 L"\t  note : requires a Windows 10 release supporting SIO_PRIORITY_HINT and SIO_TCP_INFO\n"
                                  L"-Conn:<connect,ConnectEx>\n"
                                  L"   - specifies the Winsock API to establish outbound connections\n"
                                  L"    the default is appropriate unless deliberately needing to test other APIs\n"
                                  L"\t- <default> == ConnectEx  (appropriate unless explicitly wanting to test other APIs)\n"
                                  L"\t- ConnectEx : uses OVERLAPPED ConnectEx with IO Completion ports\n"
-                                 L"\t- connect : uses blocking calls to connect\n"
-                                 L"\t          : be careful using this as it will not scale out well as each call blocks a thread\n"
+                                 L"\t- connect : uses nonblocking calls to connect, completed when the socket signals FD_CONNECT\n"
+                                 L"-Dscp:<0-63>[:weight]  [-Dscp:<...>]\n"
+                                 L"   - the DSCP value marked on each connection's outgoing packets, assigned across connections in proportion\n"
+                                 L"\t     to each class's weight (e.g. -Dscp:46:1 -Dscp:0:9 marks 1 in 10 connections as Expedited Forwarding)\n"
+                                 L"\t     the summary then lists the bytes and latencies seen with each class\n"
+                                 L"\t- <default> == not set: packets are sent unmarked\n"
+                                 L"\t- weight : the relative share of connections (the default is 1)\n"
+                                 L"\t  note : DSCP values are set through qWAVE, which requires running as an Administrator\n"
+                                 L"\t  note : latencies are recorded by -Pattern:Echo (UDP) and -Pattern:PushPull with -PushPullPipeline (TCP)\n"
+                                 L"\t         -Pattern:Message records the time to reassemble each message on the server\n"
+                                 L"-InlineCompletions:#####\n"
+                                 L"   - the # of IO requests a connection may complete inline, back-to-back, before its\n"
+                                 L"\t     remaining IO is continued from a threadpool thread\n"
+                                 L"\t     sends and recvs which complete immediately are processed on the calling thread;\n"
+                                 L"\t     this budget keeps one connection with a fast peer from monopolizing that thread\n"
+                                 L"\t- <default> == 64\n"
+                                 L"\t  note : applies to -IO:iocp and -IO:readwritefile\n"
                                  L"-IO:<readwritefile>\n"
                                  L"   - an additional IO option beyond iocp and rioiocp\n"
                                  L"\t- readwritefile : leverages ReadFile/WriteFile using IOCP for async completions\n"
+                                 L"-IoScheduler:<fifo,rr,drr>\n"
+                                 L"   - the order in which connections issue their next IO as their prior IO completes\n"
+                                 L"\t     with many connections, those whose completions arrive first can starve the others\n"
+                                 L"\t     the status updates include Jain's fairness index of the bytes each connection transferred\n"
+                                 L"\t- <default> == not set (each completion immediately reposts IO for its own connection)\n"
+                                 L"\t- fifo : IO is reposted in completion order, as by default, only adding the fairness index\n"
+                                 L"\t- rr : connections waiting to issue IO take turns, round-robin, reposting IO once per turn\n"
+                                 L"\t       (only differs from fifo when connections have several completions waiting, e.g. -PrePostRecvs)\n"
+                                 L"\t- drr : deficit round-robin - each connection is charged the bytes it transferred\n"
+                                 L"\t        and yields its turns to the others until it has been credited back (64KB per turn)\n"
+                                 L"\t  note : only supported with TCP and -IO:iocp\n"
+                                 L"\t  note : connections are spread across one scheduler per processor, taking turns within each\n"
                                  L"-LocalPort:####\n"
                                  L"   - the local port to bind to when initiating a connection\n"
                                  L"\t- <default> == 0  (an ephemeral port will be chosen when making a connection)\n"
@@ -1977,6 +2705,14 @@ namespace ctsTraffic {
                                  L"\t  note : Be very careful when using with TCP connections, as port values will not be immediately\n"
                                  L"\t         reusable; TCP will hold an closed IP:port in a TIME_WAIT statue for a period of time\n"
                                  L"\t         only after which will it be able to be reused (default is 4 minutes)\n"
+                                 L"-NetCounters:<physical,all>\n"
+                                 L"   - with each status update, lists the change in each interface's packets, bytes, discards and errors\n"
+                                 L"\t     along with the TCP segments retransmitted and UDP receive errors (summed across IPv4 and IPv6)\n"
+                                 L"\t     to help tell whether a change in throughput came from the application, the stack, or the wire\n"
+                                 L"\t- <default> == no counters are listed\n"
+                                 L"\t- physical : only hardware interfaces which are up\n"
+                                 L"\t- all : all interfaces which are up (including virtual and tunnel interfaces)\n"
+                                 L"\t  note : only written to the console; interfaces with no change over the interval are not listed\n"
                                  L"-OnError:<log,break>\n"
                                  L"   - policy to control how errors are handled at runtime\n"
                                  L"\t- <default> == log \n"
@@ -1990,6 +2726,15 @@ namespace ctsTraffic {
                                  L"\t            : ctsTraffic servers have this enabled by default\n"
                                  L"\t- tcpfastpath : a new option for Windows 8, only for TCP sockets over loopback\n"
                                  L"\t              : the firewall must be disabled for the option to take effect\n"
+                                 L"-Outliers:#####\n"
+                                 L"-OutliersBy:<throughput,idle>\n"
+                                 L"   - with each status update, lists the # of active connections which are the slowest\n"
+                                 L"\t     with their addresses, bytes/sec, time since their last completed IO, and transfer state\n"
+                                 L"\t- <default> == 0 (no connections are listed)\n"
+                                 L"\t- throughput : (the default for -OutliersBy) the fewest bytes/sec since the connection started IO\n"
+                                 L"\t- idle : the longest time since the connection last completed an IO (e.g. connections which are stuck)\n"
+                                 L"\t  note : only supported with TCP, and only written to the console\n"
+                                 L"\t  note : each update samples at most 1024 connections, continuing from the prior update\n"
                                  L"-PrePostRecvs:#####\n"
                                  L"   - specifies the number of recv requests to issue concurrently within an IO Pattern\n"
                                  L"   - for example, with the default -pattern:pull, the client will post recv calls \n"
@@ -1999,6 +2744,15 @@ namespace ctsTraffic {
                                  L"\t- <default> == 2 for UDP (two recv requests kept in-flight)\n"
                                  L"\t  note : with TCP patterns, -verify:connection must be specified in order to specify\n"
                                  L"\t         more than one -PrePostRecvs (UDP can always support any number)\n"
+                                 L"-PrePostSends:#####\n"
+                                 L"   - specifies the number of send requests to keep in-flight concurrently within a TCP IO Pattern\n"
+                                 L"   - for example, with the default -pattern:push, the client will post send calls \n"
+                                 L"\t     one after another, immediately posting a send after the prior completed.\n"
+                                 L"\t     With -pattern:push -PrePostSends:4, 4 send calls will be kept in-flight at all times,\n"
+                                 L"\t     keeping the send buffer filled on high bandwidth-delay links.\n"
+                                 L"\t- <default> == 1 (one send request at a time)\n"
+                                 L"\t  note : applies to the push, pull, pushpull and duplex patterns\n"
+                                 L"\t  note : -verify:connection must be specified in order to specify more than one -PrePostSends\n"
                                  L"-RateLimitPeriod:#####\n"
                                  L"   - the # of milliseconds describing the granularity by which -RateLimit bytes/second is enforced\n"
                                  L"\t     the -RateLimit bytes/second will be evenly split across -RateLimitPeriod milliseconds\n"
@@ -2014,9 +2768,23 @@ namespace ctsTraffic {
                                  L"-TimeLimit:#####\n"
                                  L"   - the maximum number of seconds to run before the application is aborted and terminated\n"
                                  L"\t- <default> == <no time limit>\n"
-                                 L"\t  note : this is to be used only to cap the maximum time to run, as this will log an error\n"
-                                 L"\t         if this timelimit is exceeded; predictable results should have the scenario finish\n"
-                                 L"\t         before this time limit is hit\n"
+                                 L"\t  note : this is to be used only to cap the maximum time to run; connections still transferring\n"
+                                 L"\t         data when it is exceeded are aborted, reported as AbortedAtTimeLimit, and added to the\n"
+                                 L"\t         exit code with all other failed connections; predictable results should have the scenario\n"
+                                 L"\t         finish before this time limit is hit\n"
+                                 L"-TimeLimitDrain:#####\n"
+                                 L"   - the # of milliseconds connections still transferring data are given to complete once\n"
+                                 L"\t     -TimeLimit expires; no new connections are made while they drain, and those which have\n"
+                                 L"\t     not completed by then are aborted together and counted apart from NetworkErrors\n"
+                                 L"\t- <default> == 0  (connections still transferring data are aborted as soon as -TimeLimit expires)\n"
+                                 L"\t  note : requires -TimeLimit\n"
+                                 L"-VerifyThreads:#####\n"
+                                 L"   - the # of threads dedicated to verifying the data pattern of received buffers\n"
+                                 L"\t     completed recv buffers are handed to these threads so the next recv can be posted\n"
+                                 L"\t     without waiting for the compare; a buffer is reused only after it was verified\n"
+                                 L"\t- <default> == 0  (buffers are verified inline as each recv completes)\n"
+                                 L"\t  note : requires -verify:data\n"
+                                 L"\t  note : only applicable to TCP, and not applicable with -IO:rioiocp\n"
                                  L"\n");
                     break;
             }
@@ -2026,6 +2794,8 @@ namespace ctsTraffic {
 
         bool Startup(_In_ int argc, _In_reads_(argc) wchar_t** argv)
         {
+            // calibrate the clock before any connection starts timing IO
+            ctl::ctTimer::calibrate_clock();
             ctsConfigInitOnce();
 
             if (argc < 2) {
@@ -2122,12 +2892,21 @@ namespace ctsTraffic {
             set_ioPattern(args);
             set_threadpool(args);
             // validate protocol & pattern combinations
-            if (ProtocolType::UDP == Settings->Protocol && IoPatternType::MediaStream != Settings->IoPattern) {
-                throw invalid_argument("UDP only supports the MediaStream IO Pattern");
+            if (ProtocolType::UDP == Settings->Protocol &&
+                IoPatternType::MediaStream != Settings->IoPattern &&
+                IoPatternType::Datagram != Settings->IoPattern &&
+                IoPatternType::Echo != Settings->IoPattern) {
+                throw invalid_argument("UDP only supports the MediaStream, Datagram, and Echo IO Patterns");
             }
             if (ProtocolType::TCP == Settings->Protocol && IoPatternType::MediaStream == Settings->IoPattern) {
                 throw invalid_argument("TCP does not support the MediaStream IO Pattern");
             }
+            if (ProtocolType::TCP == Settings->Protocol && IoPatternType::Datagram == Settings->IoPattern) {
+                throw invalid_argument("TCP does not support the Datagram IO Pattern");
+            }
+            if (ProtocolType::TCP == Settings->Protocol && IoPatternType::Echo == Settings->IoPattern) {
+                throw invalid_argument("TCP does not support the Echo IO Pattern");
+            }
             // set appropriate defaults for # of connections for TCP vs. UDP
             if (ProtocolType::UDP == Settings->Protocol) {
                 Settings->ConnectionLimit = DefaultUdpConnectionLimit;
@@ -2139,8 +2918,14 @@ namespace ctsTraffic {
             /// Next, set the ctsStatusInformation to be used to print status updates for this protocol
             /// - this must be called after both set_logging and set_protocol
             ///
-            if (ProtocolType::TCP == Settings->Protocol) {
+            if (IoPatternType::Message == Settings->IoPattern) {
+                print_status = std::make_shared<ctsMessageStatusInformation>();
+            } else if (ProtocolType::TCP == Settings->Protocol) {
                 print_status = std::make_shared<ctsTcpStatusInformation>();
+            } else if (IoPatternType::Datagram == Settings->IoPattern) {
+                print_status = std::make_shared<ctsDatagramStatusInformation>();
+            } else if (IoPatternType::Echo == Settings->IoPattern) {
+                print_status = std::make_shared<ctsEchoStatusInformation>();
             } else {
                 print_status = std::make_shared<ctsUdpStatusInformation>();
             }
@@ -2148,12 +2933,17 @@ namespace ctsTraffic {
             /// Next: capture other various settings which do not have explicit dependencies
             ///
             set_options(args);
+            set_congestionControl(args);
+            set_dscp(args);
             set_compartment(args);
             set_connections(args);
             set_throttleConnections(args);
             set_buffer(args);
             set_transfer(args);
             set_ratelimit(args);
+            set_teardown(args);
+            set_outliers(args);
+            set_netcounters(args);
             set_iterations(args);
             set_serverExitLimit(args);
             set_timelimit(args);
@@ -2166,6 +2956,11 @@ namespace ctsTraffic {
                     throw invalid_argument("The media stream frame size (buffer) must be at least 20 bytes");
                 }
             }
+            if (IoPatternType::Datagram == Settings->IoPattern || IoPatternType::Echo == Settings->IoPattern) {
+                // recv buffers must hold the largest datagram: sends choose their own size per datagram
+                buffersize_high = 0;
+                buffersize_low = (datagram_settings.DatagramSizeHigh > 0) ? datagram_settings.DatagramSizeHigh : datagram_settings.DatagramSizeLow;
+            }
 
             // validate localport usage
             if ((Settings->ListenAddresses.size() > 0) && (Settings->LocalPortLow != 0)) {
@@ -2185,7 +2980,29 @@ namespace ctsTraffic {
             ///
             Settings->ShouldVerifyBuffers = true;
             Settings->UseSharedBuffer = false;
+            Settings->ShouldVerifyChecksum = false;
             set_shouldVerifyBuffers(args);
+            if (Settings->ShouldVerifyChecksum) {
+                if (IoPatternType::Push != Settings->IoPattern && IoPatternType::Pull != Settings->IoPattern) {
+                    throw invalid_argument("-Verify:checksum is only supported with -Pattern:push and -Pattern:pull");
+                }
+                // the trailer is carried within the transfer: every connection must transfer more than the trailer
+                if (transfer_low <= sizeof(unsigned long)) {
+                    throw invalid_argument("-Verify:checksum requires -Transfer to be larger than the 4 byte checksum");
+                }
+            }
+            if (IoPatternType::Message == Settings->IoPattern) {
+                // the message headers are carried within the stream: received bytes are no longer the bit pattern
+                if (Settings->ShouldVerifyBuffers || Settings->ShouldVerifyChecksum) {
+                    throw invalid_argument("-Pattern:Message requires -Verify:connection");
+                }
+                // every connection must transfer at least one message header
+                if (transfer_low <= sizeof(unsigned long)) {
+                    throw invalid_argument("-Pattern:Message requires -Transfer to be larger than the 4 byte message header");
+                }
+                // the server parses every received byte: recvs can never share a buffer across connections
+                Settings->UseSharedBuffer = false;
+            }
             if (ProtocolType::UDP == Settings->Protocol) {
                 // UDP clients can never recv into the same shared buffer since it uses it for seq. numbers, etc
                 if (!IsListening()) {
@@ -2193,15 +3010,47 @@ namespace ctsTraffic {
                 }
             }
             set_prepostrecvs(args);
-            if (ProtocolType::TCP == Settings->Protocol && Settings->ShouldVerifyBuffers && Settings->PrePostRecvs > 1) {
+            if (ProtocolType::TCP == Settings->Protocol && (Settings->ShouldVerifyBuffers || Settings->ShouldVerifyChecksum) && Settings->PrePostRecvs > 1) {
                 throw invalid_argument("-PrePostRecvs > 1 requires -Verify:connection when using TCP");
             }
+            set_prepostsends(args);
+            // sends are posted in pattern order, but concurrent completions can post them to the stack out of order
+            if ((Settings->ShouldVerifyBuffers || Settings->ShouldVerifyChecksum) && Settings->PrePostSends > 1) {
+                throw invalid_argument("-PrePostSends > 1 requires -Verify:connection");
+            }
+            // for the same reason: messages are framed into sends in stream order, which the server parses in order
+            // - -Pattern:Message already requires -Verify:connection, so the check above never applies to it
+            if (IoPatternType::Message == Settings->IoPattern && Settings->PrePostSends > 1) {
+                throw invalid_argument("-Pattern:Message does not support -PrePostSends > 1");
+            }
+            set_verifyThreads(args);
             ///
             /// finally set the functions to use once all other settings are established
             /// set_ioFunction changes global options for socket operation for instance WSA_FLAG_REGISTERED_IO flag
             /// - hence it is requirement to invoke it prior to any socket operation
             ///
             set_ioFunction(args);
+            set_inlineCompletions(args);
+            set_ioScheduler(args);
+            if (Settings->IoScheduler != IoSchedulerType::NoScheduler) {
+                if (!IoFunctionDefersTasks) {
+                    throw invalid_argument("-IoScheduler is only supported with -IO:iocp");
+                }
+                // the fairness across connections is printed with each status update
+                if (IoPatternType::Message != Settings->IoPattern) {
+                    print_status = std::make_shared<ctsFairnessStatusInformation>();
+                }
+            }
+            if (Settings->ShouldVerifyChecksum && (Settings->SocketFlags & WSA_FLAG_REGISTERED_IO)) {
+                throw invalid_argument("-Verify:checksum is not supported with -IO:rioiocp");
+            }
+            if ((recv_ratelimit_low > 0 || Settings->RecvStallInterval > 0) && !IoFunctionDefersTasks) {
+                throw invalid_argument("-RecvRateLimit, -RecvStallInterval, and -RecvStallTime are only supported with -IO:iocp");
+            }
+            // messages are framed into buffers owned by the pattern, which are not registered with RIO
+            if (IoPatternType::Message == Settings->IoPattern && (Settings->SocketFlags & WSA_FLAG_REGISTERED_IO)) {
+                throw invalid_argument("-Pattern:Message is not supported with -IO:rioiocp");
+            }
             set_create(args);
             set_connect(args);
             set_accept(args);
@@ -2292,7 +3141,13 @@ namespace ctsTraffic {
                     statuslogger->LogHeader(print_status);
                 }
                 if (connectionlogger && connectionlogger->IsCsvFormat()) {
-                    if (ProtocolType::UDP == Settings->Protocol) {
+                    if (IoPatternType::Datagram == Settings->IoPattern) {
+                        connectionlogger->LogMessage(L"TimeSlice,LocalAddress,RemoteAddress,Packets/Sec,Bits/Sec,Datagrams,Lost,Reordered,Repeated,Errors,Result\n");
+
+                    } else if (IoPatternType::Echo == Settings->IoPattern) {
+                        connectionlogger->LogMessage(L"TimeSlice,LocalAddress,RemoteAddress,Probes,Lost,Reordered,Repeated,Errors,MinRtt(us),P50Rtt(us),P90Rtt(us),P99Rtt(us),MaxRtt(us),Result\n");
+
+                    } else if (ProtocolType::UDP == Settings->Protocol) {
                         connectionlogger->LogMessage(L"TimeSlice,LocalAddress,RemoteAddress,Bits/Sec,Completed,Dropped,Repeated,Retries,Errors,Result\n");
 
                     } else { // TCP
@@ -2484,6 +3339,86 @@ namespace ctsTraffic {
                 }
             }
         }
+        ///
+        /// Writes the -Outliers slowest active connections to the console, below the status line
+        ///
+        static
+        void PrintOutliers() throw()
+        {
+            try {
+                std::vector<ctsConnectionOutliers::ctsConnectionOutlier> outliers(ctsConnectionOutliers::SnapOutliers());
+                if (outliers.empty()) {
+                    return;
+                }
+
+                std::wstring outlier_string(
+                    (OutlierRankType::LongestIdle == Settings->OutlierRank) ?
+                    L"  Longest idle connections:\n" :
+                    L"  Lowest throughput connections:\n");
+                for (const auto& outlier : outliers) {
+                    const wchar_t* state = L"completing";
+                    switch (outlier.progress.protocol_status) {
+                        case ctsIOPatternStatus::MoreData:
+                            state = outlier.progress.send_blocked ? L"sending (sends pended on the peer)" : L"transferring";
+                            break;
+                        case ctsIOPatternStatus::RequestFIN:
+                            state = L"shutting down sends";
+                            break;
+                        case ctsIOPatternStatus::VerifyFIN:
+                            state = L"waiting for the peer's FIN";
+                            break;
+                    }
+                    outlier_string.append(
+                        ctString::format_string(
+                            L"\t%s -> %s  Bytes/Sec [%lld]  Idle(ms) [%lld]  %s\n",
+                            outlier.local_address.writeCompleteAddress().c_str(),
+                            outlier.remote_address.writeCompleteAddress().c_str(),
+                            outlier.progress.bytes_per_second,
+                            outlier.progress.idle_msec,
+                            state));
+                }
+                ::fwprintf(stdout, L"%s", outlier_string.c_str());
+            }
+            catch (const std::exception&) {
+                // best effort: the list is skipped for this status update
+            }
+        }
+
+        ///
+        /// Writes the -NetCounters interface and stack counter deltas to the console, below the status line
+        ///
+        static
+        void PrintNetworkCounters() throw()
+        {
+            try {
+                ctsNetworkCounters::ctsNetworkCounterDeltas deltas(ctsNetworkCounters::SnapDeltas());
+
+                std::wstring counter_string(
+                    ctString::format_string(
+                        L"  TCP Retransmitted Segments [%llu]  UDP Receive Errors [%llu]\n",
+                        deltas.tcp_retransmitted_segments,
+                        deltas.udp_receive_errors));
+                for (const auto& interface_deltas : deltas.interfaces) {
+                    counter_string.append(
+                        ctString::format_string(
+                            L"\t%s  Rx: Packets [%llu] Bytes [%llu] Discards [%llu] Errors [%llu]  Tx: Packets [%llu] Bytes [%llu] Discards [%llu] Errors [%llu]\n",
+                            interface_deltas.alias.c_str(),
+                            interface_deltas.rx_packets,
+                            interface_deltas.rx_bytes,
+                            interface_deltas.rx_discards,
+                            interface_deltas.rx_errors,
+                            interface_deltas.tx_packets,
+                            interface_deltas.tx_bytes,
+                            interface_deltas.tx_discards,
+                            interface_deltas.tx_errors));
+                }
+                ::fwprintf(stdout, L"%s", counter_string.c_str());
+            }
+            catch (const std::exception&) {
+                // best effort: the counters are skipped for this status update
+            }
+        }
+
         void PrintStatusUpdate() throw()
         {
             ctsConfigInitOnce();
@@ -2509,7 +3444,7 @@ namespace ctsTraffic {
 
                         // capture the timeslices
                         ctsSignedLongLong l_previoutimeslice = printing_previous_timeslice;
-                        ctsSignedLongLong l_current_timeslice = ctTimer::snap_qpc_msec() - Settings->StartTimeMilliseconds;
+                        ctsSignedLongLong l_current_timeslice = ctTimer::snap_clock_msec() - Settings->StartTimeMilliseconds;
 
                         if (l_current_timeslice > l_previoutimeslice) {
                             // write out the header to the console every 40 updates 
@@ -2554,6 +3489,13 @@ namespace ctsTraffic {
                                     clear_status);
                             }
 
+                            if (write_to_console && Settings->OutlierCount > 0) {
+                                PrintOutliers();
+                            }
+                            if (write_to_console && Settings->NetCounters != NetCounterType::NoNetCounters) {
+                                PrintNetworkCounters();
+                            }
+
                             // update tracking values
                             printing_previous_timeslice = l_current_timeslice;
                             ++printing_timeslice_count;
@@ -2790,9 +3732,27 @@ namespace ctsTraffic {
             // csv format : "TimeSlice,LocalAddress,RemoteAddress,Bits/Sec,Completed,Dropped,Repeated,Retries,Errors,Result"
             static LPCWSTR UDPResultCsvFormat = L"%.3f,%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,%s\n";
 
+            static LPCWSTR DatagramSuccessfulResultTextFormat = L"[%.3f] UDP connection succeeded : [%s - %s] : PacketsPerSecond [%llu]  BitsPerSecond [%llu]  Datagrams [%llu]  Lost [%llu]  Reordered [%llu]  Repeated [%llu]  Errors [%llu]\n";
+            static LPCWSTR DatagramNetworkFailureResultTextFormat = L"[%.3f] UDP connection failed with the error %s : [%s - %s] : PacketsPerSecond [%llu]  BitsPerSecond [%llu]  Datagrams [%llu]  Lost [%llu]  Reordered [%llu]  Repeated [%llu]  Errors [%llu]\n";
+            static LPCWSTR DatagramProtocolFailureResultTextFormat = L"[%.3f] UDP connection failed with the protocol error %s : [%s - %s] : PacketsPerSecond [%llu]  BitsPerSecond [%llu]  Datagrams [%llu]  Lost [%llu]  Reordered [%llu]  Repeated [%llu]  Errors [%llu]\n";
+
+            // csv format : "TimeSlice,LocalAddress,RemoteAddress,Packets/Sec,Bits/Sec,Datagrams,Lost,Reordered,Repeated,Errors,Result"
+            static LPCWSTR DatagramResultCsvFormat = L"%.3f,%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%s\n";
+
+            static LPCWSTR EchoSuccessfulResultTextFormat = L"[%.3f] UDP connection succeeded : [%s - %s] : Probes [%llu]  Lost [%llu]  Reordered [%llu]  Repeated [%llu]  Errors [%llu]  RTT(us) Min [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  Max [%lld]\n";
+            static LPCWSTR EchoNetworkFailureResultTextFormat = L"[%.3f] UDP connection failed with the error %s : [%s - %s] : Probes [%llu]  Lost [%llu]  Reordered [%llu]  Repeated [%llu]  Errors [%llu]  RTT(us) Min [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  Max [%lld]\n";
+            static LPCWSTR EchoProtocolFailureResultTextFormat = L"[%.3f] UDP connection failed with the protocol error %s : [%s - %s] : Probes [%llu]  Lost [%llu]  Reordered [%llu]  Repeated [%llu]  Errors [%llu]  RTT(us) Min [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  Max [%lld]\n";
+
+            // csv format : "TimeSlice,LocalAddress,RemoteAddress,Probes,Lost,Reordered,Repeated,Errors,MinRtt(us),P50Rtt(us),P90Rtt(us),P99Rtt(us),MaxRtt(us),Result"
+            static LPCWSTR EchoResultCsvFormat = L"%.3f,%s,%s,%llu,%llu,%llu,%llu,%llu,%lld,%lld,%lld,%lld,%lld,%s\n";
+
+            const bool is_datagram = (IoPatternType::Datagram == Settings->IoPattern);
+            const bool is_echo = (IoPatternType::Echo == Settings->IoPattern);
+
             float current_time = ctsConfig::GetStatusTimeStamp();
             long long elapsed_time(_stats.end_time.get() - _stats.start_time.get());
             long long bits_per_second = (elapsed_time > 0LL) ? static_cast<long long>(_stats.bits_received.get() * 1000LL / elapsed_time) : 0LL;
+            long long packets_per_second = (elapsed_time > 0LL) ? static_cast<long long>(_stats.successful_frames.get() * 1000LL / elapsed_time) : 0LL;
 
             try {
                 std::wstring csv_string;
@@ -2809,7 +3769,44 @@ namespace ctsTraffic {
                     }
                 }
 
-                if (connectionlogger && connectionlogger->IsCsvFormat()) {
+                if (connectionlogger && connectionlogger->IsCsvFormat() && is_echo) {
+                    csv_string = ctString::format_string(
+                        EchoResultCsvFormat,
+                        current_time,
+                        _local_addr.writeCompleteAddress().c_str(),
+                        _remote_addr.writeCompleteAddress().c_str(),
+                        _stats.successful_frames.get(),
+                        _stats.dropped_frames.get(),
+                        _stats.reordered_frames.get(),
+                        _stats.duplicate_frames.get(),
+                        _stats.error_frames.get(),
+                        _stats.round_trip_usec.minimum(),
+                        _stats.round_trip_usec.percentile(50.0),
+                        _stats.round_trip_usec.percentile(90.0),
+                        _stats.round_trip_usec.percentile(99.0),
+                        _stats.round_trip_usec.maximum(),
+                        (ProtocolError == error_type) ?
+                            ctsIOPatternProtocolErrorString(static_cast<ctsIOPatternStatus>(_error)) :
+                            error_string.c_str());
+
+                } else if (connectionlogger && connectionlogger->IsCsvFormat() && is_datagram) {
+                    csv_string = ctString::format_string(
+                        DatagramResultCsvFormat,
+                        current_time,
+                        _local_addr.writeCompleteAddress().c_str(),
+                        _remote_addr.writeCompleteAddress().c_str(),
+                        packets_per_second,
+                        bits_per_second,
+                        _stats.successful_frames.get(),
+                        _stats.dropped_frames.get(),
+                        _stats.reordered_frames.get(),
+                        _stats.duplicate_frames.get(),
+                        _stats.error_frames.get(),
+                        (ProtocolError == error_type) ?
+                            ctsIOPatternProtocolErrorString(static_cast<ctsIOPatternStatus>(_error)) :
+                            error_string.c_str());
+
+                } else if (connectionlogger && connectionlogger->IsCsvFormat()) {
                     csv_string = ctString::format_string(
                         UDPResultCsvFormat,
                         current_time,
@@ -2827,7 +3824,77 @@ namespace ctsTraffic {
                 }
                 // we'll never write csv format to the console so we'll need a text string in that case
                 // - and/or in the case the connectionlogger isn't writing to csv
-                if (write_to_console || (connectionlogger && !connectionlogger->IsCsvFormat())) {
+                if ((write_to_console || (connectionlogger && !connectionlogger->IsCsvFormat())) && is_echo) {
+                    if (0 == _error) {
+                        text_string = ctString::format_string(
+                            EchoSuccessfulResultTextFormat,
+                            current_time,
+                            _local_addr.writeCompleteAddress().c_str(),
+                            _remote_addr.writeCompleteAddress().c_str(),
+                            _stats.successful_frames.get(),
+                            _stats.dropped_frames.get(),
+                            _stats.reordered_frames.get(),
+                            _stats.duplicate_frames.get(),
+                            _stats.error_frames.get(),
+                            _stats.round_trip_usec.minimum(),
+                            _stats.round_trip_usec.percentile(50.0),
+                            _stats.round_trip_usec.percentile(90.0),
+                            _stats.round_trip_usec.percentile(99.0),
+                            _stats.round_trip_usec.maximum());
+                    } else {
+                        text_string = ctString::format_string(
+                            (ProtocolError == error_type) ? EchoProtocolFailureResultTextFormat : EchoNetworkFailureResultTextFormat,
+                            current_time,
+                            (ProtocolError == error_type) ?
+                                ctsIOPatternProtocolErrorString(static_cast<ctsIOPatternStatus>(_error)) :
+                                error_string.c_str(),
+                            _local_addr.writeCompleteAddress().c_str(),
+                            _remote_addr.writeCompleteAddress().c_str(),
+                            _stats.successful_frames.get(),
+                            _stats.dropped_frames.get(),
+                            _stats.reordered_frames.get(),
+                            _stats.duplicate_frames.get(),
+                            _stats.error_frames.get(),
+                            _stats.round_trip_usec.minimum(),
+                            _stats.round_trip_usec.percentile(50.0),
+                            _stats.round_trip_usec.percentile(90.0),
+                            _stats.round_trip_usec.percentile(99.0),
+                            _stats.round_trip_usec.maximum());
+                    }
+
+                } else if ((write_to_console || (connectionlogger && !connectionlogger->IsCsvFormat())) && is_datagram) {
+                    if (0 == _error) {
+                        text_string = ctString::format_string(
+                            DatagramSuccessfulResultTextFormat,
+                            current_time,
+                            _local_addr.writeCompleteAddress().c_str(),
+                            _remote_addr.writeCompleteAddress().c_str(),
+                            packets_per_second,
+                            bits_per_second,
+                            _stats.successful_frames.get(),
+                            _stats.dropped_frames.get(),
+                            _stats.reordered_frames.get(),
+                            _stats.duplicate_frames.get(),
+                            _stats.error_frames.get());
+                    } else {
+                        text_string = ctString::format_string(
+                            (ProtocolError == error_type) ? DatagramProtocolFailureResultTextFormat : DatagramNetworkFailureResultTextFormat,
+                            current_time,
+                            (ProtocolError == error_type) ?
+                                ctsIOPatternProtocolErrorString(static_cast<ctsIOPatternStatus>(_error)) :
+                                error_string.c_str(),
+                            _local_addr.writeCompleteAddress().c_str(),
+                            _remote_addr.writeCompleteAddress().c_str(),
+                            packets_per_second,
+                            bits_per_second,
+                            _stats.successful_frames.get(),
+                            _stats.dropped_frames.get(),
+                            _stats.reordered_frames.get(),
+                            _stats.duplicate_frames.get(),
+                            _stats.error_frames.get());
+                    }
+
+                } else if (write_to_console || (connectionlogger && !connectionlogger->IsCsvFormat())) {
                     if (0 == _error) {
                         text_string = ctString::format_string(
                             UDPSuccessfulResultTextFormat,
@@ -3008,6 +4075,18 @@ namespace ctsTraffic {
             }
         }
 
+        ctsSignedLongLong GetTcpRecvBytesPerSecond() throw()
+        {
+            ctsConfigInitOnce();
+
+            if (0 == recv_ratelimit_high) {
+                // range was not specified
+                return recv_ratelimit_low;
+            } else {
+                return random.uniform_int(recv_ratelimit_low, recv_ratelimit_high);
+            }
+        }
+
         int GetListenBacklog() throw()
         {
             ctsConfigInitOnce();
@@ -3031,6 +4110,43 @@ namespace ctsTraffic {
             return media_stream_settings;
         }
 
+        const DatagramSettings& GetDatagram() throw()
+        {
+            ctsConfigInitOnce();
+
+            ctFatalCondition(
+                0 == datagram_settings.PacketCount,
+                L"Internally requesting datagram settings when this was not specified by the user");
+
+            return datagram_settings;
+        }
+
+        ctsUnsignedLong GetDatagramSize() throw()
+        {
+            ctsConfigInitOnce();
+
+            if (0 == datagram_settings.DatagramSizeHigh) {
+                // range was not specified
+                return datagram_settings.DatagramSizeLow;
+            } else {
+                return random.uniform_int(
+                    static_cast<unsigned long>(datagram_settings.DatagramSizeLow),
+                    static_cast<unsigned long>(datagram_settings.DatagramSizeHigh));
+            }
+        }
+
+        ctsUnsignedLong GetMessageSize() throw()
+        {
+            ctsConfigInitOnce();
+
+            if (0 == message_size_high) {
+                // range was not specified
+                return message_size_low;
+            } else {
+                return random.uniform_int(message_size_low, message_size_high);
+            }
+        }
+
         bool IsListening() throw()
         {
             ctsConfigInitOnce();
@@ -3038,9 +4154,83 @@ namespace ctsTraffic {
             return !Settings->ListenAddresses.empty();
         }
 
+        bool InitiatesTeardown() throw()
+        {
+            ctsConfigInitOnce();
+
+            switch (Settings->Teardown) {
+                case TeardownType::ClientTeardown:
+                    return !IsListening();
+                case TeardownType::ServerTeardown:
+                case TeardownType::AbortiveTeardown:
+                    return IsListening();
+                default:
+                    return true;
+            }
+        }
+
+        bool AbortsOnClose() throw()
+        {
+            ctsConfigInitOnce();
+
+            return TeardownType::AbortiveTeardown == Settings->Teardown && !IsListening();
+        }
+
+        unsigned long GetTimeWaitCount() throw()
+        {
+            ctsConfigInitOnce();
+
+            // the ports in the TCP tables are in network byte order in the low 16 bits
+            const DWORD test_port = ::htons(Settings->Port);
+            unsigned long time_wait_count = 0;
+            try {
+                vector<BYTE> table_buffer;
+                ULONG table_size = 0;
+                DWORD error = ERROR_INSUFFICIENT_BUFFER;
+                while (ERROR_INSUFFICIENT_BUFFER == error) {
+                    table_buffer.resize(table_size);
+                    error = ::GetTcpTable(table_buffer.empty() ? nullptr : reinterpret_cast<PMIB_TCPTABLE>(&table_buffer[0]), &table_size, FALSE);
+                }
+                if (NO_ERROR == error) {
+                    const MIB_TCPTABLE* tcp_table = reinterpret_cast<const MIB_TCPTABLE*>(&table_buffer[0]);
+                    for (DWORD row = 0; row < tcp_table->dwNumEntries; ++row) {
+                        if (MIB_TCP_STATE_TIME_WAIT == tcp_table->table[row].dwState &&
+                            (test_port == (tcp_table->table[row].dwLocalPort & 0xffff) || test_port == (tcp_table->table[row].dwRemotePort & 0xffff))) {
+                            ++time_wait_count;
+                        }
+                    }
+                } else {
+                    PrintErrorIfFailed(L"GetTcpTable", error);
+                }
+
+                table_buffer.clear();
+                table_size = 0;
+                error = ERROR_INSUFFICIENT_BUFFER;
+                while (ERROR_INSUFFICIENT_BUFFER == error) {
+                    table_buffer.resize(table_size);
+                    error = ::GetTcp6Table(table_buffer.empty() ? nullptr : reinterpret_cast<PMIB_TCP6TABLE>(&table_buffer[0]), &table_size, FALSE);
+                }
+                if (NO_ERROR == error) {
+                    const MIB_TCP6TABLE* tcp6_table = reinterpret_cast<const MIB_TCP6TABLE*>(&table_buffer[0]);
+                    for (DWORD row = 0; row < tcp6_table->dwNumEntries; ++row) {
+                        if (MIB_TCP_STATE_TIME_WAIT == tcp6_table->table[row].State &&
+                            (test_port == (tcp6_table->table[row].dwLocalPort & 0xffff) || test_port == (tcp6_table->table[row].dwRemotePort & 0xffff))) {
+                            ++time_wait_count;
+                        }
+                    }
+                } else {
+                    PrintErrorIfFailed(L"GetTcp6Table", error);
+                }
+            }
+            catch (const std::exception& e) {
+                PrintException(e);
+            }
+            return time_wait_count;
+        }
+
         float GetStatusTimeStamp() throw()
         {
-            return static_cast<float>((ctl::ctTimer::snap_qpc_msec() - static_cast<long long>(Settings->StartTimeMilliseconds)) / 1000.0);
+            return static_cast<float>((ctl::ctTimer::snap_clock_msec() - static_cast<long long>(Settings->StartTimeMilliseconds)) / 1000.0);
         }
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -3182,6 +4372,8 @@ namespace ctsTraffic {
             Settings->HistoricTcpDetails.total_time.add(_in_stats.end_time.get() - _in_stats.start_time.get());
             Settings->HistoricTcpDetails.bytes_recv.add(_in_stats.bytes_recv.get());
             Settings->HistoricTcpDetails.bytes_sent.add(_in_stats.bytes_sent.get());
+            Settings->HistoricTcpDetails.messages.add(_in_stats.messages.get());
+            Settings->HistoricTcpDetails.send_blocked_usec.add(_in_stats.send_blocked_usec.get());
         }
         void UpdateGlobalStats(const ctsUdpStatistics& _in_stats) throw()
         {
@@ -3190,8 +4382,10 @@ namespace ctsTraffic {
             Settings->HistoricUdpDetails.dropped_frames.add(_in_stats.dropped_frames.get());
             Settings->HistoricUdpDetails.error_frames.add(_in_stats.error_frames.get());
             Settings->HistoricUdpDetails.duplicate_frames.add(_in_stats.duplicate_frames.get());
+            Settings->HistoricUdpDetails.reordered_frames.add(_in_stats.reordered_frames.get());
             Settings->HistoricUdpDetails.retry_attempts.add(_in_stats.retry_attempts.get());
             Settings->HistoricUdpDetails.successful_frames.add(_in_stats.successful_frames.get());
+            Settings->HistoricUdpDetails.round_trip_usec.merge(_in_stats.round_trip_usec);
         }
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -3239,6 +4433,22 @@ namespace ctsTraffic {
             setting_string.append(L"\n");
 
             setting_string.append(ctString::format_string(L"\tIO function: %s\n", IoFunctionName));
+            if (Settings->Options & OptionType::HANDLE_INLINE_IOCP && ProtocolType::TCP == Settings->Protocol) {
+                setting_string.append(ctString::format_string(L"\t\tInlineCompletions: %lu\n", static_cast<unsigned long>(Settings->InlineCompletions)));
+            }
+            switch (Settings->IoScheduler) {
+                case IoSchedulerType::FifoScheduler:
+                    setting_string.append(L"\t\tIoScheduler: FIFO <IO reposted in completion order>\n");
+                    break;
+                case IoSchedulerType::RoundRobinScheduler:
+                    setting_string.append(L"\t\tIoScheduler: Round-Robin\n");
+                    break;
+                case IoSchedulerType::DeficitRoundRobinScheduler:
+                    setting_string.append(L"\t\tIoScheduler: Deficit Round-Robin <charged by bytes transferred>\n");
+                    break;
+                case IoSchedulerType::NoScheduler:
+                    break;
+            }
 
             setting_string.append(L"\tIoPattern: ");
             switch (Settings->IoPattern) {
@@ -3252,21 +4462,106 @@ namespace ctsTraffic {
                     setting_string.append(L"PushPull <TCP client/server alternate send/recv>\n");
                     setting_string.append(ctString::format_string(L"\t\tPushBytes: %lu\n", static_cast<unsigned long>(Settings->PushBytes)));
                     setting_string.append(ctString::format_string(L"\t\tPullBytes: %lu\n", static_cast<unsigned long>(Settings->PullBytes)));
+                    if (Settings->PushPullPipeline > 0) {
+                        setting_string.append(ctString::format_string(L"\t\tPushPullPipeline: %lu\n", static_cast<unsigned long>(Settings->PushPullPipeline)));
+                    }
                     break;
                 case IoPatternType::Duplex:
                     setting_string.append(L"Duplex <TCP client/server both sending and receiving>\n");
                     break;
                 case IoPatternType::MediaStream:
                     setting_string.append(L"MediaStream <UDP controlled stream from server to client>\n");
+                    break;
+                case IoPatternType::Datagram:
+                    setting_string.append(L"Datagram <UDP sequenced datagrams from server to client>\n");
+                    break;
+                case IoPatternType::Echo:
+                    setting_string.append(L"Echo <UDP probes from client to server, echoed back to the client>\n");
+                    break;
+                case IoPatternType::Message:
+                    setting_string.append(L"Message <TCP client sends length-prefixed messages/server reassembles them>\n");
+                    if (0 == message_size_high) {
+                        setting_string.append(ctString::format_string(L"\t\tMessageSize: %lu\n", message_size_low));
+                    } else {
+                        setting_string.append(ctString::format_string(L"\t\tMessageSize: [%lu, %lu]\n", message_size_low, message_size_high));
+                    }
             }
 
             setting_string.append(
                 ctString::format_string(
                     L"\tLevel of verification: %s\n",
-                    Settings->ShouldVerifyBuffers ? L"Connections & Data" : L"Connections"));
+                    Settings->ShouldVerifyBuffers ? L"Connections & Data" :
+                    Settings->ShouldVerifyChecksum ? L"Connections & CRC32C Checksum" : L"Connections"));
+            if (Settings->VerifyThreads > 0) {
+                setting_string.append(ctString::format_string(L"\t\tVerifyThreads: %lu\n", static_cast<unsigned long>(Settings->VerifyThreads)));
+            }
 
             setting_string.append(ctString::format_string(L"\tPort: %u\n", Settings->Port));
 
+            if (ProtocolType::TCP == Settings->Protocol) {
+                switch (Settings->Teardown) {
+                    case TeardownType::GracefulTeardown:
+                        setting_string.append(L"\tTeardown: Graceful <both sides send their FIN once their transfer completes>\n");
+                        break;
+                    case TeardownType::ClientTeardown:
+                        setting_string.append(L"\tTeardown: Client <the client sends the first FIN>\n");
+                        break;
+                    case TeardownType::ServerTeardown:
+                        setting_string.append(L"\tTeardown: Server <the server sends the first FIN>\n");
+                        break;
+                    case TeardownType::AbortiveTeardown:
+                        setting_string.append(L"\tTeardown: RST <the server sends the first FIN, the client closes with an RST>\n");
+                        break;
+                }
+            }
+
+            if (!Settings->CongestionControls.empty()) {
+                setting_string.append(L"\tCongestionControl:");
+                for (const auto& congestion_control : Settings->CongestionControls) {
+                    setting_string.append(
+                        ctString::format_string(
+                            L" %s (weight %lu)",
+                            (CongestionControlType::LedbatCongestionControl == congestion_control.algorithm) ? L"ledbat" : L"default",
+                            congestion_control.weight));
+                }
+                setting_string.append(L"\n");
+            }
+
+            if (!Settings->TrafficClasses.empty()) {
+                setting_string.append(L"\tDscp:");
+                for (const auto& traffic_class : Settings->TrafficClasses) {
+                    setting_string.append(
+                        ctString::format_string(
+                            L" %lu (weight %lu)",
+                            traffic_class.dscp,
+                            traffic_class.weight));
+                }
+                setting_string.append(L"\n");
+            }
+
+            if (Settings->NetCounters != NetCounterType::NoNetCounters) {
+                setting_string.append(
+                    (NetCounterType::PhysicalInterfaces == Settings->NetCounters) ?
+                    L"\tNetCounters: hardware interface and stack counters are listed with each status update\n" :
+                    L"\tNetCounters: interface and stack counters are listed with each status update\n");
+            }
+
+            if (Settings->OutlierCount > 0) {
+                setting_string.append(
+                    ctString::format_string(
+                        L"\tOutliers: the %lu %s connections are listed with each status update\n",
+                        static_cast<unsigned long>(Settings->OutlierCount),
+                        (OutlierRankType::LongestIdle == Settings->OutlierRank) ? L"longest idle" : L"lowest throughput"));
+            }
+
+            if (Settings->TimeLimit > 0) {
+                setting_string.append(
+                    ctString::format_string(
+                        L"\tTimeLimit: %lu ms, after which in-flight connections are given %lu ms to complete before being aborted\n",
+                        static_cast<unsigned long>(Settings->TimeLimit),
+                        static_cast<unsigned long>(Settings->TimeLimitDrain)));
+            }
+
             if (0 == buffersize_high) {
                 setting_string.append(
                     ctString::format_string(
@@ -3291,7 +4586,35 @@ namespace ctsTraffic {
                         transfer_low, transfer_high));
             }
 
-            if (ProtocolType::UDP == Settings->Protocol) {
+            if (IoPatternType::Datagram == Settings->IoPattern || IoPatternType::Echo == Settings->IoPattern) {
+                if (0 == datagram_settings.DatagramSizeHigh) {
+                    setting_string.append(
+                        ctString::format_string(
+                            L"\t\tUDP DatagramSize: %lu bytes\n",
+                            static_cast<unsigned long>(datagram_settings.DatagramSizeLow)));
+                } else {
+                    setting_string.append(
+                        ctString::format_string(
+                            L"\t\tUDP DatagramSize: [%lu, %lu] bytes\n",
+                            static_cast<unsigned long>(datagram_settings.DatagramSizeLow),
+                            static_cast<unsigned long>(datagram_settings.DatagramSizeHigh)));
+                }
+                if (0 == datagram_settings.PacketsPerSecond && IoPatternType::Echo == Settings->IoPattern) {
+                    setting_string.append(L"\t\tUDP PacketRate: one probe at a time\n");
+                } else if (0 == datagram_settings.PacketsPerSecond) {
+                    setting_string.append(L"\t\tUDP PacketRate: unlimited\n");
+                } else {
+                    setting_string.append(
+                        ctString::format_string(
+                            L"\t\tUDP PacketRate: %lu packets per second\n",
+                            static_cast<unsigned long>(datagram_settings.PacketsPerSecond)));
+                }
+                setting_string.append(
+                    ctString::format_string(
+                        L"\t\tUDP PacketCount: %lu datagrams\n",
+                        static_cast<unsigned long>(datagram_settings.PacketCount)));
+
+            } else if (ProtocolType::UDP == Settings->Protocol) {
                 setting_string.append(
                     ctString::format_string(
                         L"\t\tUDP Stream BitsPerSecond: %lld bits per second\n",
@@ -3330,6 +4653,26 @@ namespace ctsTraffic {
                         ratelimit_low, ratelimit_high));
                 }
             }
+            if (ProtocolType::TCP == Settings->Protocol && recv_ratelimit_low > 0) {
+                if (0 == recv_ratelimit_high) {
+                    setting_string.append(
+                        ctString::format_string(
+                        L"\tReceiving throughput rate limited down to %lld bytes/second\n",
+                        recv_ratelimit_low));
+                } else {
+                    setting_string.append(
+                        ctString::format_string(
+                        L"\tReceiving throughput rate limited down to a range of [%lld, %lld] bytes/second\n",
+                        recv_ratelimit_low, recv_ratelimit_high));
+                }
+            }
+            if (ProtocolType::TCP == Settings->Protocol && Settings->RecvStallInterval > 0) {
+                setting_string.append(
+                    ctString::format_string(
+                    L"\tReceiving stalls for %lu ms every %lu ms\n",
+                    static_cast<unsigned long>(Settings->RecvStallTime),
+                    static_cast<unsigned long>(Settings->RecvStallInterval)));
+            }
 
             if (netAdapterAddresses != nullptr) {
                 setting_string.append(
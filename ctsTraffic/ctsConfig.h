@@ -28,6 +28,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctTimer.hpp>
 #include <ctSockaddr.hpp>
 #include <ctLocks.hpp>
+#include <ctHistogram.hpp>
 
 //
 // ** NOTE ** cannot include any local project cts headers - to avoid circular references
@@ -151,6 +152,52 @@ namespace ctsTraffic {
         ctsMemoryGuard<long long> successful_connections;
         ctsMemoryGuard<long long> connection_errors;
         ctsMemoryGuard<long long> protocol_errors;
+        // connections still transferring data when -TimeLimit expired which were aborted
+        // - tracked apart from connection_errors since their transfers were only partially complete
+        ctsMemoryGuard<long long> aborted_connections;
+        // only recorded by ctsAcceptEx:
+        // - the times a listener was left with no AcceptEx posted, so connections waited in the listen backlog
+        // - the time from AcceptEx completing until the connection was handed to a ctsSocket
+        ctsMemoryGuard<long long> accept_overflows;
+        ctl::ctHistogram accept_latency_usec;
+        // only recorded by ctsConnectEx and ctsSimpleConnect:
+        // - the time from issuing the connect until it completed (SYN to established for TCP)
+        // - failed connects tallied by the most common reasons, all other errors counted together
+        ctl::ctHistogram connect_latency_usec;
+        ctsMemoryGuard<long long> connect_refused;
+        ctsMemoryGuard<long long> connect_timed_out;
+        ctsMemoryGuard<long long> connect_unreachable;
+        ctsMemoryGuard<long long> connect_no_ports;
+        ctsMemoryGuard<long long> connect_other_errors;
+
+        void record_connect(long long _connect_start_usec, int _error) throw()
+        {
+            switch (_error) {
+                case NO_ERROR:
+                    connect_latency_usec.add(ctl::ctTimer::snap_clock_usec() - _connect_start_usec);
+                    break;
+                case WSAECONNREFUSED:
+                    connect_refused.increment();
+                    break;
+                case WSAETIMEDOUT:
+                    connect_timed_out.increment();
+                    break;
+                case WSAENETUNREACH:
+                case WSAEHOSTUNREACH:
+                case WSAENETDOWN:
+                    connect_unreachable.increment();
+                    break;
+                case WSAEADDRINUSE:
+                case WSAEADDRNOTAVAIL:
+                case WSAENOBUFS:
+                    // exhausted the ephemeral port range (or the 4-tuples to the target)
+                    connect_no_ports.increment();
+                    break;
+                default:
+                    connect_other_errors.increment();
+                    break;
+            }
+        }
     };
     struct ctsConnectionStatistics {
     private:
@@ -166,7 +213,7 @@ namespace ctsTraffic {
         ctsMemoryGuard<long long> connection_error_count;
         ctsMemoryGuard<long long> protocol_error_count;
 
-        ctsConnectionStatistics(long long _start_time = ctl::ctTimer::snap_qpc_msec()) throw() :
+        ctsConnectionStatistics(long long _start_time = ctl::ctTimer::snap_clock_msec()) throw() :
             start_time(_start_time),
             end_time(0LL),
             active_connection_count(0LL),
@@ -196,7 +243,7 @@ namespace ctsTraffic {
         //
         ctsConnectionStatistics snap_view(bool _clear_settings) throw()
         {
-            long long current_time = ctl::ctTimer::snap_qpc_msec();
+            long long current_time = ctl::ctTimer::snap_clock_msec();
             long long prior_time_read = (_clear_settings) ?
                 this->start_time.set_prior_value(current_time) :
                 this->start_time.get_prior_value();
@@ -220,7 +267,9 @@ namespace ctsTraffic {
         ctsMemoryGuard<long long> retry_attempts;
         ctsMemoryGuard<long long> dropped_frames;
         ctsMemoryGuard<long long> duplicate_frames;
+        ctsMemoryGuard<long long> reordered_frames;
         ctsMemoryGuard<long long> error_frames;
+        ctl::ctHistogram round_trip_usec;
     };
 
     struct ctsUdpStatistics {
@@ -235,9 +284,12 @@ namespace ctsTraffic {
         ctsMemoryGuard<long long> retry_attempts;
         ctsMemoryGuard<long long> dropped_frames;
         ctsMemoryGuard<long long> duplicate_frames;
+        ctsMemoryGuard<long long> reordered_frames;
         ctsMemoryGuard<long long> error_frames;
+        // only recorded by the Echo pattern
+        ctl::ctHistogram round_trip_usec;
 
-        ctsUdpStatistics(long long _start_time = ctl::ctTimer::snap_qpc_msec()) throw() :
+        ctsUdpStatistics(long long _start_time = ctl::ctTimer::snap_clock_msec()) throw() :
             start_time(_start_time),
             end_time(0LL),
             bits_received(0LL),
@@ -245,7 +297,9 @@ namespace ctsTraffic {
             retry_attempts(0LL),
             dropped_frames(0LL),
             duplicate_frames(0LL),
-            error_frames(0LL)
+            reordered_frames(0LL),
+            error_frames(0LL),
+            round_trip_usec()
         {
         }
         //
@@ -259,7 +313,9 @@ namespace ctsTraffic {
             retry_attempts(_in.retry_attempts),
             dropped_frames(_in.dropped_frames),
             duplicate_frames(_in.duplicate_frames),
-            error_frames(_in.error_frames)
+            reordered_frames(_in.reordered_frames),
+            error_frames(_in.error_frames),
+            round_trip_usec(_in.round_trip_usec)
         {
         }
         //
@@ -267,7 +323,7 @@ namespace ctsTraffic {
         //
         ctsUdpStatistics snap_view(bool _clear_settings) throw()
         {
-            long long current_time = ctl::ctTimer::snap_qpc_msec();
+            long long current_time = ctl::ctTimer::snap_clock_msec();
             long long prior_time_read = (_clear_settings) ?
                 this->start_time.set_prior_value(current_time) :
                 this->start_time.get_prior_value();
@@ -281,7 +337,8 @@ namespace ctsTraffic {
                 return_stats.retry_attempts.set(this->retry_attempts.snap_value_difference());
                 return_stats.dropped_frames.set(this->dropped_frames.snap_value_difference());
                 return_stats.duplicate_frames.set(this->duplicate_frames.snap_value_difference());
-                return_stats.error_frames.set(this->duplicate_frames.snap_value_difference());
+                return_stats.reordered_frames.set(this->reordered_frames.snap_value_difference());
+                return_stats.error_frames.set(this->error_frames.snap_value_difference());
 
             } else {
                 return_stats.bits_received.set(this->bits_received.read_value_difference());
@@ -289,8 +346,10 @@ namespace ctsTraffic {
                 return_stats.retry_attempts.set(this->retry_attempts.read_value_difference());
                 return_stats.dropped_frames.set(this->dropped_frames.read_value_difference());
                 return_stats.duplicate_frames.set(this->duplicate_frames.read_value_difference());
-                return_stats.error_frames.set(this->duplicate_frames.read_value_difference());
+                return_stats.reordered_frames.set(this->reordered_frames.read_value_difference());
+                return_stats.error_frames.set(this->error_frames.read_value_difference());
             }
+            this->round_trip_usec.snap(return_stats.round_trip_usec, _clear_settings);
 
             return return_stats;
         }
@@ -300,6 +359,20 @@ namespace ctsTraffic {
         ctsMemoryGuard<long long> total_time;
         ctsMemoryGuard<long long> bytes_sent;
         ctsMemoryGuard<long long> bytes_recv;
+        ctsMemoryGuard<long long> messages;
+        ctsMemoryGuard<long long> send_blocked_usec;
+        //
+        // each histogram is ~3KB: values are recorded here as they are measured, not held per connection
+        //
+        // only recorded by the pipelined PushPull pattern
+        ctl::ctHistogram segment_latency_usec;
+        // only recorded by the Message pattern
+        // - reassembly is the time from receiving a message's first byte until its last (not a one-way latency)
+        ctl::ctHistogram message_reassembly_usec;
+        // the bytes in sends posted and not yet completed, as each send is posted
+        ctl::ctHistogram send_backlog_bytes;
+        // the time from this side completing its transfer until the peer's FIN (or RST) arrived
+        ctl::ctHistogram teardown_latency_usec;
     };
 
     struct ctsTcpStatistics {
@@ -311,12 +384,22 @@ namespace ctsTraffic {
         ctsMemoryGuard<long long> end_time;
         ctsMemoryGuard<long long> bytes_sent;
         ctsMemoryGuard<long long> bytes_recv;
+        // only recorded by the Message pattern
+        ctsMemoryGuard<long long> messages;
+        // the time this connection had sends posted which had not yet completed
+        ctsMemoryGuard<long long> send_blocked_usec;
+        //
+        // latency and backlog histograms are not held per connection
+        // - they are recorded directly into Settings->HistoricTcpDetails (and the connection's traffic class)
+        //
 
-        ctsTcpStatistics(long long _current_time = ctl::ctTimer::snap_qpc_msec()) throw() :
+        ctsTcpStatistics(long long _current_time = ctl::ctTimer::snap_clock_msec()) throw() :
             start_time(_current_time),
             end_time(0LL),
             bytes_sent(0LL),
-            bytes_recv(0LL)
+            bytes_recv(0LL),
+            messages(0LL),
+            send_blocked_usec(0LL)
         {
         }
         //
@@ -326,7 +409,9 @@ namespace ctsTraffic {
             start_time(_in.start_time),
             end_time(_in.end_time),
             bytes_sent(_in.bytes_sent),
-            bytes_recv(_in.bytes_recv)
+            bytes_recv(_in.bytes_recv),
+            messages(_in.messages),
+            send_blocked_usec(_in.send_blocked_usec)
         {
         }
         //
@@ -335,7 +420,7 @@ namespace ctsTraffic {
         //
         ctsTcpStatistics snap_view(bool _clear_settings) throw()
         {
-            long long current_time = ctl::ctTimer::snap_qpc_msec();
+            long long current_time = ctl::ctTimer::snap_clock_msec();
             long long prior_time_read = (_clear_settings) ?
                 this->start_time.set_prior_value(current_time) :
                 this->start_time.get_prior_value();
@@ -346,10 +431,14 @@ namespace ctsTraffic {
             if (_clear_settings) {
                 return_stats.bytes_sent.set(this->bytes_sent.snap_value_difference());
                 return_stats.bytes_recv.set(this->bytes_recv.snap_value_difference());
+                return_stats.messages.set(this->messages.snap_value_difference());
+                return_stats.send_blocked_usec.set(this->send_blocked_usec.snap_value_difference());
 
             } else {
                 return_stats.bytes_sent.set(this->bytes_sent.read_value_difference());
                 return_stats.bytes_recv.set(this->bytes_recv.read_value_difference());
+                return_stats.messages.set(this->messages.read_value_difference());
+                return_stats.send_blocked_usec.set(this->send_blocked_usec.read_value_difference());
             }
 
             return return_stats;
@@ -376,7 +465,56 @@ namespace ctsTraffic {
             Pull,
             PushPull,
             Duplex,
-            MediaStream
+            MediaStream,
+            Datagram,
+            Echo,
+            Message
+        };
+
+        // -Teardown: which side sends the first FIN once the transfer completes
+        // - the side deferring its FIN sends it (or an RST) only when it closes its socket
+        enum TeardownType {
+            GracefulTeardown,   // both sides send their FIN as soon as their transfer completes
+            ClientTeardown,     // the client sends the first FIN: the client is left in TIME_WAIT
+            ServerTeardown,     // the server sends the first FIN: the server is left in TIME_WAIT
+            AbortiveTeardown    // the server sends the first FIN: the client then closes with an RST
+        };
+
+        // -IoScheduler: the order in which connections issue their next IO as prior IO completes
+        enum IoSchedulerType {
+            NoScheduler,                // each completion reposts IO for its own connection
+            FifoScheduler,              // as with no scheduler, but tracking fairness across connections
+            RoundRobinScheduler,        // connections waiting to issue IO take turns
+            DeficitRoundRobinScheduler  // connections take turns weighted by the bytes each last transferred
+        };
+
+        // -OutliersBy: how the active connections listed with each status update are ranked
+        enum OutlierRankType {
+            LowestThroughput,   // the fewest bytes/sec since the connection started IO
+            LongestIdle         // the longest time since the connection last completed an IO
+        };
+
+        // -CongestionControl: the congestion control applied to TCP connections, weighted across connections
+        enum CongestionControlType {
+            DefaultCongestionControl,   // the provider of the transport template the connection matches (e.g. CUBIC)
+            LedbatCongestionControl     // LEDBAT++: a background transfer which yields to other traffic
+        };
+        struct CongestionControlWeight {
+            CongestionControlType algorithm;
+            unsigned long weight;
+        };
+
+        // -Dscp: the DSCP value marked on connections' outgoing packets, weighted across connections
+        struct TrafficClassWeight {
+            unsigned long dscp;
+            unsigned long weight;
+        };
+
+        // -NetCounters: which interfaces' counters are listed with each status update
+        enum NetCounterType {
+            NoNetCounters,
+            PhysicalInterfaces, // only hardware interfaces
+            AllInterfaces       // including virtual, tunnel and loopback interfaces
         };
 
         enum OptionType {
@@ -488,6 +626,7 @@ namespace ctsTraffic {
 
         // Get* functions
         ctsSignedLongLong   GetTcpBytesPerSecond() throw();
+        ctsSignedLongLong   GetTcpRecvBytesPerSecond() throw();
         ctsUnsignedLong     GetMaxBufferSize() throw();
         ctsUnsignedLong     GetBufferSize() throw();
         ctsUnsignedLongLong GetTransferSize() throw();
@@ -497,6 +636,13 @@ namespace ctsTraffic {
         int  GetListenBacklog() throw();
         bool IsListening() throw();
 
+        // -Teardown: whether this side shuts down its sends as soon as its transfer completes
+        bool InitiatesTeardown() throw();
+        // -Teardown:rst : whether this side closes a completed connection with an RST
+        bool AbortsOnClose() throw();
+        // the number of TCP connections currently in TIME_WAIT on the port being tested
+        unsigned long GetTimeWaitCount() throw();
+
         void UpdateGlobalStats(const ctsTcpStatistics&) throw();
         void UpdateGlobalStats(const ctsUdpStatistics&) throw();
 
@@ -592,6 +738,32 @@ namespace ctsTraffic {
         };
         const MediaStreamSettings& GetMediaStream();
 
+        // for the Datagram and Echo patterns
+        struct DatagramSettings {
+            DatagramSettings() throw()
+            : DatagramSizeLow(0UL),
+              DatagramSizeHigh(0UL),
+              PacketsPerSecond(0UL),
+              PacketCount(0UL)
+            {
+            }
+
+            // set by ctsConfig from command-line arguments
+            // - DatagramSizeHigh is zero when a single size was specified
+            ctsUnsignedLong DatagramSizeLow;
+            ctsUnsignedLong DatagramSizeHigh;
+            // zero indicates the server should send as fast as it can
+            // - with the Echo pattern, zero indicates the client sends the next probe once the prior probe is echoed
+            ctsUnsignedLong PacketsPerSecond;
+            ctsUnsignedLong PacketCount;
+        };
+        const DatagramSettings& GetDatagram();
+        // returns the size of the next datagram to send (randomized when a range was specified)
+        ctsUnsignedLong GetDatagramSize() throw();
+        // returns the payload size of the next framed message to send with -Pattern:Message
+        // (randomized when a range was specified)
+        ctsUnsignedLong GetMessageSize() throw();
+
         struct ctsConfigSettings {
             ctsConfigSettings()
             : CtrlCHandle(NULL),
@@ -600,8 +772,13 @@ namespace ctsTraffic {
               ConnectFunction(nullptr),
               AcceptFunction(nullptr),
               IoFunction(nullptr),
+              AbortFunction(nullptr),
               Protocol(ProtocolType::NoProtocolSet),
               IoPattern(IoPatternType::NoIOSet),
+              Teardown(TeardownType::GracefulTeardown),
+              IoScheduler(IoSchedulerType::NoScheduler),
+              OutlierRank(OutlierRankType::LowestThroughput),
+              NetCounters(NetCounterType::NoNetCounters),
               Options(OptionType::NoOptionSet),
               SocketFlags(0UL),
               Port(0),
@@ -613,6 +790,8 @@ namespace ctsTraffic {
               ListenAddresses(),
               TargetAddresses(),
               BindAddresses(),
+              CongestionControls(),
+              TrafficClasses(),
               ConnectionStatusDetails(),
               TcpStatusDetails(),
               UdpStatusDetails(),
@@ -623,13 +802,22 @@ namespace ctsTraffic {
               TcpBytesPerSecondPeriod(100LL),
               StartTimeMilliseconds(0LL),
               TimeLimit(0UL),
+              TimeLimitDrain(0UL),
               PrePostRecvs(0UL),
+              PrePostSends(0UL),
+              VerifyThreads(0UL),
+              InlineCompletions(0UL),
+              RecvStallInterval(0UL),
+              RecvStallTime(0UL),
+              OutlierCount(0UL),
               UseSharedBuffer(false),
               ShouldVerifyBuffers(false),
+              ShouldVerifyChecksum(false),
               LocalPortLow(0),
               LocalPortHigh(0),
               PushBytes(0UL),
-              PullBytes(0UL)
+              PullBytes(0UL),
+              PushPullPipeline(0UL)
             {
             }
 
@@ -640,9 +828,15 @@ namespace ctsTraffic {
             ctsSocketFunction ConnectFunction;
             ctsSocketFunction AcceptFunction;
             ctsSocketFunction IoFunction;
+            // optional: completes a connection aborted at the time limit when closing its socket will not
+            ctsSocketFunction AbortFunction;
 
             ProtocolType  Protocol;
             IoPatternType IoPattern;
+            TeardownType  Teardown;
+            IoSchedulerType IoScheduler;
+            OutlierRankType OutlierRank;
+            NetCounterType NetCounters;
             OptionType    Options;
 
             DWORD SocketFlags;
@@ -657,11 +851,17 @@ namespace ctsTraffic {
             std::vector<ctl::ctSockaddr> ListenAddresses;
             std::vector<ctl::ctSockaddr> TargetAddresses;
             std::vector<ctl::ctSockaddr> BindAddresses;
+            // empty unless -CongestionControl was specified
+            std::vector<CongestionControlWeight> CongestionControls;
+            // empty unless -Dscp was specified
+            std::vector<TrafficClassWeight> TrafficClasses;
 
             // stats used only for status updates
             ctsConnectionStatistics ConnectionStatusDetails;
             ctsTcpStatistics TcpStatusDetails;
             ctsUdpStatistics UdpStatusDetails;
+            // the Message pattern's reassembly times since the last status update
+            ctl::ctHistogram MessageReassemblyStatusDetails;
             // stats for global tracking
             ctsConnectionHistoritcStatistics HistoricConnectionDetails;
             ctsTcpHistoricStatistics HistoricTcpDetails;
@@ -674,16 +874,26 @@ namespace ctsTraffic {
             ctsSignedLongLong StartTimeMilliseconds;
 
             ctsUnsignedLong TimeLimit;
+            // milliseconds in-flight connections are given to complete once TimeLimit expires
+            ctsUnsignedLong TimeLimitDrain;
             ctsUnsignedLong PrePostRecvs;
+            ctsUnsignedLong PrePostSends;
+            ctsUnsignedLong VerifyThreads;
+            ctsUnsignedLong InlineCompletions;
+            ctsUnsignedLong RecvStallInterval;
+            ctsUnsignedLong RecvStallTime;
+            ctsUnsignedLong OutlierCount;
 
             bool UseSharedBuffer;
             bool ShouldVerifyBuffers;
+            bool ShouldVerifyChecksum;
 
             USHORT LocalPortLow;
             USHORT LocalPortHigh;
 
             ctsUnsignedLong PushBytes;
             ctsUnsignedLong PullBytes;
+            ctsUnsignedLong PushPullPipeline;
 
             // non-copyable
             ctsConfigSettings(const ctsConfigSettings&) = delete;
@@ -0,0 +1,214 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// parent header
+#include "ctsCongestionControl.h"
+// additional c++ headers
+#include <vector>
+// additional os headers
+#include <mstcpip.h>
+// additional ctl headers
+#include <ctException.hpp>
+#include <ctLocks.hpp>
+#include <ctWeightedSchedule.hpp>
+
+///
+/// SIO_PRIORITY_HINT and SIO_TCP_INFO are only declared by the Windows 10 SDK
+/// - this project targets Win7 and doesn't require that SDK: declare them here when they aren't,
+///   and IsSupported() verifies at runtime that the OS implements them
+///
+#ifndef SIO_PRIORITY_HINT
+typedef enum {
+    SocketPriorityHintVeryLow = 0,
+    SocketPriorityHintLow,
+    SocketPriorityHintNormal,
+    SocketMaximumPriorityHintType
+} SOCKET_PRIORITY_HINT;
+#define SIO_PRIORITY_HINT _WSAIOW(IOC_VENDOR, 24)
+#endif
+
+#ifndef SIO_TCP_INFO
+typedef struct {
+    int State;
+    ULONG Mss;
+    ULONG64 ConnectionTimeMs;
+    BOOLEAN TimestampsEnabled;
+    ULONG RttUs;
+    ULONG MinRttUs;
+    ULONG BytesInFlight;
+    ULONG Cwnd;
+    ULONG SndWnd;
+    ULONG RcvWnd;
+    ULONG RcvBuf;
+    ULONG64 BytesOut;
+    ULONG64 BytesIn;
+    ULONG BytesReordered;
+    ULONG BytesRetrans;
+    ULONG FastRetrans;
+    ULONG DupAcksIn;
+    ULONG TimeoutEpisodes;
+    UCHAR SynRetrans;
+} TCP_INFO_v0;
+#define SIO_TCP_INFO _WSAIORW(IOC_VENDOR, 39)
+#endif
+
+
+namespace ctsTraffic {
+    namespace ctsCongestionControl {
+
+        using namespace ctl;
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Singleton values used as the actual implementation for every connection
+        ///
+        /// publicly exposed callers invoke ::InitOnceExecuteOnce(&InitImpl, InitOncectsCongestionControlImpl, NULL, NULL);
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        static ctWeightedSchedule* AssignmentSchedule = nullptr;
+        // one per entry in Settings->CongestionControls
+        static ctsCongestionControlStatistics* AlgorithmStatistics = nullptr;
+
+        static INIT_ONCE InitImpl = INIT_ONCE_STATIC_INIT;
+        static
+        BOOL CALLBACK InitOncectsCongestionControlImpl(PINIT_ONCE, PVOID, PVOID *)
+        {
+            const std::vector<ctsConfig::CongestionControlWeight>& algorithms = ctsConfig::Settings->CongestionControls;
+            AlgorithmStatistics = new ctsCongestionControlStatistics[algorithms.empty() ? 1 : algorithms.size()];
+
+            if (!algorithms.empty()) {
+                std::vector<unsigned long> weights;
+                for (const auto& algorithm : algorithms) {
+                    weights.push_back(algorithm.weight);
+                }
+                AssignmentSchedule = new ctWeightedSchedule(weights);
+            }
+            return TRUE;
+        }
+        static
+        void ctsCongestionControlInitOnce() throw()
+        {
+            if (!::InitOnceExecuteOnce(&InitImpl, InitOncectsCongestionControlImpl, nullptr, nullptr)) {
+                ctAlwaysFatalCondition(L"ctsCongestionControl could not be instantiated");
+            }
+        }
+
+        bool IsSupported() throw()
+        {
+            // SIO_PRIORITY_HINT shipped in a later Windows 10 release than SIO_TCP_INFO:
+            // an OS which accepts it on a new TCP socket supports both
+            SOCKET probe_socket = ::WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+            if (INVALID_SOCKET == probe_socket) {
+                probe_socket = ::WSASocket(AF_INET6, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+                if (INVALID_SOCKET == probe_socket) {
+                    return false;
+                }
+            }
+
+            SOCKET_PRIORITY_HINT priority_hint = SocketPriorityHintNormal;
+            DWORD bytes_returned = 0;
+            const int error = ::WSAIoctl(
+                probe_socket,
+                SIO_PRIORITY_HINT,
+                &priority_hint, static_cast<DWORD>(sizeof(priority_hint)),
+                nullptr, 0,
+                &bytes_returned,
+                nullptr,
+                nullptr);
+            ::closesocket(probe_socket);
+            return (0 == error);
+        }
+
+        unsigned long AssignAlgorithm() throw()
+        {
+            if (ctsConfig::Settings->CongestionControls.empty()) {
+                return 0;
+            }
+            ctsCongestionControlInitOnce();
+
+            return AssignmentSchedule->next();
+        }
+
+        int ApplyAlgorithm(SOCKET _socket, unsigned long _index) throw()
+        {
+            if (ctsConfig::Settings->CongestionControls.empty()) {
+                return NO_ERROR;
+            }
+
+            switch (ctsConfig::Settings->CongestionControls[_index].algorithm) {
+                case ctsConfig::CongestionControlType::LedbatCongestionControl: {
+                    SOCKET_PRIORITY_HINT priority_hint = SocketPriorityHintVeryLow;
+                    DWORD bytes_returned = 0;
+                    if (0 != ::WSAIoctl(
+                        _socket,
+                        SIO_PRIORITY_HINT,
+                        &priority_hint, static_cast<DWORD>(sizeof(priority_hint)),
+                        nullptr, 0,
+                        &bytes_returned,
+                        nullptr,
+                        nullptr)) {
+                        int gle = ::WSAGetLastError();
+                        ctsConfig::PrintErrorIfFailed(L"WSAIoctl(SIO_PRIORITY_HINT)", gle);
+                        return gle;
+                    }
+                    break;
+                }
+
+                default:
+                    // the connection is left with the provider of the transport template it matches
+                    break;
+            }
+            return NO_ERROR;
+        }
+
+        void RecordConnection(SOCKET _socket, unsigned long _index) throw()
+        {
+            if (ctsConfig::Settings->CongestionControls.empty()) {
+                return;
+            }
+            ctsCongestionControlInitOnce();
+
+            DWORD tcp_info_version = 0;
+            TCP_INFO_v0 tcp_info;
+            DWORD bytes_returned = 0;
+            if (0 != ::WSAIoctl(
+                _socket,
+                SIO_TCP_INFO,
+                &tcp_info_version, static_cast<DWORD>(sizeof(tcp_info_version)),
+                &tcp_info, static_cast<DWORD>(sizeof(tcp_info)),
+                &bytes_returned,
+                nullptr,
+                nullptr)) {
+                ctsConfig::PrintErrorIfFailed(L"WSAIoctl(SIO_TCP_INFO)", ::WSAGetLastError());
+                return;
+            }
+
+            ctsCongestionControlStatistics& statistics = AlgorithmStatistics[_index];
+            const long long bytes_transferred = static_cast<long long>(tcp_info.BytesIn + tcp_info.BytesOut);
+            statistics.connections.increment();
+            statistics.bytes_transferred.add(bytes_transferred);
+            statistics.bytes_retransmitted.add(static_cast<long long>(tcp_info.BytesRetrans));
+            statistics.timeout_episodes.add(static_cast<long long>(tcp_info.TimeoutEpisodes));
+            if (tcp_info.ConnectionTimeMs > 0) {
+                statistics.bytes_per_second.add(bytes_transferred * 1000LL / static_cast<long long>(tcp_info.ConnectionTimeMs));
+            }
+            statistics.rtt_usec.add(static_cast<long long>(tcp_info.RttUs));
+        }
+
+        const ctsCongestionControlStatistics& GetStatistics(unsigned long _index) throw()
+        {
+            ctsCongestionControlInitOnce();
+            return AlgorithmStatistics[_index];
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// os headers
+#include <winsock2.h>
+#include <windows.h>
+// ctl headers
+#include <ctHistogram.hpp>
+// project headers
+#include "ctsConfig.h"
+
+
+namespace ctsTraffic {
+
+    ///
+    /// ctsCongestionControl assigns each TCP connection one of the -CongestionControl algorithms
+    /// - connections are assigned in proportion to each algorithm's weight, interleaved across the connections being made
+    ///
+    /// Windows selects the congestion provider (CUBIC, DCTCP, ...) through the transport template a connection matches
+    /// - the only provider which can be chosen per socket is LEDBAT, through SIO_PRIORITY_HINT
+    ///
+    /// As each connection closes, its TCP_INFO (SIO_TCP_INFO) is recorded against its algorithm
+    ///
+    namespace ctsCongestionControl {
+
+        struct ctsCongestionControlStatistics {
+            ctsMemoryGuard<long long> connections;
+            ctsMemoryGuard<long long> bytes_transferred;
+            ctsMemoryGuard<long long> bytes_retransmitted;
+            ctsMemoryGuard<long long> timeout_episodes;
+            ctl::ctHistogram bytes_per_second;
+            ctl::ctHistogram rtt_usec;
+        };
+
+        ///
+        /// Returns true if this OS implements the ioctls -CongestionControl relies upon (SIO_PRIORITY_HINT and SIO_TCP_INFO)
+        /// - both require Windows 10: the option is rejected where they are unavailable
+        ///
+        bool IsSupported() throw();
+
+        ///
+        /// Returns the index into Settings->CongestionControls for the next connection
+        /// - a no-op returning 0 unless -CongestionControl was specified
+        ///
+        unsigned long AssignAlgorithm() throw();
+
+        ///
+        /// Applies the algorithm at _index to the socket
+        /// - returns the Win32 error if the algorithm could not be applied
+        ///
+        int ApplyAlgorithm(SOCKET _socket, unsigned long _index) throw();
+
+        ///
+        /// Records the TCP_INFO of a connection about to be closed against the algorithm at _index
+        ///
+        void RecordConnection(SOCKET _socket, unsigned long _index) throw();
+
+        ///
+        /// Returns the statistics recorded for the algorithm at _index
+        ///
+        const ctsCongestionControlStatistics& GetStatistics(unsigned long _index) throw();
+    }
+}
@@ -0,0 +1,167 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// parent header
+#include "ctsConnectionOutliers.h"
+// additional c++ headers
+#include <algorithm>
+// additional ctl headers
+#include <ctException.hpp>
+#include <ctLocks.hpp>
+// additional project headers
+#include "ctsConfig.h"
+
+
+namespace ctsTraffic {
+    namespace ctsConnectionOutliers {
+
+        using namespace ctl;
+
+        struct TrackedConnection {
+            std::weak_ptr<ctsIOPattern> pattern;
+            ctSockaddr local_address;
+            ctSockaddr remote_address;
+        };
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Singleton values used as the actual implementation for every connection
+        ///
+        /// publicly exposed callers invoke ::InitOnceExecuteOnce(&InitImpl, InitOncectsConnectionOutliersImpl, NULL, NULL);
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        static CRITICAL_SECTION TrackedLock;
+        // guarded by TrackedLock
+        static std::vector<TrackedConnection>* TrackedConnections = nullptr;
+        // guarded by TrackedLock : where the next snap resumes sampling TrackedConnections
+        static size_t SampleCursor = 0;
+        // the most connections a single snap will examine
+        // - bounds how long TrackedLock is held, and how many pattern locks each status update takes
+        static const size_t MaximumSampledConnections = 1024;
+
+        static INIT_ONCE InitImpl = INIT_ONCE_STATIC_INIT;
+        static
+        BOOL CALLBACK InitOncectsConnectionOutliersImpl(PINIT_ONCE, PVOID, PVOID *)
+        {
+            if (!::InitializeCriticalSectionEx(&TrackedLock, 4000, 0)) {
+                ctAlwaysFatalCondition(L"InitializeCriticalSectionEx failed: %u", ::GetLastError());
+            }
+            TrackedConnections = new std::vector<TrackedConnection>;
+            return TRUE;
+        }
+        static
+        void ctsConnectionOutliersInitOnce() throw()
+        {
+            if (!::InitOnceExecuteOnce(&InitImpl, InitOncectsConnectionOutliersImpl, nullptr, nullptr)) {
+                ctAlwaysFatalCondition(L"ctsConnectionOutliers could not be instantiated");
+            }
+        }
+
+        ///
+        /// orders outliers so that the fastest connection is 'greatest'
+        /// - the heap's front is then the fastest of the N slowest, the first to be replaced
+        ///
+        static
+        bool IsSlower(const ctsConnectionOutlier& _lhs, const ctsConnectionOutlier& _rhs) throw()
+        {
+            if (ctsConfig::OutlierRankType::LongestIdle == ctsConfig::Settings->OutlierRank) {
+                return _lhs.progress.idle_msec > _rhs.progress.idle_msec;
+            }
+            return _lhs.progress.bytes_per_second < _rhs.progress.bytes_per_second;
+        }
+
+        void Track(const std::shared_ptr<ctsIOPattern>& _pattern, const ctSockaddr& _local_address, const ctSockaddr& _remote_address) throw()
+        {
+            if (0 == ctsConfig::Settings->OutlierCount) {
+                return;
+            }
+            ctsConnectionOutliersInitOnce();
+
+            TrackedConnection tracked_connection;
+            tracked_connection.pattern = _pattern;
+            tracked_connection.local_address = _local_address;
+            tracked_connection.remote_address = _remote_address;
+
+            ctAutoReleaseCriticalSection auto_lock(&TrackedLock);
+            try {
+                TrackedConnections->push_back(tracked_connection);
+            }
+            catch (const std::bad_alloc&) {
+                // the connection just won't be considered an outlier
+            }
+        }
+
+        std::vector<ctsConnectionOutlier> SnapOutliers()
+        {
+            ctsConnectionOutliersInitOnce();
+
+            const size_t outlier_count = ctsConfig::Settings->OutlierCount;
+            std::vector<ctsConnectionOutlier> outliers;
+            outliers.reserve(outlier_count + 1);
+            std::vector<TrackedConnection> sampled_connections;
+            sampled_connections.reserve(MaximumSampledConnections);
+
+            //
+            // copy out the next window of tracked connections under TrackedLock
+            // - the window never wraps, so no connection is sampled twice in one snap
+            // - connections whose pattern has been released are dropped as they are reached
+            //
+            {
+                ctAutoReleaseCriticalSection auto_lock(&TrackedLock);
+                if (SampleCursor >= TrackedConnections->size()) {
+                    SampleCursor = 0;
+                }
+                size_t sample_end = min(TrackedConnections->size(), SampleCursor + MaximumSampledConnections);
+                while (SampleCursor < sample_end) {
+                    TrackedConnection& tracked_connection = (*TrackedConnections)[SampleCursor];
+                    if (tracked_connection.pattern.expired()) {
+                        // the last entry takes its place, and is examined next
+                        tracked_connection = TrackedConnections->back();
+                        TrackedConnections->pop_back();
+                        sample_end = min(sample_end, TrackedConnections->size());
+                        continue;
+                    }
+                    sampled_connections.push_back(tracked_connection);
+                    ++SampleCursor;
+                }
+            }
+
+            // each pattern's lock is taken without holding TrackedLock
+            for (const auto& tracked_connection : sampled_connections) {
+                ctsConnectionOutlier outlier;
+                auto pattern(tracked_connection.pattern.lock());
+                if (!pattern || !pattern->snap_progress(outlier.progress)) {
+                    // the connection has finished its transfer
+                    continue;
+                }
+
+                // bounded heap : only keep the N slowest seen so far
+                if (outliers.size() == outlier_count) {
+                    if (!IsSlower(outlier, outliers.front())) {
+                        continue;
+                    }
+                    std::pop_heap(outliers.begin(), outliers.end(), IsSlower);
+                    outliers.pop_back();
+                }
+                outlier.local_address = tracked_connection.local_address;
+                outlier.remote_address = tracked_connection.remote_address;
+                outliers.push_back(outlier);
+                std::push_heap(outliers.begin(), outliers.end(), IsSlower);
+            }
+
+            // sort_heap orders from the slowest to the fastest
+            std::sort_heap(outliers.begin(), outliers.end(), IsSlower);
+            return outliers;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <memory>
+#include <vector>
+// os headers
+#include <windows.h>
+// ctl headers
+#include <ctSockaddr.hpp>
+// project headers
+#include "ctsIOPattern.h"
+
+
+namespace ctsTraffic {
+
+    ///
+    /// ctsConnectionOutliers tracks the active TCP connections to list the -Outliers slowest with each status update
+    /// - connections are added as their IO pattern is constructed, and dropped once their pattern has ended
+    ///
+    /// The tracked list only holds weak references to each pattern with its addresses
+    /// - each snap selects the N slowest with a bounded heap, without touching ctsSocketState or ctsSocket
+    /// - each snap examines at most 1024 connections, resuming where the prior snap stopped
+    ///   with more connections than that, the outliers listed are the slowest of that sample
+    ///
+    namespace ctsConnectionOutliers {
+
+        struct ctsConnectionOutlier {
+            ctl::ctSockaddr local_address;
+            ctl::ctSockaddr remote_address;
+            ctsIOPatternProgress progress;
+        };
+
+        ///
+        /// Adds a connection to be tracked - a no-op unless -Outliers was specified
+        ///
+        void Track(const std::shared_ptr<ctsIOPattern>& _pattern, const ctl::ctSockaddr& _local_address, const ctl::ctSockaddr& _remote_address) throw();
+
+        ///
+        /// Returns the -Outliers slowest connections (as ranked by -OutliersBy), slowest first
+        /// - can throw std::bad_alloc
+        ///
+        std::vector<ctsConnectionOutlier> SnapOutliers();
+    }
+}
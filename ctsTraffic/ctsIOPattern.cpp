@@ -21,9 +21,12 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctScopeGuard.hpp>
 #include <ctLocks.hpp>
 #include <ctTimer.hpp>
+#include <ctCrc32c.hpp>
+#include <ctRandom.hpp>
 // additional local headers
 #include "ctsMediaStreamProtocol.hpp"
 #include "ctsPrintStatus.hpp"
+#include "ctsSocket.h"
 
 
 namespace ctsTraffic {
@@ -67,8 +70,23 @@ namespace ctsTraffic {
     static RIO_BUFFERID s_SharedBufferId = RIO_INVALID_BUFFERID;
 
     static const unsigned long s_FinBufferSize = 16; // just 16 bytes for the FIN
+    static const unsigned long s_ChecksumTrailerSize = sizeof(unsigned long); // the CRC32C with -verify:checksum
     static char s_FinBuffer[s_FinBufferSize];
 
+    /// The verifier threads used with -VerifyThreads
+    /// - a private threadpool so verification never competes with the IO threadpool for threads
+    /// - each connection allocates s_VerifyPipelineDepth extra recv buffers, which bounds the number of
+    ///   buffers any one connection can have queued for verification
+    static PTP_POOL s_VerifyThreadPool = nullptr;
+    static TP_CALLBACK_ENVIRON s_VerifyCallbackEnvironment;
+    static const unsigned long s_VerifyPipelineDepth = 2;
+
+    struct ctsVerifyRequest {
+        shared_ptr<ctsIOPattern> pattern;
+        ctsIOTask task;
+        unsigned long transferred_bytes;
+    };
+
     static
     BOOL CALLBACK InitOnceIOPatternCallback(PINIT_ONCE, PVOID, PVOID *) throw()
     {
@@ -108,6 +126,15 @@ namespace ctsTraffic {
             write_size_remaining -= bytes_to_write;
         }
 
+        // with checksum verification the payload doesn't need to be a known pattern
+        // - sending random bytes so the receiver's checksum is meaningful for an arbitrary payload
+        if (ctsConfig::Settings->ShouldVerifyChecksum) {
+            ctRandomTwister random;
+            for (size_t offset = 0; offset < s_SharedBufferSize; ++offset) {
+                s_ProtectedSharedBuffer[offset] = static_cast<char>(random.uniform_int<int>(0, 0xff));
+            }
+        }
+
         // now prevent anyone from writing to our s_ProtectedSharedBuffer
         DWORD old_setting;
         if (!::VirtualProtect(s_ProtectedSharedBuffer, s_SharedBufferSize, PAGE_READONLY, &old_setting)) {
@@ -119,13 +146,61 @@ namespace ctsTraffic {
             if (RIO_INVALID_BUFFERID == s_SharedBufferId) {
                 ctl::ctAlwaysFatalCondition(L"RIORegisterBuffer failed: %d", ::WSAGetLastError());
             }
+
+        } else if (ctsConfig::Settings->ShouldVerifyBuffers && ctsConfig::Settings->VerifyThreads > 0) {
+            // RIO can only register a single recv buffer per connection, so verification stays inline with RIO
+            s_VerifyThreadPool = ::CreateThreadpool(nullptr);
+            if (!s_VerifyThreadPool) {
+                ctl::ctAlwaysFatalCondition(L"CreateThreadpool failed: %u", ::GetLastError());
+            }
+            ::SetThreadpoolThreadMaximum(s_VerifyThreadPool, ctsConfig::Settings->VerifyThreads);
+            if (!::SetThreadpoolThreadMinimum(s_VerifyThreadPool, ctsConfig::Settings->VerifyThreads)) {
+                ctl::ctAlwaysFatalCondition(L"SetThreadpoolThreadMinimum failed: %u", ::GetLastError());
+            }
+            ::InitializeThreadpoolEnvironment(&s_VerifyCallbackEnvironment);
+            ::SetThreadpoolCallbackPool(&s_VerifyCallbackEnvironment, s_VerifyThreadPool);
         }
 
         return TRUE;
     }
 
+    ///
+    /// The concrete type of every pattern: binds initiate_io and complete_io to the Pattern's
+    /// - next_task and completed_task, specialized on its protocol and the buffer verification policy
+    ///
+    template <typename Pattern, bool Tcp, ctsIOPattern::VerifyPolicy Verify>
+    class ctsIOPattern::ctsIOPatternPolicy final : public Pattern {
+    public:
+        ctsIOPatternPolicy() : Pattern()
+        {
+        }
+
+        ctsIOTask initiate_io() throw() override
+        {
+            return this->template initiate_io_policy<Pattern, Verify>(*this);
+        }
+
+        ctsIOPatternStatus complete_io(const ctsIOTask& _task, unsigned long _bytes_transferred, unsigned long _status_code) throw() override
+        {
+            return this->template complete_io_policy<Pattern, Tcp, Verify>(*this, _task, _bytes_transferred, _status_code);
+        }
+    };
+
+    template <typename Pattern, bool Tcp>
+    shared_ptr<ctsIOPattern> ctsIOPattern::MakeIOPatternPolicy()
+    {
+        if (ctsConfig::Settings->ShouldVerifyBuffers) {
+            return make_shared<ctsIOPatternPolicy<Pattern, Tcp, VerifyBuffers>>();
+        } else if (ctsConfig::Settings->ShouldVerifyChecksum) {
+            return make_shared<ctsIOPatternPolicy<Pattern, Tcp, VerifyChecksum>>();
+        } else {
+            return make_shared<ctsIOPatternPolicy<Pattern, Tcp, VerifyNone>>();
+        }
+    }
+
     ///
     /// Helper factory to build known patterns
+    /// - the protocol is fixed by the pattern: only TCP patterns are specialized with Tcp == true
     /// - can throw ctl::ctException on a Win32 error
     /// - can throw exception on allocation failure
     ///
@@ -133,26 +208,50 @@ namespace ctsTraffic {
     {
         switch (ctsConfig::Settings->IoPattern) {
             case ctsConfig::IoPatternType::Pull:
-                return make_shared<ctsIOPatternPull>();
+                return MakeIOPatternPolicy<ctsIOPatternPull, true>();
                 break;
 
             case ctsConfig::IoPatternType::Push:
-                return make_shared<ctsIOPatternPush>();
+                return MakeIOPatternPolicy<ctsIOPatternPush, true>();
                 break;
 
             case ctsConfig::IoPatternType::PushPull:
-                return make_shared<ctsIOPatternPushPull>();
+                if (ctsConfig::Settings->PushPullPipeline > 0) {
+                    return MakeIOPatternPolicy<ctsIOPatternPushPullPipelined, true>();
+                } else {
+                    return MakeIOPatternPolicy<ctsIOPatternPushPull, true>();
+                }
                 break;
 
             case ctsConfig::IoPatternType::Duplex:
-                return make_shared<ctsIOPatternDuplex>();
+                return MakeIOPatternPolicy<ctsIOPatternDuplex, true>();
+                break;
+
+            case ctsConfig::IoPatternType::Message:
+                return MakeIOPatternPolicy<ctsIOPatternMessage, true>();
                 break;
 
             case ctsConfig::IoPatternType::MediaStream:
                 if (ctsConfig::IsListening()) {
-                    return make_shared<ctsIOPatternMediaStreamServer>();
+                    return MakeIOPatternPolicy<ctsIOPatternMediaStreamServer, false>();
+                } else {
+                    return MakeIOPatternPolicy<ctsIOPatternMediaStreamClient, false>();
+                }
+                break;
+
+            case ctsConfig::IoPatternType::Datagram:
+                if (ctsConfig::IsListening()) {
+                    return MakeIOPatternPolicy<ctsIOPatternDatagramServer, false>();
+                } else {
+                    return MakeIOPatternPolicy<ctsIOPatternDatagramClient, false>();
+                }
+                break;
+
+            case ctsConfig::IoPatternType::Echo:
+                if (ctsConfig::IsListening()) {
+                    return MakeIOPatternPolicy<ctsIOPatternEchoServer, false>();
                 } else {
-                    return make_shared<ctsIOPatternMediaStreamClient>();
+                    return MakeIOPatternPolicy<ctsIOPatternEchoClient, false>();
                 }
                 break;
 
@@ -183,23 +282,61 @@ namespace ctsTraffic {
         protocol_status(MoreData),
         bytes_sending_per_quantum(0LL),
         bytes_sending_this_quantum(0LL),
-        quantum_start_time_ms(ctl::ctTimer::snap_qpc_msec())
+        quantum_start_time_ms(ctl::ctTimer::snap_clock_msec()),
+        verify_socket(),
+        verify_pending(0UL),
+        verify_offloaded(false),
+        verify_failed(false),
+        verify_waiting(false),
+        checksum_send(0UL),
+        checksum_recv(0UL),
+        checksum_send_trailer(0UL),
+        checksum_recv_trailer(0UL),
+        policy_tcp(ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol),
+        policy_verify_buffers(ctsConfig::Settings->ShouldVerifyBuffers),
+        policy_shared_buffer(ctsConfig::Settings->UseSharedBuffer),
+        policy_rate_limit_period(ctsConfig::Settings->TcpBytesPerSecondPeriod),
+        policy_recv_bytes_per_second(ctsConfig::GetTcpRecvBytesPerSecond()),
+        policy_recv_stall_interval_ms(ctsConfig::Settings->RecvStallInterval),
+        policy_recv_stall_time_ms(ctsConfig::Settings->RecvStallTime),
+        recv_drained_usec(0LL),
+        recv_next_stall_usec(0LL),
+        tcp_stats(nullptr),
+        send_backlog_bytes(0),
+        send_backlog_count(0UL),
+        send_blocked_start_usec(0LL),
+        policy_fin_accepts_reset(ctsConfig::TeardownType::AbortiveTeardown == ctsConfig::Settings->Teardown && ctsConfig::IsListening()),
+        teardown_start_usec(0LL),
+        policy_track_progress(ctsConfig::Settings->OutlierCount > 0),
+        last_io_usec(ctl::ctTimer::snap_clock_usec()),
+        traffic_class(ctsTrafficClass::AssignClass())
     {
         // this init-once call is no-fail
         (void) ::InitOnceExecuteOnce(&s_IOPatternInitializer, InitOnceIOPatternCallback, NULL, NULL);
 
+        // only patterns receiving into their own buffers can hand those buffers to the verifier threads
+        // - the extra buffers allow recvs to keep being posted while prior buffers are being verified
+        if (s_VerifyThreadPool != nullptr && _recv_count > 0 && !policy_shared_buffer) {
+            verify_offloaded = true;
+            _recv_count += s_VerifyPipelineDepth;
+        }
+
         if (!::InitializeCriticalSectionEx(&cs, 4000, 0)) {
             throw ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsIOPattern", false);
         }
         ctlScopeGuard(deleteCSonError, { ::DeleteCriticalSection(&cs); });
 
         // (bytes/sec) * (1 sec/1000 ms) * (x ms/Quantum) == (bytes/quantum)
-        bytes_sending_per_quantum = ctsConfig::GetTcpBytesPerSecond() * static_cast<unsigned long long>(ctsConfig::Settings->TcpBytesPerSecondPeriod) / 1000LL;
+        // - zero only without -RateLimit: ctsConfig rejects a rate which rounds down to 0 bytes per quantum
+        bytes_sending_per_quantum = ctsConfig::GetTcpBytesPerSecond() * static_cast<unsigned long long>(policy_rate_limit_period) / 1000LL;
+        if (policy_recv_stall_interval_ms > 0) {
+            recv_next_stall_usec = ctl::ctTimer::snap_clock_usec() + policy_recv_stall_interval_ms * 1000LL;
+        }
 
         // if TCP, will always need a recv buffer for the final ACK 
-        if ((_recv_count > 0) || (ctsConfig::Settings->Protocol == ctsConfig::ProtocolType::TCP)) {
+        if ((_recv_count > 0) || policy_tcp) {
             // recv will only use the same shared buffer when the user specified to do so on the cmdline
-            if (ctsConfig::Settings->UseSharedBuffer) {
+            if (policy_shared_buffer) {
                 if (_recv_count > 0) {
                     for (unsigned long free_list = 0; free_list < _recv_count; ++free_list) {
                         recv_buffer_free_list.push_back(s_WriteableSharedBuffer);
@@ -256,15 +393,33 @@ namespace ctsTraffic {
         this->callback = _callback;
     }
 
-    ctsIOTask ctsIOPattern::initiate_io() throw()
+    void ctsIOPattern::register_socket(const std::weak_ptr<ctsSocket>& _socket)
+    {
+        ctAutoReleaseCriticalSection local_cs(&cs);
+        this->verify_socket = _socket;
+    }
+
+    template <typename Pattern, ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPattern::initiate_io_policy(Pattern& _pattern) throw()
     {
         ctAutoReleaseCriticalSection local_cs(&this->cs);
         ctsIOTask return_task;
-        if (this->protocol_status == MoreData) {
+        if (this->verify_must_wait()) {
+            // no IO until a verifier thread returns a buffer: VerifyCallback resumes IO on this socket
+            // - holding an IO count so the socket isn't completed while waiting (released by ctsSocket::resume_io)
+            if (!this->verify_waiting) {
+                auto shared_socket(this->verify_socket.lock());
+                if (shared_socket) {
+                    shared_socket->increment_io();
+                    this->verify_waiting = true;
+                }
+            }
+
+        } else if (this->protocol_status == MoreData) {
             // only ask the concrete class for the next task if we don't have IO outstanding
             // that *might* satisfy all the bytes we need to transfer
             if ((this->current_transfer + static_cast<ULONGLONG>(this->inflight_bytes)) < this->max_transfer) {
-                return_task = this->next_task();
+                return_task = _pattern.template next_task<Verify>();
             } else {
                 // else, return the default task telling the caller that no more IO needs to be started yet
             }
@@ -298,6 +453,10 @@ namespace ctsTraffic {
     {
         ctAutoReleaseCriticalSection local_cs(&this->cs);
 
+        if (this->verify_failed) {
+            return ErrorDataDidNotMatchBitPattern;
+        }
+
         if ((this->current_transfer > 0) && (this->current_transfer != this->max_transfer)) {
             if (this->current_transfer < this->max_transfer) {
                 return ErrorNotAllDataTransferred;
@@ -313,9 +472,28 @@ namespace ctsTraffic {
     }
 
 
+    bool ctsIOPattern::snap_progress(ctsIOPatternProgress& _progress) throw()
+    {
+        ctAutoReleaseCriticalSection local_cs(&this->cs);
+
+        if (nullptr == this->tcp_stats || this->tcp_stats->end_time.get() != 0LL) {
+            return false;
+        }
+
+        const long long current_usec = ctl::ctTimer::snap_clock_usec();
+        const long long elapsed_msec = ctl::ctTimer::snap_clock_msec() - this->tcp_stats->start_time.get();
+        const long long bytes_transferred = this->tcp_stats->bytes_sent.get() + this->tcp_stats->bytes_recv.get();
+        _progress.bytes_per_second = (elapsed_msec > 0LL) ? bytes_transferred * 1000LL / elapsed_msec : 0LL;
+        _progress.idle_msec = (current_usec - this->last_io_usec) / 1000LL;
+        _progress.protocol_status = this->protocol_status;
+        _progress.send_blocked = this->send_backlog_count > 0;
+        return true;
+    }
+
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// complete_io
+    /// complete_io_policy
     ///
     /// updates its internal counters to prepare for the next IO request
     /// - the fact that complete_io was called assumes that the IO was successful
@@ -327,15 +505,71 @@ namespace ctsTraffic {
     /// Returns the current status of the IO operation on this socket
     ///
     ////////////////////////////////////////////////////////////////////////////////////////////////////
-    ctsIOPatternStatus ctsIOPattern::complete_io(const ctsIOTask& _original_task, unsigned long _current_transfer, unsigned long _status_code) throw()
+    // the template arguments are tested instead of the settings: those tests are constant by design
+#pragma warning(push)
+#pragma warning(disable: 4127)
+    template <typename Pattern, bool Tcp, ctsIOPattern::VerifyPolicy Verify>
+    ctsIOPatternStatus ctsIOPattern::complete_io_policy(Pattern& _pattern, const ctsIOTask& _original_task, unsigned long _current_transfer, unsigned long _status_code) throw()
     {
         ctAutoReleaseCriticalSection local_cs(&this->cs);
+
+        if (this->policy_track_progress) {
+            this->last_io_usec = ctl::ctTimer::snap_clock_usec();
+        }
+        // recv buffers handed to the verifier threads are added back to the free list once verified
+        const bool offload_recv_verify =
+            this->verify_offloaded &&
+            !this->verify_failed &&
+            _original_task.tracked_io &&
+            ctsIOTask::IOAction::Recv == _original_task.ioAction &&
+            NO_ERROR == _status_code &&
+            _current_transfer > 0 &&
+            this->protocol_status != ctsIOPatternStatus::VerifyFIN;
+
         if (ctsIOTask::IOAction::Recv == _original_task.ioAction &&
-            !_original_task.unlisted_buffer) {
+            !_original_task.unlisted_buffer &&
+            !offload_recv_verify) {
             // only add it back if was one of our listed recv buffers that the base class contains
             this->recv_buffer_free_list.push_back(_original_task.buffer);
         }
+        //
+        // the sender is no longer blocked on its peer once all pended sends have completed
+        //
+        if (ctsIOTask::IOAction::Send == _original_task.ioAction && _original_task.tracked_io && this->tcp_stats != nullptr) {
+            this->send_backlog_bytes -= _original_task.buffer_length;
+            --this->send_backlog_count;
+            if (0 == this->send_backlog_count) {
+                this->tcp_stats->send_blocked_usec.add(ctl::ctTimer::snap_clock_usec() - this->send_blocked_start_usec);
+            }
+        }
+        //
+        // a slow consumer must drain the bytes just received before it will repost its recv
+        //
+        if (ctsIOTask::IOAction::Recv == _original_task.ioAction && NO_ERROR == _status_code && this->policy_recv_bytes_per_second > 0) {
+            const long long current_time_usec = ctl::ctTimer::snap_clock_usec();
+            if (this->recv_drained_usec < current_time_usec) {
+                this->recv_drained_usec = current_time_usec;
+            }
+            this->recv_drained_usec += static_cast<long long>(_current_transfer) * 1000000LL / this->policy_recv_bytes_per_second;
+        }
+        //
+        // a verifier thread found a corrupt buffer from a prior recv
+        //
+        if (this->verify_failed && !ctsIOPatternError(this->protocol_status)) {
+            this->protocol_status = ctsIOPatternStatus::ErrorDataDidNotMatchBitPattern;
+            return this->protocol_status;
+        }
 
+        //
+        // with -Teardown:rst the client resets the connection once it has received our FIN
+        // - that reset completes the FIN recv, so treat it as the zero-byte FIN
+        //
+        if (this->policy_fin_accepts_reset &&
+            ctsIOPatternStatus::VerifyFIN == this->protocol_status &&
+            (WSAECONNRESET == _status_code || ERROR_NETNAME_DELETED == _status_code)) {
+            _status_code = NO_ERROR;
+            _current_transfer = 0;
+        }
         //
         // if we have completed the transfer, than any pended IO that was unblocked is not an IO Error
         //
@@ -365,7 +599,7 @@ namespace ctsTraffic {
                     L"ctsIOPattern::complete_io() : ctsIOTask (%p) returned more bytes (%u) than were posted (%u)\n",
                     &_original_task, _current_transfer, _original_task.buffer_length);
 
-                if (ctsConfig::Settings->ShouldVerifyBuffers) {
+                if (VerifyBuffers == Verify) {
                     switch (_original_task.ioAction) {
                         case ctsIOTask::IOAction::Recv:
                             ctl::ctFatalCondition(
@@ -373,25 +607,38 @@ namespace ctsTraffic {
                                 L"ctsIOPattern::complete_io() : ctsIOTask (%p) expected_pattern_offset (%u) does not match the current pattern_offset (%llu)",
                                 &_original_task, _original_task.expected_pattern_offset, static_cast<ULONGLONG>(this->recv_pattern_offset));
 
-                            if (!this->verify_buffer(_original_task, _current_transfer)) {
-                                // immediately exit with failure if the buffer is corrupt
-                                return ctsIOPatternStatus::ErrorDataDidNotMatchBitPattern;
+                            if (offload_recv_verify && this->offload_verify(_original_task, _current_transfer)) {
+                                // the verifier threads now own this buffer - failures are reported on a later completion
+                            } else {
+                                if (offload_recv_verify) {
+                                    // failed to queue the buffer: verify inline and return it to the free list
+                                    this->recv_buffer_free_list.push_back(_original_task.buffer);
+                                }
+                                if (!this->verify_buffer(_original_task, _current_transfer)) {
+                                    // immediately exit with failure if the buffer is corrupt
+                                    return ctsIOPatternStatus::ErrorDataDidNotMatchBitPattern;
+                                }
                             }
                             this->recv_pattern_offset += _current_transfer;
                             this->recv_pattern_offset %= BufferPatternSize;
                             break;
 
                         case ctsIOTask::IOAction::Send:
-                            this->send_pattern_offset += _current_transfer;
-                            this->send_pattern_offset %= BufferPatternSize;
+                            // the send pattern offset was already advanced when the task was created
                             break;
                     }
+
+                } else if (VerifyChecksum == Verify && ctsIOTask::IOAction::Recv == _original_task.ioAction) {
+                    if (!this->verify_checksum(_original_task, _current_transfer)) {
+                        // immediately exit with failure if the checksum didn't match
+                        return ctsIOPatternStatus::ErrorChecksumDidNotMatch;
+                    }
                 }
             }
             //
             // notify the derived interface task completed (when not a FIN)
             //
-            ctsIOPatternStatus derived_status = this->completed_task(_original_task, _current_transfer);
+            ctsIOPatternStatus derived_status = _pattern.completed_task(_original_task, _current_transfer);
             if (!ctsIOPatternContinueIO(derived_status)) {
                 // exit immediately without further validation if the derived object determines a failure
                 this->protocol_status = derived_status;
@@ -408,7 +655,7 @@ namespace ctsTraffic {
         //
         // Verify Post-condition TCP protocol contracts haven't been violated
         //
-        if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol) {
+        if (Tcp) {
             if ((this->current_transfer + static_cast<ULONGLONG>(this->inflight_bytes)) < this->max_transfer) {
                 // still more data to transfer unless we have hit an error in an earlier IO
                 if (ctsIOPatternStatus::MoreData == this->protocol_status) {
@@ -427,12 +674,16 @@ namespace ctsTraffic {
                 switch (this->protocol_status) {
                     case ctsIOPatternStatus::MoreData:
                         this->protocol_status = ctsIOPatternStatus::RequestFIN;
+                        this->teardown_start_usec = ctl::ctTimer::snap_clock_usec();
                         break;
 
                     case ctsIOPatternStatus::VerifyFIN:
                         // should have received zero bytes for the final ACK : if we received more, it's a protocol error
                         if (0 == _current_transfer) {
                             this->protocol_status = ctsIOPatternStatus::CompletedTransfer;
+                            if (this->tcp_stats != nullptr) {
+                                ctsConfig::Settings->HistoricTcpDetails.teardown_latency_usec.add(ctl::ctTimer::snap_clock_usec() - this->teardown_start_usec);
+                            }
                         } else {
                             this->protocol_status = ctsIOPatternStatus::ErrorTooMuchDataTransferred;
                         }
@@ -460,9 +711,99 @@ namespace ctsTraffic {
                 // current_transfer + inflight_bytes is still less than max_transfer => keep asking for more data
             }
         }
+        //
+        // with buffers queued for verification, this thread doesn't wait on the verifier threads:
+        // - initiate_io starts no more IO while no recv buffer is free (bounding the pipeline)
+        //   and holds back the FIN until every received buffer has been verified
+        //
+        if (this->verify_failed && !ctsIOPatternError(this->protocol_status)) {
+            this->protocol_status = ctsIOPatternStatus::ErrorDataDidNotMatchBitPattern;
+        }
 
         return this->protocol_status;
     }
+#pragma warning(pop)
+
+    ///
+    /// Queues the completed recv buffer to the verifier threadpool
+    /// - holds a reference on this pattern until VerifyCallback has run
+    ///
+    bool ctsIOPattern::offload_verify(const ctsIOTask& _task, unsigned long _transferred_bytes) throw()
+    {
+        ctsVerifyRequest* request = nullptr;
+        try {
+            request = new ctsVerifyRequest;
+            request->pattern = this->shared_from_this();
+        }
+        catch (const exception& e) {
+            ctsConfig::PrintException(e);
+            delete request;
+            return false;
+        }
+        request->task = _task;
+        request->transferred_bytes = _transferred_bytes;
+
+        if (!::TrySubmitThreadpoolCallback(VerifyCallback, request, &s_VerifyCallbackEnvironment)) {
+            ctsConfig::PrintErrorIfFailed(L"TrySubmitThreadpoolCallback", ::GetLastError());
+            delete request;
+            return false;
+        }
+
+        ++this->verify_pending;
+        return true;
+    }
+
+    bool ctsIOPattern::verify_must_wait() const throw()
+    {
+        // a failed verification fails the connection on its next completion
+        if (0 == this->verify_pending || this->verify_failed) {
+            return false;
+        }
+        switch (this->protocol_status) {
+            case ctsIOPatternStatus::MoreData:
+                // the next task may need a recv buffer
+                return this->recv_buffer_free_list.empty();
+
+            case ctsIOPatternStatus::RequestFIN:
+                // the transfer is not complete until every received buffer has been verified
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    ///
+    /// Runs on the verifier threadpool: compares the buffer outside the pattern lock,
+    /// - then takes the lock only to return the buffer and record the result
+    /// - if IO was waiting on this buffer (or on the last verification before the FIN), resumes it
+    ///
+    void CALLBACK ctsIOPattern::VerifyCallback(PTP_CALLBACK_INSTANCE, PVOID _context) throw()
+    {
+        unique_ptr<ctsVerifyRequest> request(static_cast<ctsVerifyRequest*>(_context));
+        ctsIOPattern* pattern = request->pattern.get();
+
+        const bool verified = pattern->verify_buffer(request->task, request->transferred_bytes);
+
+        shared_ptr<ctsSocket> resume_socket;
+        {
+            ctAutoReleaseCriticalSection local_cs(&pattern->cs);
+            pattern->recv_buffer_free_list.push_back(request->task.buffer);
+            if (!verified) {
+                pattern->verify_failed = true;
+            }
+            --pattern->verify_pending;
+            if (pattern->verify_waiting && !pattern->verify_must_wait()) {
+                pattern->verify_waiting = false;
+                resume_socket = pattern->verify_socket.lock();
+            }
+        }
+
+        // not holding the pattern lock: the IO function calls back through initiate_io
+        if (resume_socket) {
+            resume_socket->resume_io();
+        }
+    }
 
     ctsUnsignedLongLong ctsIOPattern::get_total_transfer() const throw()
     {
@@ -474,25 +815,46 @@ namespace ctsTraffic {
         this->max_transfer = _new_total;
     }
 
+    template <ctsIOPattern::VerifyPolicy Verify>
     ctsIOTask ctsIOPattern::tracked_task(ctsIOTask::IOAction _action, unsigned long _max_transfer) throw()
     {
         ctAutoReleaseCriticalSection local_cs(&this->cs);
-        ctsIOTask return_task(this->new_task(_action, _max_transfer));
+        ctsIOTask return_task(this->new_task_policy<Verify>(_action, _max_transfer));
         return_task.tracked_io = true;
         this->inflight_bytes += return_task.buffer_length;
+        if (ctsIOTask::IOAction::Send == _action && this->tcp_stats != nullptr) {
+            if (0 == this->send_backlog_count) {
+                this->send_blocked_start_usec = ctl::ctTimer::snap_clock_usec();
+            }
+            ++this->send_backlog_count;
+            this->send_backlog_bytes += return_task.buffer_length;
+            ctsConfig::Settings->HistoricTcpDetails.send_backlog_bytes.add(static_cast<long long>(this->send_backlog_bytes));
+        }
+        // the send pattern offset advances as sends are created, not as they complete
+        // - with -PrePostSends, the next send must continue the pattern after all sends still in flight
+        // - always advanced: the peer can verify what this side sends even when this side does not verify
+        if (ctsIOTask::IOAction::Send == _action) {
+            this->send_pattern_offset += return_task.buffer_length;
+            this->send_pattern_offset %= BufferPatternSize;
+        }
         return return_task;
     }
 
+    template <ctsIOPattern::VerifyPolicy Verify>
     ctsIOTask ctsIOPattern::untracked_task(ctsIOTask::IOAction _action, unsigned long _max_transfer) throw()
     {
         ctAutoReleaseCriticalSection local_cs(&this->cs);
-        ctsIOTask return_task(this->new_task(_action, _max_transfer));
+        ctsIOTask return_task(this->new_task_policy<Verify>(_action, _max_transfer));
         return_task.tracked_io = false;
         return return_task;
     }
 
 
-    ctsIOTask ctsIOPattern::new_task(ctsIOTask::IOAction _action, unsigned long _max_transfer) throw()
+    // the template arguments are tested instead of the settings: those tests are constant by design
+#pragma warning(push)
+#pragma warning(disable: 4127)
+    template <ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPattern::new_task_policy(ctsIOTask::IOAction _action, unsigned long _max_transfer) throw()
     {
         //
         // need to know the # of bytes we have already transfered (or are in-flight)
@@ -536,6 +898,16 @@ namespace ctsTraffic {
             new_buffer_size = _max_transfer;
         }
         //
+        // third: with checksum verification the final bytes of the transfer are the CRC32C trailer
+        // - a send must not span both the payload and the trailer
+        //
+        const ULONGLONG checksum_payload_size = static_cast<ULONGLONG>(this->max_transfer) - s_ChecksumTrailerSize;
+        if (VerifyChecksum == Verify &&
+            ctsIOTask::IOAction::Send == _action &&
+            already_transferred < checksum_payload_size) {
+            new_buffer_size = min<ctsUnsignedLongLong>(new_buffer_size, checksum_payload_size - already_transferred);
+        }
+        //
         // guard against hitting a 32-bit overflow
         //
         ctl::ctFatalCondition(
@@ -552,20 +924,20 @@ namespace ctsTraffic {
             //
             // check to see if the send needs to be deferred into the future
             //
-            if (ctsConfig::GetTcpBytesPerSecond() > 0) {
-                auto current_time_ms(ctl::ctTimer::snap_qpc_msec());
+            if (this->bytes_sending_per_quantum > 0) {
+                auto current_time_ms(ctl::ctTimer::snap_clock_msec());
                 if (this->bytes_sending_this_quantum < this->bytes_sending_per_quantum) {
                     // adjust bytes_sending_this_quantum
                     this->bytes_sending_this_quantum += new_buffer_size;
 
                     // no need to adjust quantum_start_time_ms unless we skipped into a new quantum
                     // (meaning the previous quantum had not filled the max bytes for that quantum)
-                    if (current_time_ms >(this->quantum_start_time_ms + ctsConfig::Settings->TcpBytesPerSecondPeriod)) {
+                    if (current_time_ms >(this->quantum_start_time_ms + this->policy_rate_limit_period)) {
                         // current time shows it's now beyond this quantum timeframe
                         // - once we see how many quantums we have skipped forward, move our quantum start time to the quantum we are actually in
                         // - then adjust the number of bytes we are to send this quantum by how many quantum we just skipped
-                        auto quantums_skipped_since_last_send = (current_time_ms - this->quantum_start_time_ms) / ctsConfig::Settings->TcpBytesPerSecondPeriod;
-                        this->quantum_start_time_ms += quantums_skipped_since_last_send * ctsConfig::Settings->TcpBytesPerSecondPeriod;
+                        auto quantums_skipped_since_last_send = (current_time_ms - this->quantum_start_time_ms) / this->policy_rate_limit_period;
+                        this->quantum_start_time_ms += quantums_skipped_since_last_send * this->policy_rate_limit_period;
 
                         // we have to be careful making this adjustment since the remainingbytes this quantum could be very small
                         // - we only subtract out if the number of bytes skipped is >= bytes actually skipped
@@ -585,7 +957,7 @@ namespace ctsTraffic {
 
                     // ms_for_quantums_to_skip = the # of quantum beyond the current quantum that will be skipped
                     // - when we have already sent at least 1 additional quantum of bytes
-                    ctsUnsignedLongLong ms_for_quantums_to_skip = (quantum_ahead_to_schedule - 1) * ctsConfig::Settings->TcpBytesPerSecondPeriod;
+                    ctsUnsignedLongLong ms_for_quantums_to_skip = (quantum_ahead_to_schedule - 1) * this->policy_rate_limit_period;
 
                     // carry forward extra bytes from quantums that will be filled by the bytes we have already sent
                     // (including the current quantum)
@@ -596,14 +968,14 @@ namespace ctsTraffic {
                     // update the return task for when to schedule the send
                     // first, calculate the time to get to the end of this time quantum
                     // - only adjust if the current time isn't already outside this quantum
-                    if (current_time_ms < this->quantum_start_time_ms + ctsConfig::Settings->TcpBytesPerSecondPeriod) {
-                        return_task.time_offset_milliseconds = (this->quantum_start_time_ms + ctsConfig::Settings->TcpBytesPerSecondPeriod) - current_time_ms;
+                    if (current_time_ms < this->quantum_start_time_ms + this->policy_rate_limit_period) {
+                        return_task.time_offset_milliseconds = (this->quantum_start_time_ms + this->policy_rate_limit_period) - current_time_ms;
                     }
                     // then add in any quantum we need to skip
                     return_task.time_offset_milliseconds += ms_for_quantums_to_skip;
 
                     // finally, adjust quantum_start_time_ms to the next quantum which IO will complete
-                    this->quantum_start_time_ms += ms_for_quantums_to_skip + ctsConfig::Settings->TcpBytesPerSecondPeriod;
+                    this->quantum_start_time_ms += ms_for_quantums_to_skip + this->policy_rate_limit_period;
                 }
             } else {
                 return_task.time_offset_milliseconds = 0LL;
@@ -616,6 +988,24 @@ namespace ctsTraffic {
             return_task.buffer_offset = static_cast<unsigned long>(this->send_pattern_offset);
             return_task.expected_pattern_offset = 0; // The sender shouldn't be validating this
 
+            if (VerifyChecksum == Verify) {
+                if (already_transferred < checksum_payload_size) {
+                    // sends are created in stream order, so the checksum can be accumulated as tasks are created
+                    this->checksum_send = ctCrc32c::update(
+                        this->checksum_send,
+                        return_task.buffer + return_task.buffer_offset,
+                        return_task.buffer_length);
+                } else {
+                    // all payload has been sent: the remaining bytes come from the trailer
+                    if (already_transferred == checksum_payload_size) {
+                        this->checksum_send_trailer = this->checksum_send;
+                    }
+                    return_task.buffer = reinterpret_cast<char*>(&this->checksum_send_trailer);
+                    return_task.buffer_offset = static_cast<unsigned long>(already_transferred - checksum_payload_size);
+                    return_task.rio_bufferid = RIO_INVALID_BUFFERID;
+                }
+            }
+
             ctl::ctFatalCondition(
                 this->send_pattern_offset >= BufferPatternSize,
                 L"pattern_offset being too large means we might walk off the end of our shared buffer");
@@ -635,6 +1025,20 @@ namespace ctsTraffic {
             return_task.buffer_length = static_cast<unsigned long>(new_buffer_size);
             return_task.buffer_offset = 0; // always recv to the beginning of the buffer
             return_task.expected_pattern_offset = static_cast<unsigned long>(this->recv_pattern_offset);
+            //
+            // check to see if the recv needs to be deferred into the future
+            // - until prior bytes have drained, and past any stall episode which has started
+            //
+            if (this->policy_recv_bytes_per_second > 0 || this->policy_recv_stall_interval_ms > 0) {
+                const long long current_time_usec = ctl::ctTimer::snap_clock_usec();
+                long long recv_time_usec = max(current_time_usec, this->recv_drained_usec);
+                if (this->policy_recv_stall_interval_ms > 0 && recv_time_usec >= this->recv_next_stall_usec) {
+                    recv_time_usec = max(recv_time_usec, this->recv_next_stall_usec + this->policy_recv_stall_time_ms * 1000LL);
+                    this->recv_next_stall_usec = recv_time_usec + this->policy_recv_stall_interval_ms * 1000LL;
+                }
+                // rounding up: a recv is never posted before its time
+                return_task.time_offset_milliseconds = (recv_time_usec - current_time_usec + 999LL) / 1000LL;
+            }
 
             ctl::ctFatalCondition(
                 this->recv_pattern_offset >= BufferPatternSize,
@@ -646,10 +1050,12 @@ namespace ctsTraffic {
 
         return return_task;
     }
+#pragma warning(pop)
+
     bool ctsIOPattern::verify_buffer(const ctsIOTask& _original_task, unsigned long _transferred_bytes)
     {
         // only doing deep verification if the user asked us to
-        if (!ctsConfig::Settings->ShouldVerifyBuffers) {
+        if (!this->policy_verify_buffers) {
             return true;
         }
         //
@@ -677,6 +1083,53 @@ namespace ctsTraffic {
         return (length_matched == _transferred_bytes);
     }
 
+    bool ctsIOPattern::verify_checksum(const ctsIOTask& _original_task, unsigned long _transferred_bytes)
+    {
+        //
+        // TCP recvs complete in order (-PrePostRecvs must be 1 with -verify:checksum)
+        // - and only one side is receiving data, so current_transfer is the stream offset of this buffer
+        //
+        const ULONGLONG total_transfer = static_cast<ULONGLONG>(this->max_transfer);
+        const ULONGLONG payload_size = total_transfer - s_ChecksumTrailerSize;
+        ULONGLONG stream_offset = static_cast<ULONGLONG>(this->current_transfer);
+        const char* buffer = _original_task.buffer + _original_task.buffer_offset;
+        unsigned long bytes_remaining = _transferred_bytes;
+
+        if (stream_offset < payload_size) {
+            unsigned long payload_bytes = static_cast<unsigned long>(min<ULONGLONG>(bytes_remaining, payload_size - stream_offset));
+            this->checksum_recv = ctCrc32c::update(this->checksum_recv, buffer, payload_bytes);
+            buffer += payload_bytes;
+            bytes_remaining -= payload_bytes;
+            stream_offset += payload_bytes;
+        }
+
+        if (bytes_remaining > 0) {
+            size_t trailer_offset = static_cast<size_t>(stream_offset - payload_size);
+            ctl::ctFatalCondition(
+                trailer_offset + bytes_remaining > s_ChecksumTrailerSize,
+                L"ctsIOPattern::verify_checksum() : ctsIOTask (%p) received beyond the checksum trailer (offset %Iu, bytes %u)",
+                &_original_task, trailer_offset, bytes_remaining);
+            ::memcpy_s(
+                reinterpret_cast<char*>(&this->checksum_recv_trailer) + trailer_offset,
+                s_ChecksumTrailerSize - trailer_offset,
+                buffer,
+                bytes_remaining);
+            stream_offset += bytes_remaining;
+        }
+
+        if (stream_offset == total_transfer && this->checksum_recv_trailer != this->checksum_recv) {
+            ctsConfig::PrintErrorInfo(
+                L"[%.3f] ctsIOPattern found data corruption: the CRC32C of the %llu bytes received (0x%08x) did not match the CRC32C sent by the peer (0x%08x)\n",
+                ctsConfig::GetStatusTimeStamp(),
+                payload_size,
+                this->checksum_recv,
+                this->checksum_recv_trailer);
+            return false;
+        }
+
+        return true;
+    }
+
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///
@@ -689,7 +1142,7 @@ namespace ctsTraffic {
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ctsIOPatternPull::ctsIOPatternPull() :
         ctsIOPatternImpl(ctsConfig::IsListening() ? 0 : ctsConfig::Settings->PrePostRecvs),
-        io_needed(ctsConfig::IsListening() ? 1 : ctsConfig::Settings->PrePostRecvs),
+        io_needed(ctsConfig::IsListening() ? ctsConfig::Settings->PrePostSends : ctsConfig::Settings->PrePostRecvs),
         sending(ctsConfig::IsListening())
     {
     }
@@ -706,6 +1159,7 @@ namespace ctsTraffic {
     /// Return an empty task when no more IO is needed
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////
+    template <ctsIOPattern::VerifyPolicy Verify>
     ctsIOTask ctsIOPatternPull::next_task() throw()
     {
         if (this->io_needed > 0) {
@@ -716,7 +1170,7 @@ namespace ctsTraffic {
             } else {
                 next_ioaction = ctsIOTask::IOAction::Recv;
             }
-            return this->tracked_task(next_ioaction);
+            return this->tracked_task<Verify>(next_ioaction);
         } else {
             return ctsIOTask();
         }
@@ -748,7 +1202,7 @@ namespace ctsTraffic {
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ctsIOPatternPush::ctsIOPatternPush() :
         ctsIOPatternImpl(ctsConfig::IsListening() ? ctsConfig::Settings->PrePostRecvs : 0),
-        io_needed(ctsConfig::IsListening() ? ctsConfig::Settings->PrePostRecvs : 1),
+        io_needed(ctsConfig::IsListening() ? ctsConfig::Settings->PrePostRecvs : ctsConfig::Settings->PrePostSends),
         sending(!ctsConfig::IsListening())
     {
     }
@@ -765,6 +1219,7 @@ namespace ctsTraffic {
     /// Return an empty task when no more IO is needed
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////
+    template <ctsIOPattern::VerifyPolicy Verify>
     ctsIOTask ctsIOPatternPush::next_task() throw()
     {
         if (this->io_needed > 0) {
@@ -775,7 +1230,7 @@ namespace ctsTraffic {
             } else {
                 next_ioaction = ctsIOTask::IOAction::Recv;
             }
-            return this->tracked_task(next_ioaction);
+            return this->tracked_task<Verify>(next_ioaction);
         } else {
             return ctsIOTask();
         }
@@ -804,18 +1259,20 @@ namespace ctsTraffic {
     ///    -- The server pulls data in 'segments'
     ///    -- At each segment, roles swap (pusher/puller)
     ///
-    ///    -- Currently not supporting concurrent IO via ctsConfig::GetConcurrentIoCount()
-    ///       as we need precise controls when to flip from send -> recv -> send
+    ///    -- Up to -PrePostSends sends are kept in flight within a push segment
+    ///       recvs are posted one at a time, as we need precise controls when to flip from recv -> send
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ctsIOPatternPushPull::ctsIOPatternPushPull() :
-        ctsIOPatternImpl(1), // currently not supporting >1 concurrent IO requests
+        ctsIOPatternImpl(1), // currently not supporting >1 concurrent recv requests
         push_segment_size(ctsConfig::Settings->PushBytes),
         pull_segment_size(ctsConfig::Settings->PullBytes),
-        intra_segment_transfer(0ULL),
         listening(ctsConfig::IsListening()),
-        io_needed(true),
+        intra_segment_transfer(0UL),
+        intra_segment_inflight(0UL),
+        send_needed(ctsConfig::Settings->PrePostSends),
+        recv_needed(true),
         sending(!ctsConfig::IsListening()) // start with clients sending, servers receiving
     {
     }
@@ -832,6 +1289,7 @@ namespace ctsTraffic {
     /// Return an empty task when no more IO is needed
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////
+    template <ctsIOPattern::VerifyPolicy Verify>
     ctsIOTask ctsIOPatternPushPull::next_task() throw()
     {
         ctsUnsignedLong segment_size;
@@ -848,33 +1306,40 @@ namespace ctsTraffic {
             static_cast<unsigned long>(this->intra_segment_transfer),
             static_cast<unsigned long>(segment_size));
 
-        if (this->io_needed) {
-            this->io_needed = false;
+        // never post beyond the end of this segment, including what is already in flight
+        ctsUnsignedLong segment_remaining = segment_size - this->intra_segment_transfer - this->intra_segment_inflight;
+        if (0 == segment_remaining) {
+            return ctsIOTask();
+        }
 
-            if (this->sending) {
-                return this->tracked_task(
-                    ctsIOTask::IOAction::Send,
-                    segment_size - this->intra_segment_transfer);
-            } else {
-                return this->tracked_task(
-                    ctsIOTask::IOAction::Recv,
-                    segment_size - this->intra_segment_transfer);
+        ctsIOTask return_task;
+        if (this->sending) {
+            if (this->send_needed > 0) {
+                --this->send_needed;
+                return_task = this->tracked_task<Verify>(ctsIOTask::IOAction::Send, segment_remaining);
             }
         } else {
-            return ctsIOTask();
+            if (this->recv_needed) {
+                this->recv_needed = false;
+                return_task = this->tracked_task<Verify>(ctsIOTask::IOAction::Recv, segment_remaining);
+            }
         }
+        this->intra_segment_inflight += return_task.buffer_length;
+        return return_task;
     }
     ctsIOPatternStatus ctsIOPatternPushPull::completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw()
     {
         if (ctsIOTask::IOAction::Send == _task.ioAction) {
             ctsConfig::Settings->TcpStatusDetails.bytes_sent.add(_current_transfer);
             this->stats.bytes_sent.add(_current_transfer);
+            ++this->send_needed;
         } else {
             ctsConfig::Settings->TcpStatusDetails.bytes_recv.add(_current_transfer);
             this->stats.bytes_recv.add(_current_transfer);
+            this->recv_needed = true;
         }
 
-        this->io_needed = true;
+        this->intra_segment_inflight -= _task.buffer_length;
         this->intra_segment_transfer += _current_transfer;
 
         ctsUnsignedLong segment_size;
@@ -892,6 +1357,10 @@ namespace ctsTraffic {
             static_cast<unsigned long>(segment_size));
 
         if (segment_size == this->intra_segment_transfer) {
+            ctl::ctFatalCondition(
+                (this->intra_segment_inflight > 0),
+                L"Invalid ctsIOPatternPushPull state: segment completed with (%lu) bytes still in flight\n",
+                static_cast<unsigned long>(this->intra_segment_inflight));
             this->sending = !this->sending;
             this->intra_segment_transfer = 0;
         }
@@ -900,6 +1369,145 @@ namespace ctsTraffic {
     }
 
 
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///     - Pipelined PushPull Pattern
+    ///    -- TCP-only
+    ///    -- The client pushes request segments, keeping up to -PushPullPipeline outstanding
+    ///    -- The server pulls each request segment, then pushes a response segment for it
+    ///    -- Both sides keep one recv posted at all times, each bounded to the current segment
+    ///       so the client can timestamp exactly when each response completed
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ctsIOPatternPushPullPipelined::ctsIOPatternPushPullPipelined() :
+        ctsIOPatternImpl(1), // one recv at a time: each recv is bounded to the current segment
+        send_segment_size(ctsConfig::IsListening() ? ctsConfig::Settings->PullBytes : ctsConfig::Settings->PushBytes),
+        recv_segment_size(ctsConfig::IsListening() ? ctsConfig::Settings->PushBytes : ctsConfig::Settings->PullBytes),
+        pipeline_depth(ctsConfig::Settings->PushPullPipeline),
+        listening(ctsConfig::IsListening()),
+        segment_count(0ULL),
+        send_segments_started(0ULL),
+        send_segment_posted(0UL),
+        recv_segments_completed(0ULL),
+        recv_segment_received(0UL),
+        segment_start_usec(),
+        send_needed(ctsConfig::Settings->PrePostSends),
+        recv_needed(true)
+    {
+        // the transfer must be a whole # of request/response segment pairs
+        // - rounding up so at least the requested # of bytes are transferred
+        const ULONGLONG pair_size = static_cast<ULONGLONG>(send_segment_size) + static_cast<ULONGLONG>(recv_segment_size);
+        const ULONGLONG requested_transfer = static_cast<ULONGLONG>(this->get_total_transfer());
+        this->segment_count = (requested_transfer + pair_size - 1) / pair_size;
+        this->set_total_transfer(static_cast<ULONGLONG>(this->segment_count) * pair_size);
+
+        if (!this->listening) {
+            this->segment_start_usec.resize(this->pipeline_depth, 0LL);
+        }
+    }
+    ctsIOPatternPushPullPipelined::~ctsIOPatternPushPullPipelined() throw()
+    {
+    }
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// virtual methods from the base class:
+    /// - assumes will be called under a CS from the base class
+    ///
+    /// Return an empty task when no more IO is needed
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    template <ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPatternPushPullPipelined::next_task() throw()
+    {
+        // post a recv whenever the peer owes us a segment
+        // - the client is owed a response for every request it has started
+        // - the server is owed every request
+        if (this->recv_needed) {
+            const ULONGLONG recv_segments_owed = this->listening ?
+                static_cast<ULONGLONG>(this->segment_count) :
+                static_cast<ULONGLONG>(this->send_segments_started);
+            if (this->recv_segments_completed < recv_segments_owed) {
+                this->recv_needed = false;
+                return this->tracked_task<Verify>(
+                    ctsIOTask::IOAction::Recv,
+                    this->recv_segment_size - this->recv_segment_received);
+            }
+        }
+
+        if (this->send_needed > 0) {
+            // continue the segment currently being sent, else see if the next segment can start
+            // - the client can start a request while fewer than pipeline_depth are awaiting responses
+            // - the server can start a response once its request was fully received
+            bool can_send = (this->send_segment_posted > 0);
+            if (!can_send && this->send_segments_started < this->segment_count) {
+                if (this->listening) {
+                    can_send = (this->send_segments_started < this->recv_segments_completed);
+                } else {
+                    can_send = (this->send_segments_started - this->recv_segments_completed < this->pipeline_depth);
+                    if (can_send) {
+                        const size_t slot = static_cast<size_t>(static_cast<ULONGLONG>(this->send_segments_started) % this->pipeline_depth);
+                        this->segment_start_usec[slot] = ctl::ctTimer::snap_clock_usec();
+                    }
+                }
+                if (can_send) {
+                    ++this->send_segments_started;
+                }
+            }
+
+            if (can_send) {
+                --this->send_needed;
+                ctsIOTask return_task = this->tracked_task<Verify>(
+                    ctsIOTask::IOAction::Send,
+                    this->send_segment_size - this->send_segment_posted);
+                this->send_segment_posted += return_task.buffer_length;
+                if (this->send_segment_posted == this->send_segment_size) {
+                    // the entire segment has been posted
+                    this->send_segment_posted = 0;
+                }
+                return return_task;
+            }
+        }
+
+        return ctsIOTask();
+    }
+    ctsIOPatternStatus ctsIOPatternPushPullPipelined::completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw()
+    {
+        if (ctsIOTask::IOAction::Send == _task.ioAction) {
+            ctsConfig::Settings->TcpStatusDetails.bytes_sent.add(_current_transfer);
+            this->stats.bytes_sent.add(_current_transfer);
+            ++this->send_needed;
+            return MoreData;
+        }
+
+        ctsConfig::Settings->TcpStatusDetails.bytes_recv.add(_current_transfer);
+        this->stats.bytes_recv.add(_current_transfer);
+        this->recv_needed = true;
+
+        this->recv_segment_received += _current_transfer;
+        ctl::ctFatalCondition(
+            (this->recv_segment_received > this->recv_segment_size),
+            L"Invalid ctsIOPatternPushPullPipelined state: recv_segment_received (%lu), recv_segment_size (%lu)\n",
+            static_cast<unsigned long>(this->recv_segment_received),
+            this->recv_segment_size);
+
+        if (this->recv_segment_size == this->recv_segment_received) {
+            if (!this->listening) {
+                // responses arrive in request order: this completes the oldest outstanding request
+                const size_t slot = static_cast<size_t>(static_cast<ULONGLONG>(this->recv_segments_completed) % this->pipeline_depth);
+                const long long segment_latency_usec = ctl::ctTimer::snap_clock_usec() - this->segment_start_usec[slot];
+                ctsConfig::Settings->HistoricTcpDetails.segment_latency_usec.add(segment_latency_usec);
+                ctsTrafficClass::RecordSegmentLatency(this->get_traffic_class(), segment_latency_usec);
+            }
+            ++this->recv_segments_completed;
+            this->recv_segment_received = 0;
+        }
+
+        return MoreData;
+    }
+
+
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///
@@ -913,7 +1521,7 @@ namespace ctsTraffic {
         ctsIOPatternImpl(ctsConfig::Settings->PrePostRecvs),
         remaining_send_bytes(0),
         remaining_recv_bytes(0),
-        send_needed(1),
+        send_needed(ctsConfig::Settings->PrePostSends),
         recv_needed(ctsConfig::Settings->PrePostRecvs)
     {
         // max transfer bytes must be an even # so send bytes and recv bytes are balanced
@@ -945,6 +1553,7 @@ namespace ctsTraffic {
     /// Return an empty task when no more IO is needed
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////
+    template <ctsIOPattern::VerifyPolicy Verify>
     ctsIOTask ctsIOPatternDuplex::next_task() throw()
     {
         ctsIOTask return_task;
@@ -953,7 +1562,7 @@ namespace ctsTraffic {
         if (this->recv_needed > 0 && this->remaining_recv_bytes > 0) {
             /// for very large transfers, we need to ensure our SafeInt<long long> doesn't overflow
             /// - when we cast it to unsigned long
-            return_task = this->tracked_task(
+            return_task = this->tracked_task<Verify>(
                 ctsIOTask::IOAction::Recv,
                 remaining_recv_bytes > MAXLONG ? MAXLONG : static_cast<unsigned long>(this->remaining_recv_bytes));
             // for tracking purposes, assume that this recv *might* end up receiving the entire buffer size
@@ -965,7 +1574,7 @@ namespace ctsTraffic {
         } else if (this->send_needed > 0 && this->remaining_send_bytes > 0) {
             /// for very large transfers, we need to ensure our SafeInt<long long> doesn't overflow
             /// - when we cast it to unsigned long
-            return_task = this->tracked_task(
+            return_task = this->tracked_task<Verify>(
                 ctsIOTask::IOAction::Send,
                 remaining_send_bytes > MAXLONG ? MAXLONG : static_cast<unsigned long>(this->remaining_send_bytes));
             // as above, this logic was added to avoid over-subscription for remaining send bytes when send_needed > 1
@@ -1009,54 +1618,248 @@ namespace ctsTraffic {
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///
-    ///     - ctsIOPatternMediaStream (Server) Pattern
-    ///    -- UDP-only
-    ///    -- The server sends data at a specified rate
-    ///    -- The client receives data continuously
-    ///       After a 'buffer period' of data has been received,
-    ///       The client starts as timer to 'process' a time-slice of data
+    ///     - Message Pattern
+    ///    -- TCP-only
+    ///    -- The client pushes length-prefixed messages (send)
+    ///    -- The server pulls and parses them (recv)
+    ///
+    ///    -- The stream is framed as it is handed to send buffers, so a message can be split across
+    ///       sends and a send can carry many messages - exactly as the server sees them across recvs
+    ///    -- The final message is sized to end exactly at the end of the transfer
+    ///    -- The server only posts one recv at a time: each recv must be parsed in stream order
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////////////////////////////////////////////
-    ctsIOPatternMediaStreamServer::ctsIOPatternMediaStreamServer() :
-        ctsIOPatternImpl(0), // the pattern will recv data OOB from within the protocol implementation
-        frame_size_bytes(ctsConfig::GetMediaStream().FrameSizeBytes),
-        current_frame_requested(0),
-        current_frame_completed(0),
-        frame_rate_fps(ctsConfig::GetMediaStream().FramesPerSecond),
-        current_frame(1),
-        base_time_milliseconds(ctTimer::snap_qpc_msec())
+    ctsIOPatternMessage::ctsIOPatternMessage() :
+        ctsIOPatternImpl(ctsConfig::IsListening() ? 1 : 0),
+        listening(ctsConfig::IsListening()),
+        send_buffer_container(),
+        send_buffer_free_list(),
+        framed_bytes(0ULL),
+        parsed_bytes(0ULL),
+        message_header_bytes(0UL),
+        message_payload_remaining(0UL),
+        message_start_usec(0LL),
+        send_needed(ctsConfig::IsListening() ? 0UL : ctsConfig::Settings->PrePostSends),
+        recv_needed(ctsConfig::IsListening())
     {
+        ::ZeroMemory(this->message_header, MessageHeaderSize);
+
+        if (!this->listening) {
+            const size_t send_buffer_size = static_cast<size_t>(this->buffer_size);
+            const size_t send_buffer_count = static_cast<size_t>(this->send_needed);
+            this->send_buffer_container.resize(send_buffer_size * send_buffer_count);
+            this->send_buffer_free_list.reserve(send_buffer_count);
+            for (size_t buffer_count = 0; buffer_count < send_buffer_count; ++buffer_count) {
+                this->send_buffer_free_list.push_back(&this->send_buffer_container[buffer_count * send_buffer_size]);
+            }
+        }
     }
-    ctsIOPatternMediaStreamServer::~ctsIOPatternMediaStreamServer()
+    ctsIOPatternMessage::~ctsIOPatternMessage() throw()
     {
     }
-    // required virtual functions
-    ctsIOTask ctsIOPatternMediaStreamServer::next_task()
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// virtual methods from the base class:
+    /// - assumes will be called under a CS from the base class
+    ///
+    /// Return an empty task when no more IO is needed
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    template <ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPatternMessage::next_task() throw()
     {
-        ctsIOTask return_task;
-        if (current_frame_requested < frame_size_bytes) {
-            return_task = this->tracked_task(ctsIOTask::IOAction::Send, frame_size_bytes);
-            // calculate the future time to initiate the IO
-            // - then subtract the start time to give the difference
-            return_task.time_offset_milliseconds =
-                this->base_time_milliseconds
-                + static_cast<long long>(this->current_frame * 1000 / this->frame_rate_fps)
-                - ctTimer::snap_qpc_msec();
+        if (this->recv_needed) {
+            this->recv_needed = false;
+            return this->tracked_task<Verify>(ctsIOTask::IOAction::Recv);
+        }
 
-            current_frame_requested += return_task.buffer_length;
+        if (this->send_needed > 0) {
+            --this->send_needed;
+            ctsIOTask return_task(this->tracked_task<Verify>(ctsIOTask::IOAction::Send));
+
+            // replace the shared pattern buffer with one of our own, framing the next bytes of the stream into it
+            char* send_buffer = this->send_buffer_free_list.back();
+            this->send_buffer_free_list.pop_back();
+            this->frame_messages(send_buffer, return_task.buffer_length);
+
+            return_task.buffer = send_buffer;
+            return_task.buffer_offset = 0;
+            return_task.rio_bufferid = RIO_INVALID_BUFFERID;
+            return_task.unlisted_buffer = true; // this buffer is only maintained in the derived object, not the base class
+            return return_task;
         }
-        return return_task;
+
+        return ctsIOTask();
     }
-    ctsIOPatternStatus ctsIOPatternMediaStreamServer::completed_task(const ctsIOTask&, unsigned long _current_transfer) throw()
+    ctsIOPatternStatus ctsIOPatternMessage::completed_task(const ctsIOTask& _task, unsigned long _completed_bytes) throw()
     {
-        ctsConfig::Settings->UdpStatusDetails.bits_received.add(_current_transfer * 8);
-        this->stats.bits_received.add(_current_transfer * 8);
+        if (ctsIOTask::IOAction::Send == _task.ioAction) {
+            ctsConfig::Settings->TcpStatusDetails.bytes_sent.add(_completed_bytes);
+            this->stats.bytes_sent.add(_completed_bytes);
 
-        this->current_frame_completed += _current_transfer;
-        if (this->current_frame_completed == frame_size_bytes) {
-            ++this->current_frame;
-            this->current_frame_requested = 0;
+            this->send_buffer_free_list.push_back(_task.buffer);
+            ++this->send_needed;
+            return MoreData;
+        }
+
+        ctsConfig::Settings->TcpStatusDetails.bytes_recv.add(_completed_bytes);
+        this->stats.bytes_recv.add(_completed_bytes);
+
+        if (!this->parse_messages(_task.buffer + _task.buffer_offset, _completed_bytes)) {
+            return ErrorDataDidNotMatchBitPattern;
+        }
+
+        this->recv_needed = true;
+        return MoreData;
+    }
+
+    void ctsIOPatternMessage::frame_messages(_Out_writes_(_length) char* _buffer, unsigned long _length) throw()
+    {
+        unsigned long offset = 0;
+        while (offset < _length) {
+            if (0 == this->message_header_bytes && 0 == this->message_payload_remaining) {
+                // start the next message
+                // - never leave fewer bytes in the stream than a header: the final message absorbs them
+                const ULONGLONG stream_remaining = static_cast<ULONGLONG>(this->get_total_transfer()) - static_cast<ULONGLONG>(this->framed_bytes);
+                ULONGLONG payload_size = static_cast<unsigned long>(ctsConfig::GetMessageSize());
+                if (MessageHeaderSize + payload_size + MessageHeaderSize > stream_remaining) {
+                    payload_size = stream_remaining - MessageHeaderSize;
+                }
+                ctl::ctFatalCondition(
+                    (payload_size > MAXDWORD),
+                    L"ctsIOPatternMessage: the final message payload (%llu) cannot be described by its header\n",
+                    payload_size);
+
+                this->message_payload_remaining = static_cast<unsigned long>(payload_size);
+                ::CopyMemory(this->message_header, &this->message_payload_remaining, MessageHeaderSize);
+                this->message_header_bytes = MessageHeaderSize;
+            }
+
+            unsigned long bytes_framed;
+            if (this->message_header_bytes > 0) {
+                // the header can be split across sends
+                bytes_framed = min(this->message_header_bytes, _length - offset);
+                ::CopyMemory(_buffer + offset, this->message_header + (MessageHeaderSize - this->message_header_bytes), bytes_framed);
+                this->message_header_bytes -= bytes_framed;
+            } else {
+                // the payload is not inspected by the server: leave whatever bytes are in the buffer
+                bytes_framed = min(this->message_payload_remaining, _length - offset);
+                this->message_payload_remaining -= bytes_framed;
+            }
+            offset += bytes_framed;
+            this->framed_bytes += bytes_framed;
+
+            if (0 == this->message_header_bytes && 0 == this->message_payload_remaining) {
+                ctsConfig::Settings->TcpStatusDetails.messages.increment();
+                this->stats.messages.increment();
+            }
+        }
+    }
+
+    bool ctsIOPatternMessage::parse_messages(_In_reads_(_length) const char* _buffer, unsigned long _length) throw()
+    {
+        // every message completed within this recv completed at the same moment
+        const long long now_usec = ctl::ctTimer::snap_clock_usec();
+
+        unsigned long offset = 0;
+        while (offset < _length) {
+            unsigned long bytes_parsed;
+            if (this->message_header_bytes < MessageHeaderSize) {
+                if (0 == this->message_header_bytes) {
+                    this->message_start_usec = now_usec;
+                }
+                // the header can be split across recvs
+                bytes_parsed = min(MessageHeaderSize - this->message_header_bytes, _length - offset);
+                ::CopyMemory(this->message_header + this->message_header_bytes, _buffer + offset, bytes_parsed);
+                this->message_header_bytes += bytes_parsed;
+
+                if (MessageHeaderSize == this->message_header_bytes) {
+                    ::CopyMemory(&this->message_payload_remaining, this->message_header, MessageHeaderSize);
+                    // a message can never extend beyond the end of the transfer
+                    const ULONGLONG stream_remaining =
+                        static_cast<ULONGLONG>(this->get_total_transfer()) - static_cast<ULONGLONG>(this->parsed_bytes) - bytes_parsed;
+                    if (this->message_payload_remaining > stream_remaining) {
+                        ctsConfig::PrintErrorInfo(
+                            L"[%.3f] ctsIOPatternMessage found an invalid message header: a payload of %lu bytes with only %llu bytes remaining in the stream\n",
+                            ctsConfig::GetStatusTimeStamp(),
+                            this->message_payload_remaining,
+                            stream_remaining);
+                        return false;
+                    }
+                }
+            } else {
+                bytes_parsed = min(this->message_payload_remaining, _length - offset);
+                this->message_payload_remaining -= bytes_parsed;
+            }
+            offset += bytes_parsed;
+            this->parsed_bytes += bytes_parsed;
+
+            if (MessageHeaderSize == this->message_header_bytes && 0 == this->message_payload_remaining) {
+                ctsConfig::Settings->TcpStatusDetails.messages.increment();
+                ctsConfig::Settings->MessageReassemblyStatusDetails.add(now_usec - this->message_start_usec);
+                ctsConfig::Settings->HistoricTcpDetails.message_reassembly_usec.add(now_usec - this->message_start_usec);
+                ctsTrafficClass::RecordMessageReassembly(this->get_traffic_class(), now_usec - this->message_start_usec);
+                this->stats.messages.increment();
+                this->message_header_bytes = 0;
+            }
+        }
+        return true;
+    }
+
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///     - ctsIOPatternMediaStream (Server) Pattern
+    ///    -- UDP-only
+    ///    -- The server sends data at a specified rate
+    ///    -- The client receives data continuously
+    ///       After a 'buffer period' of data has been received,
+    ///       The client starts as timer to 'process' a time-slice of data
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ctsIOPatternMediaStreamServer::ctsIOPatternMediaStreamServer() :
+        ctsIOPatternImpl(0), // the pattern will recv data OOB from within the protocol implementation
+        frame_size_bytes(ctsConfig::GetMediaStream().FrameSizeBytes),
+        current_frame_requested(0),
+        current_frame_completed(0),
+        frame_rate_fps(ctsConfig::GetMediaStream().FramesPerSecond),
+        current_frame(1),
+        base_time_milliseconds(ctTimer::snap_clock_msec())
+    {
+    }
+    ctsIOPatternMediaStreamServer::~ctsIOPatternMediaStreamServer()
+    {
+    }
+    // required by ctsIOPatternPolicy
+    template <ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPatternMediaStreamServer::next_task()
+    {
+        ctsIOTask return_task;
+        if (current_frame_requested < frame_size_bytes) {
+            return_task = this->tracked_task<Verify>(ctsIOTask::IOAction::Send, frame_size_bytes);
+            // calculate the future time to initiate the IO
+            // - then subtract the start time to give the difference
+            return_task.time_offset_milliseconds =
+                this->base_time_milliseconds
+                + static_cast<long long>(this->current_frame * 1000 / this->frame_rate_fps)
+                - ctTimer::snap_clock_msec();
+
+            current_frame_requested += return_task.buffer_length;
+        }
+        return return_task;
+    }
+    ctsIOPatternStatus ctsIOPatternMediaStreamServer::completed_task(const ctsIOTask&, unsigned long _current_transfer) throw()
+    {
+        ctsConfig::Settings->UdpStatusDetails.bits_received.add(_current_transfer * 8);
+        this->stats.bits_received.add(_current_transfer * 8);
+
+        this->current_frame_completed += _current_transfer;
+        if (this->current_frame_completed == frame_size_bytes) {
+            ++this->current_frame;
+            this->current_frame_requested = 0;
             this->current_frame_completed = 0;
         }
         return MoreData;
@@ -1098,7 +1901,7 @@ namespace ctsTraffic {
         initial_buffer_frames(0),
         timer_wheel_offset_frames(0),
         recv_needed(ctsConfig::Settings->PrePostRecvs),
-        base_time_milliseconds(ctTimer::snap_qpc_msec()),
+        base_time_milliseconds(ctTimer::snap_clock_msec()),
         tracking_resend_sequence_number(1LL),
         frame_rate_ms_per_frame(1000.0 / static_cast<unsigned long>(ctsConfig::GetMediaStream().FramesPerSecond)),
         frame_entries(),
@@ -1182,6 +1985,7 @@ namespace ctsTraffic {
         ::CloseThreadpoolTimer(original_timer);
     }
 
+    template <ctsIOPattern::VerifyPolicy Verify>
     ctsIOTask ctsIOPatternMediaStreamClient::next_task()
     {
         // defaulting to an empty task (do nothing)
@@ -1195,7 +1999,7 @@ namespace ctsTraffic {
                 max_size_buffer = this->frame_size_bytes;
             }
 
-            return_task = this->untracked_task(ctsIOTask::IOAction::Recv, max_size_buffer);
+            return_task = this->untracked_task<Verify>(ctsIOTask::IOAction::Recv, max_size_buffer);
             // always write in a zero for the seq number to initialize the buffer
             *(reinterpret_cast<long long*>(return_task.buffer)) = 0LL;
             --this->recv_needed;
@@ -1389,13 +2193,13 @@ namespace ctsTraffic {
         // only schedule the next timer instance if the d'tor hasn't indicated it's wanting to exit
         if (this->renderer_timer != nullptr) {
             // calculate when that time should be relative to base_time_milliseconds 
-            // (base_time_milliseconds is the start milliseconds from ctTimer::snap_qpc_msec())
+            // (base_time_milliseconds is the start milliseconds from ctTimer::snap_clock_msec())
             long long timer_offset = this->base_time_milliseconds;
             // offset to the time when we need to check the next frame
             // - we'll also render a frame at the same time if the initial buffer is full
             timer_offset += static_cast<long long>(static_cast<unsigned long>(this->timer_wheel_offset_frames) * this->frame_rate_ms_per_frame);
             // subtract out the current time to get the delta # of milliseconds
-            timer_offset -= ctTimer::snap_qpc_msec();
+            timer_offset -= ctTimer::snap_clock_msec();
             // can't let it go negative
             if (timer_offset < 1) {
                 timer_offset = 0;
@@ -1604,4 +2408,766 @@ namespace ctsTraffic {
         }
     }
 
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///     - ctsIOPatternDatagram (Server) Pattern
+    ///    -- UDP-only
+    ///    -- Sends PacketCount datagrams, each carrying its own sequence number
+    ///    -- With a PacketRate, each datagram is scheduled at its precise offset from the start time
+    ///       - datagrams that fall within the same millisecond are sent back-to-back
+    ///    -- Without a PacketRate, every datagram is sent immediately
+    ///
+    ///   -- The total transfer from the base class starts as an upper bound (PacketCount * max size)
+    ///      - once the final datagram size is known, the total is fixed to the exact bytes requested
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ctsIOPatternDatagramServer::ctsIOPatternDatagramServer() :
+        ctsIOPatternImpl(0), // the pattern will recv data OOB from within the protocol implementation
+        packet_count(ctsConfig::GetDatagram().PacketCount),
+        packets_per_second(ctsConfig::GetDatagram().PacketsPerSecond),
+        packets_requested(0),
+        bytes_requested(0),
+        base_time_milliseconds(ctTimer::snap_clock_msec())
+    {
+    }
+    ctsIOPatternDatagramServer::~ctsIOPatternDatagramServer()
+    {
+    }
+    // required by ctsIOPatternPolicy
+    template <ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPatternDatagramServer::next_task()
+    {
+        ctsIOTask return_task;
+        if (this->packets_requested < this->packet_count) {
+            unsigned long datagram_size = ctsConfig::GetDatagramSize();
+            if (this->packets_requested + 1 == this->packet_count) {
+                // this is the final datagram: the base class now knows exactly how many bytes to expect
+                this->set_total_transfer(this->bytes_requested + datagram_size);
+            }
+
+            return_task = this->tracked_task<Verify>(ctsIOTask::IOAction::Send, datagram_size);
+            if (this->packets_per_second > 0) {
+                // calculate the future time to initiate the IO
+                // - then subtract the current time to give the difference
+                return_task.time_offset_milliseconds =
+                    this->base_time_milliseconds
+                    + static_cast<long long>(static_cast<unsigned long long>(this->packets_requested) * 1000ULL / this->packets_per_second)
+                    - ctTimer::snap_clock_msec();
+            }
+
+            ++this->packets_requested;
+            this->bytes_requested += return_task.buffer_length;
+        }
+        return return_task;
+    }
+    ctsIOPatternStatus ctsIOPatternDatagramServer::completed_task(const ctsIOTask&, unsigned long _current_transfer) throw()
+    {
+        ctsConfig::Settings->UdpStatusDetails.bits_received.add(_current_transfer * 8);
+        this->stats.bits_received.add(_current_transfer * 8);
+
+        ctsConfig::Settings->UdpStatusDetails.successful_frames.increment();
+        this->stats.successful_frames.increment();
+
+        return MoreData;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///     - ctsIOPatternDatagram (Client) Pattern
+    ///    -- UDP-only
+    ///    -- The client receives datagrams continuously, tracking each by its sequence number
+    ///       - a sequence number beyond the highest seen so far counts any skipped numbers as Lost
+    ///       - a sequence number below the highest seen so far fills a gap: it counts as Reordered
+    ///         and is no longer counted as Lost
+    ///       - a sequence number already received counts as Repeated
+    ///    -- The stream is finished once every datagram is received, or once no datagrams
+    ///       have arrived for one full timer period (any datagrams not yet seen are Lost)
+    ///       - the period is 500ms, or 4 inter-packet gaps when -PacketRate is below 8 per second
+    ///
+    ///   -- The client is only using untracked_task requests from the base
+    ///      since the correctness and lifetime of the session is only known from this instance
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    static const unsigned long DatagramIdleTimerMilliseconds = 500;
+    // with -PacketRate, the timer period spans at least this many inter-packet gaps
+    static const unsigned long DatagramIdleTimerPacketGaps = 4;
+    // START is re-sent each timer period until the server is heard from
+    static const unsigned long DatagramMaximumStartAttempts = 10;
+
+    static unsigned long DatagramIdleTimerPeriod() throw()
+    {
+        const unsigned long packets_per_second = ctsConfig::GetDatagram().PacketsPerSecond;
+        if (0 == packets_per_second) {
+            return DatagramIdleTimerMilliseconds;
+        }
+        return max(DatagramIdleTimerMilliseconds, DatagramIdleTimerPacketGaps * 1000UL / packets_per_second);
+    }
+
+    ctsIOPatternDatagramClient::ctsIOPatternDatagramClient() :
+        ctsIOPatternImpl(ctsConfig::Settings->PrePostRecvs),
+        idle_timer(nullptr),
+        idle_timer_milliseconds(DatagramIdleTimerPeriod()),
+        final_sequence_number(ctsConfig::GetDatagram().PacketCount),
+        recv_needed(ctsConfig::Settings->PrePostRecvs),
+        idle_timer_ticks(0),
+        received_count(0),
+        received_at_last_tick(0),
+        highest_sequence_number(0),
+        finished(false),
+        received_sequence_numbers()
+    {
+        // sequence numbers start at 1
+        received_sequence_numbers.resize(static_cast<size_t>(final_sequence_number) + 1, false);
+
+        idle_timer = ::CreateThreadpoolTimer(IdleTimerCallback, this, nullptr);
+        if (NULL == idle_timer) {
+            throw ctException(::GetLastError(), L"CreateThreadpoolTimer", L"ctsIOPatternDatagramClient", false);
+        }
+
+        this->base_lock();
+        this->set_next_timer();
+        this->base_unlock();
+    }
+    ctsIOPatternDatagramClient::~ctsIOPatternDatagramClient()
+    {
+        // cleanly shutdown the TP timer
+        // - indicate this by setting the TP_TIMER to null under the cs
+        // - so the callback will no longer schedule more TP timer instances
+        // - then wait for everything to clean up
+        PTP_TIMER original_timer = nullptr;
+
+        this->base_lock();
+        original_timer = this->idle_timer;
+        this->idle_timer = nullptr;
+        this->base_unlock();
+
+        ::SetThreadpoolTimer(original_timer, NULL, 0, 0);
+        ::WaitForThreadpoolTimerCallbacks(original_timer, FALSE);
+        ::CloseThreadpoolTimer(original_timer);
+    }
+
+    template <ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPatternDatagramClient::next_task()
+    {
+        // defaulting to an empty task (do nothing)
+        ctsIOTask return_task;
+        if (this->recv_needed > 0) {
+            return_task = this->untracked_task<Verify>(ctsIOTask::IOAction::Recv);
+            // always write in a zero for the seq number to initialize the buffer
+            *(reinterpret_cast<long long*>(return_task.buffer)) = 0LL;
+            --this->recv_needed;
+        }
+        return return_task;
+    }
+
+    ctsIOPatternStatus ctsIOPatternDatagramClient::completed_task(const ctsIOTask& _task, unsigned long _completed_bytes) throw()
+    {
+        if (_task.ioAction == ctsIOTask::IOAction::Recv) {
+            // since a recv completed, will need to request another
+            ++this->recv_needed;
+
+            if (this->finished) {
+                // DONE was already sent - datagrams still in flight are no longer counted
+                return MoreData;
+            }
+
+            if (_completed_bytes < UdpDatagramHeaderSizeBytes) {
+                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                this->stats.error_frames.increment();
+                return MoreData;
+            }
+
+            // first validate the buffer contents
+            ctsIOTask validation_task(_task);
+            validation_task.buffer_offset = UdpDatagramHeaderSizeBytes; // skip the header since we use it for our own stuff
+            validation_task.buffer_length -= UdpDatagramHeaderSizeBytes;
+            if (!this->verify_buffer(validation_task, _completed_bytes - UdpDatagramHeaderSizeBytes)) {
+                // exit early if the buffers don't match
+                return ctsIOPatternStatus::ErrorDataDidNotMatchBitPattern;
+            }
+
+            long long buffered_seq_number = *reinterpret_cast<long long*>(_task.buffer);
+            if (buffered_seq_number < 1 || buffered_seq_number > this->final_sequence_number) {
+                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                this->stats.error_frames.increment();
+
+                ctsConfig::PrintDebug(
+                    L"[%.3f] DatagramClient received **an unknown** seq number (%lld) (outside the final seq number %lu)\n",
+                    ctsConfig::GetStatusTimeStamp(),
+                    buffered_seq_number,
+                    this->final_sequence_number);
+
+            } else if (this->received_sequence_numbers[static_cast<size_t>(buffered_seq_number)]) {
+                ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                this->stats.duplicate_frames.increment();
+
+            } else {
+                this->received_sequence_numbers[static_cast<size_t>(buffered_seq_number)] = true;
+                ++this->received_count;
+
+                // track the # of *bits* received
+                ctsConfig::Settings->UdpStatusDetails.bits_received.add(_completed_bytes * 8);
+                this->stats.bits_received.add(_completed_bytes * 8);
+                ctsConfig::Settings->UdpStatusDetails.successful_frames.increment();
+                this->stats.successful_frames.increment();
+
+                if (buffered_seq_number > this->highest_sequence_number) {
+                    long long skipped = buffered_seq_number - this->highest_sequence_number - 1;
+                    if (skipped > 0) {
+                        ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(skipped);
+                        this->stats.dropped_frames.add(skipped);
+                    }
+                    this->highest_sequence_number = buffered_seq_number;
+
+                } else {
+                    // this datagram fills a gap that was counted as lost
+                    ctsConfig::Settings->UdpStatusDetails.reordered_frames.increment();
+                    this->stats.reordered_frames.increment();
+                    ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(-1);
+                    this->stats.dropped_frames.add(-1);
+                }
+
+                if (this->received_count == this->final_sequence_number) {
+                    this->finish_stream();
+                }
+            }
+
+        } else {  // else process SEND requests
+            // process the DONE request 
+            if (0 == ::memcmp("DONE", _task.buffer, min<unsigned long>(4, _task.buffer_length))) {
+                // indicate to the caller to abort any pended recv requests: aborting
+                ctsIOTask abort_task;
+                abort_task.ioAction = ctsIOTask::IOAction::Abort;
+                this->send_callback(abort_task);
+            }
+            // else START : nothing to do : it's a static buffer
+        }
+
+        return MoreData;
+    }
+
+    ///
+    /// Counts every datagram not yet seen as lost, stops the timer from being rescheduled,
+    /// - then sends DONE to the server
+    ///
+    _Requires_lock_held_(cs)
+    void ctsIOPatternDatagramClient::finish_stream() throw()
+    {
+        this->finished = true;
+
+        long long never_received = static_cast<long long>(this->final_sequence_number) - this->highest_sequence_number;
+        if (never_received > 0) {
+            ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(never_received);
+            this->stats.dropped_frames.add(never_received);
+        }
+        // stop the clock once the stream is done for tracking the packets/sec
+        this->end_pattern();
+
+        ctsConfig::PrintDebug(L"\t\tctsIOPatternDatagramClient - indicating DONE: %lu datagrams received\n", this->received_count);
+        this->send_callback(ctsMediaStreamMessage::Construct(ctsMediaStreamMessage::Action::DONE));
+    }
+
+    _Requires_lock_held_(cs)
+    void ctsIOPatternDatagramClient::set_next_timer() throw()
+    {
+        // only schedule the next timer instance if the d'tor hasn't indicated it's wanting to exit
+        if (this->idle_timer != nullptr) {
+            // convert to filetime from milliseconds
+            // - make a 'relative' for SetThreadpoolTimer
+            FILETIME file_time(ctTimer::convert_msec_relative_filetime(this->idle_timer_milliseconds));
+            // TP Timer APIs work off of the UTC time
+            ::SetThreadpoolTimer(this->idle_timer, &file_time, 0, 0);
+        }
+    }
+
+    VOID CALLBACK ctsIOPatternDatagramClient::IdleTimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER)
+    {
+        ctsIOPatternDatagramClient* this_ptr = reinterpret_cast<ctsIOPatternDatagramClient*>(_context);
+        // take the base lock before touching any internal members
+        this_ptr->base_lock();
+        // guarantee the lock is released on exit
+#pragma warning(suppress: 26110)   //  PREFast is getting confused with the scope guard
+        ctlScopeGuard(unlockBaseLockOnExit, { this_ptr->base_unlock(); });
+
+        if (this_ptr->finished) {
+            return;
+        }
+
+        ++this_ptr->idle_timer_ticks;
+        if (0 == this_ptr->received_count) {
+            if (this_ptr->idle_timer_ticks >= DatagramMaximumStartAttempts) {
+                // never heard from the server: abort this connection
+                ctsConfig::PrintDebug(L"\t\tctsIOPatternDatagramClient - issuing a FATALABORT to close the connection\n");
+                this_ptr->finished = true;
+
+                ctsIOTask abort_task;
+                abort_task.ioAction = ctsIOTask::IOAction::FatalAbort;
+                this_ptr->send_callback(abort_task);
+
+            } else {
+                // send another start message
+                ctsConfig::PrintDebug(L"\t\tctsIOPatternDatagramClient re-requesting START\n");
+                this_ptr->set_next_timer();
+                this_ptr->send_callback(ctsMediaStreamMessage::Construct(ctsMediaStreamMessage::Action::START));
+            }
+
+        } else if (this_ptr->received_count == this_ptr->received_at_last_tick) {
+            // nothing arrived over an entire timer period: the server is done sending
+            this_ptr->finish_stream();
+
+        } else {
+            this_ptr->received_at_last_tick = this_ptr->received_count;
+            this_ptr->set_next_timer();
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///     - ctsIOPatternEcho (Server) Pattern
+    ///    -- UDP-only
+    ///    -- ECHO probes are sent back by ctsMediaStreamServer as they are received
+    ///       - each reflected probe is completed back through this pattern to be counted
+    ///    -- The connection is complete once the client sends DONE
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ctsIOPatternEchoServer::ctsIOPatternEchoServer() :
+        ctsIOPatternImpl(0) // the probes are received OOB from within the protocol implementation
+    {
+    }
+    ctsIOPatternEchoServer::~ctsIOPatternEchoServer()
+    {
+    }
+    // required by ctsIOPatternPolicy
+    template <ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPatternEchoServer::next_task()
+    {
+        // never initiates IO: defaulting to an empty task (do nothing)
+        return ctsIOTask();
+    }
+    ctsIOPatternStatus ctsIOPatternEchoServer::completed_task(const ctsIOTask&, unsigned long _current_transfer) throw()
+    {
+        ctsConfig::Settings->UdpStatusDetails.bits_received.add(_current_transfer * 8);
+        this->stats.bits_received.add(_current_transfer * 8);
+
+        ctsConfig::Settings->UdpStatusDetails.successful_frames.increment();
+        this->stats.successful_frames.increment();
+
+        return MoreData;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///     - ctsIOPatternEcho (Client) Pattern
+    ///    -- UDP-only
+    ///    -- Sends a probe with sequence number 0 (along with START) until the server echoes it back
+    ///       - only then are the -PacketCount probes sent (sequence numbers 1 through -PacketCount)
+    ///    -- Each probe carries its sequence number and the time it was sent
+    ///       - the round-trip time is measured from building the probe until its echo is received
+    ///    -- A probe not echoed within EchoProbeTimeoutMilliseconds counts as Lost
+    ///       - if its echo does arrive later, it's no longer counted as Lost
+    ///    -- An echo with a sequence number below the highest echoed so far counts as Reordered
+    ///
+    ///   -- Probes are tracked in a fixed window of slots indexed by sequence number
+    ///      each slot with its own send buffer, so nothing is allocated per probe
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    static const unsigned long EchoStartTimerMilliseconds = 500;
+    // START is re-sent each timer period until the server is heard from
+    static const unsigned long EchoMaximumStartAttempts = 10;
+    static const unsigned long EchoProbeTimeoutMilliseconds = 1000;
+    // when only sending the next probe once the prior probe returns, the timer is only needed to catch timeouts
+    static const unsigned long EchoTimeoutTimerMilliseconds = 100;
+    static const unsigned long EchoMaximumProbeWindow = 1024;
+
+    ctsIOPatternEchoClient::ctsIOPatternEchoClient() :
+        ctsIOPatternImpl(ctsConfig::Settings->PrePostRecvs),
+        probe_timer(nullptr),
+        probe_count(ctsConfig::GetDatagram().PacketCount),
+        probes_per_second(ctsConfig::GetDatagram().PacketsPerSecond),
+        probe_buffer_size(ctsConfig::GetBufferSize()),
+        recv_needed(ctsConfig::Settings->PrePostRecvs),
+        probes(),
+        probe_buffers(),
+        start_probe(),
+        base_time_usec(0LL),
+        next_sequence_number(1LL),
+        oldest_pending_sequence_number(1LL),
+        highest_echoed_sequence_number(0LL),
+        resolved_count(0),
+        start_attempts(0),
+        start_probe_sent(false),
+        started(false),
+        probe_ready(false),
+        finished(false)
+    {
+        const unsigned long probe_window = min<unsigned long>(this->probe_count, EchoMaximumProbeWindow);
+        EchoProbe empty_probe = { 0LL, 0LL, false, false, false };
+        probes.resize(probe_window, empty_probe);
+
+        // the payload following the header never changes: fill every slot with the buffer pattern once
+        probe_buffers.resize(static_cast<size_t>(probe_window) * probe_buffer_size);
+        for (unsigned long slot = 0; slot < probe_window; ++slot) {
+            ::memcpy(
+                &probe_buffers[static_cast<size_t>(slot) * probe_buffer_size + UdpEchoHeaderSizeBytes],
+                ctsIOPattern::AccessSharedBuffer(),
+                probe_buffer_size - UdpEchoHeaderSizeBytes);
+        }
+        start_probe.resize(ctsConfig::GetDatagram().DatagramSizeLow);
+        ::memcpy(&start_probe[UdpEchoHeaderSizeBytes], ctsIOPattern::AccessSharedBuffer(), start_probe.size() - UdpEchoHeaderSizeBytes);
+        ctsMediaStreamMessage::ConstructEcho(&start_probe[0], 0LL, 0LL);
+
+        probe_timer = ::CreateThreadpoolTimer(ProbeTimerCallback, this, nullptr);
+        if (NULL == probe_timer) {
+            throw ctException(::GetLastError(), L"CreateThreadpoolTimer", L"ctsIOPatternEchoClient", false);
+        }
+    }
+    ctsIOPatternEchoClient::~ctsIOPatternEchoClient()
+    {
+        // cleanly shutdown the TP timer
+        // - indicate this by setting the TP_TIMER to null under the cs
+        // - so the callback will no longer schedule more TP timer instances
+        // - then wait for everything to clean up
+        PTP_TIMER original_timer = nullptr;
+
+        this->base_lock();
+        original_timer = this->probe_timer;
+        this->probe_timer = nullptr;
+        this->base_unlock();
+
+        ::SetThreadpoolTimer(original_timer, NULL, 0, 0);
+        ::WaitForThreadpoolTimerCallbacks(original_timer, FALSE);
+        ::CloseThreadpoolTimer(original_timer);
+    }
+
+    template <ctsIOPattern::VerifyPolicy Verify>
+    ctsIOTask ctsIOPatternEchoClient::next_task()
+    {
+        // defaulting to an empty task (do nothing)
+        ctsIOTask return_task;
+        if (this->recv_needed > 0) {
+            return_task = this->untracked_task<Verify>(ctsIOTask::IOAction::Recv);
+            --this->recv_needed;
+
+        } else if (!this->start_probe_sent) {
+            // the first probe is sent here, once the IO function is ready to take IO from this pattern
+            this->start_probe_sent = true;
+            this->set_next_timer(EchoStartTimerMilliseconds);
+
+            return_task.ioAction = ctsIOTask::IOAction::Send;
+            return_task.tracked_io = false;
+            return_task.buffer = &this->start_probe[0];
+            return_task.buffer_length = static_cast<unsigned long>(this->start_probe.size());
+
+        } else if (this->probe_ready) {
+            this->probe_ready = false;
+            return_task = this->build_probe();
+        }
+        return return_task;
+    }
+
+    ctsIOPatternStatus ctsIOPatternEchoClient::completed_task(const ctsIOTask& _task, unsigned long _completed_bytes) throw()
+    {
+        if (_task.ioAction == ctsIOTask::IOAction::Recv) {
+            // since a recv completed, will need to request another
+            ++this->recv_needed;
+
+            if (this->finished) {
+                // DONE was already sent - echoes still in flight are no longer counted
+                return MoreData;
+            }
+
+            const long long now_usec = ctTimer::snap_clock_usec();
+            if (_completed_bytes < UdpEchoHeaderSizeBytes || ::memcmp("ECHO.", _task.buffer, 5) != 0) {
+                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                this->stats.error_frames.increment();
+                return MoreData;
+            }
+
+            // first validate the buffer contents
+            ctsIOTask validation_task(_task);
+            validation_task.buffer_offset = UdpEchoHeaderSizeBytes; // skip the header since we use it for our own stuff
+            validation_task.buffer_length -= UdpEchoHeaderSizeBytes;
+            validation_task.expected_pattern_offset = 0;
+            if (!this->verify_buffer(validation_task, _completed_bytes - UdpEchoHeaderSizeBytes)) {
+                // exit early if the buffers don't match
+                return ctsIOPatternStatus::ErrorDataDidNotMatchBitPattern;
+            }
+
+            long long echoed_seq_number = *reinterpret_cast<long long*>(_task.buffer + 5);
+            if (0 == echoed_seq_number) {
+                if (!this->started) {
+                    // the server is now echoing: start sending the probes that are measured
+                    ctsConfig::PrintDebug(L"\t\tctsIOPatternEchoClient - the server echoed the first probe: starting\n");
+                    this->started = true;
+                    this->base_time_usec = now_usec;
+                    if (0 == this->probes_per_second) {
+                        this->probe_ready = true;
+                        this->set_next_timer(EchoTimeoutTimerMilliseconds);
+                    } else {
+                        this->set_next_timer(0);
+                    }
+                }
+                // else an echo from a repeated START probe
+                return MoreData;
+            }
+
+            EchoProbe* probe = nullptr;
+            if (echoed_seq_number > 0 && echoed_seq_number < this->next_sequence_number) {
+                probe = &this->probes[static_cast<size_t>(echoed_seq_number % this->probes.size())];
+            }
+            if (nullptr == probe || probe->sequence_number != echoed_seq_number) {
+                // either an unknown sequence number, or the echo returned after its slot was reused
+                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                this->stats.error_frames.increment();
+
+                ctsConfig::PrintDebug(
+                    L"[%.3f] EchoClient received **an unknown** seq number (%lld) (the next seq number to send is %lld)\n",
+                    ctsConfig::GetStatusTimeStamp(),
+                    echoed_seq_number,
+                    this->next_sequence_number);
+
+            } else if (probe->echoed) {
+                ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                this->stats.duplicate_frames.increment();
+
+            } else {
+                probe->echoed = true;
+                if (probe->lost) {
+                    // this echo had already timed out and been counted as lost
+                    probe->lost = false;
+                    ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(-1);
+                    this->stats.dropped_frames.add(-1);
+                } else {
+                    ++this->resolved_count;
+                }
+
+                const long long round_trip_usec = now_usec - probe->send_time_usec;
+                ctsConfig::Settings->UdpStatusDetails.round_trip_usec.add(round_trip_usec);
+                this->stats.round_trip_usec.add(round_trip_usec);
+
+                // track the # of *bits* received
+                ctsConfig::Settings->UdpStatusDetails.bits_received.add(_completed_bytes * 8);
+                this->stats.bits_received.add(_completed_bytes * 8);
+                ctsConfig::Settings->UdpStatusDetails.successful_frames.increment();
+                this->stats.successful_frames.increment();
+
+                if (echoed_seq_number < this->highest_echoed_sequence_number) {
+                    ctsConfig::Settings->UdpStatusDetails.reordered_frames.increment();
+                    this->stats.reordered_frames.increment();
+                } else {
+                    this->highest_echoed_sequence_number = echoed_seq_number;
+                }
+
+                if (0 == this->probes_per_second &&
+                    echoed_seq_number + 1 == this->next_sequence_number &&
+                    this->next_sequence_number <= this->probe_count) {
+                    // the outstanding probe returned: next_task will send the next probe
+                    this->probe_ready = true;
+                }
+
+                if (this->next_sequence_number > this->probe_count && this->resolved_count == this->probe_count) {
+                    this->finish_stream();
+                }
+            }
+
+        } else {  // else process SEND requests
+            // process the DONE request
+            if (0 == ::memcmp("DONE", _task.buffer, min<unsigned long>(4, _task.buffer_length))) {
+                // indicate to the caller to abort any pended recv requests: aborting
+                ctsIOTask abort_task;
+                abort_task.ioAction = ctsIOTask::IOAction::Abort;
+                this->send_callback(abort_task);
+
+            } else if (_task.buffer >= &this->probe_buffers[0] && _task.buffer < &this->probe_buffers[0] + this->probe_buffers.size()) {
+                // the slot's buffer can now be reused for a later probe
+                const size_t slot = static_cast<size_t>(_task.buffer - &this->probe_buffers[0]) / this->probe_buffer_size;
+                this->probes[slot].sending = false;
+            }
+            // else START or the start probe : nothing to do : they are never modified
+        }
+
+        return MoreData;
+    }
+
+    ///
+    /// Writes the header for the next probe into its slot's buffer
+    /// - returns an empty task if that slot's buffer is still being sent
+    ///
+    _Requires_lock_held_(cs)
+    ctsIOTask ctsIOPatternEchoClient::build_probe() throw()
+    {
+        ctsIOTask return_task;
+
+        const size_t slot = static_cast<size_t>(this->next_sequence_number % this->probes.size());
+        EchoProbe& probe = this->probes[slot];
+        if (probe.sending) {
+            return return_task;
+        }
+        if (probe.sequence_number != 0 && !probe.echoed && !probe.lost) {
+            // the window wrapped before this probe was echoed or timed out
+            ctsConfig::Settings->UdpStatusDetails.dropped_frames.increment();
+            this->stats.dropped_frames.increment();
+            ++this->resolved_count;
+        }
+
+        char* probe_buffer = &this->probe_buffers[slot * this->probe_buffer_size];
+        probe.sequence_number = this->next_sequence_number;
+        probe.send_time_usec = ctTimer::snap_clock_usec();
+        probe.sending = true;
+        probe.echoed = false;
+        probe.lost = false;
+        ctsMediaStreamMessage::ConstructEcho(probe_buffer, probe.sequence_number, probe.send_time_usec);
+        ++this->next_sequence_number;
+
+        return_task.ioAction = ctsIOTask::IOAction::Send;
+        return_task.tracked_io = false;
+        return_task.buffer = probe_buffer;
+        return_task.buffer_length = ctsConfig::GetDatagramSize();
+        return return_task;
+    }
+
+    ///
+    /// Counts every probe which has waited longer than EchoProbeTimeoutMilliseconds as lost
+    ///
+    _Requires_lock_held_(cs)
+    void ctsIOPatternEchoClient::expire_probes(long long _now_usec) throw()
+    {
+        static const long long ProbeTimeoutUsec = EchoProbeTimeoutMilliseconds * 1000LL;
+        while (this->oldest_pending_sequence_number < this->next_sequence_number) {
+            EchoProbe& probe = this->probes[static_cast<size_t>(this->oldest_pending_sequence_number % this->probes.size())];
+            if (probe.sequence_number == this->oldest_pending_sequence_number && !probe.echoed && !probe.lost) {
+                if (_now_usec - probe.send_time_usec < ProbeTimeoutUsec) {
+                    // probes are sent in order: every later probe was sent more recently
+                    break;
+                }
+                probe.lost = true;
+                ctsConfig::Settings->UdpStatusDetails.dropped_frames.increment();
+                this->stats.dropped_frames.increment();
+                ++this->resolved_count;
+            }
+            ++this->oldest_pending_sequence_number;
+        }
+    }
+
+    ///
+    /// Counts every probe not yet echoed as lost, stops the timer from being rescheduled,
+    /// - then sends DONE to the server
+    ///
+    _Requires_lock_held_(cs)
+    void ctsIOPatternEchoClient::finish_stream() throw()
+    {
+        this->finished = true;
+
+        const long long never_resolved = static_cast<long long>(this->probe_count) - this->resolved_count;
+        if (never_resolved > 0) {
+            ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(never_resolved);
+            this->stats.dropped_frames.add(never_resolved);
+        }
+        // stop the clock once the probes are done for tracking the probes/sec
+        this->end_pattern();
+
+        ctsConfig::PrintDebug(L"\t\tctsIOPatternEchoClient - indicating DONE: %lld probes echoed\n", this->stats.successful_frames.get());
+        this->send_callback(ctsMediaStreamMessage::Construct(ctsMediaStreamMessage::Action::DONE));
+    }
+
+    _Requires_lock_held_(cs)
+    void ctsIOPatternEchoClient::set_next_timer(unsigned long _milliseconds) throw()
+    {
+        // only schedule the next timer instance if the d'tor hasn't indicated it's wanting to exit
+        if (this->probe_timer != nullptr) {
+            // convert to filetime from milliseconds
+            // - make a 'relative' for SetThreadpoolTimer
+            FILETIME file_time(ctTimer::convert_msec_relative_filetime(_milliseconds));
+            // TP Timer APIs work off of the UTC time
+            ::SetThreadpoolTimer(this->probe_timer, &file_time, 0, 0);
+        }
+    }
+
+    VOID CALLBACK ctsIOPatternEchoClient::ProbeTimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER)
+    {
+        ctsIOPatternEchoClient* this_ptr = reinterpret_cast<ctsIOPatternEchoClient*>(_context);
+        // take the base lock before touching any internal members
+        this_ptr->base_lock();
+        // guarantee the lock is released on exit
+#pragma warning(suppress: 26110)   //  PREFast is getting confused with the scope guard
+        ctlScopeGuard(unlockBaseLockOnExit, { this_ptr->base_unlock(); });
+
+        if (this_ptr->finished) {
+            return;
+        }
+
+        if (!this_ptr->started) {
+            ++this_ptr->start_attempts;
+            if (this_ptr->start_attempts >= EchoMaximumStartAttempts) {
+                // never heard from the server: abort this connection
+                ctsConfig::PrintDebug(L"\t\tctsIOPatternEchoClient - issuing a FATALABORT to close the connection\n");
+                this_ptr->finished = true;
+
+                ctsIOTask abort_task;
+                abort_task.ioAction = ctsIOTask::IOAction::FatalAbort;
+                this_ptr->send_callback(abort_task);
+
+            } else {
+                // send another start message along with the first probe
+                ctsConfig::PrintDebug(L"\t\tctsIOPatternEchoClient re-requesting START\n");
+                this_ptr->set_next_timer(EchoStartTimerMilliseconds);
+                this_ptr->send_callback(ctsMediaStreamMessage::Construct(ctsMediaStreamMessage::Action::START));
+
+                ctsIOTask start_probe_task;
+                start_probe_task.ioAction = ctsIOTask::IOAction::Send;
+                start_probe_task.tracked_io = false;
+                start_probe_task.buffer = &this_ptr->start_probe[0];
+                start_probe_task.buffer_length = static_cast<unsigned long>(this_ptr->start_probe.size());
+                this_ptr->send_callback(start_probe_task);
+            }
+            return;
+        }
+
+        const long long now_usec = ctTimer::snap_clock_usec();
+        this_ptr->expire_probes(now_usec);
+
+        if (this_ptr->probes_per_second > 0) {
+            // send every probe which should have been sent by now
+            // - catching up if the timer fired late
+            const long long probes_due = 1LL + (now_usec - this_ptr->base_time_usec) * this_ptr->probes_per_second / 1000000LL;
+            while (this_ptr->next_sequence_number <= this_ptr->probe_count && this_ptr->next_sequence_number <= probes_due) {
+                ctsIOTask probe_task(this_ptr->build_probe());
+                if (ctsIOTask::IOAction::None == probe_task.ioAction) {
+                    // the window is full of probes still being sent
+                    break;
+                }
+                this_ptr->send_callback(probe_task);
+            }
+
+        } else if (!this_ptr->probe_ready && this_ptr->next_sequence_number <= this_ptr->probe_count) {
+            // the outstanding probe timed out: send the next probe
+            const EchoProbe& outstanding_probe = this_ptr->probes[static_cast<size_t>((this_ptr->next_sequence_number - 1) % this_ptr->probes.size())];
+            if (this_ptr->next_sequence_number - 1 == outstanding_probe.sequence_number && outstanding_probe.lost) {
+                ctsIOTask probe_task(this_ptr->build_probe());
+                if (probe_task.ioAction != ctsIOTask::IOAction::None) {
+                    this_ptr->send_callback(probe_task);
+                }
+            }
+        }
+
+        if (this_ptr->next_sequence_number > this_ptr->probe_count && this_ptr->resolved_count == this_ptr->probe_count) {
+            this_ptr->finish_stream();
+
+        } else if (this_ptr->probes_per_second > 0) {
+            const unsigned long probe_interval_milliseconds = 1000UL / this_ptr->probes_per_second;
+            this_ptr->set_next_timer(max<unsigned long>(1UL, min<unsigned long>(probe_interval_milliseconds, EchoTimeoutTimerMilliseconds)));
+
+        } else {
+            this_ptr->set_next_timer(EchoTimeoutTimerMilliseconds);
+        }
+    }
+
 } //namespace
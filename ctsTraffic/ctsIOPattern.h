@@ -16,6 +16,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // cpp headers
 #include <memory>
 #include <algorithm>
+#include <vector>
 // os headers
 #include <winsock2.h>
 #include <mswsock.h>
@@ -28,6 +29,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsConfig.h"
 #include "ctsIOTask.hpp"
 #include "ctsPrintStatus.hpp"
+#include "ctsTrafficClass.h"
 
 
 namespace ctsTraffic {
@@ -48,8 +50,9 @@ namespace ctsTraffic {
         ErrorNotAllDataTransferred = MAXINT - 1,
         ErrorTooMuchDataTransferred = MAXINT - 2,
         ErrorDataDidNotMatchBitPattern = MAXINT - 3,
+        ErrorChecksumDidNotMatch = MAXINT - 4,
         // next should always be the lowest error value
-        ErrorPatternMinimumValue = MAXINT - 4
+        ErrorPatternMinimumValue = MAXINT - 5
     };
     // MAXINT is reserved for internal status of IO continuing
     static const unsigned long ctsIOPatternStatusIORunning = MAXINT;
@@ -82,6 +85,9 @@ namespace ctsTraffic {
             case ErrorDataDidNotMatchBitPattern:
                 return L"ErrorDataDidNotMatchBitPattern";
 
+            case ErrorChecksumDidNotMatch:
+                return L"ErrorChecksumDidNotMatch";
+
             default:
                 ctl::ctAlwaysFatalCondition(
                     L"ctsIOPattern: internal inconsistency - expecting a protocol error ctsIOPatternStatus (%u)", _status);
@@ -89,7 +95,23 @@ namespace ctsTraffic {
         }
     }
 
-    class ctsIOPattern {
+    ///
+    /// forward declare ctsSocket
+    /// - can't include ctsSocket.h in this header to avoid circular declarations
+    ///
+    class ctsSocket;
+
+    ///
+    /// A connection's progress as captured for -Outliers
+    ///
+    struct ctsIOPatternProgress {
+        long long bytes_per_second;
+        long long idle_msec;
+        ctsIOPatternStatus protocol_status;
+        bool send_blocked;
+    };
+
+    class ctsIOPattern : public std::enable_shared_from_this<ctsIOPattern> {
     public:
         ///
         /// Helper factory to build known patterns
@@ -110,37 +132,65 @@ namespace ctsTraffic {
         /// - the task given by initiate_io should be returned through complete_io
         ///   (or a copy of that task)
         ///
-        ctsIOTask initiate_io() throw();
-        ctsIOPatternStatus complete_io(const ctsIOTask& _task, unsigned long _bytes_transferred, unsigned long _status_code) throw();
+        /// initiate_io and complete_io are implemented by ctsIOPatternPolicy, the type MakeIOPattern builds
+        /// - this is their only virtual call: from there the pattern and the policy are statically bound
+        ///
+        virtual ctsIOTask initiate_io() throw() = 0;
+        virtual ctsIOPatternStatus complete_io(const ctsIOTask& _task, unsigned long _bytes_transferred, unsigned long _status_code) throw() = 0;
         unsigned long verify_io() throw();
 
+        ///
+        /// Captures the progress of a TCP connection still transferring data (for -Outliers)
+        /// - returns false for UDP patterns, or once the pattern has ended
+        ///
+        bool snap_progress(ctsIOPatternProgress& _progress) throw();
+
+        ///
+        /// The index into Settings->TrafficClasses this connection was assigned (for -Dscp)
+        ///
+        unsigned long get_traffic_class() const throw()
+        {
+            return this->traffic_class;
+        }
+
         ///
         /// Some derived IO types require callbacks to the IO functions
         /// - to request tasks from the normal initiate_io / complete_io pattern
         ///
         void register_callback(std::function<void(const ctsIOTask&)> _callback);
 
+        ///
+        /// The socket to resume once recv buffers come back from the verifier threads (-VerifyThreads)
+        ///
+        void register_socket(const std::weak_ptr<ctsSocket>& _socket);
+
         /// hide the default c'tor
         ctsIOPattern() = delete;
         /// hide the copy c'tor and copy assignment
         ctsIOPattern(const ctsIOPattern&) = delete;
         ctsIOPattern& operator= (const ctsIOPattern&) = delete;
 
-    private:
-        ///////////////////////////////////////////////////////////////////////////////////////////////////
+    protected:
         ///
-        /// Private method to return a pre-populated task
-        /// - *not* setting the private ctsIOTask::tracked_io property
+        /// The buffer verification policy the pattern is specialized on
         ///
-        ///////////////////////////////////////////////////////////////////////////////////////////////////
-        ctsIOTask new_task(ctsIOTask::IOAction _action, unsigned long _max_transfer);
+        enum VerifyPolicy {
+            VerifyNone,
+            VerifyBuffers,
+            VerifyChecksum
+        };
 
+    private:
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         ///
-        /// Private method which must be implemented by the derived interface
+        /// ctsIOPatternPolicy is the concrete type MakeIOPattern builds: the derived Pattern specialized
+        /// - on the protocol (Tcp) and on the buffer verification policy (Verify), chosen once per connection
+        ///   so the per-IO paths don't re-test these settings nor call through function pointers
+        ///
+        /// The derived Pattern must implement:
         ///
-        /// ctsIOTask next_task()
-        /// - must return a ctsIOTask returned from tracked_task or untracked_task
+        /// template <VerifyPolicy Verify> ctsIOTask next_task()
+        /// - must return a ctsIOTask returned from tracked_task<Verify> or untracked_task<Verify>
         ///
         /// ctsIOPatternStatus completed_task(const ctsIOTask&, unsigned long _current_transfer) throw()
         /// - a notification to the derived class over what task completed
@@ -150,8 +200,47 @@ namespace ctsTraffic {
         /// - returns a ctsIOPatternStatus back to the base class to indicate errors
         ///
         ///////////////////////////////////////////////////////////////////////////////////////////////////
-        virtual ctsIOTask next_task() = 0;
-        virtual ctsIOPatternStatus completed_task(const ctsIOTask&, unsigned long _current_transfer) throw() = 0;
+        template <typename Pattern, bool Tcp, VerifyPolicy Verify>
+        class ctsIOPatternPolicy;
+        template <typename Pattern, bool Tcp>
+        static std::shared_ptr<ctsIOPattern> MakeIOPatternPolicy();
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Private methods implementing ctsIOPatternPolicy
+        ///
+        /// initiate_io_policy / complete_io_policy are initiate_io / complete_io for the Pattern
+        /// - both take cs before calling into the Pattern
+        ///
+        /// new_task_policy returns a pre-populated task
+        /// - *not* setting the private ctsIOTask::tracked_io property
+        ///
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        template <typename Pattern, VerifyPolicy Verify>
+        ctsIOTask initiate_io_policy(Pattern& _pattern) throw();
+        template <typename Pattern, bool Tcp, VerifyPolicy Verify>
+        ctsIOPatternStatus complete_io_policy(Pattern& _pattern, const ctsIOTask& _original_task, unsigned long _current_transfer, unsigned long _status_code) throw();
+        template <VerifyPolicy Verify>
+        ctsIOTask new_task_policy(ctsIOTask::IOAction _action, unsigned long _max_transfer) throw();
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Private methods for the offloaded verification pipeline (-VerifyThreads)
+        ///
+        /// offload_verify() hands a completed recv buffer to the verifier threads
+        /// - the buffer is not returned to recv_buffer_free_list until VerifyCallback has checked it
+        /// - returns false if the request could not be queued (the caller must then verify inline)
+        ///
+        /// verify_must_wait() returns true when no more IO can be started until a verifier thread finishes
+        /// - when no recv buffer is free, or when the FIN is due but received buffers are still being verified
+        /// - initiate_io then returns no IO, holding an IO count on the socket until VerifyCallback resumes it
+        ///
+        /// both must be called with cs held
+        ///
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        bool offload_verify(const ctsIOTask& _task, unsigned long _transferred_bytes) throw();
+        bool verify_must_wait() const throw();
+        static void CALLBACK VerifyCallback(PTP_CALLBACK_INSTANCE, PVOID _context) throw();
 
         // CS memory guard for data within this object
         CRITICAL_SECTION cs;
@@ -187,6 +276,49 @@ namespace ctsTraffic {
         ctsUnsignedLongLong bytes_sending_per_quantum;
         ctsUnsignedLongLong bytes_sending_this_quantum;
         ctsUnsignedLongLong quantum_start_time_ms;
+        // tracking recv buffers currently handed to the verifier threads
+        // - verify_waiting is set while IO is paused on them: the verifier thread which ends that wait
+        //   resumes IO on verify_socket
+        std::weak_ptr<ctsSocket> verify_socket;
+        unsigned long verify_pending;
+        bool verify_offloaded;
+        bool verify_failed;
+        bool verify_waiting;
+        // running CRC32C values with -verify:checksum
+        // - the trailers are the final 4 bytes of the transfer, sent after the payload
+        unsigned long checksum_send;
+        unsigned long checksum_recv;
+        unsigned long checksum_send_trailer;
+        unsigned long checksum_recv_trailer;
+        // the per-connection policy, resolved once from ctsConfig in the c'tor
+        // - initiate_io / complete_io run for every IO, so branch on these instead of re-reading the global settings
+        // - the rate limit is fixed per connection: a -RateLimit range is only sampled once
+        const bool policy_tcp;
+        const bool policy_verify_buffers;
+        const bool policy_shared_buffer;
+        const ctsUnsignedLongLong policy_rate_limit_period;
+        // -RecvRateLimit / -RecvStallInterval: recvs are reposted only once the bytes received have drained
+        // - recv_drained_usec is when all bytes received so far will have drained at the configured rate
+        const long long policy_recv_bytes_per_second;
+        const unsigned long policy_recv_stall_interval_ms;
+        const unsigned long policy_recv_stall_time_ms;
+        long long recv_drained_usec;
+        long long recv_next_stall_usec;
+        // tracking sends pended on the peer (only for TCP statistics)
+        // - blocked time accrues while any send is in flight; the backlog is sampled as each send is posted
+        ctsTcpStatistics* tcp_stats;
+        ctsSizeT send_backlog_bytes;
+        unsigned long send_backlog_count;
+        long long send_blocked_start_usec;
+        // -Teardown:rst : the server's FIN recv completes with the client's RST instead of its FIN
+        // - teardown latency is timed from when this side requests the FIN until the peer's FIN (or RST) arrives
+        const bool policy_fin_accepts_reset;
+        long long teardown_start_usec;
+        // -Outliers : when this connection last completed an IO
+        const bool policy_track_progress;
+        long long last_io_usec;
+        // -Dscp : the class this connection's statistics are recorded against
+        const unsigned long traffic_class;
 
     protected:
         ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -200,8 +332,8 @@ namespace ctsTraffic {
 
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         ///
-        /// tracked_task(ctsIOTask::IOAction, unsigned long _max_transfer)
-        /// untracked_task(ctsIOTask::IOAction, unsigned long _max_transfer)
+        /// tracked_task<Verify>(ctsIOTask::IOAction, unsigned long _max_transfer)
+        /// untracked_task<Verify>(ctsIOTask::IOAction, unsigned long _max_transfer)
         ///
         /// - returns a ctsIOTask for the next transfer based on the IOAction
         /// - the returned buffer can be contained to maximum size with _max_transfer
@@ -210,8 +342,12 @@ namespace ctsTraffic {
         /// untracked_tasks will *not* count the IO towards the max_transfer
         /// untracked_tasks will *not* have their buffers validated on complete_io
         ///
+        /// Verify is the policy given to the derived class' next_task<Verify>
+        ///
         ///////////////////////////////////////////////////////////////////////////////////////////////////
+        template <VerifyPolicy Verify>
         ctsIOTask tracked_task(ctsIOTask::IOAction, unsigned long _max_transfer = 0);
+        template <VerifyPolicy Verify>
         ctsIOTask untracked_task(ctsIOTask::IOAction, unsigned long _max_transfer = 0);
 
         ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -232,6 +368,14 @@ namespace ctsTraffic {
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         bool verify_buffer(const ctsIOTask& _original_task, unsigned long _transferred_bytes);
 
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// With -verify:checksum, accumulates the CRC32C of the received bytes
+        /// - returns false once the full transfer has been received if the peer's trailer does not match
+        ///
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        bool verify_checksum(const ctsIOTask& _original_task, unsigned long _transferred_bytes);
+
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// Expose to the derived class the option to have a ctsIOTask sent OOB to the IO caller
@@ -283,6 +427,7 @@ namespace ctsTraffic {
     public:
         ctsIOPatternImpl(unsigned long _recv_count) : ctsIOPattern(_recv_count)
         {
+            this->tcp_stats = tcp_statistics(&this->stats);
         }
         virtual ~ctsIOPatternImpl() throw()
         {
@@ -306,9 +451,10 @@ namespace ctsTraffic {
         ///
         void end_pattern() throw()
         {
-            long long prior_end_time = stats.end_time.set_conditionally(ctl::ctTimer::snap_qpc_msec(), 0LL);
+            long long prior_end_time = stats.end_time.set_conditionally(ctl::ctTimer::snap_clock_msec(), 0LL);
             if (0LL == prior_end_time) {
                 ctsConfig::UpdateGlobalStats(stats);
+                ctsTrafficClass::RecordConnection(this->get_traffic_class(), stats);
             }
         }
         ///
@@ -316,6 +462,17 @@ namespace ctsTraffic {
         /// - the type is controlled by the caller as the class template type
         ///
         S stats;
+
+    private:
+        // the base class records send backpressure directly into TCP statistics
+        static ctsTcpStatistics* tcp_statistics(ctsTcpStatistics* _stats) throw()
+        {
+            return _stats;
+        }
+        static ctsTcpStatistics* tcp_statistics(ctsUdpStatistics*) throw()
+        {
+            return nullptr;
+        }
     };
 
 
@@ -333,7 +490,8 @@ namespace ctsTraffic {
         ctsIOPatternPull();
         ~ctsIOPatternPull() throw();
 
-        // required virtual functions
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
         ctsIOTask next_task();
         ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
 
@@ -355,7 +513,8 @@ namespace ctsTraffic {
         ctsIOPatternPush();
         ~ctsIOPatternPush() throw();
 
-        // required virtual functions
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
         ctsIOTask next_task();
         ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
 
@@ -378,6 +537,8 @@ namespace ctsTraffic {
         ctsIOPatternPushPull();
         ~ctsIOPatternPushPull() throw();
 
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
         ctsIOTask next_task();
         ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
 
@@ -388,10 +549,56 @@ namespace ctsTraffic {
         const bool listening;
 
         ctsUnsignedLong intra_segment_transfer;
-        bool io_needed;
+        // bytes of the current segment posted but not yet completed
+        ctsUnsignedLong intra_segment_inflight;
+        // up to -PrePostSends sends can be in flight within a segment; only one recv
+        ctsUnsignedLong send_needed;
+        bool recv_needed;
         bool sending;
     };
 
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///     - Pipelined PushPull Pattern (-PushPullPipeline)
+    ///    -- TCP-only
+    ///    -- The client pushes 'request' segments without waiting for each 'response' segment
+    ///       with up to -PushPullPipeline requests outstanding
+    ///    -- The server pulls each request segment, then pushes a response segment for it
+    ///    -- The client records the latency of each segment: from posting the first byte of the
+    ///       request until the last byte of its response was received
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsIOPatternPushPullPipelined : public ctsIOPatternImpl<ctsTcpStatistics> {
+    public:
+        ctsIOPatternPushPullPipelined();
+        ~ctsIOPatternPushPullPipelined() throw();
+
+        ctsIOTask next_task();
+        ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
+
+    private:
+        // segment sizes in the direction this side sends and receives
+        const unsigned long send_segment_size;
+        const unsigned long recv_segment_size;
+        const unsigned long pipeline_depth;
+        const bool listening;
+
+        // the total # of request/response segment pairs on this connection
+        ctsUnsignedLongLong segment_count;
+        // segments this side has started sending, and bytes posted within the current one
+        ctsUnsignedLongLong send_segments_started;
+        ctsUnsignedLong send_segment_posted;
+        // segments this side has fully received, and bytes received within the current one
+        ctsUnsignedLongLong recv_segments_completed;
+        ctsUnsignedLong recv_segment_received;
+
+        // client-only: the time each outstanding request was started (indexed by segment % pipeline_depth)
+        std::vector<long long> segment_start_usec;
+
+        ctsUnsignedLong send_needed;
+        bool recv_needed;
+    };
+
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///
     ///  - Duplex Pattern
@@ -405,7 +612,8 @@ namespace ctsTraffic {
         ctsIOPatternDuplex();
         ~ctsIOPatternDuplex() throw();
 
-        // required virtual functions
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
         ctsIOTask next_task();
         ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
 
@@ -417,6 +625,58 @@ namespace ctsTraffic {
         ctsUnsignedLong recv_needed;
     };
 
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///  - Message Pattern
+    ///    -- TCP-only
+    ///    -- The client pushes a stream of messages, each a 4 byte length header followed by
+    ///       -MessageSize payload bytes
+    ///    -- The server parses the stream, reassembling messages which span recvs and counting
+    ///       each message contained within a recv
+    ///    -- The server records the latency of each message: from the recv completing its first byte
+    ///       until the recv completing its last byte
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsIOPatternMessage : public ctsIOPatternImpl<ctsTcpStatistics> {
+    public:
+        static const unsigned long MessageHeaderSize = sizeof(unsigned long);
+
+        ctsIOPatternMessage();
+        ~ctsIOPatternMessage() throw();
+
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
+        ctsIOTask next_task();
+        ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
+
+    private:
+        // the client writes message headers into its own send buffers
+        // - one buffer for each send which can be in flight
+        void frame_messages(_Out_writes_(_length) char* _buffer, unsigned long _length) throw();
+
+        // returns false if the stream contained an invalid message header
+        bool parse_messages(_In_reads_(_length) const char* _buffer, unsigned long _length) throw();
+
+        const bool listening;
+
+        std::vector<char> send_buffer_container;
+        std::vector<char*> send_buffer_free_list;
+
+        // client: the bytes of the stream framed into send buffers so far
+        ctsUnsignedLongLong framed_bytes;
+        // server: the bytes of the stream parsed so far
+        ctsUnsignedLongLong parsed_bytes;
+
+        // the message currently being framed (client) or reassembled (server)
+        char message_header[MessageHeaderSize];
+        unsigned long message_header_bytes;
+        unsigned long message_payload_remaining;
+        long long message_start_usec;
+
+        ctsUnsignedLong send_needed;
+        bool recv_needed;
+    };
+
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///
@@ -432,7 +692,8 @@ namespace ctsTraffic {
         ctsIOPatternMediaStreamServer();
         ~ctsIOPatternMediaStreamServer() throw();
 
-        // required virtual functions
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
         ctsIOTask next_task();
         ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
 
@@ -462,7 +723,8 @@ namespace ctsTraffic {
         ctsIOPatternMediaStreamClient();
         ~ctsIOPatternMediaStreamClient() throw();
 
-        // required virtual functions
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
         ctsIOTask next_task();
         ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
 
@@ -535,4 +797,204 @@ namespace ctsTraffic {
         VOID CALLBACK StartCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER);
     };
 
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///  - UDP Datagram server
+    ///    -- Sends -PacketCount datagrams, each tagged with its sequence number
+    ///    -- Each datagram is -DatagramSize bytes (randomized per datagram when a range is given)
+    ///    -- Paces sends at -PacketRate datagrams per second, or sends as fast as possible
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsIOPatternDatagramServer : public ctsIOPatternImpl<ctsUdpStatistics> {
+    public:
+        ctsIOPatternDatagramServer();
+        ~ctsIOPatternDatagramServer() throw();
+
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
+        ctsIOTask next_task();
+        ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
+
+    private:
+        const unsigned long packet_count;
+        const unsigned long packets_per_second;
+        ctsUnsignedLong packets_requested;
+        ctsUnsignedLongLong bytes_requested;
+        ctsSignedLongLong base_time_milliseconds;
+    };
+
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///  - UDP Datagram client
+    ///    -- Sends a START message to the server to establish a 'connection'
+    ///    -- Counts datagrams received, lost, reordered and repeated by their sequence number
+    ///    -- Sends a DONE message to the server once every datagram was received
+    ///       or once the stream has gone idle
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsIOPatternDatagramClient : public ctsIOPatternImpl<ctsUdpStatistics> {
+    public:
+        ctsIOPatternDatagramClient();
+        ~ctsIOPatternDatagramClient() throw();
+
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
+        ctsIOTask next_task();
+        ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
+
+    private:
+        PTP_TIMER idle_timer;
+        // spans several of the server's inter-packet gaps so a slow -PacketRate isn't taken for an idle stream
+        const unsigned long idle_timer_milliseconds;
+
+        const unsigned long final_sequence_number;
+
+        ctsUnsignedLong recv_needed;
+        ctsUnsignedLong idle_timer_ticks;
+
+        // member variables that require the base lock
+        _Requires_lock_held_(cs)
+        unsigned long received_count;
+
+        _Requires_lock_held_(cs)
+        unsigned long received_at_last_tick;
+
+        _Requires_lock_held_(cs)
+        long long highest_sequence_number;
+
+        _Requires_lock_held_(cs)
+        bool finished;
+
+        _Requires_lock_held_(cs)
+        std::vector<bool> received_sequence_numbers;
+
+        // member functions which require the base lock
+        _Requires_lock_held_(cs)
+        void finish_stream() throw();
+
+        _Requires_lock_held_(cs)
+        void set_next_timer() throw();
+
+        /// Re-sends START until the server is heard from, then watches for the stream going idle
+        static
+        VOID CALLBACK IdleTimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER);
+    };
+
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///  - UDP Echo server
+    ///    -- Never initiates IO: ECHO probes are reflected by the protocol implementation
+    ///    -- Counts each reflected probe
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsIOPatternEchoServer : public ctsIOPatternImpl<ctsUdpStatistics> {
+    public:
+        ctsIOPatternEchoServer();
+        ~ctsIOPatternEchoServer() throw();
+
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
+        ctsIOTask next_task();
+        ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
+    };
+
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///  - UDP Echo client
+    ///    -- Sends -PacketCount timestamped ECHO probes of -DatagramSize bytes
+    ///    -- Paces probes at -PacketRate probes per second,
+    ///       or sends the next probe once the prior probe was echoed (or timed out)
+    ///    -- Records the round-trip time of every echoed probe, and counts probes lost, reordered and repeated
+    ///    -- Sends a DONE message to the server once every probe was echoed or timed out
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsIOPatternEchoClient : public ctsIOPatternImpl<ctsUdpStatistics> {
+    public:
+        ctsIOPatternEchoClient();
+        ~ctsIOPatternEchoClient() throw();
+
+        // required by ctsIOPatternPolicy
+        template <VerifyPolicy Verify>
+        ctsIOTask next_task();
+        ctsIOPatternStatus completed_task(const ctsIOTask& _task, unsigned long _current_transfer) throw();
+
+    private:
+        struct EchoProbe {
+            long long sequence_number;
+            long long send_time_usec;
+            bool sending;
+            bool echoed;
+            bool lost;
+        };
+
+        PTP_TIMER probe_timer;
+
+        const unsigned long probe_count;
+        const unsigned long probes_per_second;
+        const unsigned long probe_buffer_size;
+
+        ctsUnsignedLong recv_needed;
+
+        // member variables that require the base lock
+        _Requires_lock_held_(cs)
+        std::vector<EchoProbe> probes;
+
+        _Requires_lock_held_(cs)
+        std::vector<char> probe_buffers;
+
+        _Requires_lock_held_(cs)
+        std::vector<char> start_probe;
+
+        _Requires_lock_held_(cs)
+        long long base_time_usec;
+
+        _Requires_lock_held_(cs)
+        long long next_sequence_number;
+
+        _Requires_lock_held_(cs)
+        long long oldest_pending_sequence_number;
+
+        _Requires_lock_held_(cs)
+        long long highest_echoed_sequence_number;
+
+        _Requires_lock_held_(cs)
+        unsigned long resolved_count;
+
+        _Requires_lock_held_(cs)
+        unsigned long start_attempts;
+
+        _Requires_lock_held_(cs)
+        bool start_probe_sent;
+
+        _Requires_lock_held_(cs)
+        bool started;
+
+        _Requires_lock_held_(cs)
+        bool probe_ready;
+
+        _Requires_lock_held_(cs)
+        bool finished;
+
+        // member functions which require the base lock
+        _Requires_lock_held_(cs)
+        ctsIOTask build_probe() throw();
+
+        _Requires_lock_held_(cs)
+        void expire_probes(long long _now_usec) throw();
+
+        _Requires_lock_held_(cs)
+        void finish_stream() throw();
+
+        _Requires_lock_held_(cs)
+        void set_next_timer(unsigned long _milliseconds) throw();
+
+        /// Re-sends START until the server echoes back, then paces probes and times out those not echoed
+        static
+        VOID CALLBACK ProbeTimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID _context, PTP_TIMER);
+    };
+
 } //namespace
@@ -0,0 +1,304 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// parent header
+#include "ctsIoScheduler.h"
+// additional c++ headers
+#include <functional>
+#include <list>
+#include <unordered_map>
+// additional ctl headers
+#include <ctException.hpp>
+#include <ctLocks.hpp>
+// additional project headers
+#include "ctsConfig.h"
+#include "ctsSocket.h"
+#include "SocketFunctions\ctsSendRecvIocp.hpp"
+
+
+namespace ctsTraffic {
+    namespace ctsIoScheduler {
+
+        using namespace ctl;
+
+        // bytes credited to each connection in deficit per round with -IoScheduler:drr
+        static const long long DeficitQuantumBytes = 65536LL;
+        // connections a threadpool thread dispatches before resubmitting the remaining queue
+        // - so one threadpool thread isn't held indefinitely dispatching IO for other connections
+        static const unsigned long MaximumDispatchesPerThread = 64;
+
+        struct ReadyConnection {
+            // only used as a key: never dereferenced
+            const ctsSocket* key;
+            // distinguishes a new ctsSocket allocated at the address of one deleted while it was queued
+            unsigned long long connection_id;
+        };
+        struct ConnectionState {
+            ConnectionState() throw() : socket(), connection_id(0ULL), deficit_bytes(0LL), interval_bytes(0LL), queued_count(0UL)
+            {
+            }
+            std::weak_ptr<ctsSocket> socket;
+            unsigned long long connection_id;
+            long long deficit_bytes;
+            long long interval_bytes;
+            // the IO this connection is waiting to issue, each holding an IO refcount on its ctsSocket
+            // - while non-zero, the connection has exactly one entry in its shard's ready_connections
+            unsigned long queued_count;
+        };
+
+        ///
+        /// Connections are spread across one shard per processor, by the address of their ctsSocket
+        /// - each shard has its own lock, ready list and threadpool work, so shards schedule and dispatch concurrently
+        /// - the scheduling order is kept among the connections within each shard
+        ///
+        struct SchedulerShard {
+            CRITICAL_SECTION lock;
+            PTP_WORK dispatch_work;
+            // guarded by lock
+            // - connections take turns by moving from the front to the back of ready_connections
+            std::list<ReadyConnection> ready_connections;
+            std::unordered_map<const ctsSocket*, ConnectionState> connections;
+            unsigned long long next_connection_id;
+            bool dispatching;
+        };
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Singleton values used as the actual implementation for every connection
+        ///
+        /// publicly exposed callers invoke ::InitOnceExecuteOnce(&InitImpl, InitOncectsIoSchedulerImpl, NULL, NULL);
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        static SchedulerShard* Shards = nullptr;
+        static unsigned long ShardCount = 0;
+
+        static
+        VOID NTAPI ThreadPoolDispatchWorker(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) throw();
+
+        static INIT_ONCE InitImpl = INIT_ONCE_STATIC_INIT;
+        static
+        BOOL CALLBACK InitOncectsIoSchedulerImpl(PINIT_ONCE, PVOID, PVOID *)
+        {
+            SYSTEM_INFO system_info;
+            ::GetSystemInfo(&system_info);
+            ShardCount = system_info.dwNumberOfProcessors;
+            Shards = new SchedulerShard[ShardCount];
+
+            for (unsigned long shard = 0; shard < ShardCount; ++shard) {
+                if (!::InitializeCriticalSectionEx(&Shards[shard].lock, 4000, 0)) {
+                    ctAlwaysFatalCondition(L"InitializeCriticalSectionEx failed: %u", ::GetLastError());
+                }
+                Shards[shard].dispatch_work = ::CreateThreadpoolWork(ThreadPoolDispatchWorker, &Shards[shard], ctsConfig::Settings->PTPEnvironment);
+                if (nullptr == Shards[shard].dispatch_work) {
+                    ctAlwaysFatalCondition(L"CreateThreadpoolWork failed: %u", ::GetLastError());
+                }
+                Shards[shard].next_connection_id = 0ULL;
+                Shards[shard].dispatching = false;
+            }
+            return TRUE;
+        }
+        static
+        void ctsIoSchedulerInitOnce() throw()
+        {
+            if (!::InitOnceExecuteOnce(&InitImpl, InitOncectsIoSchedulerImpl, nullptr, nullptr)) {
+                ctAlwaysFatalCondition(L"ctsIoScheduler could not be instantiated");
+            }
+        }
+
+        static
+        SchedulerShard& ShardForConnection(const ctsSocket* _key) throw()
+        {
+            return Shards[std::hash<const ctsSocket*>()(_key) % ShardCount];
+        }
+
+        ///
+        /// Issues the connection's next IO, then releases the IO refcount the scheduler was holding
+        ///
+        static
+        void DispatchIo(const std::weak_ptr<ctsSocket>& _socket) throw()
+        {
+            auto shared_socket(_socket.lock());
+            ctsSocket* psocket = shared_socket.get();
+            if (nullptr == psocket) {
+                // the underlying socket went away - nothing to do
+                return;
+            }
+
+            ctsSendRecvIocp(_socket);
+            if (0 == psocket->decrement_io()) {
+                // all IO completed while this was queued
+                psocket->complete_state(NO_ERROR);
+            }
+        }
+
+        ///
+        /// Dispatches the shard's queued connections in scheduling order until none are waiting
+        /// - each turn reposts IO once: a connection with more completions waiting moves to the back of the list
+        ///   so with -IoScheduler:rr, connections with several completions waiting (e.g. -PrePostRecvs) take turns with the others
+        /// - must be called holding the shard's lock with dispatching set by this thread
+        ///
+        _Requires_lock_held_(_shard.lock)
+        static
+        void DispatchReadyConnections(SchedulerShard& _shard) throw()
+        {
+            unsigned long dispatched = 0;
+            while (!_shard.ready_connections.empty()) {
+                if (MaximumDispatchesPerThread == dispatched) {
+                    // leave dispatching set: the threadpool continues where this thread stopped
+                    ::SubmitThreadpoolWork(_shard.dispatch_work);
+                    return;
+                }
+
+                const ReadyConnection& next_connection = _shard.ready_connections.front();
+                auto found_state = _shard.connections.find(next_connection.key);
+                if (found_state == _shard.connections.end() || found_state->second.connection_id != next_connection.connection_id) {
+                    // its ctsSocket was deleted while queued
+                    _shard.ready_connections.pop_front();
+                    continue;
+                }
+
+                ConnectionState& state = found_state->second;
+                if (state.deficit_bytes < 0LL) {
+                    if (_shard.ready_connections.size() > 1) {
+                        // still in deficit: credit its quantum and let the other connections go first
+                        state.deficit_bytes += DeficitQuantumBytes;
+                        _shard.ready_connections.splice(_shard.ready_connections.end(), _shard.ready_connections, _shard.ready_connections.begin());
+                        continue;
+                    }
+                    // it's the only connection waiting: there's no one to yield to
+                    state.deficit_bytes = 0LL;
+                }
+
+                --state.queued_count;
+                if (state.queued_count > 0) {
+                    _shard.ready_connections.splice(_shard.ready_connections.end(), _shard.ready_connections, _shard.ready_connections.begin());
+                } else {
+                    _shard.ready_connections.pop_front();
+                }
+
+                // issue the IO outside the lock - IO completing inline can schedule more IO
+                // - copying the socket first, as the state can be erased once the lock is released
+                std::weak_ptr<ctsSocket> next_socket(state.socket);
+                ::LeaveCriticalSection(&_shard.lock);
+                DispatchIo(next_socket);
+                ++dispatched;
+                ::EnterCriticalSection(&_shard.lock);
+            }
+            _shard.dispatching = false;
+        }
+
+        static
+        VOID NTAPI ThreadPoolDispatchWorker(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) throw()
+        {
+            SchedulerShard* shard = static_cast<SchedulerShard*>(_context);
+            ::EnterCriticalSection(&shard->lock);
+            DispatchReadyConnections(*shard);
+            ::LeaveCriticalSection(&shard->lock);
+        }
+
+        void ScheduleIo(const std::weak_ptr<ctsSocket>& _socket, unsigned long _bytes_transferred) throw()
+        {
+            ctsIoSchedulerInitOnce();
+
+            auto shared_socket(_socket.lock());
+            if (!shared_socket) {
+                // the underlying socket went away - nothing to do
+                return;
+            }
+
+            SchedulerShard& shard = ShardForConnection(shared_socket.get());
+            ::EnterCriticalSection(&shard.lock);
+            try {
+                ConnectionState& state = shard.connections[shared_socket.get()];
+                if (0ULL == state.connection_id) {
+                    state.socket = _socket;
+                    state.connection_id = ++shard.next_connection_id;
+                }
+                state.interval_bytes += _bytes_transferred;
+
+                if (ctsConfig::IoSchedulerType::FifoScheduler != ctsConfig::Settings->IoScheduler) {
+                    if (ctsConfig::IoSchedulerType::DeficitRoundRobinScheduler == ctsConfig::Settings->IoScheduler) {
+                        state.deficit_bytes -= _bytes_transferred;
+                    }
+                    // a connection already waiting keeps its place: the IO is dispatched on one of its turns
+                    if (0UL == state.queued_count) {
+                        ReadyConnection ready_connection = { shared_socket.get(), state.connection_id };
+                        shard.ready_connections.push_back(ready_connection);
+                    }
+                    ++state.queued_count;
+
+                    if (!shard.dispatching) {
+                        // always dispatching from the threadpool: the caller is an IO completion holding
+                        // - its own socket lock, which must not be held while issuing IO for other connections
+                        shard.dispatching = true;
+                        ::SubmitThreadpoolWork(shard.dispatch_work);
+                    }
+                    ::LeaveCriticalSection(&shard.lock);
+                    return;
+                }
+            }
+            catch (const std::bad_alloc&) {
+                // fall through to issuing IO directly if can't track this connection
+            }
+            ::LeaveCriticalSection(&shard.lock);
+
+            // fifo: repost IO directly on this thread, in the order completions arrive
+            DispatchIo(_socket);
+        }
+
+        void RemoveConnection(const ctsSocket* _socket) throw()
+        {
+            ctsIoSchedulerInitOnce();
+
+            SchedulerShard& shard = ShardForConnection(_socket);
+            ctAutoReleaseCriticalSection auto_lock(&shard.lock);
+            shard.connections.erase(_socket);
+        }
+
+        ctsFairnessStatistics SnapFairness(bool _clear_settings) throw()
+        {
+            ctsIoSchedulerInitOnce();
+
+            ctsFairnessStatistics fairness = { 0LL, 0.0 };
+            double sum_bytes = 0.0;
+            double sum_squared_bytes = 0.0;
+
+            for (unsigned long shard = 0; shard < ShardCount; ++shard) {
+                ctAutoReleaseCriticalSection auto_lock(&Shards[shard].lock);
+                auto& connections = Shards[shard].connections;
+                for (auto connection = connections.begin(); connection != connections.end();) {
+                    const double bytes = static_cast<double>(connection->second.interval_bytes);
+                    sum_bytes += bytes;
+                    sum_squared_bytes += bytes * bytes;
+                    ++fairness.flows;
+
+                    if (_clear_settings) {
+                        // connections with no activity for a full interval (and none pending) are no longer tracked
+                        if (0LL == connection->second.interval_bytes && 0UL == connection->second.queued_count) {
+                            connection = connections.erase(connection);
+                            continue;
+                        }
+                        connection->second.interval_bytes = 0LL;
+                    }
+                    ++connection;
+                }
+            }
+
+            // J = (sum x)^2 / (n * sum x^2)
+            if (sum_squared_bytes > 0.0) {
+                fairness.fairness_index = (sum_bytes * sum_bytes) / (static_cast<double>(fairness.flows) * sum_squared_bytes);
+            }
+            return fairness;
+        }
+    }
+}
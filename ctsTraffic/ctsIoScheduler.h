@@ -0,0 +1,72 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <memory>
+// os headers
+#include <windows.h>
+
+
+namespace ctsTraffic {
+
+    /// forward declare ctsSocket
+    /// - can't include ctsSocket.h in this header to avoid circular declarations
+    class ctsSocket;
+
+    ///
+    /// ctsIoScheduler orders which connections issue their next IO once a prior IO completes (-IoScheduler)
+    /// - without it, each completion immediately reposts IO for its own connection, so connections
+    ///   whose completions arrive first (and most often) can starve the others
+    ///
+    /// Connections wanting more IO are queued, and are dispatched from the threadpool in one of these orders:
+    /// - fifo : in completion order (IO is reposted exactly as without a scheduler)
+    /// - rr : round-robin, each queued connection reposts IO once per round, however many completions it has waiting
+    ///        (this only differs from fifo when connections have several completions waiting, e.g. -PrePostRecvs)
+    /// - drr : deficit round-robin, each connection is charged the bytes it transferred, and must wait
+    ///         rounds (each crediting it a quantum of bytes) until it is no longer in deficit
+    ///
+    /// Connections are sharded across one dispatcher per processor, each with its own lock
+    /// - rounds are taken among the connections sharing a dispatcher
+    ///
+    /// The bytes each connection transferred are tracked to report Jain's fairness index per status interval
+    ///
+    namespace ctsIoScheduler {
+
+        ///
+        /// Queues the connection to issue its next IO, charging it the bytes just transferred
+        /// - the caller must have called ctsSocket::increment_io for the scheduler to hold until IO is issued
+        ///
+        void ScheduleIo(const std::weak_ptr<ctsSocket>& _socket, unsigned long _bytes_transferred) throw();
+
+        ///
+        /// Stops tracking the connection as its ctsSocket is deleted
+        /// - so a new ctsSocket allocated at the same address does not inherit its deficit and bytes
+        ///
+        void RemoveConnection(const ctsSocket* _socket) throw();
+
+        struct ctsFairnessStatistics {
+            // the # of connections which transferred data (or were waiting to) within the interval
+            long long flows;
+            // Jain's fairness index of the bytes each flow transferred: 1.0 when all are equal, 1/flows when one flow has all
+            double fairness_index;
+        };
+
+        ///
+        /// Returns the fairness of the bytes transferred since the last snap
+        /// - only resetting the per-connection counts if the _In_ bool is true
+        ///
+        ctsFairnessStatistics SnapFairness(bool _clear_settings) throw();
+    }
+}
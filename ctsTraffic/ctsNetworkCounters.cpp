@@ -0,0 +1,227 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// parent header
+#include "ctsNetworkCounters.h"
+// additional c++ headers
+#include <algorithm>
+// additional os headers
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <iphlpapi.h>
+// additional ctl headers
+#include <ctException.hpp>
+#include <ctLocks.hpp>
+// additional project headers
+#include "ctsConfig.h"
+
+
+namespace ctsTraffic {
+    namespace ctsNetworkCounters {
+
+        using namespace ctl;
+
+        struct InterfaceCounters {
+            ULONG64 luid;
+            // the absolute counter values, in the same form as the deltas returned to the caller
+            ctsInterfaceCounterDeltas values;
+        };
+
+        struct StackCounters {
+            // the stack reports these as 32-bit counters: deltas are taken with unsigned 32-bit math to survive wrapping
+            DWORD tcp_retransmitted_segments;
+            DWORD udp_receive_errors;
+        };
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Singleton values used as the actual implementation for every snap
+        ///
+        /// publicly exposed callers invoke ::InitOnceExecuteOnce(&InitImpl, InitOncectsNetworkCountersImpl, NULL, NULL);
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        static CRITICAL_SECTION CountersLock;
+        // guarded by CountersLock
+        static std::vector<InterfaceCounters>* PriorInterfaceCounters = nullptr;
+        static StackCounters PriorStackCounters;
+
+        static INIT_ONCE InitImpl = INIT_ONCE_STATIC_INIT;
+        static
+        BOOL CALLBACK InitOncectsNetworkCountersImpl(PINIT_ONCE, PVOID, PVOID *)
+        {
+            if (!::InitializeCriticalSectionEx(&CountersLock, 4000, 0)) {
+                ctAlwaysFatalCondition(L"InitializeCriticalSectionEx failed: %u", ::GetLastError());
+            }
+            PriorInterfaceCounters = new std::vector<InterfaceCounters>;
+            ::ZeroMemory(&PriorStackCounters, sizeof(PriorStackCounters));
+            return TRUE;
+        }
+        static
+        void ctsNetworkCountersInitOnce() throw()
+        {
+            if (!::InitOnceExecuteOnce(&InitImpl, InitOncectsNetworkCountersImpl, nullptr, nullptr)) {
+                ctAlwaysFatalCondition(L"ctsNetworkCounters could not be instantiated");
+            }
+        }
+
+        ///
+        /// reads the current counters of every interface which is up, filtered by -NetCounters
+        /// - can throw std::bad_alloc
+        ///
+        static
+        std::vector<InterfaceCounters> ReadInterfaceCounters()
+        {
+            std::vector<InterfaceCounters> counters;
+
+            PMIB_IF_TABLE2 if_table = nullptr;
+            DWORD error = ::GetIfTable2(&if_table);
+            if (error != NO_ERROR) {
+                ctsConfig::PrintErrorIfFailed(L"GetIfTable2", error);
+                return counters;
+            }
+
+            try {
+                for (ULONG row = 0; row < if_table->NumEntries; ++row) {
+                    const MIB_IF_ROW2& if_row = if_table->Table[row];
+                    if (if_row.OperStatus != IfOperStatusUp) {
+                        continue;
+                    }
+                    if (ctsConfig::NetCounterType::PhysicalInterfaces == ctsConfig::Settings->NetCounters &&
+                        !if_row.InterfaceAndOperStatusFlags.HardwareInterface) {
+                        continue;
+                    }
+                    // GetIfTable2 lists the filter and miniport layers of an adapter as separate rows under the same Luid
+                    if (std::any_of(counters.begin(), counters.end(), [&] (const InterfaceCounters& _counters) {
+                        return _counters.luid == if_row.InterfaceLuid.Value;
+                    })) {
+                        continue;
+                    }
+
+                    InterfaceCounters if_counters;
+                    if_counters.luid = if_row.InterfaceLuid.Value;
+                    if_counters.values.alias = if_row.Alias;
+                    if_counters.values.rx_packets = if_row.InUcastPkts + if_row.InNUcastPkts;
+                    if_counters.values.rx_bytes = if_row.InOctets;
+                    if_counters.values.rx_discards = if_row.InDiscards;
+                    if_counters.values.rx_errors = if_row.InErrors;
+                    if_counters.values.tx_packets = if_row.OutUcastPkts + if_row.OutNUcastPkts;
+                    if_counters.values.tx_bytes = if_row.OutOctets;
+                    if_counters.values.tx_discards = if_row.OutDiscards;
+                    if_counters.values.tx_errors = if_row.OutErrors;
+                    counters.push_back(if_counters);
+                }
+            }
+            catch (...) {
+                ::FreeMibTable(if_table);
+                throw;
+            }
+
+            ::FreeMibTable(if_table);
+            return counters;
+        }
+
+        ///
+        /// reads the current TCP and UDP counters, summed across both address families
+        ///
+        static
+        StackCounters ReadStackCounters() throw()
+        {
+            StackCounters counters;
+            ::ZeroMemory(&counters, sizeof(counters));
+
+            const ULONG families[] = { AF_INET, AF_INET6 };
+            for (const auto& family : families) {
+                MIB_TCPSTATS tcp_stats;
+                DWORD error = ::GetTcpStatisticsEx(&tcp_stats, family);
+                if (NO_ERROR == error) {
+                    counters.tcp_retransmitted_segments += tcp_stats.dwRetransSegs;
+                } else {
+                    ctsConfig::PrintErrorIfFailed(L"GetTcpStatisticsEx", error);
+                }
+
+                MIB_UDPSTATS udp_stats;
+                error = ::GetUdpStatisticsEx(&udp_stats, family);
+                if (NO_ERROR == error) {
+                    counters.udp_receive_errors += udp_stats.dwInErrors;
+                } else {
+                    ctsConfig::PrintErrorIfFailed(L"GetUdpStatisticsEx", error);
+                }
+            }
+            return counters;
+        }
+
+        void Start() throw()
+        {
+            if (ctsConfig::NetCounterType::NoNetCounters == ctsConfig::Settings->NetCounters) {
+                return;
+            }
+            ctsNetworkCountersInitOnce();
+
+            ctAutoReleaseCriticalSection auto_lock(&CountersLock);
+            try {
+                *PriorInterfaceCounters = ReadInterfaceCounters();
+            }
+            catch (const std::bad_alloc&) {
+                // the first snap will then report interfaces from their own baseline
+                PriorInterfaceCounters->clear();
+            }
+            PriorStackCounters = ReadStackCounters();
+        }
+
+        ctsNetworkCounterDeltas SnapDeltas()
+        {
+            ctsNetworkCountersInitOnce();
+
+            ctsNetworkCounterDeltas deltas;
+            std::vector<InterfaceCounters> current_interface_counters(ReadInterfaceCounters());
+            const StackCounters current_stack_counters(ReadStackCounters());
+
+            ctAutoReleaseCriticalSection auto_lock(&CountersLock);
+            for (const auto& current : current_interface_counters) {
+                auto prior = std::find_if(PriorInterfaceCounters->begin(), PriorInterfaceCounters->end(), [&] (const InterfaceCounters& _counters) {
+                    return _counters.luid == current.luid;
+                });
+                // an interface which came up since the prior snap is reported from a zero baseline
+                // - as is an interface whose counters were reset
+                ctsInterfaceCounterDeltas baseline = ctsInterfaceCounterDeltas();
+                if (prior != PriorInterfaceCounters->end() &&
+                    current.values.rx_bytes >= prior->values.rx_bytes &&
+                    current.values.tx_bytes >= prior->values.tx_bytes) {
+                    baseline = prior->values;
+                }
+
+                ctsInterfaceCounterDeltas interface_deltas(current.values);
+                interface_deltas.rx_packets -= baseline.rx_packets;
+                interface_deltas.rx_bytes -= baseline.rx_bytes;
+                interface_deltas.rx_discards -= baseline.rx_discards;
+                interface_deltas.rx_errors -= baseline.rx_errors;
+                interface_deltas.tx_packets -= baseline.tx_packets;
+                interface_deltas.tx_bytes -= baseline.tx_bytes;
+                interface_deltas.tx_discards -= baseline.tx_discards;
+                interface_deltas.tx_errors -= baseline.tx_errors;
+                if (interface_deltas.rx_packets != 0 || interface_deltas.tx_packets != 0 ||
+                    interface_deltas.rx_discards != 0 || interface_deltas.tx_discards != 0 ||
+                    interface_deltas.rx_errors != 0 || interface_deltas.tx_errors != 0) {
+                    deltas.interfaces.push_back(interface_deltas);
+                }
+            }
+            deltas.tcp_retransmitted_segments = static_cast<DWORD>(current_stack_counters.tcp_retransmitted_segments - PriorStackCounters.tcp_retransmitted_segments);
+            deltas.udp_receive_errors = static_cast<DWORD>(current_stack_counters.udp_receive_errors - PriorStackCounters.udp_receive_errors);
+
+            // the current counters are the baseline for the next snap
+            PriorInterfaceCounters->swap(current_interface_counters);
+            PriorStackCounters = current_stack_counters;
+            return deltas;
+        }
+    }
+}
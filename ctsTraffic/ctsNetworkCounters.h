@@ -0,0 +1,68 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <string>
+#include <vector>
+// os headers
+#include <windows.h>
+
+
+namespace ctsTraffic {
+
+    ///
+    /// ctsNetworkCounters snaps interface and TCP/IP stack counters for -NetCounters
+    /// - each snap returns the change in every counter since the prior snap
+    ///   (or since Start for the first snap) so a status interval can be matched with what the stack and the NICs saw
+    ///
+    /// interface counters are read from GetIfTable2: only interfaces which are operationally up are reported
+    /// stack counters are read from GetTcpStatisticsEx and GetUdpStatisticsEx, summed across IPv4 and IPv6
+    ///
+    namespace ctsNetworkCounters {
+
+        struct ctsInterfaceCounterDeltas {
+            std::wstring alias;
+            unsigned long long rx_packets;
+            unsigned long long rx_bytes;
+            unsigned long long rx_discards;
+            unsigned long long rx_errors;
+            unsigned long long tx_packets;
+            unsigned long long tx_bytes;
+            unsigned long long tx_discards;
+            unsigned long long tx_errors;
+        };
+
+        struct ctsNetworkCounterDeltas {
+            std::vector<ctsInterfaceCounterDeltas> interfaces;
+            // segments the TCP stack retransmitted
+            unsigned long long tcp_retransmitted_segments;
+            // datagrams UDP couldn't deliver for reasons other than no listening port - including a full receive buffer
+            unsigned long long udp_receive_errors;
+        };
+
+        ///
+        /// Takes the baseline which the first SnapDeltas is measured against
+        /// - a no-op unless -NetCounters was specified
+        ///
+        void Start() throw();
+
+        ///
+        /// Returns the counter deltas since the prior snap
+        /// - interfaces with no change in any counter are not returned
+        /// - can throw std::bad_alloc
+        ///
+        ctsNetworkCounterDeltas SnapDeltas();
+    }
+}
@@ -25,6 +25,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctString.hpp>
 // project headers
 #include "ctsConfig.h"
+#include "ctsIoScheduler.h"
 
 
 namespace ctsTraffic {
@@ -467,6 +468,210 @@ namespace ctsTraffic {
         static const unsigned long ErrorFramesLength = 7;
     };
 
+    class ctsDatagramStatusInformation : public ctsStatusInformation {
+    public:
+        ctsDatagramStatusInformation() throw()
+        {
+        }
+        ~ctsDatagramStatusInformation() throw()
+        {
+        }
+
+        ///
+        /// Pure-Virtual functions required to be defined
+        ///
+        LPCWSTR format_legend() throw()
+        {
+            return
+                L"Legend:\n"
+                L"* TimeSlice - (seconds) cumulative runtime\n"
+                L"* Packets/Sec - datagrams sent (server) or received (client) per second within the TimeSlice period\n"
+                L"* Bits/Sec - bits streamed within the TimeSlice period\n"
+                L"* Datagrams - count of datagrams sent (server) or received (client) within the TimeSlice\n"
+                L"* Lost - count of sequence numbers skipped within the TimeSlice\n"
+                L"* Reordered - count of datagrams received after a later sequence number within the TimeSlice\n"
+                L"  (a reordered datagram is no longer counted as Lost)\n"
+                L"* Errors - count of repeated or invalid datagrams within the TimeSlice\n"
+                L"\n";
+        }
+
+        LPCWSTR format_header(ctsConfig::StatusFormatting _format) throw()
+        {
+            if (ctsConfig::StatusFormatting::Csv == _format) {
+                return
+                    L"TimeSlice,Packets/Sec,Bits/Sec,Datagrams,Lost,Reordered,Errors\n";
+
+            } else {
+                /// Formatted to fit on an 80-column command shell
+                return
+                    L" TimeSlice   Packets/Sec      Bits/Sec  Datagrams      Lost  Reordered   Errors \n";
+                ///   00000000.0..000000000000..00000000000000..000000000..00000000..000000000..0000000
+                ///   1   5    0    5    0    5    0    5    0    5    0    5    0    5    0    5    0
+                ///           10        20        30        40        50        60        70        80
+            }
+        }
+
+        PrintingStatus format_data(ctsConfig::StatusFormatting _format, long long _current_time, bool _clear_status) throw()
+        {
+            ctsUdpStatistics udp_data(ctsConfig::Settings->UdpStatusDetails.snap_view(_clear_status));
+            long long time_elapsed = udp_data.end_time.get() - udp_data.start_time.get();
+            long long packets_per_second = (time_elapsed > 0LL) ? static_cast<long long>(udp_data.successful_frames.get() * 1000LL / time_elapsed) : 0LL;
+            long long bits_per_second = (time_elapsed > 0LL) ? static_cast<long long>(udp_data.bits_received.get() * 1000LL / time_elapsed) : 0LL;
+            long long error_count = udp_data.duplicate_frames.get() + udp_data.error_frames.get();
+
+            if (ctsConfig::StatusFormatting::Csv == _format) {
+                unsigned long characters_written = 0;
+                // converting milliseconds to seconds before printing
+                characters_written += this->append_csvoutput(characters_written, TimeSliceLength, static_cast<float>(_current_time / 1000.0));
+                characters_written += this->append_csvoutput(characters_written, PacketsPerSecondLength, packets_per_second);
+                characters_written += this->append_csvoutput(characters_written, BitsPerSecondLength, bits_per_second);
+                characters_written += this->append_csvoutput(characters_written, DatagramsLength, udp_data.successful_frames.get());
+                characters_written += this->append_csvoutput(characters_written, LostLength, udp_data.dropped_frames.get());
+                characters_written += this->append_csvoutput(characters_written, ReorderedLength, udp_data.reordered_frames.get());
+                characters_written += this->append_csvoutput(characters_written, ErrorsLength, error_count, false); // no comma at the end
+                this->terminate_string(characters_written);
+
+            } else {
+                // converting milliseconds to seconds before printing
+                this->right_justify_output(TimeSliceOffset, TimeSliceLength, static_cast<float>(_current_time / 1000.0));
+                this->right_justify_output(PacketsPerSecondOffset, PacketsPerSecondLength, packets_per_second);
+                this->right_justify_output(BitsPerSecondOffset, BitsPerSecondLength, bits_per_second);
+                this->right_justify_output(DatagramsOffset, DatagramsLength, udp_data.successful_frames.get());
+                this->right_justify_output(LostOffset, LostLength, udp_data.dropped_frames.get());
+                this->right_justify_output(ReorderedOffset, ReorderedLength, udp_data.reordered_frames.get());
+                this->right_justify_output(ErrorsOffset, ErrorsLength, error_count);
+                this->terminate_string(ErrorsOffset);
+            }
+            return PrintComplete;
+        }
+
+
+    private:
+        // constant offsets for each numeric value to print
+        static const unsigned long TimeSliceOffset = 10;
+        static const unsigned long TimeSliceLength = 10;
+
+        static const unsigned long PacketsPerSecondOffset = 24;
+        static const unsigned long PacketsPerSecondLength = 12;
+
+        static const unsigned long BitsPerSecondOffset = 38;
+        static const unsigned long BitsPerSecondLength = 12;
+
+        static const unsigned long DatagramsOffset = 49;
+        static const unsigned long DatagramsLength = 9;
+
+        static const unsigned long LostOffset = 59;
+        static const unsigned long LostLength = 8;
+
+        static const unsigned long ReorderedOffset = 70;
+        static const unsigned long ReorderedLength = 9;
+
+        static const unsigned long ErrorsOffset = 79;
+        static const unsigned long ErrorsLength = 7;
+    };
+
+    class ctsEchoStatusInformation : public ctsStatusInformation {
+    public:
+        ctsEchoStatusInformation() throw()
+        {
+        }
+        ~ctsEchoStatusInformation() throw()
+        {
+        }
+
+        ///
+        /// Pure-Virtual functions required to be defined
+        ///
+        LPCWSTR format_legend() throw()
+        {
+            return
+                L"Legend:\n"
+                L"* TimeSlice - (seconds) cumulative runtime\n"
+                L"* Probes/Sec - probes echoed (client) or reflected (server) per second within the TimeSlice period\n"
+                L"* Lost - count of probes not echoed within their timeout within the TimeSlice\n"
+                L"* Reordered - count of probes echoed after a later sequence number within the TimeSlice\n"
+                L"* P50(us) - (microseconds) the median round-trip time of probes echoed within the TimeSlice\n"
+                L"* P99(us) - (microseconds) the 99th percentile round-trip time of probes echoed within the TimeSlice\n"
+                L"* Max(us) - (microseconds) the largest round-trip time of probes echoed within the TimeSlice\n"
+                L"* Errors - count of repeated or invalid echoes within the TimeSlice\n"
+                L"\n";
+        }
+
+        LPCWSTR format_header(ctsConfig::StatusFormatting _format) throw()
+        {
+            if (ctsConfig::StatusFormatting::Csv == _format) {
+                return
+                    L"TimeSlice,Probes/Sec,Lost,Reordered,P50(us),P99(us),Max(us),Errors\n";
+
+            } else {
+                /// Formatted to fit on an 80-column command shell
+                return
+                    L" TimeSlice  Probes/Sec     Lost  Reordered  P50(us)  P99(us)  Max(us)  Errors \n";
+                ///   00000000.0.00000000000.00000000.0000000000.00000000.00000000.00000000.0000000
+                ///   1   5    0    5    0    5    0    5    0    5    0    5    0    5    0    5    0
+                ///           10        20        30        40        50        60        70        80
+            }
+        }
+
+        PrintingStatus format_data(ctsConfig::StatusFormatting _format, long long _current_time, bool _clear_status) throw()
+        {
+            ctsUdpStatistics udp_data(ctsConfig::Settings->UdpStatusDetails.snap_view(_clear_status));
+            long long time_elapsed = udp_data.end_time.get() - udp_data.start_time.get();
+            long long probes_per_second = (time_elapsed > 0LL) ? static_cast<long long>(udp_data.successful_frames.get() * 1000LL / time_elapsed) : 0LL;
+            long long error_count = udp_data.duplicate_frames.get() + udp_data.error_frames.get();
+
+            if (ctsConfig::StatusFormatting::Csv == _format) {
+                unsigned long characters_written = 0;
+                // converting milliseconds to seconds before printing
+                characters_written += this->append_csvoutput(characters_written, TimeSliceLength, static_cast<float>(_current_time / 1000.0));
+                characters_written += this->append_csvoutput(characters_written, ProbesPerSecondLength, probes_per_second);
+                characters_written += this->append_csvoutput(characters_written, LostLength, udp_data.dropped_frames.get());
+                characters_written += this->append_csvoutput(characters_written, ReorderedLength, udp_data.reordered_frames.get());
+                characters_written += this->append_csvoutput(characters_written, RoundTripLength, udp_data.round_trip_usec.percentile(50.0));
+                characters_written += this->append_csvoutput(characters_written, RoundTripLength, udp_data.round_trip_usec.percentile(99.0));
+                characters_written += this->append_csvoutput(characters_written, RoundTripLength, udp_data.round_trip_usec.maximum());
+                characters_written += this->append_csvoutput(characters_written, ErrorsLength, error_count, false); // no comma at the end
+                this->terminate_string(characters_written);
+
+            } else {
+                // converting milliseconds to seconds before printing
+                this->right_justify_output(TimeSliceOffset, TimeSliceLength, static_cast<float>(_current_time / 1000.0));
+                this->right_justify_output(ProbesPerSecondOffset, ProbesPerSecondLength, probes_per_second);
+                this->right_justify_output(LostOffset, LostLength, udp_data.dropped_frames.get());
+                this->right_justify_output(ReorderedOffset, ReorderedLength, udp_data.reordered_frames.get());
+                this->right_justify_output(RoundTripMedianOffset, RoundTripLength, udp_data.round_trip_usec.percentile(50.0));
+                this->right_justify_output(RoundTripTailOffset, RoundTripLength, udp_data.round_trip_usec.percentile(99.0));
+                this->right_justify_output(RoundTripMaximumOffset, RoundTripLength, udp_data.round_trip_usec.maximum());
+                this->right_justify_output(ErrorsOffset, ErrorsLength, error_count);
+                this->terminate_string(ErrorsOffset);
+            }
+            return PrintComplete;
+        }
+
+
+    private:
+        // constant offsets for each numeric value to print
+        static const unsigned long TimeSliceOffset = 10;
+        static const unsigned long TimeSliceLength = 10;
+
+        static const unsigned long ProbesPerSecondOffset = 22;
+        static const unsigned long ProbesPerSecondLength = 11;
+
+        static const unsigned long LostOffset = 31;
+        static const unsigned long LostLength = 8;
+
+        static const unsigned long ReorderedOffset = 42;
+        static const unsigned long ReorderedLength = 10;
+
+        static const unsigned long RoundTripMedianOffset = 51;
+        static const unsigned long RoundTripTailOffset = 60;
+        static const unsigned long RoundTripMaximumOffset = 69;
+        static const unsigned long RoundTripLength = 8;
+
+        static const unsigned long ErrorsOffset = 77;
+        static const unsigned long ErrorsLength = 7;
+    };
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
@@ -637,5 +842,226 @@ namespace ctsTraffic {
         static const int DetailedAddressLength = 46;
     };
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Print function for TCP connections when an -IoScheduler is set
+    /// - replaces the completed count with the fairness of the bytes transferred across connections
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsFairnessStatusInformation : public ctsStatusInformation {
+    public:
+        ctsFairnessStatusInformation() throw() : ctsStatusInformation()
+        {
+        }
+        ~ctsFairnessStatusInformation() throw()
+        {
+        }
+
+        PrintingStatus format_data(ctsConfig::StatusFormatting _format, long long _current_time, bool _clear_status) throw()
+        {
+            ctsTcpStatistics tcp_data(ctsConfig::Settings->TcpStatusDetails.snap_view(_clear_status));
+            ctsConnectionStatistics connection_data(ctsConfig::Settings->ConnectionStatusDetails.snap_view(_clear_status));
+            ctsIoScheduler::ctsFairnessStatistics fairness(ctsIoScheduler::SnapFairness(_clear_status));
+
+            long long time_elapsed = tcp_data.end_time.get() - tcp_data.start_time.get();
+            long long send_bytes_per_second = (time_elapsed > 0LL) ? tcp_data.bytes_sent.get() * 1000LL / time_elapsed : 0LL;
+            long long recv_bytes_per_second = (time_elapsed > 0LL) ? tcp_data.bytes_recv.get() * 1000LL / time_elapsed : 0LL;
+            long long error_count = connection_data.connection_error_count.get() + connection_data.protocol_error_count.get();
+
+            if (ctsConfig::StatusFormatting::Csv == _format) {
+                unsigned long characters_written = 0;
+                // converting milliseconds to seconds before printing
+                characters_written += this->append_csvoutput(characters_written, TimeSliceLength, static_cast<float>(_current_time / 1000.0));
+                characters_written += this->append_csvoutput(characters_written, SendBytesPerSecondLength, send_bytes_per_second);
+                characters_written += this->append_csvoutput(characters_written, RecvBytesPerSecondLength, recv_bytes_per_second);
+                characters_written += this->append_csvoutput(characters_written, CurrentTransactionsLength, connection_data.active_connection_count.get());
+                characters_written += this->append_csvoutput(characters_written, FlowsLength, fairness.flows);
+                characters_written += this->append_csvoutput(characters_written, FairnessLength, static_cast<float>(fairness.fairness_index));
+                characters_written += this->append_csvoutput(characters_written, ErrorsLength, error_count, false); // no comma at the end
+                this->terminate_string(characters_written);
+
+            } else {
+                // converting milliseconds to seconds before printing
+                this->right_justify_output(TimeSliceOffset, TimeSliceLength, static_cast<float>(_current_time / 1000.0));
+                this->right_justify_output(SendBytesPerSecondOffset, SendBytesPerSecondLength, send_bytes_per_second);
+                this->right_justify_output(RecvBytesPerSecondOffset, RecvBytesPerSecondLength, recv_bytes_per_second);
+                this->right_justify_output(CurrentTransactionsOffset, CurrentTransactionsLength, connection_data.active_connection_count.get());
+                this->right_justify_output(FlowsOffset, FlowsLength, fairness.flows);
+                this->right_justify_output(FairnessOffset, FairnessLength, static_cast<float>(fairness.fairness_index));
+                this->right_justify_output(ErrorsOffset, ErrorsLength, error_count);
+                this->terminate_string(ErrorsOffset);
+            }
+
+            return PrintComplete;
+        }
+
+        LPCWSTR format_legend() throw()
+        {
+            return
+                L"Legend:\n"
+                L"* TimeSlice - (seconds) cumulative runtime\n"
+                L"* Send & Recv Rates - bytes/sec that were transferred within the TimeSlice period\n"
+                L"* In-Flight - count of established connections transmitting IO pattern data\n"
+                L"* Flows - count of connections which transferred data (or were waiting to) within the TimeSlice\n"
+                L"* Fairness - Jain's fairness index of the bytes each of those connections transferred within the TimeSlice\n"
+                L"  (1.000 when all transferred the same, down to 1/Flows when one connection transferred everything)\n"
+                L"* Errors - cumulative count of failed IO patterns due to Winsock errors or data errors\n"
+                L"\n";
+        }
+
+        LPCWSTR format_header(ctsConfig::StatusFormatting _format) throw()
+        {
+            if (ctsConfig::StatusFormatting::Csv == _format) {
+                return
+                    L"TimeSlice,SendBps,RecvBps,In-Flight,Flows,Fairness,Errors\n";
+
+            } else {
+                /// Formatted to fit on an 80-column command shell
+                return
+                    L" TimeSlice     SendBps    RecvBps  In-Flight   Flows  Fairness  Errors \n";
+                ///   00000000.0..0000000000.0000000000..000000000.0000000..00000000..000000.
+                ///   1   5    0    5    0    5    0    5    0    5    0    5    0    5    0    5    0
+                ///           10        20        30        40        50        60        70        80
+            }
+        }
+
+    private:
+        // constant offsets for each numeric value to print
+        static const int TimeSliceOffset = 10;
+        static const int TimeSliceLength = 10;
+
+        static const int SendBytesPerSecondOffset = 22;
+        static const int SendBytesPerSecondLength = 10;
+
+        static const int RecvBytesPerSecondOffset = 33;
+        static const int RecvBytesPerSecondLength = 10;
+
+        static const int CurrentTransactionsOffset = 44;
+        static const int CurrentTransactionsLength = 9;
+
+        static const int FlowsOffset = 52;
+        static const int FlowsLength = 7;
+
+        static const int FairnessOffset = 62;
+        static const int FairnessLength = 8;
+
+        static const int ErrorsOffset = 70;
+        static const int ErrorsLength = 6;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Print function for the TCP Message pattern
+    /// - messages are counted (and their latency recorded) by the server as each is reassembled
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsMessageStatusInformation : public ctsStatusInformation {
+    public:
+        ctsMessageStatusInformation() throw() : ctsStatusInformation()
+        {
+        }
+        ~ctsMessageStatusInformation() throw()
+        {
+        }
+
+        PrintingStatus format_data(ctsConfig::StatusFormatting _format, long long _current_time, bool _clear_status) throw()
+        {
+            ctsTcpStatistics tcp_data(ctsConfig::Settings->TcpStatusDetails.snap_view(_clear_status));
+            ctsConnectionStatistics connection_data(ctsConfig::Settings->ConnectionStatusDetails.snap_view(_clear_status));
+            ctl::ctHistogram message_reassembly_usec;
+            ctsConfig::Settings->MessageReassemblyStatusDetails.snap(message_reassembly_usec, _clear_status);
+
+            long long time_elapsed = tcp_data.end_time.get() - tcp_data.start_time.get();
+            long long send_bytes_per_second = (time_elapsed > 0LL) ? tcp_data.bytes_sent.get() * 1000LL / time_elapsed : 0LL;
+            long long recv_bytes_per_second = (time_elapsed > 0LL) ? tcp_data.bytes_recv.get() * 1000LL / time_elapsed : 0LL;
+            long long messages_per_second = (time_elapsed > 0LL) ? tcp_data.messages.get() * 1000LL / time_elapsed : 0LL;
+            long long error_count = connection_data.connection_error_count.get() + connection_data.protocol_error_count.get();
+
+            if (ctsConfig::StatusFormatting::Csv == _format) {
+                unsigned long characters_written = 0;
+                // converting milliseconds to seconds before printing
+                characters_written += this->append_csvoutput(characters_written, TimeSliceLength, static_cast<float>(_current_time / 1000.0));
+                characters_written += this->append_csvoutput(characters_written, SendBytesPerSecondLength, send_bytes_per_second);
+                characters_written += this->append_csvoutput(characters_written, RecvBytesPerSecondLength, recv_bytes_per_second);
+                characters_written += this->append_csvoutput(characters_written, MessagesPerSecondLength, messages_per_second);
+                characters_written += this->append_csvoutput(characters_written, LatencyLength, message_reassembly_usec.percentile(50.0));
+                characters_written += this->append_csvoutput(characters_written, LatencyLength, message_reassembly_usec.percentile(99.0));
+                characters_written += this->append_csvoutput(characters_written, LatencyLength, message_reassembly_usec.maximum());
+                characters_written += this->append_csvoutput(characters_written, ErrorsLength, error_count, false); // no comma at the end
+                this->terminate_string(characters_written);
+
+            } else {
+                // converting milliseconds to seconds before printing
+                this->right_justify_output(TimeSliceOffset, TimeSliceLength, static_cast<float>(_current_time / 1000.0));
+                this->right_justify_output(SendBytesPerSecondOffset, SendBytesPerSecondLength, send_bytes_per_second);
+                this->right_justify_output(RecvBytesPerSecondOffset, RecvBytesPerSecondLength, recv_bytes_per_second);
+                this->right_justify_output(MessagesPerSecondOffset, MessagesPerSecondLength, messages_per_second);
+                this->right_justify_output(LatencyMedianOffset, LatencyLength, message_reassembly_usec.percentile(50.0));
+                this->right_justify_output(LatencyTailOffset, LatencyLength, message_reassembly_usec.percentile(99.0));
+                this->right_justify_output(LatencyMaximumOffset, LatencyLength, message_reassembly_usec.maximum());
+                this->right_justify_output(ErrorsOffset, ErrorsLength, error_count);
+                this->terminate_string(ErrorsOffset);
+            }
+
+            return PrintComplete;
+        }
+
+        LPCWSTR format_legend() throw()
+        {
+            return
+                L"Legend:\n"
+                L"* TimeSlice - (seconds) cumulative runtime\n"
+                L"* Send & Recv Rates - bytes/sec that were transferred within the TimeSlice period\n"
+                L"* Msgs/Sec - messages framed (client) or reassembled (server) per second within the TimeSlice period\n"
+                L"* P50(us) - (microseconds) the median time from receiving the first byte of a message until its last byte\n"
+                L"* P99(us) - (microseconds) the 99th percentile time from receiving the first byte of a message until its last byte\n"
+                L"* Max(us) - (microseconds) the largest time from receiving the first byte of a message until its last byte\n"
+                L"* Errors - cumulative count of failed IO patterns due to Winsock errors or invalid message headers\n"
+                L"\n";
+        }
+
+        LPCWSTR format_header(ctsConfig::StatusFormatting _format) throw()
+        {
+            if (ctsConfig::StatusFormatting::Csv == _format) {
+                return
+                    L"TimeSlice,SendBps,RecvBps,Msgs/Sec,P50(us),P99(us),Max(us),Errors\n";
+
+            } else {
+                /// Formatted to fit on an 80-column command shell
+                return
+                    L" TimeSlice     SendBps    RecvBps  Msgs/Sec  P50(us)  P99(us)  Max(us)  Errors \n";
+                ///   00000000.0..0000000000.0000000000..00000000..0000000..0000000..0000000..000000.
+                ///   1   5    0    5    0    5    0    5    0    5    0    5    0    5    0    5    0
+                ///           10        20        30        40        50        60        70        80
+            }
+        }
+
+    private:
+        // constant offsets for each numeric value to print
+        static const int TimeSliceOffset = 10;
+        static const int TimeSliceLength = 10;
+
+        static const int SendBytesPerSecondOffset = 22;
+        static const int SendBytesPerSecondLength = 10;
+
+        static const int RecvBytesPerSecondOffset = 33;
+        static const int RecvBytesPerSecondLength = 10;
+
+        static const int MessagesPerSecondOffset = 43;
+        static const int MessagesPerSecondLength = 8;
+
+        static const int LatencyMedianOffset = 52;
+        static const int LatencyTailOffset = 61;
+        static const int LatencyMaximumOffset = 70;
+        static const int LatencyLength = 7;
+
+        static const int ErrorsOffset = 78;
+        static const int ErrorsLength = 6;
+    };
+
 
 } // namespace
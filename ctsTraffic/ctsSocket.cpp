@@ -25,6 +25,10 @@ See the Apache Version 2.0 License for specific language governing permissions a
 
 // project headers
 #include "ctsConfig.h"
+#include "ctsCongestionControl.h"
+#include "ctsConnectionOutliers.h"
+#include "ctsIoScheduler.h"
+#include "ctsTrafficClass.h"
 #include "ctsSocketState.h"
 
 
@@ -43,7 +47,9 @@ namespace ctsTraffic {
       tp_timer(),
       io_pattern(),
       parent(_parent),
-      last_error(ctsIOPatternStatusIORunning)
+      last_error(ctsIOPatternStatusIORunning),
+      congestion_control(ctsCongestionControl::AssignAlgorithm()),
+      qos_flow_id(0)
     {
         /// using a common spin count from base OS usage & crt usage
         if (!::InitializeCriticalSectionEx(&this->socket_cs, 4000, 0)) {
@@ -64,6 +70,11 @@ namespace ctsTraffic {
         //   (a race-condition touching the io_pattern with deleting the io_pattern)
         this->io_pattern.reset();
 
+        // -IoScheduler tracks connections by their address
+        if (ctsConfig::Settings->IoScheduler != ctsConfig::IoSchedulerType::NoScheduler) {
+            ctsIoScheduler::RemoveConnection(this);
+        }
+
         ::DeleteCriticalSection(&this->socket_cs);
     }
 
@@ -90,6 +101,9 @@ namespace ctsTraffic {
             _socket, this->socket);
 
         this->socket = _socket;
+
+        // -CongestionControl : failing to apply the algorithm is logged, and the connection continues with the default
+        ctsCongestionControl::ApplyAlgorithm(this->socket, this->congestion_control);
     }
 
     void ctsSocket::close_socket() throw()
@@ -104,6 +118,20 @@ namespace ctsTraffic {
         ctAutoReleaseCriticalSection auto_lock(&this->socket_cs);
 
         if (this->socket != INVALID_SOCKET) {
+            // -Teardown:rst : once the transfer has completed, close with an RST instead of a FIN
+            if (NO_ERROR == this->last_error && ctsConfig::AbortsOnClose()) {
+                LINGER linger_option;
+                linger_option.l_onoff = 1;
+                linger_option.l_linger = 0;
+                if (SOCKET_ERROR == ::setsockopt(this->socket, SOL_SOCKET, SO_LINGER, reinterpret_cast<const char*>(&linger_option), static_cast<int>(sizeof(linger_option)))) {
+                    ctsConfig::PrintErrorIfFailed(L"setsockopt(SO_LINGER)", ::WSAGetLastError());
+                }
+            }
+            if (NO_ERROR == this->last_error) {
+                ctsCongestionControl::RecordConnection(this->socket, this->congestion_control);
+            }
+            ctsTrafficClass::RemoveClass(this->socket, this->qos_flow_id);
+            this->qos_flow_id = 0;
             ::closesocket(this->socket);
             this->socket = INVALID_SOCKET;
         }
@@ -129,6 +157,9 @@ namespace ctsTraffic {
         // caller (parent) is assumed to serialize access
         try {
             this->io_pattern = ctsIOPattern::MakeIOPattern();
+            this->io_pattern->register_socket(this->shared_from_this());
+            // local and target addresses are both known once the pattern is constructed
+            ctsConnectionOutliers::Track(this->io_pattern, this->get_local(), this->get_target());
         }
         catch (const ctException& e) {
             return (e.why() != 0 ? e.why() : ERROR_OUTOFMEMORY);
@@ -136,6 +167,13 @@ namespace ctsTraffic {
         catch (const exception&) {
             return ERROR_OUTOFMEMORY;
         }
+
+        // -Dscp : TCP sockets are connected by now, so their outgoing packets can be marked
+        // - failing to mark fails the connection, rather than letting it run unmarked
+        ctAutoReleaseCriticalSection auto_lock(&this->socket_cs);
+        if (this->socket != INVALID_SOCKET) {
+            return ctsTrafficClass::ApplyClass(this->socket, this->io_pattern->get_traffic_class(), this->target_address, this->qos_flow_id);
+        }
         return NO_ERROR;
     }
 
@@ -244,8 +282,9 @@ namespace ctsTraffic {
         }
         //
         // if we now need a FIN, invoke shutdown() first to ensure a FIN is sent to the target
+        // - unless -Teardown has this side defer its FIN until the peer's FIN arrives
         //
-        if (ctsIOPatternStatus::RequestFIN == next_pattern_status) {
+        if (ctsIOPatternStatus::RequestFIN == next_pattern_status && ctsConfig::InitiatesTeardown()) {
             SOCKET s = this->lock_socket();
             { // scoping the lifetime of the lock
                 if (s != INVALID_SOCKET) {
@@ -298,6 +337,16 @@ namespace ctsTraffic {
     }
 
     void ctsSocket::complete_state(DWORD _dwerror) throw()
+    {
+        this->complete_state_impl(_dwerror, false);
+    }
+
+    void ctsSocket::complete_state_inline(DWORD _dwerror) throw()
+    {
+        this->complete_state_impl(_dwerror, true);
+    }
+
+    void ctsSocket::complete_state_impl(DWORD _dwerror, bool _run_inline) throw()
     {
         LONG current_io_count = ::InterlockedCompareExchange(&this->io_count, 0, 0);
         ctFatalCondition(
@@ -324,7 +373,11 @@ namespace ctsTraffic {
         auto ref_parent(this->parent.lock());
         if (ref_parent) {
             auto gle = this->get_last_error();
-            ref_parent->complete_state(gle);
+            if (_run_inline) {
+                ref_parent->complete_state_inline(gle);
+            } else {
+                ref_parent->complete_state(gle);
+            }
         }
     }
 
@@ -362,6 +415,15 @@ namespace ctsTraffic {
         return io_value;
     }
 
+    void ctsSocket::resume_io() throw()
+    {
+        ctsConfig::Settings->IoFunction(this->shared_from_this());
+        if (0 == this->decrement_io()) {
+            // if we have no more IO pended, complete the state
+            this->complete_state(NO_ERROR);
+        }
+    }
+
     unsigned int ctsSocket::get_last_error() const throw()
     {
         ctAutoReleaseCriticalSection auto_lock(&this->socket_cs);
@@ -19,6 +19,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // os headers
 #include <Winsock2.h>
 #include <windows.h>
+#include <qos2.h>
 // ctl headers
 #include <ctThreadIocp.hpp>
 #include <ctThreadPoolTimer.hpp>
@@ -145,6 +146,12 @@ namespace ctsTraffic {
         ///
         void complete_state(DWORD _dwerror) throw();
 
+        ///
+        /// complete_state which can run the next state inline on the calling thread
+        /// - only to be called holding no locks: not the socket lock nor any lock of the caller
+        ///
+        void complete_state_inline(DWORD _dwerror) throw();
+
         ///
         /// Gets/Sets the local address of the SOCKET
         ///
@@ -169,6 +176,12 @@ namespace ctsTraffic {
         LONG increment_io() throw();
         LONG decrement_io() throw();
 
+        ///
+        /// Called by the IO pattern once IO it had paused can continue (recv buffers back from -VerifyThreads)
+        /// - invokes the IO function, then releases the IO count the pattern took when it paused
+        ///
+        void resume_io() throw();
+
         ///
         /// methods for constructing a new IO Pattern
         /// - construct returns a Win32 error code if can construct the pattern
@@ -209,6 +222,8 @@ namespace ctsTraffic {
         void set_last_error(DWORD _error) throw();
         void reset_last_error() throw();
 
+        void complete_state_impl(DWORD _dwerror, bool _run_inline) throw();
+
         // private members for this socket instance
         // mutable is requred to EnterCS/LeaveCS in const methods
 
@@ -236,6 +251,13 @@ namespace ctsTraffic {
 
         _Guarded_by_(socket_cs)
         unsigned                            last_error;
+
+        // the index into Settings->CongestionControls assigned to this connection
+        const unsigned long                 congestion_control;
+
+        // the qWAVE flow this socket was added to for -Dscp (0 if not marked)
+        _Guarded_by_(socket_cs)
+        QOS_FLOWID                          qos_flow_id;
     };
 
 } // namespace
@@ -37,7 +37,8 @@ namespace ctsTraffic {
         total_connections_remaining(0),
         pending_limit(0),
         pending_sockets(0),
-        active_sockets(0)
+        active_sockets(0),
+        draining(false)
     {
         if (ctsConfig::Settings->AcceptFunction) {
             // server 'accept' settings
@@ -180,6 +181,51 @@ namespace ctsTraffic {
         return fReturn;
     }
 
+    void ctsSocketBroker::drain(DWORD _milliseconds) throw()
+    {
+        // TimerCallback stops creating sockets, and sets done_event once no sockets are transferring data
+        // - sockets not yet transferring data are told not to start
+        // - calling back into the sockets outside the broker lock: their states can complete inline back into the broker
+        std::vector<std::shared_ptr<ctsSocketState>> sockets_to_drain;
+        try {
+            ctl::ctAutoReleaseCriticalSection lock_broker(&this->cs);
+            this->draining = true;
+            sockets_to_drain = this->socket_pool;
+        }
+        catch (const std::bad_alloc&) {
+            // the d'tor will tear down the remaining sockets
+            return;
+        }
+        for (auto& socket_state : sockets_to_drain) {
+            socket_state->drain();
+        }
+        sockets_to_drain.clear();
+
+        if (this->wait(_milliseconds)) {
+            return;
+        }
+
+        std::vector<std::shared_ptr<ctsSocketState>> sockets_to_abort;
+        try {
+            ctl::ctAutoReleaseCriticalSection lock_broker(&this->cs);
+            sockets_to_abort = this->socket_pool;
+        }
+        catch (const std::bad_alloc&) {
+            // the d'tor will tear down the remaining sockets
+            return;
+        }
+
+        ctsConfig::PrintDebug(
+            L"\t\tctsSocketBroker: aborting the sockets which did not drain (%Iu sockets in the pool)\n",
+            sockets_to_abort.size());
+        for (auto& socket_state : sockets_to_abort) {
+            socket_state->abort();
+        }
+        sockets_to_abort.clear();
+
+        this->wait(AbortedCallbackTimeout);
+    }
+
     ///
     /// Timer callback to scavenge any closed sockets
     /// Then refresh sockets that should be created anew
@@ -204,7 +250,14 @@ namespace ctsTraffic {
 
         // refresh our pool of sockets if more sockets should be added
         try {
-            if ((0 == _broker->total_connections_remaining) &&
+            if (_broker->draining) {
+                /// no new sockets are created once the time limit expired
+                /// - done once no sockets are transferring data: those still pending are closed by the d'tor
+                if (0 == _broker->active_sockets) {
+                    ::SetEvent(_broker->done_event.get());
+                }
+
+            } else if ((0 == _broker->total_connections_remaining) &&
                  (0 == _broker->pending_sockets) &&
                  (0 == _broker->active_sockets)) {
                 /// it's time to exit if no more work is to be done
@@ -43,6 +43,13 @@ namespace ctsTraffic {
 
         bool wait(DWORD _milliseconds) throw();
 
+        ///
+        /// Called once the time limit has expired
+        /// - stops making new connections, giving those transferring data _milliseconds to complete
+        ///   then aborts those remaining all at once so their Closing states run in parallel on the threadpool
+        ///
+        void drain(DWORD _milliseconds) throw();
+
         /// not copyable
         ctsSocketBroker(const ctsSocketBroker&) = delete;
         ctsSocketBroker& operator=(const ctsSocketBroker&) = delete;
@@ -52,6 +59,8 @@ namespace ctsTraffic {
         /// - delete any closed sockets
         /// - create new sockets
         static const unsigned int TimerCallbackTimeout = 333; // millseconds
+        /// time given to aborted connections to run their Closing state before the broker is destroyed
+        static const unsigned int AbortedCallbackTimeout = 5000; // millseconds
 
         /// CS to guard access to the vector socket_pool
         CRITICAL_SECTION cs;
@@ -69,6 +78,8 @@ namespace ctsTraffic {
         unsigned long pending_limit;
         unsigned long pending_sockets;
         unsigned long active_sockets;
+        /// set once the time limit has expired: no new sockets are created
+        bool draining;
 
         ///
         /// Callback for the threadpool timer to scavenge closed sockets and recreate new ones
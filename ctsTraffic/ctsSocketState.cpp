@@ -30,6 +30,11 @@ namespace ctsTraffic {
     using namespace ctl;
     using namespace std;
 
+    ///
+    /// the depth of ctsSocketState states currently running nested on this thread
+    ///
+    static __declspec(thread) unsigned long s_InlineStateDepth = 0;
+
 
     ctsSocketState::ctsSocketState(ctsSocketBroker* _broker)
     : thread_pool_worker(nullptr),
@@ -38,7 +43,9 @@ namespace ctsTraffic {
       socket(),
       broker(_broker),
       state(Creating),
-      initiated_io(false)
+      initiated_io(false),
+      draining(false),
+      aborted(false)
     {
         if (!::InitializeCriticalSectionEx(&state_guard, 4000, 0)) {
             throw ctException(::GetLastError(), L"InitializeCriticalSectionEx", L"ctsSocketState", false);
@@ -88,8 +95,19 @@ namespace ctsTraffic {
     }
 
     void ctsSocketState::complete_state(DWORD _dwerror) throw()
+    {
+        this->complete_state_impl(_dwerror, false);
+    }
+
+    void ctsSocketState::complete_state_inline(DWORD _dwerror) throw()
+    {
+        this->complete_state_impl(_dwerror, true);
+    }
+
+    void ctsSocketState::complete_state_impl(DWORD _dwerror, bool _run_inline) throw()
     {
         bool initiating_io = false;
+        State next_state;
         //
         // must guard the entire switch statement with a state guard
         //
@@ -158,6 +176,7 @@ namespace ctsTraffic {
             }
             this->state = Closing;
         }
+        next_state = this->state;
         //
         // release the state lock now that transitions were performed
         //
@@ -180,14 +199,25 @@ namespace ctsTraffic {
         //   but complete_state can be called under low memory conditions before an error was set
         // - otherwise, if not closing, reset the last error for the next state
         //
-        if (Closing == this->state) {
+        if (Closing == next_state) {
             this->socket->set_last_error(_dwerror);
         } else {
             this->socket->reset_last_error();
         }
 
-        // schedule the next functor to run when not closing down the socket
-        ::SubmitThreadpoolWork(this->thread_pool_worker);
+        //
+        // run the next functor inline on this completing thread only if the caller holds no locks
+        // - Closing always runs on the threadpool (see the Closing case in run_state)
+        // - also falling back to the threadpool to bound the recursion as states complete inline
+        //   (the caller of complete_state holds a reference on this object while it runs inline)
+        //
+        if (_run_inline && next_state != Closing && s_InlineStateDepth < MaximumInlineStateDepth) {
+            ++s_InlineStateDepth;
+            this->run_state();
+            --s_InlineStateDepth;
+        } else {
+            ::SubmitThreadpoolWork(this->thread_pool_worker);
+        }
     }
 
 
@@ -204,9 +234,70 @@ namespace ctsTraffic {
         ctl::ctAutoReleaseCriticalSection lock_broker(&this->broker_guard);
         this->broker = nullptr;
     }
+    ///
+    /// connections which have not yet started IO will close instead of starting it
+    ///
+    void ctsSocketState::drain() throw()
+    {
+        ctl::ctAutoReleaseCriticalSection lock_state(&this->state_guard);
+        this->draining = true;
+    }
+    ///
+    /// every connection not yet closing is aborted
+    /// - closing the socket fails its pended IO (or connect), completing it to Closing on the threadpool
+    /// - states not yet run see the draining flag and close instead of starting
+    ///
+    void ctsSocketState::abort() throw()
+    {
+        std::shared_ptr<ctsSocket> socket_to_close;
+        bool initiated = false;
+        {
+            ctl::ctAutoReleaseCriticalSection lock_state(&this->state_guard);
+            if (this->state < Closing) {
+                this->draining = true;
+                this->aborted = true;
+                // the socket is only assigned before leaving the Creating state
+                if (this->state != Creating) {
+                    socket_to_close = this->socket;
+                }
+                initiated = (InitiatedIO == this->state);
+            }
+        }
+        // not holding the state lock as IO can complete inline back into complete_state
+        if (socket_to_close) {
+            socket_to_close->close_socket();
+            // some IO functions (MediaStream server) do not pend IO on the socket
+            // - those must be told directly to complete the connection
+            if (initiated && ctsConfig::Settings->AbortFunction) {
+                ctsConfig::Settings->AbortFunction(weak_ptr<ctsSocket>(socket_to_close));
+            }
+        }
+    }
+
+    ///
+    /// checked under the state lock before each state starts its functor
+    /// - once draining, the connection is completed as aborted instead of starting new work
+    ///
+    _Requires_lock_held_(state_guard)
+    bool ctsSocketState::check_draining() throw()
+    {
+        if (this->draining) {
+            this->aborted = true;
+        }
+        return this->draining;
+    }
 
 
     VOID NTAPI ctsSocketState::ThreadPoolWorker(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) throw()
+    {
+        // states completed from within this functor count against the inline depth of this thread
+        ctsSocketState* context = reinterpret_cast<ctsSocketState*>(_context);
+        ++s_InlineStateDepth;
+        context->run_state();
+        --s_InlineStateDepth;
+    }
+
+    void ctsSocketState::run_state() throw()
     {
         //
         // invoke the corresponding function object
@@ -216,12 +307,11 @@ namespace ctsTraffic {
         // - since this could complete inline if it fails, and complete_state
         //   needs to know that we already tried to run the functor for this state
         //
-        ctsSocketState* context = reinterpret_cast<ctsSocketState*>(_context);
-        switch (context->state) {
+        switch (this->state) {
             case Creating: {
                 unsigned long error = 0;
                 try {
-                    context->socket = make_shared<ctsSocket>(std::weak_ptr<ctsSocketState>(context->shared_from_this()));
+                    this->socket = make_shared<ctsSocket>(std::weak_ptr<ctsSocketState>(this->shared_from_this()));
                 }
                 catch (const ctl::ctException& e) {
                     error = e.why() == 0 ? ERROR_OUTOFMEMORY : e.why();
@@ -231,36 +321,54 @@ namespace ctsTraffic {
                 }
 
                 if (error != 0) {
-                    context->complete_state(error);
+                    this->complete_state(error);
 
                 } else {
-                    ::EnterCriticalSection(&context->state_guard);
-                    context->state = Created;
-                    ::LeaveCriticalSection(&context->state_guard);
+                    ::EnterCriticalSection(&this->state_guard);
+                    this->state = Created;
+                    bool is_draining = this->check_draining();
+                    ::LeaveCriticalSection(&this->state_guard);
 
-                    ctsConfig::Settings->CreateFunction(weak_ptr<ctsSocket>(context->socket));
-                    ctsConfig::PrintDebug(L"\t\tctsSocketState Created\n");
+                    if (is_draining) {
+                        this->complete_state(WSAECONNABORTED);
+                    } else {
+                        ctsConfig::Settings->CreateFunction(weak_ptr<ctsSocket>(this->socket));
+                        ctsConfig::PrintDebug(L"\t\tctsSocketState Created\n");
+                    }
                 }
                 break;
             }
 
-            case Connecting:
-                ::EnterCriticalSection(&context->state_guard);
-                context->state = Connected;
-                ::LeaveCriticalSection(&context->state_guard);
+            case Connecting: {
+                ::EnterCriticalSection(&this->state_guard);
+                this->state = Connected;
+                bool is_draining = this->check_draining();
+                ::LeaveCriticalSection(&this->state_guard);
 
-                ctsConfig::Settings->ConnectFunction(weak_ptr<ctsSocket>(context->socket));
-                ctsConfig::PrintDebug(L"\t\tctsSocketState Connected\n");
+                if (is_draining) {
+                    this->complete_state(WSAECONNABORTED);
+                } else {
+                    ctsConfig::Settings->ConnectFunction(weak_ptr<ctsSocket>(this->socket));
+                    ctsConfig::PrintDebug(L"\t\tctsSocketState Connected\n");
+                }
                 break;
+            }
 
-            case InitiatingIO:
-                ::EnterCriticalSection(&context->state_guard);
-                context->state = InitiatedIO;
-                ::LeaveCriticalSection(&context->state_guard);
+            case InitiatingIO: {
+                // moving to InitiatedIO even when draining, so Closing balances the active counts taken for this connection
+                ::EnterCriticalSection(&this->state_guard);
+                this->state = InitiatedIO;
+                bool is_draining = this->check_draining();
+                ::LeaveCriticalSection(&this->state_guard);
 
-                ctsConfig::Settings->IoFunction(weak_ptr<ctsSocket>(context->socket));
-                ctsConfig::PrintDebug(L"\t\tctsSocketState InitiatedIO\n");
+                if (is_draining) {
+                    this->complete_state(WSAECONNABORTED);
+                } else {
+                    ctsConfig::Settings->IoFunction(weak_ptr<ctsSocket>(this->socket));
+                    ctsConfig::PrintDebug(L"\t\tctsSocketState InitiatedIO\n");
+                }
                 break;
+            }
 
                 ///
                 /// Processing all closing tasks on a separate threadpool thread
@@ -269,14 +377,14 @@ namespace ctsTraffic {
                 ///   on a threadpool thread - in which case it would deadlock on itself
                 ///
             case Closing: {
-                ::EnterCriticalSection(&context->broker_guard);
-                if (context->broker != nullptr) {
-                    context->broker->closing(context->initiated_io);
+                ::EnterCriticalSection(&this->broker_guard);
+                if (this->broker != nullptr) {
+                    this->broker->closing(this->initiated_io);
                 }
-                ::LeaveCriticalSection(&context->broker_guard);
+                ::LeaveCriticalSection(&this->broker_guard);
 
-                if (context->initiated_io) {
-                    auto gle = context->socket->get_last_error();
+                if (this->initiated_io) {
+                    auto gle = this->socket->get_last_error();
 
                     // Update the status counter if we previously tracked this connection as active
                     ctsConfig::Settings->ConnectionStatusDetails.active_connection_count.decrement();
@@ -286,6 +394,10 @@ namespace ctsTraffic {
                         ctsConfig::Settings->HistoricConnectionDetails.successful_connections.increment();
                         ctsConfig::Settings->ConnectionStatusDetails.successful_completion_count.increment();
 
+                    } else if (this->aborted) {
+                        // the transfer was cut short by the time limit: not counted as an error
+                        ctsConfig::Settings->HistoricConnectionDetails.aborted_connections.increment();
+
                     } else if (ctsIOPatternProtocolError(static_cast<ctsIOPatternStatus>(gle))) {
                         ctsConfig::Settings->HistoricConnectionDetails.protocol_errors.increment();
                         ctsConfig::Settings->ConnectionStatusDetails.protocol_error_count.increment();
@@ -294,6 +406,10 @@ namespace ctsTraffic {
                         ctsConfig::Settings->HistoricConnectionDetails.connection_errors.increment();
                         ctsConfig::Settings->ConnectionStatusDetails.connection_error_count.increment();
                     }
+                } else if (this->aborted) {
+                    // closed by the time limit before it could start IO: not counted as an error
+                    ctsConfig::Settings->HistoricConnectionDetails.aborted_connections.increment();
+
                 } else {
                     // if this socket never started IO, it never created an io_pattern to track stats
                     // - in this case, directly track the failures in the global stats
@@ -303,14 +419,14 @@ namespace ctsTraffic {
 
                 // close the socket first to snap the end-time in the stats
                 // - then print from the pattern data before destroying the io_pattern
-                context->socket->close_socket();
-                context->socket->print_pattern_results();
+                this->socket->close_socket();
+                this->socket->print_pattern_results();
 
                 // update the state last, since ctsBroker looks for this state value
                 // - to know when to delete the ctsSocketState instance
-                ::EnterCriticalSection(&context->state_guard);
-                context->state = Closed;
-                ::LeaveCriticalSection(&context->state_guard);
+                ::EnterCriticalSection(&this->state_guard);
+                this->state = Closed;
+                ::LeaveCriticalSection(&this->state_guard);
 
                 break;
             }
@@ -318,9 +434,9 @@ namespace ctsTraffic {
             default: {
                 // the callback should never see any other states
                 ctAlwaysFatalCondition(
-                    L"ctsSocketState::ThreadPoolWorker - invalid socket state [%d]",
-                    context->state);
-                ::LeaveCriticalSection(&context->state_guard);
+                    L"ctsSocketState::run_state - invalid socket state [%d]",
+                    this->state);
+                ::LeaveCriticalSection(&this->state_guard);
                 break;
             }
         }
@@ -70,9 +70,16 @@ namespace ctsTraffic {
 
         ///
         /// Completes the current socket state
+        /// - the next state runs on the threadpool
         ///
         void complete_state(DWORD) throw();
 
+        ///
+        /// Completes the current socket state, running the next state inline on this thread when possible
+        /// - only for callers holding no locks: the next state's functor would run under them
+        ///
+        void complete_state_inline(DWORD) throw();
+
         ///
         /// Accessor to current state information
         ///
@@ -92,6 +99,14 @@ namespace ctsTraffic {
         ///
         friend class ctsSocketBroker;
         void detach() throw();
+        ///
+        /// once the time limit has expired, stops a connection from starting any further states
+        ///
+        void drain() throw();
+        ///
+        /// once the drain time has expired, closes a connection in any state before Closing
+        ///
+        void abort() throw();
 
         ///
         /// private members of ctsSocketState
@@ -104,6 +119,30 @@ namespace ctsTraffic {
         std::shared_ptr<ctsSocket> socket;
         State                      state;
         bool                       initiated_io;
+        bool                       draining;
+        bool                       aborted;
+
+        ///
+        /// the number of states which can run nested on one thread before falling back to the threadpool
+        ///
+        static const unsigned long MaximumInlineStateDepth = 4;
+
+        ///
+        /// performs the state transition, then runs the next state either inline or on the threadpool
+        ///
+        void complete_state_impl(DWORD _dwerror, bool _run_inline) throw();
+
+        ///
+        /// runs the functor for the current state
+        /// - either inline from complete_state or from the threadpool callback
+        ///
+        void run_state() throw();
+
+        ///
+        /// returns if the connection should close instead of running its next state
+        ///
+        _Requires_lock_held_(state_guard)
+        bool check_draining() throw();
 
         ///
         /// static threadpool callback function
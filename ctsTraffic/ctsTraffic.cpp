@@ -27,6 +27,9 @@ See the Apache Version 2.0 License for specific language governing permissions a
 
 // local headers
 #include "ctsConfig.h"
+#include "ctsCongestionControl.h"
+#include "ctsTrafficClass.h"
+#include "ctsNetworkCounters.h"
 #include "ctsSocketBroker.h"
 
 using namespace ctsTraffic;
@@ -90,14 +93,18 @@ __cdecl wmain(_In_ int argc, _In_reads_z_(argc) wchar_t** argv)
         ctsConfig::PrintLegend();
 
         // set the start timer as close as possible to the start of the engine
-        ctsConfig::Settings->StartTimeMilliseconds = ctl::ctTimer::snap_qpc_msec();
+        ctsConfig::Settings->StartTimeMilliseconds = ctl::ctTimer::snap_clock_msec();
+        ctsNetworkCounters::Start();
         ctsSocketBroker broker;
         g_SocketBroker = &broker;
 
         ctl::ctThreadpoolTimer status_timer;
         status_timer.schedule_reoccuring(ctsConfig::PrintStatusUpdate, 0LL, ctsConfig::Settings->StatusUpdateFrequencyMilliseconds);
         if (!broker.wait(ctsConfig::Settings->TimeLimit > 0 ? ctsConfig::Settings->TimeLimit : INFINITE)) {
-            throw std::runtime_error("Timelimit exceeded : aborting");
+            ctsConfig::PrintErrorInfo(
+                L"[%.3f] Timelimit exceeded : draining connections\n",
+                ctsConfig::GetStatusTimeStamp());
+            broker.drain(ctsConfig::Settings->TimeLimitDrain);
         }
     }
     catch (const ctsSafeIntException& e) {
@@ -133,10 +140,232 @@ __cdecl wmain(_In_ int argc, _In_reads_z_(argc) wchar_t** argv)
         ctsConfig::Settings->HistoricConnectionDetails.successful_connections.get(),
         ctsConfig::Settings->HistoricConnectionDetails.connection_errors.get(),
         ctsConfig::Settings->HistoricConnectionDetails.protocol_errors.get());
+    if (ctsConfig::Settings->HistoricConnectionDetails.aborted_connections.get() > 0) {
+        ctsConfig::PrintSummary(
+            L"AbortedAtTimeLimit [%lld]   (connections still transferring data when -TimeLimit expired)\n",
+            ctsConfig::Settings->HistoricConnectionDetails.aborted_connections.get());
+    }
+
+    if (ctsConfig::Settings->HistoricConnectionDetails.accept_latency_usec.count() > 0) {
+        const ctl::ctHistogram& accept_latency = ctsConfig::Settings->HistoricConnectionDetails.accept_latency_usec;
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Accept Statistics (all accepted connections over the complete lifetime)  \n"
+            L"-------------------------------------------------------------------------------\n"
+            L"Accepted [%lld]   ListenQueueOverflows [%lld]\n"
+            L"Latency(us) Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  Max [%lld]\n",
+            accept_latency.count(),
+            ctsConfig::Settings->HistoricConnectionDetails.accept_overflows.get(),
+            accept_latency.minimum(),
+            accept_latency.mean(),
+            accept_latency.percentile(50.0),
+            accept_latency.percentile(90.0),
+            accept_latency.percentile(99.0),
+            accept_latency.maximum());
+    }
+
+    if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol && !ctsConfig::IsListening()) {
+        const ctl::ctHistogram& connect_latency = ctsConfig::Settings->HistoricConnectionDetails.connect_latency_usec;
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Connect Statistics (all connect attempts over the complete lifetime)  \n"
+            L"-------------------------------------------------------------------------------\n"
+            L"Connected [%lld]   Refused [%lld]   TimedOut [%lld]   Unreachable [%lld]   NoPorts [%lld]   OtherErrors [%lld]\n"
+            L"Latency(us) Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  P99.9 [%lld]  Max [%lld]\n",
+            connect_latency.count(),
+            ctsConfig::Settings->HistoricConnectionDetails.connect_refused.get(),
+            ctsConfig::Settings->HistoricConnectionDetails.connect_timed_out.get(),
+            ctsConfig::Settings->HistoricConnectionDetails.connect_unreachable.get(),
+            ctsConfig::Settings->HistoricConnectionDetails.connect_no_ports.get(),
+            ctsConfig::Settings->HistoricConnectionDetails.connect_other_errors.get(),
+            connect_latency.minimum(),
+            connect_latency.mean(),
+            connect_latency.percentile(50.0),
+            connect_latency.percentile(90.0),
+            connect_latency.percentile(99.0),
+            connect_latency.percentile(99.9),
+            connect_latency.maximum());
+    }
+
+    if (!ctsConfig::Settings->CongestionControls.empty()) {
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Congestion Control Statistics (connections by -CongestionControl algorithm)  \n"
+            L"-------------------------------------------------------------------------------\n");
+        for (unsigned long index = 0; index < ctsConfig::Settings->CongestionControls.size(); ++index) {
+            const ctsConfig::CongestionControlWeight& congestion_control = ctsConfig::Settings->CongestionControls[index];
+            const ctsCongestionControl::ctsCongestionControlStatistics& stats = ctsCongestionControl::GetStatistics(index);
+            ctsConfig::PrintSummary(
+                L"%s (weight %lu)   Connections [%lld]   Bytes [%lld]   RetransmittedBytes [%lld]   TimeoutEpisodes [%lld]\n"
+                L"\tBytes/sec Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  Max [%lld]\n"
+                L"\tRTT(us) Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  Max [%lld]\n",
+                (ctsConfig::CongestionControlType::LedbatCongestionControl == congestion_control.algorithm) ? L"ledbat" : L"default",
+                congestion_control.weight,
+                stats.connections.get(),
+                stats.bytes_transferred.get(),
+                stats.bytes_retransmitted.get(),
+                stats.timeout_episodes.get(),
+                stats.bytes_per_second.minimum(),
+                stats.bytes_per_second.mean(),
+                stats.bytes_per_second.percentile(50.0),
+                stats.bytes_per_second.percentile(90.0),
+                stats.bytes_per_second.maximum(),
+                stats.rtt_usec.minimum(),
+                stats.rtt_usec.mean(),
+                stats.rtt_usec.percentile(50.0),
+                stats.rtt_usec.percentile(90.0),
+                stats.rtt_usec.percentile(99.0),
+                stats.rtt_usec.maximum());
+        }
+    }
+
+    if (!ctsConfig::Settings->TrafficClasses.empty()) {
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Traffic Class Statistics (connections by -Dscp class)  \n"
+            L"-------------------------------------------------------------------------------\n");
+        for (unsigned long index = 0; index < ctsConfig::Settings->TrafficClasses.size(); ++index) {
+            const ctsConfig::TrafficClassWeight& traffic_class = ctsConfig::Settings->TrafficClasses[index];
+            const ctsTrafficClass::ctsTrafficClassStatistics& stats = ctsTrafficClass::GetStatistics(index);
+            ctsConfig::PrintSummary(
+                L"DSCP %lu (weight %lu)   Connections [%lld]   Bytes [%lld]\n",
+                traffic_class.dscp,
+                traffic_class.weight,
+                stats.connections.get(),
+                stats.bytes_transferred.get());
+
+            const ctl::ctHistogram* latency = nullptr;
+            LPCWSTR latency_name = nullptr;
+            if (ctsConfig::ProtocolType::UDP == ctsConfig::Settings->Protocol) {
+                ctsConfig::PrintSummary(
+                    L"\tFrames [%lld]   Dropped [%lld]\n",
+                    stats.successful_frames.get(),
+                    stats.dropped_frames.get());
+                latency = &stats.round_trip_usec;
+                latency_name = L"RTT(us)";
+            } else if (stats.message_reassembly_usec.count() > 0) {
+                latency = &stats.message_reassembly_usec;
+                latency_name = L"MessageReassembly(us)";
+            } else {
+                latency = &stats.segment_latency_usec;
+                latency_name = L"SegmentLatency(us)";
+            }
+            if (latency->count() > 0) {
+                ctsConfig::PrintSummary(
+                    L"\t%s Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  P99.9 [%lld]  Max [%lld]\n",
+                    latency_name,
+                    latency->minimum(),
+                    latency->mean(),
+                    latency->percentile(50.0),
+                    latency->percentile(90.0),
+                    latency->percentile(99.0),
+                    latency->percentile(99.9),
+                    latency->maximum());
+            }
+        }
+    }
+
+    if (ctsConfig::IoPatternType::Echo == ctsConfig::Settings->IoPattern && !ctsConfig::IsListening()) {
+        const ctl::ctHistogram& round_trip = ctsConfig::Settings->HistoricUdpDetails.round_trip_usec;
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Round-Trip Statistics (all echo probes over the complete lifetime)  \n"
+            L"-------------------------------------------------------------------------------\n"
+            L"Probes [%lld]   Lost [%lld]   Reordered [%lld]   Repeated [%lld]\n"
+            L"RTT(us) Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  P99.9 [%lld]  Max [%lld]\n",
+            ctsConfig::Settings->HistoricUdpDetails.successful_frames.get(),
+            ctsConfig::Settings->HistoricUdpDetails.dropped_frames.get(),
+            ctsConfig::Settings->HistoricUdpDetails.reordered_frames.get(),
+            ctsConfig::Settings->HistoricUdpDetails.duplicate_frames.get(),
+            round_trip.minimum(),
+            round_trip.mean(),
+            round_trip.percentile(50.0),
+            round_trip.percentile(90.0),
+            round_trip.percentile(99.0),
+            round_trip.percentile(99.9),
+            round_trip.maximum());
+    }
+
+    if (ctsConfig::IoPatternType::PushPull == ctsConfig::Settings->IoPattern && ctsConfig::Settings->PushPullPipeline > 0 && !ctsConfig::IsListening()) {
+        const ctl::ctHistogram& segment_latency = ctsConfig::Settings->HistoricTcpDetails.segment_latency_usec;
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Segment Latency (all pipelined push/pull segments over the complete lifetime)  \n"
+            L"-------------------------------------------------------------------------------\n"
+            L"Segments [%lld]\n"
+            L"Latency(us) Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  P99.9 [%lld]  Max [%lld]\n",
+            segment_latency.count(),
+            segment_latency.minimum(),
+            segment_latency.mean(),
+            segment_latency.percentile(50.0),
+            segment_latency.percentile(90.0),
+            segment_latency.percentile(99.0),
+            segment_latency.percentile(99.9),
+            segment_latency.maximum());
+    }
+
+    if (ctsConfig::IoPatternType::Message == ctsConfig::Settings->IoPattern && ctsConfig::IsListening()) {
+        const ctl::ctHistogram& message_reassembly = ctsConfig::Settings->HistoricTcpDetails.message_reassembly_usec;
+        const long long total_time = ctsConfig::Settings->HistoricTcpDetails.total_time.get();
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Message Statistics (all messages received over the complete lifetime)  \n"
+            L"-------------------------------------------------------------------------------\n"
+            L"Messages [%lld]   Messages/Sec (per connection) [%lld]\n"
+            L"Reassembly(us) Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  P99.9 [%lld]  Max [%lld]\n",
+            ctsConfig::Settings->HistoricTcpDetails.messages.get(),
+            (total_time > 0LL) ? ctsConfig::Settings->HistoricTcpDetails.messages.get() * 1000LL / total_time : 0LL,
+            message_reassembly.minimum(),
+            message_reassembly.mean(),
+            message_reassembly.percentile(50.0),
+            message_reassembly.percentile(90.0),
+            message_reassembly.percentile(99.0),
+            message_reassembly.percentile(99.9),
+            message_reassembly.maximum());
+    }
+
+    if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol && ctsConfig::Settings->HistoricTcpDetails.bytes_sent.get() > 0) {
+        const ctl::ctHistogram& send_backlog = ctsConfig::Settings->HistoricTcpDetails.send_backlog_bytes;
+        const long long total_time = ctsConfig::Settings->HistoricTcpDetails.total_time.get();
+        const long long blocked_time = ctsConfig::Settings->HistoricTcpDetails.send_blocked_usec.get() / 1000LL;
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Send Backpressure (all connections over the complete lifetime)  \n"
+            L"-------------------------------------------------------------------------------\n"
+            L"SendBlocked [%lld ms]   (%lld%% of total connection time)\n"
+            L"SendBacklog(bytes) P50 [%lld]  P90 [%lld]  P99 [%lld]  Max [%lld]\n",
+            blocked_time,
+            (total_time > 0LL) ? blocked_time * 100LL / total_time : 0LL,
+            send_backlog.percentile(50.0),
+            send_backlog.percentile(90.0),
+            send_backlog.percentile(99.0),
+            send_backlog.maximum());
+    }
+
+    if (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol) {
+        const ctl::ctHistogram& teardown_latency = ctsConfig::Settings->HistoricTcpDetails.teardown_latency_usec;
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Historic Teardown Statistics (all completed connections over the complete lifetime)  \n"
+            L"-------------------------------------------------------------------------------\n"
+            L"Teardowns [%lld]   TIME_WAIT on port %u (at exit) [%lu]\n"
+            L"Latency(us) Min [%lld]  Mean [%lld]  P50 [%lld]  P90 [%lld]  P99 [%lld]  Max [%lld]\n",
+            teardown_latency.count(),
+            static_cast<unsigned>(ctsConfig::Settings->Port),
+            ctsConfig::GetTimeWaitCount(),
+            teardown_latency.minimum(),
+            teardown_latency.mean(),
+            teardown_latency.percentile(50.0),
+            teardown_latency.percentile(90.0),
+            teardown_latency.percentile(99.0),
+            teardown_latency.maximum());
+    }
 
+    // connections aborted at -TimeLimit did not complete their transfer: they count as failures
     long long error_count =
         ctsConfig::Settings->HistoricConnectionDetails.connection_errors.get() +
-        ctsConfig::Settings->HistoricConnectionDetails.protocol_errors.get();
+        ctsConfig::Settings->HistoricConnectionDetails.protocol_errors.get() +
+        ctsConfig::Settings->HistoricConnectionDetails.aborted_connections.get();
     if (error_count > MAXINT) {
         error_count = MAXINT;
     }
@@ -0,0 +1,192 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// parent header
+#include "ctsTrafficClass.h"
+// additional c++ headers
+#include <vector>
+// additional ctl headers
+#include <ctException.hpp>
+#include <ctLocks.hpp>
+#include <ctWeightedSchedule.hpp>
+
+
+namespace ctsTraffic {
+    namespace ctsTrafficClass {
+
+        using namespace ctl;
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Singleton values used as the actual implementation for every connection
+        ///
+        /// publicly exposed callers invoke ::InitOnceExecuteOnce(&InitImpl, InitOncectsTrafficClassImpl, NULL, NULL);
+        ///
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        static ctWeightedSchedule* AssignmentSchedule = nullptr;
+        // one per entry in Settings->TrafficClasses
+        static ctsTrafficClassStatistics* ClassStatistics = nullptr;
+        // the qWAVE handle every marked socket's flow is created under
+        // - left null if QOSCreateHandle failed, with the failure returned from every ApplyClass
+        static HANDLE QosHandle = nullptr;
+        static DWORD QosHandleError = NO_ERROR;
+
+        static INIT_ONCE InitImpl = INIT_ONCE_STATIC_INIT;
+        static
+        BOOL CALLBACK InitOncectsTrafficClassImpl(PINIT_ONCE, PVOID, PVOID *)
+        {
+            const std::vector<ctsConfig::TrafficClassWeight>& classes = ctsConfig::Settings->TrafficClasses;
+            ClassStatistics = new ctsTrafficClassStatistics[classes.empty() ? 1 : classes.size()];
+
+            if (!classes.empty()) {
+                std::vector<unsigned long> weights;
+                for (const auto& traffic_class : classes) {
+                    weights.push_back(traffic_class.weight);
+                }
+                AssignmentSchedule = new ctWeightedSchedule(weights);
+
+                QOS_VERSION qos_version;
+                qos_version.MajorVersion = 1;
+                qos_version.MinorVersion = 0;
+                if (!::QOSCreateHandle(&qos_version, &QosHandle)) {
+                    QosHandleError = ::GetLastError();
+                    QosHandle = nullptr;
+                    ctsConfig::PrintErrorIfFailed(L"QOSCreateHandle", QosHandleError);
+                }
+            }
+            return TRUE;
+        }
+        static
+        void ctsTrafficClassInitOnce() throw()
+        {
+            if (!::InitOnceExecuteOnce(&InitImpl, InitOncectsTrafficClassImpl, nullptr, nullptr)) {
+                ctAlwaysFatalCondition(L"ctsTrafficClass could not be instantiated");
+            }
+        }
+
+        unsigned long AssignClass() throw()
+        {
+            if (ctsConfig::Settings->TrafficClasses.empty()) {
+                return 0;
+            }
+            ctsTrafficClassInitOnce();
+            return AssignmentSchedule->next();
+        }
+
+        DWORD ApplyClass(SOCKET _socket, unsigned long _index, const ctSockaddr& _remote_address, QOS_FLOWID& _flow_id) throw()
+        {
+            _flow_id = 0;
+            if (ctsConfig::Settings->TrafficClasses.empty()) {
+                return NO_ERROR;
+            }
+            ctsTrafficClassInitOnce();
+            if (nullptr == QosHandle) {
+                return QosHandleError;
+            }
+
+            // connected TCP sockets are added without a destination
+            if (!::QOSAddSocketToFlow(
+                QosHandle,
+                _socket,
+                (ctsConfig::ProtocolType::TCP == ctsConfig::Settings->Protocol) ? nullptr : _remote_address.sockaddr(),
+                QOSTrafficTypeBestEffort,
+                QOS_NON_ADAPTIVE_FLOW,
+                &_flow_id)) {
+                DWORD gle = ::GetLastError();
+                ctsConfig::PrintErrorIfFailed(L"QOSAddSocketToFlow", gle);
+                _flow_id = 0;
+                return gle;
+            }
+
+            DWORD dscp = ctsConfig::Settings->TrafficClasses[_index].dscp;
+            if (!::QOSSetFlow(
+                QosHandle,
+                _flow_id,
+                QOSSetOutgoingDSCPValue,
+                static_cast<ULONG>(sizeof(dscp)),
+                &dscp,
+                0,
+                nullptr)) {
+                DWORD gle = ::GetLastError();
+                ctsConfig::PrintErrorIfFailed(L"QOSSetFlow(QOSSetOutgoingDSCPValue)", gle);
+                RemoveClass(_socket, _flow_id);
+                _flow_id = 0;
+                return gle;
+            }
+            return NO_ERROR;
+        }
+
+        void RemoveClass(SOCKET _socket, QOS_FLOWID _flow_id) throw()
+        {
+            if (0 == _flow_id || nullptr == QosHandle) {
+                return;
+            }
+            if (!::QOSRemoveSocketFromFlow(QosHandle, _socket, _flow_id, 0)) {
+                ctsConfig::PrintErrorIfFailed(L"QOSRemoveSocketFromFlow", ::GetLastError());
+            }
+        }
+
+        void RecordConnection(unsigned long _index, const ctsTcpStatistics& _stats) throw()
+        {
+            if (ctsConfig::Settings->TrafficClasses.empty()) {
+                return;
+            }
+            ctsTrafficClassInitOnce();
+
+            ctsTrafficClassStatistics& statistics = ClassStatistics[_index];
+            statistics.connections.increment();
+            statistics.bytes_transferred.add(_stats.bytes_sent.get() + _stats.bytes_recv.get());
+        }
+
+        void RecordConnection(unsigned long _index, const ctsUdpStatistics& _stats) throw()
+        {
+            if (ctsConfig::Settings->TrafficClasses.empty()) {
+                return;
+            }
+            ctsTrafficClassInitOnce();
+
+            ctsTrafficClassStatistics& statistics = ClassStatistics[_index];
+            statistics.connections.increment();
+            statistics.bytes_transferred.add(_stats.bits_received.get() / 8);
+            statistics.successful_frames.add(_stats.successful_frames.get());
+            statistics.dropped_frames.add(_stats.dropped_frames.get());
+            statistics.round_trip_usec.merge(_stats.round_trip_usec);
+        }
+
+        void RecordMessageReassembly(unsigned long _index, long long _usec) throw()
+        {
+            if (ctsConfig::Settings->TrafficClasses.empty()) {
+                return;
+            }
+            ctsTrafficClassInitOnce();
+
+            ClassStatistics[_index].message_reassembly_usec.add(_usec);
+        }
+
+        void RecordSegmentLatency(unsigned long _index, long long _usec) throw()
+        {
+            if (ctsConfig::Settings->TrafficClasses.empty()) {
+                return;
+            }
+            ctsTrafficClassInitOnce();
+
+            ClassStatistics[_index].segment_latency_usec.add(_usec);
+        }
+
+        const ctsTrafficClassStatistics& GetStatistics(unsigned long _index) throw()
+        {
+            ctsTrafficClassInitOnce();
+            return ClassStatistics[_index];
+        }
+    }
+}
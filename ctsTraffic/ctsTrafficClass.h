@@ -0,0 +1,89 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// os headers
+#include <winsock2.h>
+#include <windows.h>
+#include <qos2.h>
+// ctl headers
+#include <ctHistogram.hpp>
+#include <ctSockaddr.hpp>
+// project headers
+#include "ctsConfig.h"
+
+
+namespace ctsTraffic {
+
+    ///
+    /// ctsTrafficClass assigns each connection one of the -Dscp classes
+    /// - connections are assigned in proportion to each class's weight, interleaved across the connections being made
+    ///
+    /// Windows ignores IP_TOS: outgoing DSCP values are set through a qWAVE flow per socket
+    /// - setting a DSCP value through qWAVE requires the process to run as an Administrator
+    ///
+    /// As each connection's IO pattern ends, its statistics are recorded against its class
+    ///
+    namespace ctsTrafficClass {
+
+        struct ctsTrafficClassStatistics {
+            ctsMemoryGuard<long long> connections;
+            // TCP : bytes sent and received - UDP : bytes received
+            ctsMemoryGuard<long long> bytes_transferred;
+            // TCP : the Message pattern's latency, and the pipelined PushPull pattern's segment latency
+            ctl::ctHistogram message_reassembly_usec;
+            ctl::ctHistogram segment_latency_usec;
+            // UDP : frames received and dropped, and the Echo pattern's round-trip time
+            ctsMemoryGuard<long long> successful_frames;
+            ctsMemoryGuard<long long> dropped_frames;
+            ctl::ctHistogram round_trip_usec;
+        };
+
+        ///
+        /// Returns the index into Settings->TrafficClasses for the next connection
+        /// - a no-op returning 0 unless -Dscp was specified
+        ///
+        unsigned long AssignClass() throw();
+
+        ///
+        /// Marks the socket with the DSCP value of the class at _index, returning the flow it was added to
+        /// - TCP sockets must be connected; UDP sockets are marked for datagrams sent to _remote_address
+        /// - returns the Win32 error if the socket could not be marked
+        ///
+        DWORD ApplyClass(SOCKET _socket, unsigned long _index, const ctl::ctSockaddr& _remote_address, QOS_FLOWID& _flow_id) throw();
+
+        ///
+        /// Removes the socket from the flow returned from ApplyClass
+        ///
+        void RemoveClass(SOCKET _socket, QOS_FLOWID _flow_id) throw();
+
+        ///
+        /// Records the statistics of a completed IO pattern against the class at _index
+        ///
+        void RecordConnection(unsigned long _index, const ctsTcpStatistics& _stats) throw();
+        void RecordConnection(unsigned long _index, const ctsUdpStatistics& _stats) throw();
+
+        ///
+        /// Records a TCP latency against the class at _index as it is measured
+        /// - these histograms are too large to hold per connection until its pattern ends
+        ///
+        void RecordMessageReassembly(unsigned long _index, long long _usec) throw();
+        void RecordSegmentLatency(unsigned long _index, long long _usec) throw();
+
+        ///
+        /// Returns the statistics recorded for the class at _index
+        ///
+        const ctsTrafficClassStatistics& GetStatistics(unsigned long _index) throw();
+    }
+}